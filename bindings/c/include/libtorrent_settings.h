@@ -17,6 +17,7 @@ enum settings_tags_t {
 	SET_PEER_FINGERPRINT, // char const*
 	SET_DHT_BOOTSTRAP_NODES, // char const*
 	SET_WEBTORRENT_STUN_SERVER, // char const*
+	SET_DNS_SERVERS, // char const*
 	SET_ALLOW_MULTIPLE_CONNECTIONS_PER_IP, // int (0 or 1)
 	SET_SEND_REDUNDANT_HAVE, // int (0 or 1)
 	SET_USE_DHT_AS_FALLBACK, // int (0 or 1)
@@ -78,6 +79,10 @@ enum settings_tags_t {
 	SET_SSRF_MITIGATION, // int (0 or 1)
 	SET_ALLOW_IDNA, // int (0 or 1)
 	SET_ENABLE_SET_FILE_VALID_DATA, // int (0 or 1)
+	SET_WEBTORRENT_SHARE_CONNECTIONS, // int (0 or 1)
+	SET_DISK_BUFFER_HUGE_PAGES, // int (0 or 1)
+	SET_ADAPTIVE_DISK_THREADS, // int (0 or 1)
+	SET_BUILTIN_DNS_RESOLVER, // int (0 or 1)
 	SET_TRACKER_COMPLETION_TIMEOUT, // int
 	SET_TRACKER_RECEIVE_TIMEOUT, // int
 	SET_STOP_TRACKER_TIMEOUT, // int
@@ -213,6 +218,24 @@ enum settings_tags_t {
 	SET_MAX_PIECE_COUNT, // int
 	SET_MIN_WEBSOCKET_ANNOUNCE_INTERVAL, // int
 	SET_WEBTORRENT_CONNECTION_TIMEOUT, // int
+	SET_WEBTORRENT_SEND_BUFFER_LOW_WATERMARK, // int
+	SET_WEBTORRENT_SEND_BUFFER_HIGH_WATERMARK, // int
+	SET_WEBTORRENT_OFFER_POOL_SIZE, // int
+	SET_WEBTORRENT_OFFER_POOL_EXPIRY, // int
+	SET_DISK_BUFFER_SLAB_SIZE, // int
+	SET_READ_CACHE_SIZE, // int
+	SET_MAX_DIRTY_BYTES, // int
+	SET_DISK_QUEUE_READ_WEIGHT, // int
+	SET_DISK_QUEUE_WRITE_WEIGHT, // int
+	SET_DISK_QUEUE_HASH_WEIGHT, // int
+	SET_DISK_QUEUE_OTHER_WEIGHT, // int
+	SET_MOVE_STORAGE_THREADS, // int
+	SET_SCRAPE_BATCH_DELAY, // int
+	SET_MAX_CONCURRENT_HOST_ANNOUNCES, // int
+	SET_ANNOUNCE_JITTER, // int
+	SET_URLSEED_CONNECTIONS, // int
+	SET_TRACKER_KEEP_ALIVE_TIMEOUT, // int
+	SET_MAX_IDLE_TRACKER_CONNECTIONS, // int
 };
 
 #endif // LIBTORRENT_SETTINGS_H
@@ -22,6 +22,7 @@ int settings_key(int const tag)
 		case SET_PEER_FINGERPRINT: return sp::peer_fingerprint;
 		case SET_DHT_BOOTSTRAP_NODES: return sp::dht_bootstrap_nodes;
 		case SET_WEBTORRENT_STUN_SERVER: return sp::webtorrent_stun_server;
+		case SET_DNS_SERVERS: return sp::dns_servers;
 		case SET_ALLOW_MULTIPLE_CONNECTIONS_PER_IP: return sp::allow_multiple_connections_per_ip;
 		case SET_SEND_REDUNDANT_HAVE: return sp::send_redundant_have;
 		case SET_USE_DHT_AS_FALLBACK: return sp::use_dht_as_fallback;
@@ -83,6 +84,10 @@ int settings_key(int const tag)
 		case SET_SSRF_MITIGATION: return sp::ssrf_mitigation;
 		case SET_ALLOW_IDNA: return sp::allow_idna;
 		case SET_ENABLE_SET_FILE_VALID_DATA: return sp::enable_set_file_valid_data;
+		case SET_WEBTORRENT_SHARE_CONNECTIONS: return sp::webtorrent_share_connections;
+		case SET_DISK_BUFFER_HUGE_PAGES: return sp::disk_buffer_huge_pages;
+		case SET_ADAPTIVE_DISK_THREADS: return sp::adaptive_disk_threads;
+		case SET_BUILTIN_DNS_RESOLVER: return sp::builtin_dns_resolver;
 		case SET_TRACKER_COMPLETION_TIMEOUT: return sp::tracker_completion_timeout;
 		case SET_TRACKER_RECEIVE_TIMEOUT: return sp::tracker_receive_timeout;
 		case SET_STOP_TRACKER_TIMEOUT: return sp::stop_tracker_timeout;
@@ -218,6 +223,24 @@ int settings_key(int const tag)
 		case SET_MAX_PIECE_COUNT: return sp::max_piece_count;
 		case SET_MIN_WEBSOCKET_ANNOUNCE_INTERVAL: return sp::min_websocket_announce_interval;
 		case SET_WEBTORRENT_CONNECTION_TIMEOUT: return sp::webtorrent_connection_timeout;
+		case SET_WEBTORRENT_SEND_BUFFER_LOW_WATERMARK: return sp::webtorrent_send_buffer_low_watermark;
+		case SET_WEBTORRENT_SEND_BUFFER_HIGH_WATERMARK: return sp::webtorrent_send_buffer_high_watermark;
+		case SET_WEBTORRENT_OFFER_POOL_SIZE: return sp::webtorrent_offer_pool_size;
+		case SET_WEBTORRENT_OFFER_POOL_EXPIRY: return sp::webtorrent_offer_pool_expiry;
+		case SET_DISK_BUFFER_SLAB_SIZE: return sp::disk_buffer_slab_size;
+		case SET_READ_CACHE_SIZE: return sp::read_cache_size;
+		case SET_MAX_DIRTY_BYTES: return sp::max_dirty_bytes;
+		case SET_DISK_QUEUE_READ_WEIGHT: return sp::disk_queue_read_weight;
+		case SET_DISK_QUEUE_WRITE_WEIGHT: return sp::disk_queue_write_weight;
+		case SET_DISK_QUEUE_HASH_WEIGHT: return sp::disk_queue_hash_weight;
+		case SET_DISK_QUEUE_OTHER_WEIGHT: return sp::disk_queue_other_weight;
+		case SET_MOVE_STORAGE_THREADS: return sp::move_storage_threads;
+		case SET_SCRAPE_BATCH_DELAY: return sp::scrape_batch_delay;
+		case SET_MAX_CONCURRENT_HOST_ANNOUNCES: return sp::max_concurrent_host_announces;
+		case SET_ANNOUNCE_JITTER: return sp::announce_jitter;
+		case SET_URLSEED_CONNECTIONS: return sp::urlseed_connections;
+		case SET_TRACKER_KEEP_ALIVE_TIMEOUT: return sp::tracker_keep_alive_timeout;
+		case SET_MAX_IDLE_TRACKER_CONNECTIONS: return sp::max_idle_tracker_connections;
 		default:
 			// ignore unknown tags
 			return -1;
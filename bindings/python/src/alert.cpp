@@ -269,6 +269,7 @@ namespace boost
 	POLY(alerts_dropped_alert)
 	POLY(session_stats_alert)
 	POLY(socks5_alert)
+	POLY(storage_moved_progress_alert)
 
 #if TORRENT_ABI_VERSION == 1
 	POLY(anonymous_mode_alert)
@@ -1101,6 +1102,12 @@ void bind_alert()
         .add_property("ip", make_getter(&socks5_alert::ip, by_value()))
         ;
 
+    class_<storage_moved_progress_alert, bases<torrent_alert>, noncopyable>(
+       "storage_moved_progress_alert", no_init)
+        .def_readonly("bytes_copied", &storage_moved_progress_alert::bytes_copied)
+        .def_readonly("total_bytes", &storage_moved_progress_alert::total_bytes)
+        ;
+
     class_<dht_live_nodes_alert, bases<alert>, noncopyable>(
        "dht_live_nodes_alert", no_init)
         .add_property("node_id", &dht_live_nodes_alert::node_id)
@@ -14,7 +14,9 @@ see LICENSE file.
 #include "libtorrent/bencode.hpp"
 #include "libtorrent/torrent_info.hpp"
 #include "libtorrent/create_torrent.hpp"
+#include "libtorrent/settings_pack.hpp"
 
+#include <chrono>
 #include <functional>
 #include <cstdio>
 #include <sstream>
@@ -121,8 +123,14 @@ OPTIONS:
 -L collection add a collection name to this torrent. Other torrents
               in the same collection is expected to share files
               with this one.
+-1            Only generate V1 metadata
 -2            Only generate V2 metadata
 -T            Include file timestamps in the .torrent file.
+-j threads    the number of threads to hash the files with
+-b            benchmark mode. Hash the files and print the rate
+              they were hashed at, don't write a torrent file.
+              Files that are in the page cache are read faster
+              than from disk.
 )";
 	std::exit(1);
 }
@@ -144,6 +152,8 @@ int main(int argc_, char const* argv_[]) try
 	int piece_size = 0;
 	lt::create_flags_t flags = {};
 	std::string root_cert;
+	int hashing_threads = 0;
+	bool benchmark = false;
 
 	std::string outfile;
 #ifdef TORRENT_WINDOWS
@@ -165,12 +175,18 @@ int main(int argc_, char const* argv_[]) try
 			case 'l':
 				flags |= lt::create_torrent::symlinks;
 				continue;
+			case '1':
+				flags |= lt::create_torrent::v1_only;
+				continue;
 			case '2':
 				flags |= lt::create_torrent::v2_only;
 				continue;
 			case 'T':
 				flags |= lt::create_torrent::modification_time;
 				continue;
+			case 'b':
+				benchmark = true;
+				continue;
 		}
 
 		if (args.size() < 2) print_usage();
@@ -185,6 +201,7 @@ int main(int argc_, char const* argv_[]) try
 			case 'c': comment_str = args[1]; break;
 			case 'r': root_cert = args[1]; break;
 			case 'L': collections.push_back(args[1]); break;
+			case 'j': hashing_threads = atoi(args[1]); break;
 			case 'S': {
 				if (strlen(args[1]) != 40) {
 					std::cerr << "invalid info-hash for -S. "
@@ -259,10 +276,28 @@ int main(int argc_, char const* argv_[]) try
 		t.add_similar_torrent(s);
 
 	auto const num = t.num_pieces();
-	lt::set_piece_hashes(t, branch_path(full_path)
-		, [num] (lt::piece_index_t const p) {
-			std::cerr << "\r" << p << "/" << num;
-		});
+	auto const progress = [num, benchmark] (lt::piece_index_t const p) {
+		if (!benchmark) std::cerr << "\r" << p << "/" << num;
+	};
+
+	auto const start = std::chrono::steady_clock::now();
+	if (hashing_threads > 0) {
+		lt::settings_pack pack;
+		pack.set_int(lt::settings_pack::hashing_threads, hashing_threads);
+		lt::set_piece_hashes(t, branch_path(full_path), pack, progress);
+	}
+	else {
+		lt::set_piece_hashes(t, branch_path(full_path), progress);
+	}
+
+	if (benchmark) {
+		double const seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+		double const megabytes = double(fs.total_size()) / 1000000.0;
+		std::cerr << "hashed " << megabytes << " MB in " << seconds << " s: "
+			<< (megabytes / seconds) << " MB/s\n";
+		return 0;
+	}
 
 	std::cerr << "\n";
 	t.set_creator(creator_str.c_str());
@@ -74,7 +74,7 @@ namespace libtorrent {
 	constexpr int user_alert_id = 10000;
 
 	// this constant represents "max_alert_index" + 1
-	constexpr int num_alert_types = 97;
+	constexpr int num_alert_types = 98;
 
 	// internal
 	constexpr int abi_alert_count = 128;
@@ -2911,6 +2911,28 @@ TORRENT_VERSION_NAMESPACE_3
 		aux::noexcept_movable<tcp::endpoint> ip;
 	};
 
+	// The ``storage_moved_progress_alert`` is posted about once a second
+	// while the files of a torrent are copied as part of
+	// torrent_handle::move_storage(). Files are only copied when the new
+	// save path is on a different volume, otherwise they are renamed.
+	struct TORRENT_EXPORT storage_moved_progress_alert final : torrent_alert
+	{
+		// internal
+		TORRENT_UNEXPORT storage_moved_progress_alert(aux::stack_allocator& alloc
+			, torrent_handle const& h, std::int64_t copied, std::int64_t total);
+
+		TORRENT_DEFINE_ALERT(storage_moved_progress_alert, 97)
+
+		static inline constexpr alert_category_t static_category = alert_category::storage;
+		std::string message() const override;
+
+		// the number of bytes copied so far, and the total number of bytes
+		// to copy. Bytes copied by an earlier, interrupted, move to the same
+		// location count as copied.
+		std::int64_t const bytes_copied;
+		std::int64_t const total_bytes;
+	};
+
 TORRENT_VERSION_NAMESPACE_3_END
 
 	// internal
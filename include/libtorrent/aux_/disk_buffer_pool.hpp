@@ -19,6 +19,7 @@ see LICENSE file.
 #endif
 #include <vector>
 #include <mutex>
+#include <atomic>
 #include <functional>
 #include <memory>
 
@@ -33,6 +34,8 @@ namespace libtorrent {
 
 namespace aux {
 
+	struct slab_depot;
+
 	struct TORRENT_EXTRA_EXPORT disk_buffer_pool
 	{
 		explicit disk_buffer_pool(io_context& ios);
@@ -48,7 +51,6 @@ namespace aux {
 
 		int in_use() const
 		{
-			std::unique_lock<std::mutex> l(m_pool_mutex);
 			return m_in_use;
 		}
 
@@ -56,19 +58,24 @@ namespace aux {
 
 	private:
 
-		void free_buffer_impl(char* buf, std::unique_lock<std::mutex>& l);
-		char* allocate_buffer_impl(std::unique_lock<std::mutex>& l, char const* category);
+		char* allocate_buffer_impl(char const* category);
+		void free_buffer_impl(char* buf);
+
+		// these allocate and free the memory of a single block, either with
+		// malloc() or from the slabs
+		char* allocate_block();
+		void free_block(char* buf);
 
 		// number of disk buffers currently allocated
-		int m_in_use;
+		std::atomic<int> m_in_use;
 
 		// cache size limit
-		int m_max_use;
+		std::atomic<int> m_max_use;
 
 		// if we have exceeded the limit, we won't start
 		// allowing allocations again until we drop below
 		// this low watermark
-		int m_low_watermark;
+		std::atomic<int> m_low_watermark;
 
 		// if we exceed the max number of buffers, we start
 		// adding up callbacks to this queue. Once the number
@@ -77,18 +84,28 @@ namespace aux {
 		std::vector<std::weak_ptr<disk_observer>> m_observers;
 
 		// set to true to throttle more allocations
-		bool m_exceeded_max_size;
+		std::atomic<bool> m_exceeded_max_size;
 
 		// this is the main thread io_context. Callbacks are
 		// posted on this in order to have them execute in
 		// the main thread.
 		io_context& m_ios;
 
-		void check_buffer_level(std::unique_lock<std::mutex>& l);
+		void check_buffer_level();
 		void remove_buffer_in_use(char* buf);
 
+		// protects m_observers and the transitions of m_exceeded_max_size
+		// to false. Allocating and freeing buffers doesn't need it
 		mutable std::mutex m_pool_mutex;
 
+		// when settings_pack::disk_buffer_slab_size is set, blocks are carved
+		// out of large regions kept here, instead of being allocated with
+		// malloc(). This is decided the first time settings are applied and
+		// doesn't change afterwards, since every buffer must be freed the way
+		// it was allocated.
+		std::shared_ptr<slab_depot> m_slabs;
+		bool m_allocator_set = false;
+
 		// this is specifically exempt from release_asserts
 		// since it's a quite costly check. Only for debug
 		// builds.
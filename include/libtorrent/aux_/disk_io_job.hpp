@@ -21,6 +21,7 @@ see LICENSE file.
 #include "libtorrent/units.hpp"
 #include "libtorrent/session_types.hpp"
 #include "libtorrent/flags.hpp"
+#include "libtorrent/time.hpp"
 
 #include <variant>
 #include <string>
@@ -183,6 +184,19 @@ namespace libtorrent::aux {
 
 		move_flags_t move_flags = move_flags_t::always_replace_files;
 
+		// for move_storage jobs, this is called with the number of bytes
+		// copied so far and the total, if files have to be copied
+		std::function<void(std::int64_t, std::int64_t)> move_progress;
+
+		// the time this job was put in a job queue. This is used to measure
+		// how long jobs wait for a disk thread
+		time_point queued_time;
+
+		// for reads with the time_critical flag set, the time by which the
+		// block is needed. These jobs are executed in deadline order, ahead of
+		// other jobs
+		time_point deadline;
+
 #if TORRENT_USE_ASSERTS
 		bool in_use = false;
 
@@ -0,0 +1,128 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef TORRENT_DISK_JOB_QUEUE_HPP_INCLUDED
+#define TORRENT_DISK_JOB_QUEUE_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/aux_/export.hpp"
+#include "libtorrent/aux_/disk_io_job.hpp"
+#include "libtorrent/aux_/tailqueue.hpp"
+#include "libtorrent/aux_/array.hpp"
+#include "libtorrent/time.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <unordered_map>
+
+namespace libtorrent::aux {
+
+	// disk jobs are scheduled in classes, in order of how sensitive they are
+	// to latency. Reads are requested by peers waiting for the data, writes
+	// hold on to disk buffers until they complete, hash jobs are mostly
+	// torrent checking and everything else (moving storage, renaming files,
+	// fence jobs) is maintenance
+	enum class job_class_t : std::uint8_t
+	{
+		read, write, hash, other, num_classes
+	};
+
+	constexpr int num_job_classes = static_cast<int>(job_class_t::num_classes);
+
+	TORRENT_EXTRA_EXPORT job_class_t job_class(job_action_t a);
+
+	// the queue of disk jobs waiting for a disk thread. Instead of a single
+	// FIFO, jobs are queued per job class and per storage. pop_front() picks
+	// the class using stride scheduling, where each class gets a share of
+	// the jobs proportional to its weight. Within a class, the storages with
+	// jobs queued take turns, so one torrent being checked or moved can't
+	// starve all the others. Jobs of the same class and storage are always
+	// executed in the order they were queued.
+	//
+	// Reads with the time_critical flag set bypass the classes. They are
+	// queued in a separate lane, ordered by deadline, which is always served
+	// first (earliest deadline first).
+	//
+	// This is not thread safe, it's protected by the disk job mutex
+	struct TORRENT_EXTRA_EXPORT disk_job_queue
+	{
+		disk_job_queue();
+		disk_job_queue(disk_job_queue const&) = delete;
+		disk_job_queue& operator=(disk_job_queue const&) = delete;
+
+		// sets the relative share of jobs each class gets when there are
+		// jobs of several classes queued. Weights less than 1 are treated as 1
+		void set_weights(aux::array<int, num_job_classes> const& weights);
+
+		// queue a job. This also stamps it with the time it was queued
+		void push_back(disk_io_job* j);
+		void append(tailqueue<disk_io_job>& jobs);
+
+		// removes and returns the next job to execute. The queue must not be
+		// empty
+		disk_io_job* pop_front();
+
+		bool empty() const { return m_size == 0; }
+		int size() const { return m_size; }
+		int size(job_class_t c) const
+		{ return m_classes[static_cast<int>(c)].size; }
+
+		// the number of jobs in the time-critical lane. These are not
+		// included in size(job_class_t)
+		int num_time_critical() const
+		{ return int(m_time_critical.size()); }
+
+		// call ``f`` for every queued job, in no particular order
+		template <typename Fun>
+		void for_each(Fun f)
+		{
+			for (auto& j : m_time_critical)
+				f(j.second);
+			for (auto& c : m_classes)
+				for (auto& q : c.queues)
+					for (auto i = q.second.iterate(); i.get(); i.next())
+						f(i.get());
+		}
+
+	private:
+
+		struct class_queue
+		{
+			// the jobs of every storage that has any queued, in this class.
+			std::unordered_map<mmap_storage const*, tailqueue<disk_io_job>> queues;
+
+			// the storages with jobs queued, in the order they take turns
+			std::deque<mmap_storage const*> round_robin;
+
+			int size = 0;
+
+			// the stride scheduling state. The class with the lowest pass is
+			// served next, and its pass is then advanced by its stride, which
+			// is inversely proportional to its weight
+			std::uint64_t pass = 0;
+			std::uint64_t stride = 1;
+		};
+
+		aux::array<class_queue, num_job_classes> m_classes;
+
+		// time-critical reads, ordered by deadline. Jobs with the same
+		// deadline are kept in the order they were queued
+		std::multimap<time_point, disk_io_job*> m_time_critical;
+
+		// the pass of the class that was served last. When a class goes from
+		// empty to non-empty, its pass is moved forward to this, to not let it
+		// build up credit while it was idle
+		std::uint64_t m_virtual_time = 0;
+
+		int m_size = 0;
+	};
+}
+
+#endif
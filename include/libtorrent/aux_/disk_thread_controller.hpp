@@ -0,0 +1,65 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef TORRENT_DISK_THREAD_CONTROLLER_HPP_INCLUDED
+#define TORRENT_DISK_THREAD_CONTROLLER_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/aux_/export.hpp"
+#include "libtorrent/time.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+namespace libtorrent::aux {
+
+	// decides how many threads a disk_io_thread_pool should be allowed to
+	// run, based on how long jobs wait in the queue compared to how long they
+	// take to execute. The disk threads report every job they complete with
+	// job_done(), and update() is called periodically to pick a new limit.
+	//
+	// if jobs spend more time waiting in the queue than being serviced, the
+	// threads can't keep up and the limit is raised. If jobs hardly wait at
+	// all, some threads are mostly idle and the limit is lowered by one. The
+	// limit grows faster than it shrinks, to react quickly to bursts.
+	struct TORRENT_EXTRA_EXPORT disk_thread_controller
+	{
+		// the outcome of one call to update()
+		struct decision
+		{
+			// the new thread limit
+			int limit = 0;
+
+			// the number of jobs completed since the last update
+			int jobs = 0;
+
+			// the average time jobs spent in the queue and executing,
+			// respectively, in microseconds
+			std::int64_t queue_wait = 0;
+			std::int64_t service_time = 0;
+		};
+
+		// record a completed job. This is thread safe
+		void job_done(time_duration wait, time_duration service);
+
+		// pick a new thread limit in the range [1, ``max_threads``], given the
+		// current ``limit``. The samples recorded since the last call are
+		// consumed. Not thread safe, it must only be called from one thread at
+		// a time
+		decision update(int limit, int max_threads);
+
+	private:
+
+		std::atomic<int> m_jobs{0};
+		std::atomic<std::int64_t> m_wait{0};
+		std::atomic<std::int64_t> m_service{0};
+	};
+}
+
+#endif
@@ -0,0 +1,240 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef TORRENT_DNS_RESOLVER_HPP_INCLUDE
+#define TORRENT_DNS_RESOLVER_HPP_INCLUDE
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/error_code.hpp"
+#include "libtorrent/io_context.hpp"
+#include "libtorrent/socket.hpp"
+#include "libtorrent/span.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/address.hpp"
+#include "libtorrent/aux_/deadline_timer.hpp"
+#include "libtorrent/aux_/resolver_interface.hpp"
+
+namespace libtorrent::aux {
+
+	// the record types we ask for
+	enum class dns_type : std::uint16_t
+	{
+		a = 1,
+		aaaa = 28
+	};
+
+	// the interesting parts of a response to a DNS query
+	struct TORRENT_EXTRA_EXPORT dns_response
+	{
+		std::uint16_t id = 0;
+
+		// the RCODE of the response. 0 is success, 3 is NXDOMAIN
+		int rcode = 0;
+
+		// the TC bit. The response didn't fit in a UDP packet, the question
+		// has to be asked again over TCP
+		bool truncated = false;
+
+		// the addresses in the answer section, of the type asked for
+		std::vector<address> addresses;
+
+		// the lowest TTL of the records in the answer section, or for
+		// negative responses, the negative caching TTL from the SOA record
+		// in the authority section (RFC 2308). -1 if there was none
+		std::int64_t ttl = -1;
+	};
+
+	// builds a recursive query for the ``type`` records of ``hostname``.
+	// Returns false if ``hostname`` is not a valid DNS name
+	TORRENT_EXTRA_EXPORT bool write_dns_query(std::uint16_t id, std::string const& hostname
+		, dns_type type, std::vector<char>& out);
+
+	// parses the response to a query for the ``type`` records of
+	// ``hostname``. Returns false if the packet is malformed or isn't a
+	// response to that question
+	TORRENT_EXTRA_EXPORT bool parse_dns_response(span<char const> buf
+		, std::string const& hostname, dns_type type, dns_response& resp);
+
+	// a DNS client, talking to the name servers over UDP directly instead of
+	// going through getaddrinfo(). Every attempt of a lookup is sent from a
+	// new socket, bound to a random port, and only answers from the name
+	// server it was sent to are accepted. Truncated answers are asked for
+	// again over TCP. Lookups run concurrently, and both the
+	// A and AAAA records of a name are asked for in parallel. Responses are
+	// cached for as long as their TTL says (capped by the cache timeout),
+	// failed lookups (NXDOMAIN and names without addresses) are cached too.
+	// Names that are looked up again shortly before their entry expires are
+	// refreshed in the background, to not have the next lookup wait for it.
+	//
+	// Unlike the system resolver, this does not consult the hosts file and
+	// does not apply the search domains from resolv.conf
+	struct TORRENT_EXTRA_EXPORT dns_resolver final : resolver_interface
+	{
+		explicit dns_resolver(io_context& ios);
+		~dns_resolver();
+
+		dns_resolver(dns_resolver const&) = delete;
+		dns_resolver& operator=(dns_resolver const&) = delete;
+
+		void async_resolve(std::string const& host, resolver_flags flags
+			, callback_t h) override;
+
+		void abort() override;
+
+		void set_cache_timeout(seconds timeout) override;
+
+		// the name servers to ask, in order of preference. If this is
+		// empty, the nameservers listed in /etc/resolv.conf are used
+		void set_servers(std::vector<udp::endpoint> servers);
+
+		// the time to wait for a response before asking the next name
+		// server, and the number of times to ask before failing
+		void set_query_timeout(time_duration timeout, int attempts);
+
+		// the name servers listed in a resolv.conf file
+		static std::vector<udp::endpoint> system_servers(
+			std::string const& resolv_conf = "/etc/resolv.conf");
+
+	private:
+
+		// the socket of one attempt of a lookup, and the name server it
+		// asks
+		struct udp_attempt
+		{
+			explicit udp_attempt(io_context& ios) : sock(ios) {}
+
+			udp::socket sock;
+			udp::endpoint server;
+			udp::endpoint from;
+			std::array<char, 1500> buffer;
+		};
+
+		// a question asked again over TCP, because the answer was truncated
+		struct tcp_lookup
+		{
+			explicit tcp_lookup(io_context& ios) : sock(ios) {}
+
+			tcp::socket sock;
+			std::uint16_t id = 0;
+
+			// the query and the response, both prefixed by their length
+			std::vector<char> query;
+			std::array<char, 2> length;
+			std::vector<char> buffer;
+		};
+
+		struct query
+		{
+			explicit query(io_context& ios) : timer(ios) {}
+
+			std::string hostname;
+
+			// the transaction IDs of the outstanding A and AAAA questions, 0
+			// if not outstanding
+			std::array<std::uint16_t, 2> ids{};
+			std::array<bool, 2> answered{};
+
+			int attempts = 0;
+
+			// lookups not flagged abort_on_shutdown survive abort()
+			bool critical = false;
+
+			// the addresses and the lowest TTL of the answers so far
+			std::vector<address> addresses;
+			std::int64_t ttl = -1;
+
+			deadline_timer timer;
+
+			// the current attempt, and the questions asked over TCP
+			std::shared_ptr<udp_attempt> udp;
+			std::array<std::shared_ptr<tcp_lookup>, 2> tcp;
+
+			// no callbacks means this is a prefetch
+			std::vector<callback_t> callbacks;
+		};
+
+		struct cache_entry
+		{
+			// empty for a negative entry
+			std::vector<address> addresses;
+			time_point expires;
+			time_duration ttl;
+
+			// set when the entry is refreshed in the background
+			bool prefetching = false;
+		};
+
+		void start_query(std::string const& hostname, resolver_flags flags
+			, callback_t h);
+		void send_query(std::shared_ptr<query> const& q);
+		void start_timer(std::shared_ptr<query> const& q);
+		void on_timeout(std::weak_ptr<query> q, error_code const& ec);
+		void start_receive(std::weak_ptr<query> q, std::shared_ptr<udp_attempt> a);
+		void on_receive(std::weak_ptr<query> q, std::shared_ptr<udp_attempt> a
+			, error_code const& ec, std::size_t bytes);
+		void on_response(std::shared_ptr<query> const& q, int question
+			, dns_response const& resp);
+
+		// ask ``question`` again over TCP
+		void start_tcp(std::shared_ptr<query> const& q, int question
+			, tcp::endpoint const& server);
+		void on_tcp_connect(std::weak_ptr<query> q, int question
+			, std::shared_ptr<tcp_lookup> t, error_code const& ec);
+		void on_tcp_write(std::weak_ptr<query> q, int question
+			, std::shared_ptr<tcp_lookup> t, error_code const& ec);
+		void on_tcp_length(std::weak_ptr<query> q, int question
+			, std::shared_ptr<tcp_lookup> t, error_code const& ec);
+		void on_tcp_read(std::weak_ptr<query> q, int question
+			, std::shared_ptr<tcp_lookup> t, error_code const& ec);
+		void tcp_failed(std::shared_ptr<query> const& q);
+
+		// returns the lookup if it's still in progress and ``t`` is the
+		// TCP connection of its ``question``
+		std::shared_ptr<query> tcp_query(std::weak_ptr<query> const& wq
+			, int question, std::shared_ptr<tcp_lookup> const& t) const;
+
+		// fail or complete the lookup. If ``cache`` is set, a failure is
+		// remembered as a negative cache entry
+		void finish_query(std::shared_ptr<query> const& q, error_code const& ec
+			, bool cache);
+		static void close_sockets(query& q);
+		void add_cache_entry(std::string const& hostname, std::vector<address> addresses
+			, time_duration ttl);
+		std::vector<udp::endpoint> const& servers();
+
+		io_context& m_ios;
+
+		std::vector<udp::endpoint> m_servers;
+		bool m_servers_loaded = false;
+
+		std::unordered_map<std::string, cache_entry> m_cache;
+
+		// the lookups in flight, by hostname
+		std::unordered_map<std::string, std::shared_ptr<query>> m_queries;
+
+		// max number of cached entries
+		int m_max_size = 700;
+
+		// the longest time to keep an entry in the cache, regardless of its
+		// TTL
+		time_duration m_timeout = seconds(1200);
+
+		time_duration m_query_timeout = seconds(2);
+		int m_max_attempts = 3;
+	};
+}
+
+#endif
@@ -78,6 +78,13 @@ namespace libtorrent::aux {
 		std::int64_t readv(std::int64_t file_offset, span<iovec_t const> bufs
 			, error_code& ec, aux::open_mode_t flags = {});
 
+		// reserve disk space for ``length`` bytes at ``offset`` in the file,
+		// to make subsequent writes to that range cheaper and less
+		// fragmented. This may grow the file, but never shrinks it. Only
+		// native allocation is used (currently on linux). On other systems,
+		// or on filesystems that don't support it, this is a no-op
+		void allocate(std::int64_t offset, std::int64_t length, error_code& ec);
+
 	private:
 		handle_type m_file_handle;
 	};
@@ -16,6 +16,7 @@ see LICENSE file.
 
 #if TORRENT_HAVE_MMAP || TORRENT_HAVE_MAP_VIEW_OF_FILE
 
+#include <atomic>
 #include <map>
 #include <mutex>
 #include <vector>
@@ -45,11 +46,20 @@ namespace libtorrent::aux {
 	TORRENT_EXTRA_EXPORT file_open_mode_t to_file_open_mode(open_mode_t const);
 
 	// this is an internal cache of open file mappings.
+	//
+	// every read and write job looks up its file in the pool, from all disk
+	// threads. To keep those lookups from serializing on a single mutex, the
+	// files are spread over a number of shards, each with its own mutex and
+	// LRU list. A hit only locks the shard the file belongs to. The LRU order
+	// is only maintained within each shard, so evicting a file picks the
+	// least recently used one among the oldest file of every shard. This is
+	// approximate, but close enough for closing idle files.
 	struct TORRENT_EXTRA_EXPORT file_view_pool
 	{
 		// ``size`` specifies the number of allowed files handles
-		// to hold open at any given time.
-		explicit file_view_pool(int size = 40);
+		// to hold open at any given time. ``shards`` is the number of
+		// independently locked partitions of the pool.
+		explicit file_view_pool(int size = 40, int shards = 16);
 		~file_view_pool();
 
 		file_view_pool(file_view_pool const&) = delete;
@@ -79,15 +89,23 @@ namespace libtorrent::aux {
 		// by the file_view_pool.
 		int size_limit() const { return m_size; }
 
+		// the number of file views currently held open
+		int num_files() const { return m_num_files; }
+
 		std::vector<open_file_state> get_status(storage_index_t st) const;
 
 		void close_oldest();
 
 	private:
 
-		std::shared_ptr<file_mapping> remove_oldest(std::unique_lock<std::mutex>&);
+		// closes the least recently used file among the oldest ones of each
+		// shard. Must be called without holding any shard mutex
+		std::shared_ptr<file_mapping> remove_oldest();
+
+		std::atomic<int> m_size;
 
-		int m_size;
+		// the total number of files in all shards
+		std::atomic<int> m_num_files{0};
 
 		using file_id = std::pair<storage_index_t, file_index_t>;
 
@@ -126,16 +144,25 @@ namespace libtorrent::aux {
 			>
 		>;
 
-		// maps storage pointer, file index pairs to the lru entry for the file
-		files_container m_files;
-		mutable std::mutex m_mutex;
+		struct alignas(64) shard
+		{
+			// maps storage pointer, file index pairs to the lru entry for the
+			// file
+			files_container files;
+			mutable std::mutex mutex;
+
+			// the boost.multi-index container is not no-throw move
+			// constructable. In order to destruct files without holding the
+			// mutex, we need this separate pre-allocated container to move it
+			// into before releasing the mutex and clearing it.
+			files_container deferred_destruction;
+			std::mutex destruction_mutex;
+		};
+
+		shard& shard_for(file_id const& k) const;
 
-		// the boost.multi-index container is not no-throw move constructable. In
-		// order to destruct m_files without holding the mutex, we need this
-		// separate pre-allocated container to move it into before releasing the
-		// mutex and clearing it.
-		files_container m_deferred_destruction;
-		mutable std::mutex m_destruction_mutex;
+		int const m_num_shards;
+		std::unique_ptr<shard[]> m_shards;
 	};
 
 }
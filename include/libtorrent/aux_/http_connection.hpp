@@ -99,6 +99,37 @@ struct TORRENT_EXTRA_EXPORT http_connection
 
 	void close(bool force = false);
 
+	// when set, the server is asked to keep the connection open after the
+	// response (HTTP/1.1 keep-alive). Once a bottled response has been
+	// received in full, nothing more is read from the socket, and the next
+	// get() to the same host is sent over the same connection. If the server
+	// closed it in the meantime, the request is retried on a new connection
+	void keep_alive(bool k) { m_keep_alive = k; }
+
+	// returns true if the response to the last request has been received in
+	// full and the connection is still open, i.e. it can be used for
+	// another request
+	bool idle() const;
+
+	// replaces the handlers, when the connection is handed to a new owner
+	void set_handlers(http_handler handler, http_connect_handler ch
+		, http_filter_handler fh, hostname_filter_handler hfh);
+
+	// the time it took to establish the last connection, including the SSL
+	// handshake
+	time_duration connect_time() const { return m_connect_time; }
+
+#if TORRENT_USE_SSL
+	// the SSL session to resume when the next connection is made
+	void resume_ssl_session(ssl::session_handle s) { m_ssl_session = std::move(s); }
+
+	// the SSL session of the current connection, or an empty handle
+	ssl::session_handle ssl_session();
+
+	// true if the SSL handshake of the current connection resumed a session
+	bool ssl_session_resumed();
+#endif
+
 	aux::socket_type const& socket() const { return *m_sock; }
 
 	std::vector<tcp::endpoint> const& endpoints() const { return m_endpoints; }
@@ -124,6 +155,13 @@ private:
 
 	void callback(error_code e, span<char> data = {});
 
+	// if the request was sent over a connection left open by the previous
+	// one, and it failed with ``e`` before any of the response was
+	// received, the server most likely closed the connection while it was
+	// idle. In that case the request is sent again on a new connection, and
+	// true is returned
+	bool retry_stale_connection(error_code const& e);
+
 	aux::vector<char> m_recvbuffer;
 	io_context& m_ios;
 
@@ -141,6 +179,7 @@ private:
 
 #if TORRENT_USE_SSL
 	ssl::context* m_ssl_ctx;
+	ssl::session_handle m_ssl_session;
 #endif
 
 #if TORRENT_USE_I2P
@@ -164,6 +203,11 @@ private:
 	time_point m_last_receive;
 	time_point m_start_time;
 
+	// when the last connection attempt was started, and how long the last
+	// successful one took
+	time_point m_connect_start;
+	time_duration m_connect_time{};
+
 	// specifies whether or not the connection is
 	// configured to use a proxy
 	aux::proxy_settings m_proxy;
@@ -223,6 +267,15 @@ private:
 
 	// true while resolving hostname
 	bool m_resolving_host = false;
+
+	// ask the server to keep the connection open
+	bool m_keep_alive = false;
+
+	// true while the current request was sent over a connection kept open
+	// from a previous request, until the first bytes of the response are
+	// received. m_sendbuffer is kept until then, to be able to send the
+	// request again
+	bool m_reused = false;
 };
 
 }
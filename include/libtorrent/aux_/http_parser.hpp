@@ -89,6 +89,29 @@ namespace libtorrent::aux {
 		bool parse_chunk_header(span<char const> buf
 			, std::int64_t* chunk_size, int* header_size);
 
+		// incrementally parses the body of the response, once the header is
+		// finished. ``buf`` is the data received after what previous calls
+		// consumed, it's advanced past the bytes consumed by this call. The
+		// returned span is the payload found, pointing into ``buf``. It may
+		// be empty, if only chunk framing was consumed. Call it again as long
+		// as ``buf`` isn't empty and body_finished() is false.
+		//
+		// Chunked encoding is handled in place, regardless of
+		// dont_parse_chunks, and the state of a chunk header is kept
+		// across calls, so a header split across reads is never scanned
+		// twice. Trailer headers are skipped. This is an alternative to
+		// calling incoming() on the body, not to be mixed with it.
+		span<char const> parse_body(span<char const>& buf, bool& error);
+
+		// true once parse_body() has consumed the whole body. Bodies without
+		// a content-length or chunked encoding only finish by finish_body()
+		bool body_finished() const { return m_body_state == body_done; }
+
+		// to be called when the connection is closed. A body without a
+		// content-length or chunked encoding ends here. Returns
+		// body_finished()
+		bool finish_body();
+
 		// reset the whole state and start over
 		void reset();
 
@@ -133,6 +156,39 @@ namespace libtorrent::aux {
 
 		enum { read_status, read_header, read_body, error_state } m_state = read_status;
 
+		// the state of parse_body()
+		enum body_state_t : std::uint8_t
+		{
+			// the body is the remaining content-length bytes
+			body_content,
+			// the body lasts until the connection is closed
+			body_until_close,
+			// in the hex size of a chunk header
+			body_chunk_size,
+			// past the size of a chunk header, in the chunk extensions
+			body_chunk_ext,
+			// expecting the LF terminating a chunk header
+			body_chunk_lf,
+			// in the chunk data
+			body_chunk_data,
+			// expecting the CRLF terminating the chunk data
+			body_chunk_end,
+			// at the start of a line in the trailer
+			body_trailer_start,
+			// in a line of the trailer
+			body_trailer_line,
+			body_done,
+			body_error
+		};
+		body_state_t m_body_state = body_until_close;
+
+		// the chunk size being parsed, or the bytes left of the chunk or the
+		// content
+		std::int64_t m_body_left = 0;
+
+		// the number of hex digits parsed of the current chunk size
+		int m_chunk_digits = 0;
+
 		// this is true if the server is HTTP/1.0 or
 		// if it sent "connection: close"
 		bool m_connection_close = false;
@@ -13,6 +13,7 @@ see LICENSE file.
 
 #include <vector>
 #include <memory>
+#include <optional>
 
 #include "libtorrent/config.hpp"
 #include "libtorrent/peer_id.hpp"
@@ -45,6 +46,10 @@ namespace libtorrent::aux {
 		void start() override;
 		void close() override;
 
+		// the max number of ``info_hash`` arguments in a scrape request. This
+		// keeps the URL at about 4 kiB
+		static constexpr int max_scrape_hashes = 64;
+
 	private:
 
 		std::shared_ptr<http_tracker_connection> shared_from_this()
@@ -58,18 +63,45 @@ namespace libtorrent::aux {
 		void on_connect(aux::http_connection& c);
 		void on_response(error_code const& ec, aux::http_parser const& parser
 			, span<char const> data);
+		void on_scrape_response(span<char const> data);
 
 		void on_timeout(error_code const&) override {}
 
 		std::shared_ptr<aux::http_connection> m_tracker_connection;
 		address m_tracker_ip;
 		io_context& m_ioc;
+
+		// set if the connection may be shared with other requests to the
+		// same tracker, i.e. it's not made through a proxy or i2p. Idle
+		// connections and SSL sessions are pooled by the tracker_manager
+		// under this key
+		std::optional<http_tracker_key> m_pool_key;
 	};
 
 	TORRENT_EXTRA_EXPORT tracker_response parse_tracker_response(
 		span<char const> data, error_code& ec
 		, tracker_request_flags_t flags, sha1_hash const& scrape_ih);
 
+	// the statistics of one torrent in a scrape response
+	struct scrape_entry
+	{
+		// set to errors::invalid_hash_entry if the response doesn't include
+		// this torrent
+		error_code ec;
+		int complete = -1;
+		int incomplete = -1;
+		int downloaded = -1;
+		int downloaders = -1;
+	};
+
+	// parse a response to a scrape of one or more torrents. The returned
+	// tracker_response has the fields that apply to the whole response (such
+	// as the failure reason), ``entries`` receives one entry per hash in
+	// ``info_hashes``, in the same order
+	TORRENT_EXTRA_EXPORT tracker_response parse_scrape_response(
+		span<char const> data, error_code& ec
+		, span<sha1_hash const> info_hashes, std::vector<scrape_entry>& entries);
+
 	TORRENT_EXTRA_EXPORT bool extract_peer_info(bdecode_node const& info
 		, peer_entry& ret, error_code& ec);
 }
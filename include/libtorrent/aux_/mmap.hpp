@@ -109,6 +109,11 @@ namespace aux {
 
 		// ...
 		file_view view();
+
+		// start writing back the dirty pages in the byte range [offset,
+		// offset + len) of the file. If ``wait`` is true, block until they
+		// have been written
+		void flush(std::int64_t offset, std::int64_t len, bool wait, error_code& ec);
 	private:
 
 		void close();
@@ -148,6 +153,13 @@ namespace aux {
 			return m_mapping->memory();
 		}
 
+		void flush(std::int64_t const offset, std::int64_t const len
+			, bool const wait, error_code& ec)
+		{
+			TORRENT_ASSERT(m_mapping);
+			m_mapping->flush(offset, len, wait, ec);
+		}
+
 	private:
 		explicit file_view(std::shared_ptr<file_mapping> m) : m_mapping(std::move(m)) {}
 		std::shared_ptr<file_mapping> m_mapping;
@@ -15,10 +15,13 @@ see LICENSE file.
 
 #include "libtorrent/config.hpp"
 
+#include <functional>
 #include <mutex>
 #include <atomic>
+#include <map>
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include "libtorrent/fwd.hpp"
 #include "libtorrent/aux_/disk_job_fence.hpp"
@@ -70,7 +73,9 @@ namespace libtorrent::aux {
 		void delete_files(remove_flags_t options, storage_error&);
 		void initialize(settings_interface const&, storage_error&);
 		std::pair<status_t, std::string> move_storage(std::string save_path
-			, move_flags_t, storage_error&);
+			, move_flags_t, int copy_threads
+			, std::function<void(std::int64_t, std::int64_t)> const& progress
+			, storage_error&);
 		bool verify_resume_data(add_torrent_params const& rd
 			, aux::vector<std::string, file_index_t> const& links
 			, storage_error&);
@@ -91,6 +96,26 @@ namespace libtorrent::aux {
 		file_storage const& files() const { return m_mapped_files ? *m_mapped_files : m_files; }
 		file_storage const& orig_files() const { return m_files; }
 
+		// the number of bytes written to the files of this storage that
+		// haven't been flushed yet. Writes are only tracked when
+		// settings_pack::max_dirty_bytes is enabled
+		std::int64_t dirty_bytes() const { return m_dirty_bytes; }
+
+		struct flush_result
+		{
+			// the number of contiguous ranges writeback was started for
+			int ranges = 0;
+			std::int64_t bytes = 0;
+		};
+
+		// start the writeback of all dirty ranges, in file and offset order.
+		// Contiguous writes are coalesced into a single range. The writeback
+		// started by the previous flush is waited for first, which bounds the
+		// dirty memory of this storage to about twice the flush threshold. If
+		// another thread is already flushing this storage, this returns
+		// immediately
+		flush_result flush_dirty(settings_interface const&, storage_error&);
+
 		bool set_need_tick()
 		{
 			bool const prev = m_need_tick;
@@ -128,6 +153,25 @@ namespace libtorrent::aux {
 
 		std::unique_ptr<file_storage> m_mapped_files;
 
+		void add_dirty_range(file_index_t file, std::int64_t offset, std::int64_t len);
+
+		// forget about all dirty ranges and pending writeback. Called when the
+		// files are closed, deleted or moved
+		void clear_dirty_ranges();
+
+		// ranges of files that have been written to, but not flushed yet.
+		// This maps (file, start offset) to the end offset. Adjacent ranges
+		// are merged as they are added
+		using dirty_ranges_t = std::map<std::pair<file_index_t, std::int64_t>, std::int64_t>;
+		std::mutex m_dirty_mutex;
+		dirty_ranges_t m_dirty_ranges;
+		std::atomic<std::int64_t> m_dirty_bytes{0};
+
+		// held while flushing. Protects m_writeback, the ranges whose
+		// writeback was started by the last flush
+		std::mutex m_flush_mutex;
+		dirty_ranges_t m_writeback;
+
 		// in order to avoid calling stat() on each file multiple times
 		// during startup, cache the results in here, and clear it all
 		// out once the torrent starts (to avoid getting stale results)
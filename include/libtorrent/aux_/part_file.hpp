@@ -15,7 +15,6 @@ see LICENSE file.
 #include <string>
 #include <vector>
 #include <mutex>
-#include <unordered_map>
 #include <cstdint>
 #include <memory>
 
@@ -24,6 +23,8 @@ see LICENSE file.
 #include "libtorrent/error_code.hpp"
 #include "libtorrent/units.hpp"
 #include "libtorrent/hasher.hpp"
+#include "libtorrent/bitfield.hpp"
+#include "libtorrent/aux_/vector.hpp"
 #include "libtorrent/aux_/open_mode.hpp"
 #include "libtorrent/aux_/storage_utils.hpp" // for iovec_t
 
@@ -63,6 +64,9 @@ namespace libtorrent::aux {
 		file open_file(aux::open_mode_t mode, error_code& ec);
 		void flush_metadata_impl(error_code& ec);
 
+		// mark the header entry of ``piece`` as needing to be written to disk
+		void set_dirty(piece_index_t piece);
+
 		std::int64_t slot_offset(slot_index_t const slot) const
 		{
 			return static_cast<int>(slot) * static_cast<std::int64_t>(m_piece_size)
@@ -75,8 +79,10 @@ namespace libtorrent::aux {
 		std::string m_path;
 		std::string const m_name;
 
-		// allocate a slot and return the slot index
-		slot_index_t allocate_slot(piece_index_t piece);
+		// allocate a slot and return the slot index. If the file needs to
+		// grow to hold the new slot, the space of the slots reserved past the
+		// end of the file is allocated in ``f``
+		slot_index_t allocate_slot(piece_index_t piece, file& f);
 
 		// this mutex must be held while accessing the data
 		// structure. Not while reading or writing from the file though!
@@ -90,6 +96,14 @@ namespace libtorrent::aux {
 		// this is the number of slots allocated
 		slot_index_t m_num_allocated{0};
 
+		// the number of slots disk space has been reserved for. Space is
+		// reserved ahead of m_num_allocated, in chunks proportional to the
+		// size of the file, to avoid growing it one piece at a time
+		slot_index_t m_num_reserved{0};
+
+		// the number of pieces stored in the part file
+		int m_num_pieces = 0;
+
 		// the max number of pieces in the torrent this part file is
 		// backing
 		int const m_max_pieces;
@@ -107,8 +121,18 @@ namespace libtorrent::aux {
 		// need to flush the metadata before closing the file
 		bool m_dirty_metadata = false;
 
-		// maps a piece index to the part-file slot it is stored in
-		std::unordered_map<piece_index_t, slot_index_t> m_piece_map;
+		// this is true once the whole header has been written to (or read
+		// from) the file. Until then, flushing the metadata writes the whole
+		// header rather than just the dirty blocks
+		bool m_header_on_disk = false;
+
+		// one bit per 1 kiB block of the header. Set bits are blocks whose
+		// entries have changed since they were last written to disk
+		bitfield m_dirty_blocks;
+
+		// maps a piece index to the part-file slot it is stored in, or -1 if
+		// the piece is not in the part file. This mirrors the header on disk
+		aux::vector<slot_index_t, piece_index_t> m_piece_map;
 	};
 }
 
@@ -98,6 +98,19 @@ namespace libtorrent {
 		, std::string const& new_path, error_code& ec);
 	TORRENT_EXTRA_EXPORT void copy_file(std::string const& f
 		, std::string const& newf, error_code& ec);
+
+	// copies ``f`` to ``newf``, assuming the first ``offset`` bytes of
+	// ``newf`` were already copied by an earlier call that was cut short.
+	// Anything in ``newf`` past ``offset`` is discarded. ``progress`` is
+	// called with the number of bytes copied since the last call, as the copy
+	// makes progress. On linux, the file is cloned (reflinked) if the file
+	// system supports it, and otherwise copied by the kernel, with
+	// copy_file_range(). The copy is flushed to disk before this returns. On
+	// Windows and Mac OS, ``offset`` is ignored and the whole file is copied
+	// by the system.
+	TORRENT_EXTRA_EXPORT void copy_file(std::string const& f
+		, std::string const& newf, std::int64_t offset
+		, std::function<void(std::int64_t)> const& progress, error_code& ec);
 	TORRENT_EXTRA_EXPORT void move_file(std::string const& f
 		, std::string const& newf, error_code& ec);
 
@@ -21,6 +21,7 @@ see LICENSE file.
 #include "libtorrent/aux_/open_mode.hpp" // for aux::open_mode_t
 #include "libtorrent/aux_/file_pointer.hpp"
 #include "libtorrent/aux_/posix_part_file.hpp"
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -58,7 +59,9 @@ namespace aux {
 		void delete_files(remove_flags_t options, storage_error& error);
 
 		std::pair<status_t, std::string> move_storage(std::string const& sp
-			, move_flags_t const flags, storage_error& ec);
+			, move_flags_t const flags, int copy_threads
+			, std::function<void(std::int64_t, std::int64_t)> const& progress
+			, storage_error& ec);
 
 		void rename_file(file_index_t const index, std::string const& new_filename, storage_error& ec);
 
@@ -0,0 +1,198 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#ifndef TORRENT_READ_CACHE_HPP_INCLUDED
+#define TORRENT_READ_CACHE_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/units.hpp"
+#include "libtorrent/span.hpp"
+#include "libtorrent/storage_defs.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+#include "libtorrent/disk_buffer_holder.hpp" // for buffer_allocator_interface
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace libtorrent::aux {
+
+	// the key of pieces in the read cache
+	struct cached_piece_key
+	{
+		storage_index_t storage;
+		piece_index_t piece;
+		bool operator==(cached_piece_key const& rhs) const
+		{ return storage == rhs.storage && piece == rhs.piece; }
+	};
+
+	struct cached_piece_key_hash
+	{
+		std::size_t operator()(cached_piece_key const& k) const
+		{
+			return std::hash<storage_index_t>{}(k.storage) * 31
+				^ std::hash<piece_index_t>{}(k.piece);
+		}
+	};
+
+	// a user-space cache of blocks read from disk, shared by all torrents. It
+	// holds whole or partial pieces, and evicts pieces using the 2Q algorithm:
+	// pieces read for the first time enter a FIFO queue (A1in) which is
+	// limited to a quarter of the cache. When a piece falls off the end of
+	// A1in its key is remembered in a ghost queue (A1out). If a piece in A1out
+	// is read again, it's inserted into the main LRU (Am), since it's been
+	// requested more than once within a reasonably short period of time. This
+	// makes the cache resistant to one-off reads of large ranges, such as a
+	// peer downloading a torrent sequentially, while keeping pieces that are
+	// popular among many peers.
+	//
+	// blocks are read from disk by the disk threads, without holding the
+	// cache mutex. A disk thread filling the cache first calls begin_fill(),
+	// then reads the blocks and passes them to insert() along with the token
+	// returned by begin_fill(). If the piece was invalidated in between (by
+	// writing to it), the blocks are discarded, since they may be stale.
+	struct TORRENT_EXTRA_EXPORT read_cache
+	{
+		// the blocks are allocated from the disk buffer pool, and returned to
+		// it when they are evicted
+		struct block_deleter
+		{
+			buffer_allocator_interface* allocator = nullptr;
+			void operator()(char* b) const { allocator->free_disk_buffer(b); }
+		};
+		using buffer_t = std::unique_ptr<char, block_deleter>;
+
+		explicit read_cache(int max_blocks = 0);
+		read_cache(read_cache const&) = delete;
+		read_cache& operator=(read_cache const&) = delete;
+
+		// sets the max number of blocks to keep in the cache. Setting it to 0
+		// disables the cache. Returns the number of blocks evicted to shrink
+		// the cache to the new size
+		int set_max_size(int blocks);
+		int max_size() const;
+
+		// the number of blocks currently held by the cache
+		int size() const;
+
+		// if the byte range [start, start + length) of the piece is in the
+		// cache, ``f`` is called to allocate the buffer to copy the data
+		// into, and true is returned. ``f`` may return nullptr, in which case
+		// nothing is copied. The range may span at most two blocks.
+		template <typename Fun>
+		bool get(storage_index_t const st, piece_index_t const piece
+			, int const start, int const length, Fun f)
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			cached_piece* p = find_range(st, piece, start, length);
+			if (p == nullptr) return false;
+
+			char* dst = f();
+			if (dst == nullptr) return true;
+
+			int const first = start / default_block_size;
+			int const block_offset = start - first * default_block_size;
+			int const len1 = std::min(length, default_block_size - block_offset);
+			std::memcpy(dst, p->blocks[std::size_t(first)].get() + block_offset
+				, std::size_t(len1));
+			if (len1 < length)
+			{
+				std::memcpy(dst + len1, p->blocks[std::size_t(first) + 1].get()
+					, std::size_t(length - len1));
+			}
+			return true;
+		}
+
+		// returns true if the block at ``offset`` in ``piece`` is in the cache
+		bool has_block(storage_index_t st, piece_index_t piece, int offset) const;
+
+		// announce the intention to read blocks of the specified piece from
+		// disk and insert them into the cache. The returned token must be
+		// passed to insert() or cancel_fill().
+		std::uint32_t begin_fill(storage_index_t st, piece_index_t piece);
+		void cancel_fill(storage_index_t st, piece_index_t piece);
+
+		// insert blocks into the cache. ``blocks`` are the consecutive blocks
+		// starting at block index ``first_block`` in the piece, which has
+		// ``blocks_in_piece`` blocks in total. Entries in ``blocks`` that are
+		// nullptr are skipped. The cache takes ownership of the buffers it
+		// keeps. Returns the number of blocks evicted to make room.
+		int insert(storage_index_t st, piece_index_t piece
+			, int first_block, int blocks_in_piece
+			, span<buffer_t> blocks, std::uint32_t token);
+
+		// drop all cached blocks of a piece, or of all pieces of a storage.
+		// This must be called whenever the data on disk changes, and when a
+		// storage index is released. These return the number of blocks evicted
+		int evict_piece(storage_index_t st, piece_index_t piece);
+		int evict_storage(storage_index_t st);
+		int clear();
+
+	private:
+
+		enum class queue_t : std::uint8_t { a1in, am };
+
+		struct cached_piece
+		{
+			std::vector<buffer_t> blocks;
+			int num_blocks = 0;
+			queue_t queue = queue_t::a1in;
+			std::list<cached_piece_key>::iterator lru;
+		};
+
+		// pieces that are being read from disk. The generation is incremented
+		// every time the piece is invalidated, to tell the filling threads
+		// their blocks are stale
+		struct fill_state
+		{
+			int refs = 0;
+			std::uint32_t generation = 0;
+		};
+
+		cached_piece* find_range(storage_index_t st, piece_index_t piece
+			, int start, int length);
+
+		std::list<cached_piece_key>& queue(queue_t q)
+		{ return q == queue_t::a1in ? m_a1in : m_am; }
+
+		int evict_piece_impl(cached_piece_key const& key);
+		void invalidate_fill(cached_piece_key const& key);
+		void add_ghost(cached_piece_key const& key);
+
+		// evict pieces until the cache fits in m_max_blocks. Returns the
+		// number of blocks evicted
+		int make_room();
+
+		mutable std::mutex m_mutex;
+
+		std::unordered_map<cached_piece_key, cached_piece, cached_piece_key_hash> m_pieces;
+		std::unordered_map<cached_piece_key, fill_state, cached_piece_key_hash> m_filling;
+
+		// the most recently used pieces are at the front of both lists
+		std::list<cached_piece_key> m_a1in;
+		std::list<cached_piece_key> m_am;
+
+		// keys of pieces recently evicted from A1in. New entries are at the
+		// front
+		std::list<cached_piece_key> m_a1out;
+		std::unordered_map<cached_piece_key, std::list<cached_piece_key>::iterator
+			, cached_piece_key_hash> m_ghosts;
+
+		int m_max_blocks;
+		int m_num_blocks = 0;
+		int m_a1in_blocks = 0;
+	};
+}
+
+#endif
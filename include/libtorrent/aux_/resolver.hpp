@@ -23,6 +23,7 @@ see LICENSE file.
 #include "libtorrent/io_context.hpp"
 #include "libtorrent/socket.hpp"
 #include "libtorrent/aux_/resolver_interface.hpp"
+#include "libtorrent/aux_/dns_resolver.hpp"
 #include "libtorrent/address.hpp"
 
 namespace libtorrent {
@@ -39,6 +40,12 @@ struct TORRENT_EXTRA_EXPORT resolver final : resolver_interface
 
 	void set_cache_timeout(seconds timeout) override;
 
+	// send lookups to the built-in DNS client instead of the system
+	// resolver. ``servers`` are the name servers to use, if empty, the ones
+	// in /etc/resolv.conf. On Windows, where there is no resolv.conf, the
+	// system resolver is still used if ``servers`` is empty
+	void use_builtin(bool enable, std::vector<udp::endpoint> servers = {});
+
 private:
 
 	void on_lookup(error_code const& ec, tcp::resolver::results_type ips
@@ -71,6 +78,9 @@ private:
 	// the callbacks to call when a host resolution completes. This allows to
 	// attach more callbacks if the same host is looked up mutliple times
 	std::multimap<std::string, resolver_interface::callback_t> m_callbacks;
+
+	dns_resolver m_builtin;
+	bool m_use_builtin = false;
 };
 
 }
@@ -24,12 +24,14 @@ see LICENSE file.
 #include <boost/functional/hash.hpp>
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
+#include <deque>
 #include <functional>
 #include <memory>
 #include <optional>
 #include <queue>
 #include <vector>
 #include <chrono>
+#include <string>
 #include <unordered_map>
 
 namespace rtc {
@@ -41,10 +43,12 @@ namespace libtorrent {
 
 struct alert_manager;
 struct torrent;
+struct counters;
 
 namespace aux {
 
 struct rtc_stream_init;
+struct session_settings;
 
 constexpr int RTC_OFFER_ID_LEN = 16;
 
@@ -69,6 +73,146 @@ struct rtc_offer
 	std::function<void(peer_id const& pid, rtc_answer const& answer)> answer_callback;
 };
 
+// An offer generated ahead of time, which has already gathered its ICE
+// candidates. It is not bound to any torrent until it is taken from the pool.
+struct rtc_pregenerated_offer
+{
+	rtc_offer_id id;
+	std::string sdp; // session description in SDP format
+	std::shared_ptr<rtc::PeerConnection> peer_connection;
+	std::shared_ptr<rtc::DataChannel> data_channel;
+};
+
+// This class maintains the session-wide pool of pre-generated offers, so that
+// announces to WebSocket trackers don't have to wait for ICE gathering.
+struct TORRENT_EXTRA_EXPORT rtc_offer_pool final : std::enable_shared_from_this<rtc_offer_pool>
+{
+	rtc_offer_pool(io_context& ioc, session_settings const& settings, counters& cnt);
+	~rtc_offer_pool();
+	rtc_offer_pool& operator=(rtc_offer_pool const&) = delete;
+	rtc_offer_pool(rtc_offer_pool const&) = delete;
+	rtc_offer_pool& operator=(rtc_offer_pool&&) noexcept = delete;
+	rtc_offer_pool(rtc_offer_pool&&) noexcept = delete;
+
+	void close();
+
+	// returns the oldest ready offer, if any. Offers that are not ready yet
+	// are never handed out.
+	std::optional<rtc_pregenerated_offer> take();
+
+	// start generating offers until the pool holds
+	// settings_pack::webtorrent_offer_pool_size of them
+	void refill();
+
+	// discard offers until the pool holds no more than
+	// settings_pack::webtorrent_offer_pool_size of them
+	void trim();
+
+	int num_ready() const { return int(m_ready.size()); }
+	int size() const { return int(m_entries.size()); }
+
+private:
+	struct entry
+	{
+		explicit entry(io_context& ioc) : timer(ioc) {}
+
+		rtc_pregenerated_offer offer;
+		time_point start_time;
+
+		// this is the generation timeout until the offer is ready, and its
+		// expiry afterwards
+		deadline_timer timer;
+	};
+
+	void on_generated(error_code const& ec, rtc_offer_id offer_id, std::string sdp);
+	void on_expired(error_code const& ec, rtc_offer_id offer_id);
+	void remove(rtc_offer_id const& offer_id);
+	void update_gauge();
+
+	io_context& m_io_context;
+	session_settings const& m_settings;
+	counters& m_stats_counters;
+
+	std::unordered_map<rtc_offer_id, entry, boost::hash<std::vector<char>>> m_entries;
+
+	// the ready offers, oldest first
+	std::deque<rtc_offer_id> m_ready;
+
+	bool m_abort = false;
+};
+
+struct rtc_signaling;
+
+// The session-wide set of established PeerConnections, indexed by the
+// transport id the remote client advertised in its session descriptions.
+// When another of our torrents is matched with the same client, the offerer
+// opens an additional DataChannel on the existing connection instead of
+// setting up a new ICE/DTLS/SCTP transport. The channel's protocol carries
+// the offer id, which is how the answering side routes it to its torrent.
+//
+// The transport id is only a hint. A connection is shared only if the DTLS
+// fingerprint in the new session description matches the one the connection
+// was authenticated with, and the DataChannel must arrive on that connection.
+struct TORRENT_EXTRA_EXPORT rtc_transport_cache final : std::enable_shared_from_this<rtc_transport_cache>
+{
+	explicit rtc_transport_cache(io_context& ioc);
+	~rtc_transport_cache();
+	rtc_transport_cache& operator=(rtc_transport_cache const&) = delete;
+	rtc_transport_cache(rtc_transport_cache const&) = delete;
+	rtc_transport_cache& operator=(rtc_transport_cache&&) noexcept = delete;
+	rtc_transport_cache(rtc_transport_cache&&) noexcept = delete;
+
+	void close();
+
+	// the id we advertise in our own session descriptions. It is random and
+	// identifies this session, not a single connection.
+	std::string const& local_id() const { return m_local_id; }
+
+	// fingerprint is the remote DTLS certificate fingerprint, from the remote
+	// session description
+	void add(std::string const& remote_id, std::string const& fingerprint
+		, std::shared_ptr<rtc::PeerConnection> const& pc);
+
+	// returns the PeerConnection to the given remote client, if it's still
+	// alive, i.e. if any stream still uses it, and if it was authenticated
+	// with the same certificate fingerprint
+	std::shared_ptr<rtc::PeerConnection> find(std::string const& remote_id
+		, std::string const& fingerprint);
+
+	// the remote client is expected to open a DataChannel for this offer on
+	// the shared connection pc. It will be handed to sig.
+	void expect_channel(rtc_offer_id const& offer_id, std::weak_ptr<rtc_signaling> sig
+		, std::shared_ptr<rtc::PeerConnection> const& pc);
+	void cancel_channel(rtc_offer_id const& offer_id);
+
+	int size() const { return int(m_transports.size()); }
+
+private:
+	void on_data_channel(std::shared_ptr<rtc::DataChannel> dc
+		, std::weak_ptr<rtc::PeerConnection> pc);
+
+	struct transport
+	{
+		std::weak_ptr<rtc::PeerConnection> peer_connection;
+		std::string fingerprint;
+	};
+
+	struct expected_channel
+	{
+		std::weak_ptr<rtc_signaling> signaling;
+		std::weak_ptr<rtc::PeerConnection> peer_connection;
+	};
+
+	io_context& m_io_context;
+	std::string m_local_id;
+
+	std::unordered_map<std::string, transport> m_transports;
+	std::unordered_map<rtc_offer_id, expected_channel
+		, boost::hash<std::vector<char>>> m_expected_channels;
+
+	bool m_abort = false;
+};
+
 // This class handles client signaling for WebRTC DataChannels
 struct TORRENT_EXTRA_EXPORT rtc_signaling final : std::enable_shared_from_this<rtc_signaling>
 {
@@ -95,6 +239,8 @@ struct TORRENT_EXTRA_EXPORT rtc_signaling final : std::enable_shared_from_this<r
 #endif
 
 private:
+	friend struct rtc_transport_cache;
+
 	using description_handler = std::function<void(error_code const&, std::string const& description)>;
 
 	struct connection
@@ -105,15 +251,42 @@ private:
 		std::shared_ptr<rtc::DataChannel> data_channel;
 		std::optional<peer_id> pid;
 
+		// when the connection was created, to measure offer generation time.
+		// This is not set for offers taken from the pool.
+		std::optional<time_point> start_time;
+
+		// when the offer was handed to the tracker, and when we got the remote
+		// session description, to measure handshake latency
+		std::optional<time_point> offer_time;
+		std::optional<time_point> negotiation_time;
+		bool ice_connected = false;
+
+		// the transport id the remote client advertised, if it supports
+		// sharing connections, and its DTLS certificate fingerprint
+		std::string remote_transport_id;
+		std::string remote_fingerprint;
+
+		// true if the DataChannel is opened on a PeerConnection shared with
+		// other torrents
+		bool shared = false;
+
 		deadline_timer timer;
 	};
 
 	rtc_offer_id generate_offer_id() const;
 
 	connection& create_connection(rtc_offer_id const& offer_id, description_handler handler);
+	connection& adopt_connection(rtc_pregenerated_offer offer);
+	connection& add_connection(rtc_offer_id const& offer_id, std::shared_ptr<rtc::PeerConnection> pc);
+	void set_data_channel(connection& conn, rtc_offer_id const& offer_id, std::shared_ptr<rtc::DataChannel> dc);
+	bool share_connection(rtc_offer const& offer, std::string const& remote_id);
+	void on_shared_answer(connection& conn, rtc_offer_id const& offer_id
+		, std::string const& remote_id, std::string const& fingerprint);
+	std::string parse_transport_id(std::string const& sdp) const;
 	void on_generated_offer(error_code const& ec, rtc_offer offer);
 	void on_generated_answer(error_code const& ec, rtc_answer answer, rtc_offer offer);
 	void on_data_channel(error_code const& ec, rtc_offer_id offer_id, std::shared_ptr<rtc::DataChannel> dc);
+	void on_connected(rtc_offer_id const& offer_id, time_point connect_time);
 
 	io_context& m_io_context;
 	torrent* m_torrent;
@@ -41,12 +41,22 @@ namespace rtc {
 }
 
 namespace libtorrent {
+
+struct counters;
+
 namespace aux {
 
 struct TORRENT_EXTRA_EXPORT rtc_stream_init
 {
 	std::shared_ptr<rtc::PeerConnection> peer_connection;
 	std::shared_ptr<rtc::DataChannel> data_channel;
+
+	// bufferedAmount thresholds for write flow control
+	std::size_t send_buffer_low_watermark = 0;
+	std::size_t send_buffer_high_watermark = 0;
+
+	// if set, message and byte counts are recorded here
+	counters* stats_counters = nullptr;
 };
 
 struct TORRENT_EXTRA_EXPORT rtc_stream_impl : std::enable_shared_from_this<rtc_stream_impl>
@@ -108,7 +118,9 @@ private:
 	bool ensure_open();
 
 	std::size_t incoming_data(span<char const> data);
-	std::pair<std::size_t, bool> write_data(std::size_t size);
+	std::size_t write_data(std::size_t max_size, error_code& ec);
+	bool is_write_blocked() const;
+	void inc_stats_counter(int c, std::int64_t value = 1);
 
 	io_context& m_io_context;
 	std::shared_ptr<rtc::PeerConnection> m_peer_connection;
@@ -121,6 +133,16 @@ private:
 	std::size_t m_write_buffer_size = 0;
 	std::size_t m_read_buffer_size = 0;
 
+	// writes stall while the DataChannel buffers more than the high
+	// watermark, and resume once it has drained to the low watermark
+	std::size_t m_send_buffer_low_watermark;
+	std::size_t m_send_buffer_high_watermark;
+
+	// true while the write handler waits for the DataChannel to drain
+	bool m_write_stalled = false;
+
+	counters* m_stats_counters;
+
 	std::vector<char> m_incoming;
 };
 
@@ -324,11 +346,11 @@ struct TORRENT_EXTRA_EXPORT rtc_stream
 		for (auto i = buffer_sequence_begin(buffers)
 			, end(buffer_sequence_end(buffers)); i != end; ++i)
 		{
-			m_impl->add_write_buffer(i->data(), i->size());
+			m_impl->add_write_buffer(*i);
 		}
 
 		std::size_t ret = m_impl->write_some(ec);
-		m_impl->clear_read_buffers();
+		m_impl->clear_write_buffers();
 		return ret;
 	}
 
@@ -392,6 +392,10 @@ namespace aux {
 
 			io_context& get_context() override { return m_io_context; }
 			resolver_interface& get_resolver() override { return m_host_resolver; }
+#if TORRENT_USE_RTC
+			rtc_offer_pool& rtc_offers() override;
+			rtc_transport_cache& rtc_transports() override;
+#endif
 
 			aux::vector<torrent*>& torrent_list(torrent_list_index_t i) override
 			{
@@ -815,6 +819,8 @@ namespace aux {
 			void update_auto_sequential();
 			void update_max_failcount();
 			void update_resolver_cache_timeout();
+			void update_dns_resolver();
+			void update_webtorrent_offer_pool_size();
 
 			void update_ip_notifier();
 			void update_upnp();
@@ -936,6 +942,17 @@ namespace aux {
 
 			tracker_manager m_tracker_manager;
 
+#if TORRENT_USE_RTC
+			// pre-generated WebRTC offers shared by all torrents. This is
+			// created lazily, the first time a torrent announces to a
+			// WebSocket tracker
+			std::shared_ptr<rtc_offer_pool> m_rtc_offer_pool;
+
+			// established WebRTC connections which other torrents may open
+			// DataChannels on, indexed by remote client
+			std::shared_ptr<rtc_transport_cache> m_rtc_transports;
+#endif
+
 			// the torrents must be destructed after the torrent_peer_allocator,
 			// since the torrents hold the peer lists that own the torrent_peers
 			// (which are allocated in the torrent_peer_allocator)
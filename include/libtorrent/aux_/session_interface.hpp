@@ -55,6 +55,10 @@ namespace aux {
 	struct torrent_peer;
 	struct torrent_peer_allocator_interface;
 	struct external_ip;
+#if TORRENT_USE_RTC
+	struct rtc_offer_pool;
+	struct rtc_transport_cache;
+#endif
 }
 
 	// hidden
@@ -132,6 +136,10 @@ namespace libtorrent::aux {
 		virtual torrent_peer_allocator_interface& get_peer_allocator() = 0;
 		virtual io_context& get_context() = 0;
 		virtual aux::resolver_interface& get_resolver() = 0;
+#if TORRENT_USE_RTC
+		virtual aux::rtc_offer_pool& rtc_offers() = 0;
+		virtual aux::rtc_transport_cache& rtc_transports() = 0;
+#endif
 
 		virtual bool has_connection(peer_connection* p) const = 0;
 		virtual void insert_peer(std::shared_ptr<peer_connection> const& c) = 0;
@@ -79,6 +79,19 @@ namespace libtorrent::aux {
 	// verifies the hostname in its SSL handshake
 	void setup_ssl_hostname(socket_type& s, std::string const& hostname, error_code& ec);
 
+#if TORRENT_USE_SSL
+	// the TLS session of an SSL socket whose handshake has completed, to
+	// resume it on a later connection. Empty for other sockets
+	ssl::session_handle get_ssl_session(socket_type& s);
+
+	// assuming the socket_type s is an ssl socket, ask to resume ``session``
+	// in its SSL handshake
+	void set_ssl_session(socket_type& s, ssl::session_handle const& session, error_code& ec);
+
+	// returns true if the SSL handshake of s resumed an earlier session
+	bool ssl_session_resumed(socket_type& s);
+#endif
+
 	// properly shuts down SSL sockets. holder keeps s alive
 	void async_shutdown(socket_type& s, std::shared_ptr<void> holder);
 }
@@ -59,6 +59,8 @@ see LICENSE file.
 #include <cstddef>
 #include <functional>
 #include <exception>
+#include <memory>
+#include <vector>
 
 namespace libtorrent::aux::ssl {
 
@@ -88,6 +90,10 @@ using stream_handle_type = native_stream_type;
 
 typedef int (*server_name_callback_type)(SSL* s, int*, void* arg);
 
+// a TLS session saved from a connection, to resume it on a later connection
+// to the same server
+using session_handle = std::shared_ptr<SSL_SESSION>;
+
 #elif defined TORRENT_USE_GNUTLS
 using boost::asio::gnutls::context;
 using boost::asio::gnutls::stream_base;
@@ -102,6 +108,9 @@ using stream_handle_type = stream_base*;
 
 typedef bool (*server_name_callback_type)(stream_handle_type handle, std::string const& name, void* arg);
 
+// the serialized session data
+using session_handle = std::shared_ptr<std::vector<char>>;
+
 #endif
 
 namespace error {
@@ -154,6 +163,18 @@ TORRENT_EXTRA_EXPORT void set_context(stream_handle_type s, context_handle_type
 TORRENT_EXTRA_EXPORT bool has_context(stream_handle_type s, context_handle_type c);
 TORRENT_EXTRA_EXPORT context_handle_type get_context(stream_handle_type s);
 
+// returns the session negotiated by the handshake of ``s``, or an empty
+// handle if the handshake hasn't completed or the session can't be resumed
+TORRENT_EXTRA_EXPORT session_handle get_session(stream_handle_type s);
+
+// ask to resume ``session`` in the handshake of ``s``. This must be called
+// before the handshake. If the server doesn't accept it, a full handshake
+// is made
+TORRENT_EXTRA_EXPORT void set_session(stream_handle_type s, session_handle const& session, error_code& ec);
+
+// returns true if the handshake of ``s`` resumed an earlier session
+TORRENT_EXTRA_EXPORT bool session_resumed(stream_handle_type s);
+
 } // libtorrent::aux:ssl
 
 #endif // TORRENT_USE_SSL
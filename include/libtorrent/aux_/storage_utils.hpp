@@ -14,12 +14,14 @@ see LICENSE file.
 #include <cstdint>
 #include <string>
 #include <functional>
+#include <vector>
 
 #include "libtorrent/config.hpp"
 #include "libtorrent/fwd.hpp"
 #include "libtorrent/span.hpp"
 #include "libtorrent/span.hpp"
 #include "libtorrent/units.hpp"
+#include "libtorrent/aux_/vector.hpp"
 #include "libtorrent/storage_defs.hpp" // for status_t
 #include "libtorrent/session_types.hpp"
 #include "libtorrent/error_code.hpp"
@@ -53,12 +55,33 @@ namespace aux {
 	// moves the files in file_storage f from ``save_path`` to
 	// ``destination_save_path`` according to the rules defined by ``flags``.
 	// returns the status code and the new save_path.
+	// Files that can't be renamed (because the destination is on a different
+	// volume) are copied, using up to ``copy_threads`` threads, and
+	// ``progress`` is called with the number of bytes copied and the total
+	// number of bytes to copy. If the move fails, the copies are removed. A
+	// copy interrupted by the process exiting is resumed by the next call.
 	TORRENT_EXTRA_EXPORT std::pair<status_t, std::string>
 	move_storage(file_storage const& f
 		, std::string save_path
 		, std::string const& destination_save_path
 		, std::function<void(std::string const&, lt::error_code&)> const& move_partfile
-		, move_flags_t flags, storage_error& ec);
+		, move_flags_t flags, int copy_threads
+		, std::function<void(std::int64_t, std::int64_t)> const& progress
+		, storage_error& ec);
+
+	// copies the files in ``files`` from ``save_path`` to ``new_save_path``,
+	// using up to ``num_threads`` threads. Each file is copied to
+	// ``<name>.moving`` and renamed once it's complete and flushed to disk.
+	// A ``.moving`` file left behind by an earlier call is resumed from, if
+	// it's newer than the source and its content matches the source,
+	// otherwise the file is copied from the start. ``copied`` is set for
+	// every file that was copied. ``progress`` is called from this thread,
+	// about once a second, with the number of bytes copied and the total.
+	TORRENT_EXTRA_EXPORT void copy_files(file_storage const& f
+		, std::string const& save_path, std::string const& new_save_path
+		, std::vector<file_index_t> const& files, int num_threads
+		, std::function<void(std::int64_t, std::int64_t)> const& progress
+		, aux::vector<bool, file_index_t>& copied, storage_error& ec);
 
 	// deletes the files on fs from save_path according to options. Options may
 	// opt to only delete the partfile
@@ -10,6 +10,7 @@ see LICENSE file.
 #ifndef TORRENT_STORE_BUFFER
 #define TORRENT_STORE_BUFFER
 
+#include <array>
 #include <unordered_map>
 #include <mutex>
 
@@ -65,14 +66,24 @@ struct hash<libtorrent::aux::torrent_location>
 namespace libtorrent {
 namespace aux {
 
-struct store_buffer
+// the store buffer is split into shards, each with its own mutex, to allow
+// disk threads and the network thread to look up and retire blocks
+// concurrently. Blocks are assigned to shards by storage and piece, which
+// means all blocks of a piece are in the same shard. ``Shards`` must be a
+// power of 2
+template <int Shards>
+struct basic_store_buffer
 {
+	static_assert(Shards > 0 && (Shards & (Shards - 1)) == 0
+		, "the number of shards must be a power of 2");
+
 	template <typename Fun>
 	bool get(torrent_location const loc, Fun f) const
 	{
-		std::unique_lock<std::mutex> l(m_mutex);
-		auto const it = m_store_buffer.find(loc);
-		if (it != m_store_buffer.end())
+		shard const& s = shard_for(loc);
+		std::unique_lock<std::mutex> l(s.mutex);
+		auto const it = s.blocks.find(loc);
+		if (it != s.blocks.end())
 		{
 			f(it->second);
 			return true;
@@ -83,38 +94,80 @@ struct store_buffer
 	template <typename Fun>
 	int get2(torrent_location const loc1, torrent_location const loc2, Fun f) const
 	{
-		std::unique_lock<std::mutex> l(m_mutex);
-		auto const it1 = m_store_buffer.find(loc1);
-		auto const it2 = m_store_buffer.find(loc2);
-		char const* buf1 = (it1 == m_store_buffer.end()) ? nullptr : it1->second;
-		char const* buf2 = (it2 == m_store_buffer.end()) ? nullptr : it2->second;
-
-		if (buf1 == nullptr && buf2 == nullptr)
-			return 0;
+		shard const& s1 = shard_for(loc1);
+		shard const& s2 = shard_for(loc2);
 
-		return f(buf1, buf2);
+		// the two locations are normally adjacent blocks in the same piece,
+		// and in the same shard. Otherwise both shards need to be locked for
+		// the buffers to stay valid while f is called
+		if (&s1 == &s2)
+		{
+			std::unique_lock<std::mutex> l(s1.mutex);
+			return get2_impl(s1, loc1, s2, loc2, f);
+		}
+		std::scoped_lock<std::mutex, std::mutex> l(s1.mutex, s2.mutex);
+		return get2_impl(s1, loc1, s2, loc2, f);
 	}
 
 	void insert(torrent_location const loc, char const* buf)
 	{
-		std::lock_guard<std::mutex> l(m_mutex);
-		m_store_buffer.insert({loc, buf});
+		shard& s = shard_for(loc);
+		std::lock_guard<std::mutex> l(s.mutex);
+		s.blocks.insert({loc, buf});
 	}
 
 	void erase(torrent_location const loc)
 	{
-		std::lock_guard<std::mutex> l(m_mutex);
-		auto it = m_store_buffer.find(loc);
-		TORRENT_ASSERT(it != m_store_buffer.end());
-		m_store_buffer.erase(it);
+		shard& s = shard_for(loc);
+		std::lock_guard<std::mutex> l(s.mutex);
+		auto it = s.blocks.find(loc);
+		TORRENT_ASSERT(it != s.blocks.end());
+		s.blocks.erase(it);
 	}
 
 private:
 
-	mutable std::mutex m_mutex;
-	std::unordered_map<torrent_location, char const*> m_store_buffer;
+	// each shard is aligned to a cache line to avoid false sharing between
+	// the mutexes
+	struct alignas(64) shard
+	{
+		mutable std::mutex mutex;
+		std::unordered_map<torrent_location, char const*> blocks;
+	};
+
+	template <typename Fun>
+	static int get2_impl(shard const& s1, torrent_location const loc1
+		, shard const& s2, torrent_location const loc2, Fun& f)
+	{
+		auto const it1 = s1.blocks.find(loc1);
+		auto const it2 = s2.blocks.find(loc2);
+		char const* buf1 = (it1 == s1.blocks.end()) ? nullptr : it1->second;
+		char const* buf2 = (it2 == s2.blocks.end()) ? nullptr : it2->second;
+
+		if (buf1 == nullptr && buf2 == nullptr)
+			return 0;
+
+		return f(buf1, buf2);
+	}
+
+	static std::size_t shard_index(torrent_location const& loc)
+	{
+		std::size_t ret = 0;
+		boost::hash_combine(ret, std::hash<storage_index_t>{}(loc.torrent));
+		boost::hash_combine(ret, std::hash<piece_index_t>{}(loc.piece));
+		return ret & std::size_t(Shards - 1);
+	}
+
+	shard& shard_for(torrent_location const& loc)
+	{ return m_shards[shard_index(loc)]; }
+	shard const& shard_for(torrent_location const& loc) const
+	{ return m_shards[shard_index(loc)]; }
+
+	std::array<shard, Shards> m_shards;
 };
 
+using store_buffer = basic_store_buffer<32>;
+
 }
 }
 
@@ -124,7 +124,7 @@ namespace libtorrent::aux {
 #endif // TORRENT_DISABLE_STREAMING
 
 	// this is the internal representation of web seeds
-	struct web_seed_t : web_seed_entry
+	struct TORRENT_EXTRA_EXPORT web_seed_t : web_seed_entry
 	{
 		explicit web_seed_t(web_seed_entry const& wse);
 		web_seed_t(std::string const& url_
@@ -144,6 +144,37 @@ namespace libtorrent::aux {
 		// pointer, when the web seed is connected
 		ipv4_peer peer_info{tcp::endpoint(), true, {}};
 
+		// the peer_info fields of the second and later connections to this
+		// web seed (see settings_pack::urlseed_connections). The connections
+		// and the piece picker point to these, so entries are never removed
+		// while the web seed exists
+		std::deque<ipv4_peer> extra_peer_info;
+
+		// calls ``f`` with each of the peer_info fields of this web seed,
+		// starting with peer_info
+		template <typename Fun>
+		void for_each_peer_info(Fun f)
+		{
+			f(peer_info);
+			for (auto& pi : extra_peer_info) f(pi);
+		}
+
+		// returns the peer_info field used by the connection ``p``, or
+		// nullptr if it isn't connected to this web seed
+		torrent_peer* peer_info_for(peer_connection_interface const* p);
+		bool has_connection(peer_connection_interface const* p) const;
+
+		// the number of connections to this web seed, including the ones
+		// still connecting
+		int num_connections() const;
+
+		// returns a peer_info field not used by any connection, adding one
+		// if all are in use
+		ipv4_peer& free_peer_info();
+
+		// true if any of the connections to this web seed was banned
+		bool banned() const;
+
 		// this is initialized to true, but if we discover the
 		// server not to support it, it's set to false, and we
 		// make larger requests.
@@ -174,11 +205,30 @@ namespace libtorrent::aux {
 		// web seed from resolving to any local network IPs.
 		bool no_local_ips = false;
 
+		// a block whose request was interrupted, and the part of it received
+		// so far
+		struct restart_block
+		{
+			peer_request request;
+			std::vector<char> data;
+		};
+
 		// if the web server doesn't support keepalive or a block request was
 		// interrupted, the block received so far is kept here for the next
-		// connection to pick up
-		peer_request restart_request = { piece_index_t(-1), -1, -1};
-		std::vector<char> restart_piece;
+		// connection to pick up. There is one per peer_info field, for the
+		// connections to this web seed not to replace each other's block
+		std::map<torrent_peer const*, restart_block> restart_blocks;
+
+		// saves the partial block ``data`` of the request ``r``, of the
+		// connection using the peer_info field ``slot``. The block previously
+		// saved for ``slot``, or for the same request, is replaced. Returns
+		// the number of bytes of those that were discarded
+		int save_restart_block(torrent_peer const* slot
+			, peer_request const& r, std::vector<char>& data);
+
+		// if a partial block was saved for the request ``r``, moves it into
+		// ``data`` and returns true
+		bool take_restart_block(peer_request const& r, std::vector<char>& data);
 
 		// this maps file index to a URL it has been redirected to. If an entry is
 		// missing, it means it has not been redirected and the full path should
@@ -200,13 +250,13 @@ namespace libtorrent::aux {
 			retry = std::move(rhs.retry);
 			endpoints = std::move(rhs.endpoints);
 			peer_info = std::move(rhs.peer_info);
+			extra_peer_info = std::move(rhs.extra_peer_info);
 			supports_keepalive = std::move(rhs.supports_keepalive);
 			resolving = std::move(rhs.resolving);
 			removed = std::move(rhs.removed);
 			ephemeral = std::move(rhs.ephemeral);
 			no_local_ips = std::move(rhs.no_local_ips);
-			restart_request = std::move(rhs.restart_request);
-			restart_piece = std::move(rhs.restart_piece);
+			restart_blocks = std::move(rhs.restart_blocks);
 			redirects = std::move(rhs.redirects);
 			have_files = std::move(rhs.have_files);
 			return *this;
@@ -435,7 +485,11 @@ namespace libtorrent::aux {
 			bool fail;
 			error_code error;
 		};
+		// read the piece and post it in a read_piece_alert
 		void read_piece(piece_index_t);
+		// same as read_piece(), but the disk reads are issued as
+		// time-critical, ordered by ``deadline``
+		void read_piece_deadline(piece_index_t, time_point deadline);
 		void on_disk_read_complete(disk_buffer_holder, storage_error const&
 			, peer_request const&, std::shared_ptr<read_piece_struct>);
 
@@ -1231,6 +1285,7 @@ namespace libtorrent::aux {
 		void on_torrent_paused();
 		void on_storage_moved(status_t status, std::string const& path
 			, storage_error const& error);
+		void on_storage_move_progress(std::int64_t copied, std::int64_t total);
 		void on_file_renamed(std::string const& filename
 			, file_index_t file_idx
 			, storage_error const& error);
@@ -1284,6 +1339,11 @@ namespace libtorrent::aux {
 #ifdef TORRENT_SSL_PEERS
 		std::unique_ptr<ssl::context> m_ssl_ctx;
 
+		// identifies m_ssl_ctx, and the certificate it presents, to the
+		// tracker manager. Connections and SSL sessions to trackers are only
+		// reused by requests with the same ID
+		std::uint32_t m_ssl_ctx_id = 0;
+
 		bool verify_peer_cert(bool const preverified, ssl::verify_context& ctx);
 
 		void init_ssl(string_view cert);
@@ -26,6 +26,8 @@ see LICENSE file.
 #include <memory>
 #include <unordered_map>
 #include <deque>
+#include <optional>
+#include <map>
 
 #include "libtorrent/flags.hpp"
 #include "libtorrent/socket.hpp"
@@ -44,6 +46,7 @@ see LICENSE file.
 #include "libtorrent/aux_/udp_socket.hpp"
 #include "libtorrent/aux_/session_settings.hpp"
 #include "libtorrent/aux_/ssl.hpp"
+#include "libtorrent/aux_/array.hpp"
 #include "libtorrent/tracker_event.hpp" // for event_t enum
 
 #if TORRENT_USE_RTC
@@ -67,6 +70,7 @@ namespace libtorrent::aux {
 	struct resolver_interface;
 	class http_tracker_connection;
 	class udp_tracker_connection;
+	struct http_connection;
 #if TORRENT_USE_RTC
 	struct websocket_tracker_connection;
 #endif
@@ -83,6 +87,10 @@ using tracker_request_flags_t = flags::bitfield_flag<std::uint8_t, struct tracke
 		// see parse_tracker_response()
 		static inline constexpr tracker_request_flags_t i2p = 1_bit;
 
+		// the torrent is downloading and has few peers. When a tracker has a
+		// backlog of announces, these are sent ahead of the others
+		static inline constexpr tracker_request_flags_t needs_peers = 2_bit;
+
 		std::string url;
 		std::string trackerid;
 #if TORRENT_ABI_VERSION == 1
@@ -119,6 +127,11 @@ using tracker_request_flags_t = flags::bitfield_flag<std::uint8_t, struct tracke
 
 #if TORRENT_USE_SSL
 		ssl::context* ssl_ctx = nullptr;
+
+		// identifies ``ssl_ctx`` in the pool of idle connections and in the
+		// SSL session cache. 0 is the session's own context, the contexts of
+		// SSL torrents get one from new_ssl_context_id()
+		std::uint32_t ssl_ctx_id = 0;
 #endif
 #if TORRENT_USE_I2P
 		i2p_connection* i2pconn = nullptr;
@@ -211,6 +224,16 @@ using tracker_request_flags_t = flags::bitfield_flag<std::uint8_t, struct tracke
 #endif
 	};
 
+	// scrapes of several torrents to the same tracker may be sent as a single
+	// request. The tracker connection is created for the first torrent, and
+	// the others are carried along as batched requests. Responses and errors
+	// are reported to each of them
+	struct batched_request
+	{
+		tracker_request req;
+		std::weak_ptr<request_callback> requester;
+	};
+
 	struct TORRENT_EXTRA_EXPORT timeout_handler
 		: std::enable_shared_from_this<timeout_handler>
 	{
@@ -266,6 +289,22 @@ using tracker_request_flags_t = flags::bitfield_flag<std::uint8_t, struct tracke
 
 		tracker_request const& tracker_req() const { return m_req; }
 
+		// the requests sent along with tracker_req() (only for batched
+		// scrapes). Must be set before the connection is started
+		std::vector<batched_request> const& batch() const { return m_batch; }
+		void set_batch(std::vector<batched_request> b) { m_batch = std::move(b); }
+
+		// announces sent by the tracker_manager's announce scheduler are
+		// counted against their tracker host until they complete. This is
+		// empty for requests that weren't scheduled
+		std::string const& scheduled_host() const { return m_scheduled_host; }
+		time_point dispatch_time() const { return m_dispatch_time; }
+		void set_scheduled_host(std::string host)
+		{
+			m_scheduled_host = std::move(host);
+			m_dispatch_time = clock_type::now();
+		}
+
 		void fail(error_code const& ec, operation_t op, char const* msg = ""
 			, seconds32 interval = seconds32(0), seconds32 min_interval = seconds32(0));
 		virtual void start() = 0;
@@ -288,10 +327,78 @@ using tracker_request_flags_t = flags::bitfield_flag<std::uint8_t, struct tracke
 
 		tracker_request m_req;
 		std::weak_ptr<request_callback> m_requester;
+		std::vector<batched_request> m_batch;
+		std::string m_scheduled_host;
+		time_point m_dispatch_time;
 
 		tracker_manager& m_man;
 	};
 
+	// identifies a UDP tracker in the connection ID cache. Connection IDs
+	// are tied to the address they were handed out to, so the listen socket
+	// is part of the key. When the tracker is reached through a proxy by
+	// hostname, the address of ``ep`` is unspecified
+	struct udp_tracker_key
+	{
+		aux::listen_socket_handle socket;
+		udp::endpoint ep;
+		std::string hostname;
+
+		bool operator<(udp_tracker_key const& rhs) const
+		{
+			return std::tie(socket, ep, hostname)
+				< std::tie(rhs.socket, rhs.ep, rhs.hostname);
+		}
+		bool operator==(udp_tracker_key const& rhs) const
+		{
+			return socket == rhs.socket && ep == rhs.ep && hostname == rhs.hostname;
+		}
+	};
+
+	// returns the port to announce in ``req``, given the port we listen on.
+	// I2P announces don't reveal a listen port and trackers reject port 0,
+	// both are announced as 1. ``req.kind`` is a set of flags, so an I2P
+	// announce is recognized by its i2p bit, even if it's also marked
+	// needs_peers
+	TORRENT_EXTRA_EXPORT std::uint16_t announce_port(tracker_request const& req
+		, std::uint16_t listen_port);
+
+#if TORRENT_USE_SSL
+	// returns a new ID for an SSL context, to be used as
+	// tracker_request::ssl_ctx_id. IDs are never reused, unlike the
+	// addresses of destroyed contexts
+	TORRENT_EXTRA_EXPORT std::uint32_t new_ssl_context_id();
+#endif
+
+	// identifies an HTTP tracker in the pool of idle connections and in the
+	// SSL session cache. Connections are bound to the address of the listen
+	// socket, so it's part of the key
+	struct http_tracker_key
+	{
+		std::string hostname;
+		int port = 0;
+		bool ssl = false;
+		address bind_address;
+#if TORRENT_USE_SSL
+		// the tracker_request::ssl_ctx_id of the SSL context the
+		// connection uses
+		std::uint32_t ssl_ctx_id = 0;
+#endif
+
+		bool operator<(http_tracker_key const& rhs) const
+		{
+			return std::tie(hostname, port, ssl, bind_address
+#if TORRENT_USE_SSL
+				, ssl_ctx_id
+#endif
+				) < std::tie(rhs.hostname, rhs.port, rhs.ssl, rhs.bind_address
+#if TORRENT_USE_SSL
+				, rhs.ssl_ctx_id
+#endif
+				);
+		}
+	};
+
 	class TORRENT_EXTRA_EXPORT tracker_manager final
 		: single_threaded
 	{
@@ -347,6 +454,12 @@ using tracker_request_flags_t = flags::bitfield_flag<std::uint8_t, struct tracke
 		void sent_bytes(int bytes);
 		void received_bytes(int bytes);
 
+		// the number of scrape requests held back to be batched with others
+		int num_pending_scrapes() const { return m_num_pending_scrapes; }
+
+		// the number of announces waiting in the announce scheduler
+		int num_scheduled_announces() const { return m_num_scheduled_announces; }
+
 		void incoming_error(error_code const& ec, udp::endpoint const& ep);
 		bool incoming_packet(udp::endpoint const& ep, span<char const> buf);
 
@@ -360,6 +473,54 @@ using tracker_request_flags_t = flags::bitfield_flag<std::uint8_t, struct tracke
 			std::shared_ptr<aux::udp_tracker_connection> c
 			, std::uint32_t tid);
 
+		enum class connection_id_status : std::uint8_t
+		{
+			// the cached connection ID was returned
+			valid,
+			// another connection has a connect request in flight to this
+			// tracker. The connection will be notified when it completes
+			pending,
+			// there is no connection ID, the connection must send a connect
+			// request. Others asking in the meantime will wait for it
+			missing
+		};
+
+		// look up the connection ID for the tracker ``c`` talks to (BEP 15).
+		// The cache is shared by all torrents
+		connection_id_status get_connection_id(
+			std::shared_ptr<aux::udp_tracker_connection> const& c
+			, std::int64_t& id);
+
+		// the connect request sent by ``c`` succeeded or failed. This
+		// notifies the connections waiting for it
+		void connection_id_received(udp_tracker_key const& key, std::int64_t id);
+		void connection_id_failed(udp_tracker_key const& key
+			, aux::udp_tracker_connection const* c);
+
+		// returns an idle connection to the tracker ``key``, left open by an
+		// earlier request, or nullptr if there is none
+		std::shared_ptr<aux::http_connection> take_http_connection(
+			http_tracker_key const& key);
+
+		// hands over a connection whose response has been received in full,
+		// to be reused by the next request to the same tracker. It's closed
+		// if keep-alive is disabled or there are enough idle connections to
+		// this tracker already
+		void return_http_connection(io_context& ios, http_tracker_key const& key
+			, std::shared_ptr<aux::http_connection> c);
+
+		// an HTTP tracker connection was established. This updates the
+		// connection counters
+		void http_connection_opened(time_duration connect_time, bool ssl_resumed);
+
+#if TORRENT_USE_SSL
+		// the SSL session of the last connection to the tracker ``key``, to
+		// be resumed by the next one
+		ssl::session_handle ssl_session(http_tracker_key const& key) const;
+		void save_ssl_session(http_tracker_key const& key, ssl::session_handle s);
+		int num_ssl_sessions() const { return int(m_ssl_sessions.size()); }
+#endif
+
 		aux::session_settings const& settings() const { return m_settings; }
 		aux::resolver_interface& host_resolver() { return m_host_resolver; }
 
@@ -373,6 +534,98 @@ using tracker_request_flags_t = flags::bitfield_flag<std::uint8_t, struct tracke
 
 	private:
 
+		// create the connection for a request and start it (or queue it, for
+		// HTTP). ``batch`` are scrape requests sent along with ``req``. If
+		// ``scheduled_host`` is set, the connection counts against that host
+		// in the announce scheduler. Returns false if no connection was
+		// created
+		bool start_request(io_context& ios
+			, tracker_request&& req
+			, std::weak_ptr<request_callback> c
+			, std::vector<batched_request> batch
+			, std::string scheduled_host = {});
+
+		void schedule_announce(io_context& ios, tracker_request&& req
+			, std::weak_ptr<request_callback> c);
+		void dispatch_announces();
+		void announce_finished(tracker_connection& c);
+
+		// removes the announces of the torrent and tracker of ``req`` that are
+		// waiting in the scheduler
+		void drop_scheduled_announces(tracker_request const& req);
+
+		void queue_scrape(io_context& ios, tracker_request&& req
+			, std::weak_ptr<request_callback> c);
+		void flush_scrapes(io_context& ios);
+		void start_scrapes(io_context& ios, std::vector<batched_request> batch);
+
+		// scrape requests waiting to be sent. Each group can be sent to the
+		// tracker as one request: they have the same URL and listen socket
+		std::vector<std::vector<batched_request>> m_pending_scrapes;
+		int m_num_pending_scrapes = 0;
+
+		// fires scrape_batch_delay milliseconds after the first scrape is
+		// added to m_pending_scrapes, to send them
+		std::optional<deadline_timer> m_scrape_timer;
+
+		struct queued_announce
+		{
+			tracker_request req;
+			std::weak_ptr<request_callback> requester;
+			time_point queued;
+		};
+
+		// the announce scheduler state of one tracker host
+		struct announce_host
+		{
+			// the number of announces to this host that haven't completed
+			int in_flight = 0;
+
+			// the announces waiting to be sent, keyed by the earliest time
+			// they may be sent. The first queue is for torrents that need
+			// peers, and it's always served first
+			aux::array<std::multimap<time_point, queued_announce>, 2> queue;
+		};
+
+		// announces (not scrapes) to HTTP and UDP trackers go through the
+		// announce scheduler. It limits the number of concurrent announces to
+		// each tracker host (max_concurrent_host_announces) and delays
+		// regular re-announces by a random jitter, to not have all torrents
+		// announce at the same time. event=stopped announces bypass it
+		std::unordered_map<std::string, announce_host> m_announce_hosts;
+		int m_num_scheduled_announces = 0;
+		io_context* m_announce_ios = nullptr;
+		std::optional<deadline_timer> m_announce_timer;
+
+		struct connection_id_entry
+		{
+			std::int64_t connection_id = 0;
+			time_point expires = min_time();
+
+			// the connection with a connect request in flight to this
+			// tracker, and the ones waiting for it to complete
+			std::weak_ptr<aux::udp_tracker_connection> connecting;
+			std::vector<std::weak_ptr<aux::udp_tracker_connection>> waiting;
+
+			// the transaction ID of the refresh request in flight, or 0
+			std::uint32_t refresh_tid = 0;
+			time_point refresh_sent = min_time();
+		};
+
+		// send a new connect request to the tracker if its connection ID is
+		// about to expire, to not have the next announce wait for it
+		void refresh_connection_id(udp_tracker_key const& key
+			, connection_id_entry& e, time_point now);
+		bool on_refresh_response(std::uint32_t tid, udp::endpoint const* ep
+			, span<char const> buf);
+
+		// UDP tracker connection IDs
+		std::map<udp_tracker_key, connection_id_entry> m_connection_ids;
+
+		// the refresh requests in flight, by transaction ID. These are
+		// sent by the tracker manager itself, not by a connection
+		std::unordered_map<std::uint32_t, udp_tracker_key> m_connection_id_refresh;
+
 		// maps transactionid to the udp_tracker_connection
 		// These must use shared_ptr to avoid a dangling reference
 		// if a connection is erased while a timeout event is in the queue
@@ -381,6 +634,35 @@ using tracker_request_flags_t = flags::bitfield_flag<std::uint8_t, struct tracke
 		std::vector<std::shared_ptr<aux::http_tracker_connection>> m_http_conns;
 		std::deque<std::shared_ptr<aux::http_tracker_connection>> m_queued;
 
+		struct idle_http_connection
+		{
+			std::shared_ptr<aux::http_connection> connection;
+			time_point expires;
+		};
+
+		// close the idle connections whose keep-alive timeout has passed, and
+		// set the timer for the next one to expire
+		void expire_http_connections();
+		void close_idle_http_connections();
+
+		// idle HTTP tracker connections, kept open to be reused. The most
+		// recently returned connection of each tracker is last
+		std::map<http_tracker_key, std::vector<idle_http_connection>> m_idle_http_conns;
+		int m_num_idle_http_conns = 0;
+		std::optional<deadline_timer> m_idle_http_timer;
+
+#if TORRENT_USE_SSL
+		struct saved_ssl_session
+		{
+			ssl::session_handle session;
+			time_point saved;
+		};
+
+		// the SSL session of the last connection to each HTTPS tracker. Old
+		// sessions are dropped as new ones are saved
+		std::map<http_tracker_key, saved_ssl_session> m_ssl_sessions;
+#endif
+
 #if TORRENT_USE_RTC
 		// websocket connections by URL
 		std::unordered_map<std::string, std::shared_ptr<aux::websocket_tracker_connection>> m_websocket_conns;
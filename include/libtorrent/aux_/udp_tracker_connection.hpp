@@ -14,10 +14,9 @@ see LICENSE file.
 #include <vector>
 #include <string>
 #include <utility>
-#include <mutex>
 #include <cstdint>
 #include <memory>
-#include <map>
+#include <array>
 
 #include "libtorrent/aux_/udp_socket.hpp"
 #include "libtorrent/aux_/tracker_manager.hpp"
@@ -42,6 +41,17 @@ namespace libtorrent::aux {
 
 		std::uint32_t transaction_id() const { return m_transaction_id; }
 
+		// the max number of info-hashes in a scrape request. This is what
+		// fits in a 1500 byte packet (BEP 15)
+		static constexpr int max_scrape_hashes = 74;
+
+		// the connect request with transaction ID ``tid``
+		static std::array<char, 16> connect_packet(std::uint32_t tid);
+
+		// identifies the tracker endpoint this connection talks to, in the
+		// connection ID cache
+		udp_tracker_key cache_key() const;
+
 	private:
 
 		enum class action_t : std::uint8_t
@@ -63,6 +73,16 @@ namespace libtorrent::aux {
 		void name_lookup(error_code const& error
 			, std::vector<address> const& addresses, int port);
 		void start_announce();
+		void send_request();
+
+		// called by the tracker_manager when the connect request this
+		// connection was waiting for completes (or fails)
+		void on_connection_id(udp_tracker_key const& key, std::int64_t id);
+		void on_connection_id_failed(udp_tracker_key const& key);
+
+		// if this connection has the connect request to m_target in flight,
+		// let the connections waiting for it know it failed
+		void release_connect();
 
 		bool on_receive(udp::endpoint const& ep, span<char const> buf);
 		bool on_receive_hostname(char const* hostname, span<char const> buf);
@@ -86,23 +106,23 @@ namespace libtorrent::aux {
 		std::string m_hostname;
 		std::vector<tcp::endpoint> m_endpoints;
 
-		struct connection_cache_entry
-		{
-			std::int64_t connection_id;
-			time_point expires;
-		};
-
-		static std::map<address, connection_cache_entry> m_connection_cache;
-		static std::mutex m_cache_mutex;
-
 		udp::endpoint m_target;
 
+		std::int64_t m_connection_id = 0;
+
 		std::uint32_t m_transaction_id;
 		int m_attempts;
 
 		action_t m_state;
 
 		bool m_abort;
+
+		// true if we sent the connect request other connections to the same
+		// tracker are waiting for
+		bool m_connect_owner = false;
+
+		// true while waiting for another connection's connect request
+		bool m_waiting_for_id = false;
 	};
 
 }
@@ -26,6 +26,18 @@ see LICENSE file.
 
 namespace libtorrent::aux {
 
+	// queues the byte range ``r`` behind the ``pending`` requests. If it
+	// continues where the last one ends, and the two fit in
+	// ``max_request_bytes``, that one is extended instead (even across
+	// pieces and files). Returns true if ``r`` was merged
+	TORRENT_EXTRA_EXPORT bool add_pending_request(std::deque<peer_request>& pending
+		, peer_request const& r, int piece_size, int max_request_bytes);
+
+	// the number of HTTP requests to keep outstanding to a web seed.
+	// ``pipeline_size`` is the urlseed_pipeline_size setting
+	TORRENT_EXTRA_EXPORT int web_seed_pipeline_depth(bool keepalive
+		, int pipeline_size);
+
 	class TORRENT_EXTRA_EXPORT web_peer_connection
 		: public web_connection_base
 	{
@@ -61,6 +73,12 @@ namespace libtorrent::aux {
 	private:
 
 		void on_receive_padfile();
+
+		// sends the HTTP request(s) for the byte range ``r``
+		void write_http_request(peer_request const& r);
+
+		// sends as many of the pending requests as the pipeline depth allows
+		void issue_requests();
 		void incoming_payload(char const* buf, int len);
 		void incoming_zeroes(int len);
 		void handle_redirect(int bytes_left);
@@ -86,6 +104,12 @@ namespace libtorrent::aux {
 		};
 		std::deque<file_request_t> m_file_requests;
 
+		// byte ranges requested by the bittorrent engine that we haven't sent
+		// HTTP requests for yet, because there already are
+		// urlseed_pipeline_size requests outstanding. Adjacent ranges are
+		// merged into one while they wait, to make fewer, larger requests
+		std::deque<peer_request> m_pending_requests;
+
 		std::string m_url;
 
 		aux::web_seed_t* m_web;
@@ -102,18 +126,6 @@ namespace libtorrent::aux {
 		// next response starts
 		int m_received_body;
 
-		// this is the offset inside the current receive
-		// buffer where the next chunk header will be.
-		// this is updated for each chunk header that's
-		// parsed. It does not necessarily point to a valid
-		// offset in the receive buffer, if we haven't received
-		// it yet. This offset never includes the HTTP header
-		int m_chunk_pos;
-
-		// this is the number of bytes we've already received
-		// from the next chunk header we're waiting for
-		int m_partial_chunk_header;
-
 		// the number of responses we've received so far on
 		// this connection
 		int m_num_responses;
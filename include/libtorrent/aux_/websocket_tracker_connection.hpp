@@ -29,8 +29,10 @@ see LICENSE file.
 #include <map>
 #include <memory>
 #include <queue>
+#include <string>
 #include <tuple>
 #include <variant>
+#include <vector>
 #include <optional>
 
 namespace libtorrent::aux {
@@ -42,6 +44,37 @@ struct tracker_answer
 	aux::rtc_answer answer;
 };
 
+struct websocket_tracker_response {
+	sha1_hash info_hash;
+	std::optional<tracker_response> resp;
+	std::optional<aux::rtc_offer> offer;
+	std::optional<aux::rtc_answer> answer;
+};
+
+// Incremental (SAX-style) parser for messages received from WebSocket
+// trackers. Only the fields we care about are extracted, no DOM is built, and
+// the parser's internal buffers are reused from one message to the next.
+struct TORRENT_EXTRA_EXPORT websocket_tracker_parser
+{
+	websocket_tracker_parser();
+	~websocket_tracker_parser();
+	websocket_tracker_parser(websocket_tracker_parser const&) = delete;
+	websocket_tracker_parser& operator=(websocket_tracker_parser const&) = delete;
+
+	std::variant<websocket_tracker_response, std::string>
+		parse(span<char const> message, error_code& ec);
+
+private:
+	struct impl;
+	std::unique_ptr<impl> m_impl;
+};
+
+// these append the JSON encoding of the message to ``out``
+TORRENT_EXTRA_EXPORT void write_websocket_tracker_message(std::string& out
+	, tracker_request const& req);
+TORRENT_EXTRA_EXPORT void write_websocket_tracker_message(std::string& out
+	, tracker_answer const& ans);
+
 struct TORRENT_EXTRA_EXPORT websocket_tracker_connection : tracker_connection
 {
 	friend class tracker_manager;
@@ -70,8 +103,7 @@ private:
 	}
 
 	void send_pending();
-	void do_send(tracker_request const& req);
-	void do_send(tracker_answer const& ans);
+	void do_write();
 	void do_read();
 	void on_timeout(error_code const& ec) override;
 	void on_connect(error_code const& ec);
@@ -83,7 +115,14 @@ private:
 	ssl::context m_ssl_context;
 	std::shared_ptr<aux::websocket_stream> m_websocket;
 	boost::beast::flat_buffer m_read_buffer;
+	websocket_tracker_parser m_parser;
+
+	// pending messages are encoded back to back in m_write_data, and written
+	// one WebSocket message at a time. The buffer is reused across batches
 	std::string m_write_data;
+	std::vector<std::size_t> m_write_sizes;
+	std::size_t m_write_index = 0;
+	std::size_t m_write_offset = 0;
 
 	using tracker_message = std::variant<tracker_request, tracker_answer>;
 	std::queue<std::tuple<tracker_message, std::weak_ptr<request_callback>>> m_pending;
@@ -92,13 +131,6 @@ private:
 	bool m_sending = false;
 };
 
-struct websocket_tracker_response {
-	sha1_hash info_hash;
-	std::optional<tracker_response> resp;
-	std::optional<aux::rtc_offer> offer;
-	std::optional<aux::rtc_answer> answer;
-};
-
 TORRENT_EXTRA_EXPORT std::variant<websocket_tracker_response, std::string>
 	parse_websocket_tracker_response(span<char const> message, error_code &ec);
 
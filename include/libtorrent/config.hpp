@@ -136,6 +136,10 @@ see LICENSE file.
 #define TORRENT_USE_IFCONF 1
 #define TORRENT_HAS_SALEN 0
 #define TORRENT_USE_FDATASYNC 1
+#define TORRENT_USE_SYNC_FILE_RANGE 1
+#if defined __GLIBC__ && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define TORRENT_USE_COPY_FILE_RANGE 1
+#endif
 
 #if defined __GLIBC__ && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ > 24))
 #define TORRENT_USE_GETRANDOM 1
@@ -430,6 +434,14 @@ see LICENSE file.
 #define TORRENT_USE_FDATASYNC 0
 #endif
 
+#ifndef TORRENT_USE_SYNC_FILE_RANGE
+#define TORRENT_USE_SYNC_FILE_RANGE 0
+#endif
+
+#ifndef TORRENT_USE_COPY_FILE_RANGE
+#define TORRENT_USE_COPY_FILE_RANGE 0
+#endif
+
 #ifndef TORRENT_USE_UNC_PATHS
 #define TORRENT_USE_UNC_PATHS 0
 #endif
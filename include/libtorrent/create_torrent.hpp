@@ -435,8 +435,11 @@ namespace aux {
 	//
 	// 	void Fun(piece_index_t);
 	//
-	// The overloads taking a settings_pack may be used to configure the
-	// underlying disk access. Such as ``settings_pack::aio_threads``.
+	// The files are read sequentially, in large chunks, and hashed by a pool
+	// of threads while the next chunk is read. For hybrid torrents, the v1
+	// and v2 hashes are computed in the same pass. The overloads taking a
+	// settings_pack may be used to set the number of hashing threads,
+	// ``settings_pack::hashing_threads``.
 	//
 	// The overloads that don't take an ``error_code&`` may throw an exception in case of a
 	// file error, the other overloads sets the error code to reflect the error, if any.
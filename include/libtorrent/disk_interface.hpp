@@ -150,6 +150,12 @@ namespace file_open_mode {
 		// hash does not need to be computed.
 		static inline constexpr disk_job_flags_t v1_hash = 5_bit;
 
+		// the read is for a piece with a deadline, set by
+		// torrent_handle::set_piece_deadline(). Disk I/O implementations that
+		// queue jobs should execute these reads ahead of other jobs, earliest
+		// deadline first. This flag is set by async_read_deadline().
+		static inline constexpr disk_job_flags_t time_critical = 7_bit;
+
 		// this is called when a new torrent is added. The shared_ptr can be
 		// used to hold the internal torrent object alive as long as there are
 		// outstanding disk operations on the storage.
@@ -173,6 +179,21 @@ namespace file_open_mode {
 		virtual void async_read(storage_index_t storage, peer_request const& r
 			, std::function<void(disk_buffer_holder, storage_error const&)> handler
 			, disk_job_flags_t flags = {}) = 0;
+
+		// like async_read(), but the block is needed by ``deadline``. This is
+		// used for time-critical (streaming) pieces. The default
+		// implementation calls async_read() with the time_critical flag set,
+		// disk I/O implementations that queue jobs may override this to
+		// prioritize the read by its deadline.
+		virtual void async_read_deadline(storage_index_t storage, peer_request const& r
+			, time_point deadline
+			, std::function<void(disk_buffer_holder, storage_error const&)> handler
+			, disk_job_flags_t flags = {})
+		{
+			TORRENT_UNUSED(deadline);
+			async_read(storage, r, std::move(handler), flags | time_critical);
+		}
+
 		virtual bool async_write(storage_index_t storage, peer_request const& r
 			, char const* buf, std::shared_ptr<disk_observer> o
 			, std::function<void(storage_error const&)> handler
@@ -203,6 +224,20 @@ namespace file_open_mode {
 		virtual void async_move_storage(storage_index_t storage, std::string p, move_flags_t flags
 			, std::function<void(status_t, std::string const&, storage_error const&)> handler) = 0;
 
+		// like async_move_storage(), but if files have to be copied, because
+		// the new location is on a different volume, ``progress`` is called on
+		// the network thread with the number of bytes copied so far and the
+		// total number of bytes to copy. The default implementation doesn't
+		// report progress, it just calls async_move_storage().
+		virtual void async_move_storage_progress(storage_index_t storage, std::string p
+			, move_flags_t flags
+			, std::function<void(status_t, std::string const&, storage_error const&)> handler
+			, std::function<void(std::int64_t, std::int64_t)> progress)
+		{
+			TORRENT_UNUSED(progress);
+			async_move_storage(storage, std::move(p), flags, std::move(handler));
+		}
+
 		// This is called on disk I/O objects to request they close all open
 		// files for the specified storage/torrent. If file handles are not
 		// pooled/cached, it can be a no-op. For truly asynchronous disk I/O,
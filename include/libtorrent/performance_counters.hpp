@@ -301,6 +301,78 @@ namespace libtorrent {
 			socket_recv_size19,
 			socket_recv_size20,
 
+			// WebTorrent offer counters
+			rtc_offer_pool_hits,
+			rtc_offer_pool_misses,
+			rtc_offers_generated,
+			rtc_offer_generation_time,
+			rtc_shared_connections,
+
+			// WebTorrent connection counters
+			rtc_answers_received,
+			rtc_answer_time,
+			rtc_ice_connected,
+			rtc_ice_connect_time,
+			rtc_data_channels_opened,
+			rtc_data_channel_open_time,
+			rtc_connection_failures,
+			rtc_connection_timeouts,
+			rtc_messages_in,
+			rtc_messages_out,
+			rtc_bytes_in,
+			rtc_bytes_out,
+			rtc_send_stalls,
+
+			// the time it took to open WebTorrent DataChannels, from
+			// the remote session description. The time is
+			// 1 << n milliseconds, where n is the number at the end
+			// of the counter name
+
+			// 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768
+			rtc_connect_time5,
+			rtc_connect_time6,
+			rtc_connect_time7,
+			rtc_connect_time8,
+			rtc_connect_time9,
+			rtc_connect_time10,
+			rtc_connect_time11,
+			rtc_connect_time12,
+			rtc_connect_time13,
+			rtc_connect_time14,
+			rtc_connect_time15,
+
+			read_cache_hits,
+			read_cache_misses,
+			read_cache_evictions,
+
+			num_disk_flushes,
+			num_flush_ranges,
+			disk_flush_bytes,
+			disk_flush_time,
+
+			disk_threads_grown,
+			disk_threads_shrunk,
+
+			// the order of these must match aux::job_class_t
+			disk_read_queue_time,
+			disk_write_queue_time,
+			disk_hash_queue_time,
+			disk_other_queue_time,
+
+			tracker_announces,
+			tracker_announce_queue_time,
+			tracker_announce_time,
+
+			udp_tracker_connection_id_hits,
+			udp_tracker_connection_id_misses,
+			udp_tracker_connection_id_waits,
+			udp_tracker_connection_id_refreshes,
+
+			http_tracker_connections_reused,
+			http_tracker_connections_opened,
+			http_tracker_connect_time,
+			http_tracker_ssl_sessions_resumed,
+
 			num_stats_counters
 		};
 
@@ -436,6 +508,21 @@ namespace libtorrent {
 
 			num_queued_tracker_announces,
 
+			num_rtc_pooled_offers,
+
+			read_cache_blocks,
+
+			disk_generic_thread_limit,
+			disk_hash_thread_limit,
+			disk_generic_queue_wait,
+			disk_generic_service_time,
+			disk_hash_queue_wait,
+			disk_hash_service_time,
+
+			num_scheduled_tracker_announces,
+
+			num_idle_http_tracker_connections,
+
 			num_counters,
 			num_gauges_counters = num_counters - num_stats_counters
 		};
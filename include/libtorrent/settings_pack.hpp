@@ -359,6 +359,14 @@ namespace aux {
 			// traversal for WebRTC. It must have the format ``hostname:port``.
 			webtorrent_stun_server,
 
+			// the comma-separated list of name servers used by the built-in
+			// DNS client (see ``builtin_dns_resolver``), as IP addresses with
+			// an optional port, e.g. ``"1.1.1.1,[2606:4700:4700::1111]:53"``.
+			// If empty, the nameservers listed in /etc/resolv.conf are used.
+			// On Windows, where there is no resolv.conf, leaving this empty
+			// makes libtorrent use the system resolver.
+			dns_servers,
+
 			max_string_setting_internal
 		};
 
@@ -974,6 +982,43 @@ namespace aux {
 			// previously deleted information from the disk.
 			enable_set_file_valid_data,
 
+			// when enabled, WebTorrent connections to a client we are already
+			// connected to for another torrent open an additional DataChannel
+			// on the existing WebRTC connection, instead of negotiating a new
+			// one. This only works with other libtorrent based clients, which
+			// advertise support in their session descriptions. This is off by
+			// default, since the session-wide id advertised for it lets others
+			// tell that the same client is in several swarms.
+			webtorrent_share_connections,
+
+			// when ``disk_buffer_slab_size`` is set, this makes the disk
+			// buffer pool back its slabs with huge pages. On Linux, explicit
+			// huge pages (``MAP_HUGETLB``) are used if any have been reserved,
+			// otherwise transparent huge pages are requested with
+			// ``madvise()``. Slabs are rounded up to a multiple of 2 MiB.
+			disk_buffer_huge_pages,
+
+			// when enabled, the number of disk threads is adjusted at run time
+			// based on how long disk jobs wait in the queue compared to how
+			// long they take to execute. ``aio_threads`` and
+			// ``hashing_threads`` become the upper bounds of the generic and
+			// hashing thread pools. A pool has at least one thread, unless
+			// its upper bound is 0. The current limits and the measured
+			// latencies are reported as session stats.
+			adaptive_disk_threads,
+
+			// when enabled, host names are resolved by libtorrent's own DNS
+			// client instead of the operating system's resolver. It sends the
+			// queries to the name servers in ``dns_servers`` directly, over
+			// UDP from a new random source port for every query, and retries
+			// over TCP when a response is truncated. It runs any number of
+			// lookups in parallel and caches both successful and failed
+			// lookups for as long as their TTL allows (capped by
+			// ``resolver_cache_timeout``). Names about to expire from the
+			// cache are refreshed in the background. It does not consult the
+			// hosts file.
+			builtin_dns_resolver,
+
 			max_bool_setting_internal
 		};
 
@@ -1054,10 +1099,17 @@ namespace aux {
 			// reliable.
 			urlseed_timeout,
 
-			// controls the pipelining size of url and http seeds. i.e. the number of HTTP
-			// request to keep outstanding before waiting for the first one to
-			// complete. It's common for web servers to limit this to a relatively
-			// low number, like 5
+			// controls the pipelining size of url and http seeds. i.e. the
+			// number of HTTP requests to keep outstanding on a web seed
+			// connection before waiting for the first one to complete. It's
+			// common for web servers to limit this to a relatively low number,
+			// which is why it defaults to 5. A range spanning several files is
+			// requested with one HTTP request per file, each of them counts
+			// towards the limit. Values less than 1 are treated as 1. Requests
+			// that have to wait for room in the pipeline are merged with
+			// adjacent ones (up to urlseed_max_request_bytes), to make fewer,
+			// larger requests. Servers that don't support keep-alive are only
+			// sent one request at a time
 			urlseed_pipeline_size,
 
 			// number of seconds until a new retry of a url-seed takes place.
@@ -1985,6 +2037,126 @@ namespace aux {
 			// the WebRTC connection timeout used by WebTorrent (in seconds)
 			webtorrent_connection_timeout,
 
+			// flow control thresholds for WebTorrent DataChannels, in bytes.
+			// Writes to a DataChannel complete as soon as the data is queued,
+			// as long as the amount of buffered data in the channel stays below
+			// ``webtorrent_send_buffer_high_watermark``. Once it goes above,
+			// writing stalls until the buffered amount drains to
+			// ``webtorrent_send_buffer_low_watermark``.
+			webtorrent_send_buffer_low_watermark,
+			webtorrent_send_buffer_high_watermark,
+
+			// the number of WebRTC offers generated ahead of time and shared by
+			// all torrents announcing to WebSocket trackers. Pre-generated
+			// offers have already gathered their ICE candidates, so announces
+			// drawing from the pool are not delayed. Each pooled offer keeps a
+			// PeerConnection open and is re-gathered every
+			// ``webtorrent_offer_pool_expiry`` seconds, so the pool is disabled
+			// (0) by default. Lowering this setting discards the excess offers.
+			webtorrent_offer_pool_size,
+
+			// the number of seconds a pre-generated WebRTC offer is kept in the
+			// pool before being discarded and replaced by a fresh one.
+			webtorrent_offer_pool_expiry,
+
+			// when set to a non-zero value, the disk buffer pool allocates
+			// memory in regions of this many bytes (slabs), carved into 16 kiB
+			// blocks, instead of calling malloc() for each block. Threads keep
+			// a small cache of free blocks, so most allocations and frees don't
+			// need any synchronization. The slabs are kept until the session is
+			// destructed, so the memory use stays at its peak. This is only
+			// read when the disk I/O subsystem is constructed.
+			disk_buffer_slab_size,
+
+			// ``read_cache_size`` is the number of 16 kiB blocks to keep in a
+			// user-space read cache, in front of the disk. It's used to serve
+			// blocks that are requested by many peers without reading them from
+			// disk again, which is useful when seeding popular torrents. When a
+			// block is not in the cache, ``read_cache_line_size`` blocks from the
+			// same piece are read along with it. When ``suggest_mode`` is set to
+			// ``suggest_read_cache``, the whole piece is read, in order for the
+			// suggested pieces to actually be in the cache. Pieces are evicted
+			// using the 2Q algorithm. Setting this to 0 disables the cache, which
+			// is the default. The cached blocks are allocated from the disk
+			// buffer pool, whose limit (``max_queued_disk_bytes``) is raised by
+			// this many blocks.
+			read_cache_size,
+
+			// ``max_dirty_bytes`` is the number of bytes written to a torrent's
+			// files that may be left for the operating system to write back at
+			// its own pace. Once a torrent has this many bytes of unflushed
+			// writes, the disk thread starts writing them back, merging
+			// contiguous writes into large ranges and issuing them in file
+			// offset order, and waits for the previous batch to complete. This
+			// turns the scattered writeback of pieces downloaded out of order
+			// into mostly sequential I/O, which matters for spinning disks and
+			// SMR drives. It also bounds the amount of dirty memory per torrent
+			// to about twice this value. Setting it to 0 disables it, leaving
+			// writeback to the operating system.
+			max_dirty_bytes,
+
+			// the relative share of disk thread time given to each class of
+			// disk jobs, when jobs of several classes are queued. Reads are
+			// requested by peers waiting for the data, writes hold on to disk
+			// buffers until they complete, hash jobs are mostly torrent
+			// checking and the other class is made up of moving storage,
+			// renaming and deleting files and other maintenance. With the
+			// default weights, reads get 8 jobs for every 4 writes, 2 hash
+			// jobs and 1 other job. Within each class, torrents take turns, so
+			// that a torrent being checked or moved won't starve the disk I/O
+			// of other torrents. Weights less than 1 are treated as 1.
+			disk_queue_read_weight,
+			disk_queue_write_weight,
+			disk_queue_hash_weight,
+			disk_queue_other_weight,
+
+			// when moving the storage of a torrent to a different volume, the
+			// files have to be copied rather than renamed.
+			// ``move_storage_threads`` is the max number of files copied at the
+			// same time. Files are copied with copy_file_range(), or cloned if
+			// the file system supports it, on linux. A copy interrupted by the
+			// process exiting is resumed by the next move to the same location.
+			move_storage_threads,
+
+			// scrape requests to the same tracker are held back for up to
+			// this many milliseconds, to be sent together. UDP trackers are
+			// scraped with up to 74 info-hashes per request and HTTP trackers
+			// with multiple ``info_hash`` arguments. 0 disables batching, which
+			// is the default.
+			scrape_batch_delay,
+
+			// the max number of announces to a single tracker host that may be
+			// outstanding at a time, across all torrents. Additional announces
+			// are queued, and announces of downloading torrents with few peers
+			// are sent first. 0 means no limit, and disables the jitter below.
+			// Announces are then sent right away, which is the default.
+			max_concurrent_host_announces,
+
+			// regular re-announces (without an event) are delayed by a random
+			// number of milliseconds, up to this value. This spreads out the
+			// announces of torrents that were started at the same time, to
+			// avoid having them all re-announce at the same time too.
+			announce_jitter,
+
+			// the number of connections to open to each web seed. Each
+			// connection requests its own range of pieces, which lets a torrent
+			// served by a single HTTP server download faster than a single TCP
+			// stream allows. The first connection is opened as usual, the
+			// others once it has connected. max_web_seed_connections still
+			// limits the number of web seeds, not connections.
+			urlseed_connections,
+
+			// HTTP tracker connections are kept open (HTTP/1.1 keep-alive) for
+			// this many seconds after a response, to be reused by the next
+			// announce or scrape to the same tracker host, by any torrent. 0
+			// disables keep-alive. The TLS session of HTTPS trackers is
+			// resumed on new connections either way.
+			tracker_keep_alive_timeout,
+
+			// the max number of idle connections to keep open to a single
+			// HTTP tracker host. See tracker_keep_alive_timeout.
+			max_idle_tracker_connections,
+
 			max_int_setting_internal
 		};
 
@@ -2925,7 +2925,7 @@ namespace {
 		"dht_pkt", "dht_get_peers_reply", "dht_direct_response",
 		"picker_log", "session_error", "dht_live_nodes",
 		"session_stats_header", "dht_sample_infohashes",
-		"block_uploaded", "alerts_dropped", "socks5"
+		"block_uploaded", "alerts_dropped", "socks5", "storage_moved_progress"
 		}};
 
 		TORRENT_ASSERT(alert_type >= 0);
@@ -2971,4 +2971,23 @@ namespace {
 #endif
 	}
 
+	storage_moved_progress_alert::storage_moved_progress_alert(aux::stack_allocator& alloc
+		, torrent_handle const& h, std::int64_t const copied, std::int64_t const total)
+		: torrent_alert(alloc, h)
+		, bytes_copied(copied)
+		, total_bytes(total)
+	{}
+
+	std::string storage_moved_progress_alert::message() const
+	{
+#ifdef TORRENT_DISABLE_ALERT_MSG
+		return {};
+#else
+		char ret[300];
+		std::snprintf(ret, sizeof(ret), "%s moving storage: %" PRId64 " of %" PRId64 " bytes copied"
+			, torrent_alert::message().c_str(), bytes_copied, total_bytes);
+		return ret;
+#endif
+	}
+
 } // namespace libtorrent
@@ -12,24 +12,25 @@ see LICENSE file.
 */
 
 #include "libtorrent/create_torrent.hpp"
-#include "libtorrent/mmap_disk_io.hpp" // for hasher_thread_divisor
-#include "libtorrent/disk_interface.hpp"
 #include "libtorrent/aux_/merkle.hpp" // for merkle_*()
 #include "libtorrent/torrent_info.hpp"
-#include "libtorrent/performance_counters.hpp" // for counters
 #include "libtorrent/aux_/throw.hpp"
 #include "libtorrent/aux_/path.hpp"
 #include "libtorrent/aux_/session_settings.hpp"
-#include "libtorrent/session.hpp" // for default_disk_io_constructor
 #include "libtorrent/aux_/directory.hpp"
+#include "libtorrent/aux_/file_pointer.hpp"
 
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <functional>
 #include <memory>
-
-using namespace std::placeholders;
+#include <mutex>
+#include <thread>
 
 namespace libtorrent {
 namespace {
@@ -103,76 +104,298 @@ namespace {
 		}
 	}
 
-	struct hash_state
+	// hashes the pieces of a torrent in a single pass over its files. The
+	// files are read from start to end, in chunks of whole pieces and at
+	// least chunk_size bytes. While the next chunk is being read, a pool of
+	// threads hashes the previous ones, computing both the SHA-1 piece hashes
+	// (v1) and the SHA-256 block hashes (v2) from the same buffer
+	struct piece_hasher
 	{
-		create_torrent& ct;
-		storage_holder storage;
-		disk_interface& iothread;
-		piece_index_t piece_counter;
-		piece_index_t completed_piece;
-		std::function<void(piece_index_t)> const& f;
-		error_code& ec;
+		piece_hasher(create_torrent& t, std::string const& path, int num_threads);
+		~piece_hasher();
+		piece_hasher(piece_hasher const&) = delete;
+		piece_hasher& operator=(piece_hasher const&) = delete;
+
+		void run(std::function<void(piece_index_t)> const& f, error_code& ec);
+
+	private:
+
+		// the smallest read, in bytes
+		static constexpr int chunk_size = 4 * 1024 * 1024;
+
+		struct chunk
+		{
+			piece_index_t first_piece{0};
+			int num_pieces = 0;
+			std::vector<char> buffer;
+			aux::vector<sha1_hash> v1_hashes;
+			aux::vector<sha256_hash> v2_roots;
+
+			// set by the hashing thread once it's done with the chunk
+			bool done = false;
+		};
+
+		bool read_chunk(chunk& c, piece_index_t first_piece, int num_pieces
+			, error_code& ec);
+		void hash_chunk(chunk& c) const;
+		void set_hashes(chunk const& c, std::function<void(piece_index_t)> const& f);
+		void hash_thread();
+		void stop();
+
+		create_torrent& m_ct;
+		file_storage const& m_files;
+		std::string const& m_path;
+		bool const m_v1;
+		bool const m_v2;
+
+		// the file currently being read, and the offset of the next read
+		// within it
+		file_index_t m_file{-1};
+		aux::file_pointer m_handle;
+		std::int64_t m_file_offset = 0;
+
+		std::vector<chunk> m_chunks;
+
+		std::mutex m_mutex;
+		std::condition_variable m_queue_cond;
+		std::condition_variable m_done_cond;
+		std::deque<chunk*> m_queue;
+		bool m_abort = false;
+
+		std::vector<std::thread> m_threads;
 	};
 
-	void on_hash(aux::vector<sha256_hash> v2_blocks, piece_index_t const piece
-		, sha1_hash const& piece_hash, storage_error const& error, hash_state* st)
+	piece_hasher::piece_hasher(create_torrent& t, std::string const& path
+		, int const num_threads)
+		: m_ct(t)
+		, m_files(t.files())
+		, m_path(path)
+		, m_v1(!t.is_v2_only())
+		, m_v2(!t.is_v1_only())
+		// one chunk per thread being hashed, one being read and one being
+		// handed over
+		, m_chunks(std::size_t(num_threads + 2))
+	{
+		for (int i = 0; i < num_threads; ++i)
+			m_threads.emplace_back(&piece_hasher::hash_thread, this);
+	}
+
+	piece_hasher::~piece_hasher() { stop(); }
+
+	void piece_hasher::stop()
 	{
-		if (error)
 		{
-			// on error
-			st->ec = error.ec;
-			st->iothread.abort(true);
-			return;
+			std::lock_guard<std::mutex> l(m_mutex);
+			m_abort = true;
+			m_queue.clear();
 		}
+		m_queue_cond.notify_all();
+		for (auto& t : m_threads) t.join();
+		m_threads.clear();
+	}
+
+	void piece_hasher::run(std::function<void(piece_index_t)> const& f, error_code& ec)
+	{
+		int const num_pieces = m_files.num_pieces();
+		int const chunk_pieces = std::max(1, chunk_size / m_files.piece_length());
+		int const num_buffers = int(m_chunks.size());
+
+		// the next piece to read and the next one to set the hash of
+		int read_piece = 0;
+		int done_piece = 0;
+		int read_chunks = 0;
+		int done_chunks = 0;
+		while (done_piece < num_pieces)
+		{
+			bool const can_read = read_piece < num_pieces
+				&& read_chunks - done_chunks < num_buffers;
 
-		if (!st->ct.is_v2_only())
-			st->ct.set_hash(piece, piece_hash);
+			chunk* done = nullptr;
+			{
+				std::unique_lock<std::mutex> l(m_mutex);
+				chunk& c = m_chunks[std::size_t(done_chunks % num_buffers)];
+				if (!can_read) m_done_cond.wait(l, [&c] { return c.done; });
+				if (c.done) done = &c;
+			}
+
+			if (done != nullptr)
+			{
+				set_hashes(*done, f);
+				done->done = false;
+				done_piece += done->num_pieces;
+				++done_chunks;
+				continue;
+			}
 
-		if (!st->ct.is_v1_only())
+			chunk& c = m_chunks[std::size_t(read_chunks % num_buffers)];
+			int const n = std::min(chunk_pieces, num_pieces - read_piece);
+			if (!read_chunk(c, piece_index_t(read_piece), n, ec)) break;
+			{
+				std::lock_guard<std::mutex> l(m_mutex);
+				m_queue.push_back(&c);
+			}
+			m_queue_cond.notify_one();
+			read_piece += n;
+			++read_chunks;
+		}
+		stop();
+	}
+
+	bool piece_hasher::read_chunk(chunk& c, piece_index_t const first_piece
+		, int const num_pieces, error_code& ec)
+	{
+		c.first_piece = first_piece;
+		c.num_pieces = num_pieces;
+
+		std::int64_t const start = static_cast<int>(first_piece) * std::int64_t(m_files.piece_length());
+		std::int64_t const size = std::min(std::int64_t(num_pieces) * m_files.piece_length()
+			, m_files.total_size() - start);
+		c.buffer.resize(std::size_t(size));
+
+		char* buf = c.buffer.data();
+		for (auto const& s : m_files.map_block(first_piece, 0, size))
 		{
-			file_index_t const current_file = st->ct.files().file_index_at_piece(piece);
-			if (!st->ct.files().pad_file_at(current_file))
+			if (m_files.pad_file_at(s.file_index))
+			{
+				std::memset(buf, 0, std::size_t(s.size));
+				buf += s.size;
+				continue;
+			}
+
+			if (s.file_index != m_file)
+			{
+				m_handle = aux::file_pointer{};
+				std::string const fn = m_files.file_path(s.file_index, m_path);
+#ifdef TORRENT_WINDOWS
+				FILE* f = ::_wfopen(convert_to_native_path_string(fn).c_str(), L"rb");
+#else
+				FILE* f = std::fopen(fn.c_str(), "rb");
+#endif
+				if (f == nullptr)
+				{
+					ec.assign(errno, generic_category());
+					return false;
+				}
+				// the reads are large, don't copy them through the stdio buffer
+				std::setvbuf(f, nullptr, _IONBF, 0);
+				m_handle = aux::file_pointer{f};
+				m_file = s.file_index;
+				m_file_offset = 0;
+			}
+
+			if (s.offset != m_file_offset)
+			{
+				if (aux::portable_fseeko(m_handle.file(), s.offset, SEEK_SET) != 0)
+				{
+					ec.assign(errno, generic_category());
+					return false;
+				}
+				m_file_offset = s.offset;
+			}
+
+			std::size_t const len = std::size_t(s.size);
+			std::size_t const r = std::fread(buf, 1, len, m_handle.file());
+			if (r != len)
 			{
-				piece_index_t const file_first_piece(int(st->ct.files().file_offset(current_file) / st->ct.piece_length()));
-				TORRENT_ASSERT(st->ct.files().file_offset(current_file) % st->ct.piece_length() == 0);
-
-				auto const file_piece_offset = piece - file_first_piece;
-				auto const file_size = st->ct.files().file_size(current_file);
-				auto const file_blocks = st->ct.files().file_num_blocks(current_file);
-				auto const piece_blocks = st->ct.files().blocks_in_piece2(piece);
-				int const num_leafs = merkle_num_leafs(file_blocks);
-				// If the file is smaller than one piece then the block hashes
-				// should be padded to the next power of two instead of the next
-				// piece boundary.
-				int const padded_leafs = file_size < st->ct.piece_length()
-					? num_leafs
-					: st->ct.piece_length() / default_block_size;
-
-				TORRENT_ASSERT(padded_leafs <= int(v2_blocks.size()));
-				for (auto i = piece_blocks; i < padded_leafs; ++i)
-					v2_blocks[i].clear();
-				sha256_hash const piece_root = merkle_root(
-					span<sha256_hash>(v2_blocks).first(padded_leafs));
-				st->ct.set_hash2(current_file, file_piece_offset, piece_root);
+				if (std::ferror(m_handle.file())) ec.assign(errno, generic_category());
+				else ec = errors::file_too_short;
+				return false;
 			}
+			buf += s.size;
+			m_file_offset += s.size;
 		}
+		return true;
+	}
+
+	void piece_hasher::hash_chunk(chunk& c) const
+	{
+		int const piece_length = m_files.piece_length();
+		c.v1_hashes.resize(m_v1 ? c.num_pieces : 0);
+		c.v2_roots.resize(m_v2 ? c.num_pieces : 0);
 
-		auto flags = disk_interface::sequential_access;
-		if (!st->ct.is_v2_only()) flags |= disk_interface::v1_hash;
+		aux::vector<sha256_hash> v2_blocks;
+		if (m_v2) v2_blocks.resize(piece_length / default_block_size);
 
-		st->f(st->completed_piece);
-		++st->completed_piece;
-		if (st->piece_counter < st->ct.files().end_piece())
+		for (int i = 0; i < c.num_pieces; ++i)
 		{
-			span<sha256_hash> v2_span(v2_blocks);
-			st->iothread.async_hash(st->storage, st->piece_counter, v2_span, flags
-				, std::bind(&on_hash, std::move(v2_blocks), _1, _2, _3, st));
-			++st->piece_counter;
-			st->iothread.submit_jobs();
+			piece_index_t const piece = c.first_piece + piece_index_t::diff_type(i);
+			char const* const data = c.buffer.data() + std::ptrdiff_t(i) * piece_length;
+
+			int const piece_size = m_v1 ? m_files.piece_size(piece) : 0;
+
+			file_index_t const file = m_files.file_index_at_piece(piece);
+			bool const v2 = m_v2 && !m_files.pad_file_at(file);
+			int const piece_size2 = v2 ? m_files.piece_size2(piece) : 0;
+
+			// hash both versions block by block, while the block is in the
+			// cache
+			hasher h;
+			for (int offset = 0; offset < std::max(piece_size, piece_size2)
+				; offset += default_block_size)
+			{
+				if (offset < piece_size)
+					h.update(data + offset, std::min(default_block_size, piece_size - offset));
+				if (offset < piece_size2)
+				{
+					v2_blocks[offset / default_block_size] = hasher256(data + offset
+						, std::min(default_block_size, piece_size2 - offset)).final();
+				}
+			}
+			if (m_v1) c.v1_hashes[i] = h.final();
+			if (!v2) continue;
+
+			auto const file_size = m_files.file_size(file);
+			int const piece_blocks = m_files.blocks_in_piece2(piece);
+			int const num_leafs = merkle_num_leafs(m_files.file_num_blocks(file));
+			// If the file is smaller than one piece then the block hashes
+			// should be padded to the next power of two instead of the next
+			// piece boundary.
+			int const padded_leafs = file_size < piece_length
+				? num_leafs
+				: piece_length / default_block_size;
+
+			TORRENT_ASSERT(padded_leafs <= int(v2_blocks.size()));
+			for (auto j = piece_blocks; j < padded_leafs; ++j)
+				v2_blocks[j].clear();
+			c.v2_roots[i] = merkle_root(span<sha256_hash>(v2_blocks).first(padded_leafs));
 		}
-		else if (st->completed_piece == st->ct.files().end_piece())
+	}
+
+	// the hashes are set in the calling thread, in piece order
+	void piece_hasher::set_hashes(chunk const& c
+		, std::function<void(piece_index_t)> const& f)
+	{
+		for (int i = 0; i < c.num_pieces; ++i)
 		{
-			st->iothread.abort(true);
+			piece_index_t const piece = c.first_piece + piece_index_t::diff_type(i);
+			if (m_v1) m_ct.set_hash(piece, c.v1_hashes[i]);
+
+			file_index_t const file = m_files.file_index_at_piece(piece);
+			if (m_v2 && !m_files.pad_file_at(file))
+			{
+				piece_index_t const file_first_piece(int(m_files.file_offset(file) / m_files.piece_length()));
+				TORRENT_ASSERT(m_files.file_offset(file) % m_files.piece_length() == 0);
+				m_ct.set_hash2(file, piece - file_first_piece, c.v2_roots[i]);
+			}
+			f(piece);
+		}
+	}
+
+	void piece_hasher::hash_thread()
+	{
+		std::unique_lock<std::mutex> l(m_mutex);
+		for (;;)
+		{
+			m_queue_cond.wait(l, [this] { return m_abort || !m_queue.empty(); });
+			if (m_abort) return;
+
+			chunk* c = m_queue.front();
+			m_queue.pop_front();
+			l.unlock();
+			hash_chunk(*c);
+			l.lock();
+			c->done = true;
+			m_done_cond.notify_all();
 		}
 	}
 
@@ -226,18 +449,6 @@ namespace aux {
 			, default_pred, flags);
 	}
 
-namespace {
-	struct disk_aborter
-	{
-		explicit disk_aborter(disk_interface& dio) : m_dio(dio) {}
-		~disk_aborter() { m_dio.abort(true); }
-		disk_aborter(disk_aborter const&) = delete;
-		disk_aborter& operator=(disk_aborter const&) = delete;
-	private:
-		disk_interface& m_dio;
-	};
-}
-
 	void set_piece_hashes(create_torrent& t, std::string const& p
 		, std::function<void(piece_index_t)> const& f, error_code& ec)
 	{
@@ -251,15 +462,6 @@ namespace {
 		, settings_interface const& sett
 		, std::function<void(piece_index_t)> const& f, error_code& ec)
 	{
-		// optimized path
-#ifdef TORRENT_BUILD_SIMULATOR
-		sim::default_config conf;
-		sim::simulation sim{conf};
-		io_context ios{sim};
-#else
-		io_context ios;
-#endif
-
 #if TORRENT_USE_UNC_PATHS
 		std::string const path = canonicalize_path(p);
 #else
@@ -278,59 +480,9 @@ namespace {
 			return;
 		}
 
-		counters cnt;
-		int const num_threads = sett.get_int(settings_pack::hashing_threads);
-		std::unique_ptr<disk_interface> disk_thread = default_disk_io_constructor(ios, sett, cnt);
-		disk_aborter da(*disk_thread);
-
-		aux::vector<download_priority_t, file_index_t> priorities;
-		sha1_hash info_hash;
-		storage_params params{
-			t.files(),
-			nullptr,
-			path,
-			storage_mode_t::storage_mode_sparse,
-			priorities,
-			info_hash
-		};
-
-		storage_holder storage = disk_thread->new_torrent(params
-			, std::shared_ptr<void>());
-
-		// have 4 outstanding hash requests per thread, and no less than 1 MiB
-		int const jobs_per_thread = 4;
-		int const piece_read_ahead = std::max(num_threads * jobs_per_thread
-			, 1 * 1024 * 1024 / t.piece_length());
-
-		hash_state st = { t, std::move(storage), *disk_thread, piece_index_t(0), piece_index_t(0), f, ec };
-		for (piece_index_t i(0); i < piece_index_t(piece_read_ahead); ++i)
-		{
-			aux::vector<sha256_hash> v2_blocks;
-
-			if (!t.is_v1_only())
-				v2_blocks.resize(t.piece_length() / default_block_size);
-
-			auto flags = disk_interface::sequential_access;
-			if (!t.is_v2_only()) flags |= disk_interface::v1_hash;
-
-			// the span needs to be created before the call to async_hash to ensure that
-			// it is constructed before the vector is moved into the bind context
-			span<sha256_hash> v2_span(v2_blocks);
-			disk_thread->async_hash(st.storage, i, v2_span, flags
-				, std::bind(&on_hash, std::move(v2_blocks), _1, _2, _3, &st));
-			++st.piece_counter;
-			if (st.piece_counter >= t.files().end_piece()) break;
-		}
-		disk_thread->submit_jobs();
-
-#ifdef TORRENT_BUILD_SIMULATOR
-		sim.run();
-#else
-		ios.run();
-#endif
-		if (st.ec) {
-			ec = st.ec;
-		}
+		int const num_threads = std::max(1, sett.get_int(settings_pack::hashing_threads));
+		piece_hasher h(t, path, num_threads);
+		h.run(f, ec);
 	}
 
 	create_torrent::~create_torrent() = default;
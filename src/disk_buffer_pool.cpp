@@ -27,8 +27,20 @@ see LICENSE file.
 #include <linux/unistd.h>
 #endif
 
+#if TORRENT_HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#ifdef TORRENT_WINDOWS
+#include "libtorrent/aux_/windows.hpp"
+#endif
+
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
 namespace libtorrent {
 namespace aux {
 
@@ -44,6 +56,169 @@ namespace aux {
 		}
 	}
 
+	// the number of blocks moved between a thread's cache and the depot at a
+	// time. A thread caches at most twice as many
+	constexpr int slab_batch_size = 32;
+
+	// huge pages are 2 MiB on all architectures we care about
+	constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+	char* allocate_slab(std::size_t const size, bool const huge_pages)
+	{
+#if TORRENT_HAVE_MMAP
+		void* ret = MAP_FAILED;
+#ifdef MAP_HUGETLB
+		if (huge_pages)
+		{
+			// this only succeeds if huge pages have been reserved
+			ret = ::mmap(nullptr, size, PROT_READ | PROT_WRITE
+				, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (ret != MAP_FAILED) return static_cast<char*>(ret);
+		}
+#endif
+		ret = ::mmap(nullptr, size, PROT_READ | PROT_WRITE
+			, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ret == MAP_FAILED) return nullptr;
+#if TORRENT_USE_MADVISE && defined MADV_HUGEPAGE
+		// fall back to transparent huge pages
+		if (huge_pages) ::madvise(ret, size, MADV_HUGEPAGE);
+#endif
+		return static_cast<char*>(ret);
+#elif defined TORRENT_WINDOWS
+		TORRENT_UNUSED(huge_pages);
+		return static_cast<char*>(::VirtualAlloc(nullptr, size
+			, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+#else
+		TORRENT_UNUSED(huge_pages);
+		return static_cast<char*>(std::malloc(size));
+#endif
+	}
+
+	void free_slab(char* slab, std::size_t const size)
+	{
+#if TORRENT_HAVE_MMAP
+		::munmap(slab, size);
+#elif defined TORRENT_WINDOWS
+		TORRENT_UNUSED(size);
+		::VirtualFree(slab, 0, MEM_RELEASE);
+#else
+		TORRENT_UNUSED(size);
+		std::free(slab);
+#endif
+	}
+
+	} // anonymous namespace
+
+	// the slabs of a disk_buffer_pool, and the free blocks which are not
+	// cached by any thread. Slabs are only released when the pool is
+	// destructed, so the memory use stays at its peak.
+	struct slab_depot
+	{
+		slab_depot(int const slab_size, bool const huge_pages)
+			: m_huge_pages(huge_pages)
+		{
+			std::size_t size = std::size_t(std::max(slab_size, default_block_size));
+			std::size_t const granularity = huge_pages
+				? huge_page_size : std::size_t(default_block_size);
+			size = (size + granularity - 1) / granularity * granularity;
+			m_slab_size = size;
+		}
+
+		~slab_depot()
+		{
+			for (char* slab : m_slabs) free_slab(slab, m_slab_size);
+		}
+
+		slab_depot(slab_depot const&) = delete;
+		slab_depot& operator=(slab_depot const&) = delete;
+
+		// appends up to count free blocks to out, allocating a new slab if
+		// there are none. Returns false if we're out of memory
+		bool take(std::vector<char*>& out, int const count)
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			if (m_free.empty() && !grow()) return false;
+
+			auto const n = std::min(std::size_t(count), m_free.size());
+			out.insert(out.end(), m_free.end() - std::ptrdiff_t(n), m_free.end());
+			m_free.resize(m_free.size() - n);
+			return true;
+		}
+
+		void give(char* const* blocks, int const count)
+		{
+			std::lock_guard<std::mutex> l(m_mutex);
+			m_free.insert(m_free.end(), blocks, blocks + count);
+		}
+
+	private:
+
+		bool grow()
+		{
+			std::size_t const num_blocks = m_slab_size / std::size_t(default_block_size);
+
+			// make room for every block up-front, so that returning blocks
+			// never allocates
+			m_slabs.reserve(m_slabs.size() + 1);
+			m_free.reserve(m_num_blocks + num_blocks);
+
+			char* slab = allocate_slab(m_slab_size, m_huge_pages);
+			if (slab == nullptr) return false;
+
+			m_slabs.push_back(slab);
+			m_num_blocks += num_blocks;
+
+			// hand out the blocks in address order
+			for (std::size_t i = num_blocks; i > 0; --i)
+				m_free.push_back(slab + (i - 1) * std::size_t(default_block_size));
+			return true;
+		}
+
+		std::mutex m_mutex;
+		std::vector<char*> m_free;
+		std::vector<char*> m_slabs;
+		std::size_t m_num_blocks = 0;
+		std::size_t m_slab_size;
+		bool const m_huge_pages;
+	};
+
+	namespace {
+
+	// each thread keeps a few free blocks of the last pool it used, to
+	// allocate and free them without any synchronization
+	struct thread_cache
+	{
+		thread_cache() = default;
+		thread_cache(thread_cache const&) = delete;
+		thread_cache& operator=(thread_cache const&) = delete;
+		~thread_cache() { flush(); }
+
+		void flush()
+		{
+			if (auto d = depot.lock())
+				d->give(blocks.data(), int(blocks.size()));
+			blocks.clear();
+			depot.reset();
+		}
+
+		std::weak_ptr<slab_depot> depot;
+		std::vector<char*> blocks;
+	};
+
+	thread_cache& local_cache(std::shared_ptr<slab_depot> const& depot)
+	{
+		thread_local thread_cache cache;
+
+		// the blocks are returned to the depot they came from. If it's gone,
+		// so is their memory and they are just dropped
+		if (cache.depot.owner_before(depot) || depot.owner_before(cache.depot))
+		{
+			cache.flush();
+			cache.depot = depot;
+		}
+		return cache;
+	}
+
 	} // anonymous namespace
 
 	disk_buffer_pool::disk_buffer_pool(io_context& ios)
@@ -66,9 +241,11 @@ namespace aux {
 	// and if we're in fact below the low watermark. If so, we need to
 	// post the notification messages to the peers that are waiting for
 	// more buffers to received data into
-	void disk_buffer_pool::check_buffer_level(std::unique_lock<std::mutex>& l)
+	void disk_buffer_pool::check_buffer_level()
 	{
-		TORRENT_ASSERT(l.owns_lock());
+		if (!m_exceeded_max_size || m_in_use > m_low_watermark) return;
+
+		std::unique_lock<std::mutex> l(m_pool_mutex);
 		if (!m_exceeded_max_size || m_in_use > m_low_watermark) return;
 
 		m_exceeded_max_size = false;
@@ -81,8 +258,7 @@ namespace aux {
 
 	char* disk_buffer_pool::allocate_buffer(char const* category)
 	{
-		std::unique_lock<std::mutex> l(m_pool_mutex);
-		return allocate_buffer_impl(l, category);
+		return allocate_buffer_impl(category);
 	}
 
 	// we allow allocating more blocks even after we exceed the max size,
@@ -95,25 +271,27 @@ namespace aux {
 	char* disk_buffer_pool::allocate_buffer(bool& exceeded
 		, std::shared_ptr<disk_observer> o, char const* category)
 	{
-		std::unique_lock<std::mutex> l(m_pool_mutex);
-		char* ret = allocate_buffer_impl(l, category);
+		char* ret = allocate_buffer_impl(category);
 		if (m_exceeded_max_size)
 		{
-			exceeded = true;
-			if (o) m_observers.push_back(o);
+			// the flag is only cleared under the mutex, along with the
+			// observers being notified. Check again to not miss that
+			std::lock_guard<std::mutex> l(m_pool_mutex);
+			if (m_exceeded_max_size)
+			{
+				exceeded = true;
+				if (o) m_observers.push_back(o);
+			}
 		}
 		return ret;
 	}
 
-	char* disk_buffer_pool::allocate_buffer_impl(std::unique_lock<std::mutex>& l
-		, char const*)
+	char* disk_buffer_pool::allocate_buffer_impl(char const*)
 	{
 		TORRENT_ASSERT(m_settings_set);
 		TORRENT_ASSERT(m_magic == 0x1337);
-		TORRENT_ASSERT(l.owns_lock());
-		TORRENT_UNUSED(l);
 
-		char* ret = static_cast<char*>(std::malloc(default_block_size));
+		char* ret = allocate_block();
 
 		if (ret == nullptr)
 		{
@@ -121,22 +299,23 @@ namespace aux {
 			return nullptr;
 		}
 
-		++m_in_use;
+		int const in_use = ++m_in_use;
 
 #if TORRENT_USE_INVARIANT_CHECKS
 		try
 		{
+			std::lock_guard<std::mutex> l(m_pool_mutex);
 			TORRENT_ASSERT(m_buffers_in_use.count(ret) == 0);
 			m_buffers_in_use.insert(ret);
 		}
 		catch (...)
 		{
-			free_buffer_impl(ret, l);
+			free_buffer_impl(ret);
 			return nullptr;
 		}
 #endif
 
-		if (m_in_use >= m_low_watermark + (m_max_use - m_low_watermark)
+		if (in_use >= m_low_watermark + (m_max_use - m_low_watermark)
 			/ 2 && !m_exceeded_max_size)
 		{
 			m_exceeded_max_size = true;
@@ -150,29 +329,43 @@ namespace aux {
 		// sort the pointers in order to maximize cache hits
 		std::sort(bufvec.begin(), bufvec.end());
 
-		std::unique_lock<std::mutex> l(m_pool_mutex);
 		for (char* buf : bufvec)
 		{
 			remove_buffer_in_use(buf);
-			free_buffer_impl(buf, l);
+			free_buffer_impl(buf);
 		}
 
-		check_buffer_level(l);
+		check_buffer_level();
 	}
 
 	void disk_buffer_pool::free_buffer(char* buf)
 	{
-		std::unique_lock<std::mutex> l(m_pool_mutex);
 		remove_buffer_in_use(buf);
-		free_buffer_impl(buf, l);
-		check_buffer_level(l);
+		free_buffer_impl(buf);
+		check_buffer_level();
 	}
 
 	void disk_buffer_pool::set_settings(settings_interface const& sett)
 	{
 		std::unique_lock<std::mutex> l(m_pool_mutex);
 
-		int const pool_size = std::max(1, sett.get_int(settings_pack::max_queued_disk_bytes) / default_block_size);
+		// the allocator is picked before the first buffer is allocated, and
+		// can't change afterwards
+		if (!m_allocator_set)
+		{
+			TORRENT_ASSERT(m_in_use == 0);
+			int const slab_size = sett.get_int(settings_pack::disk_buffer_slab_size);
+			if (slab_size > 0)
+			{
+				m_slabs = std::make_shared<slab_depot>(slab_size
+					, sett.get_bool(settings_pack::disk_buffer_huge_pages));
+			}
+			m_allocator_set = true;
+		}
+
+		// the read cache allocates its blocks from this pool too
+		int const pool_size = std::max(1, sett.get_int(settings_pack::max_queued_disk_bytes) / default_block_size
+			+ std::max(0, sett.get_int(settings_pack::read_cache_size)));
 		m_max_use = pool_size;
 		m_low_watermark = m_max_use / 2;
 		if (m_in_use >= m_max_use && !m_exceeded_max_size)
@@ -189,24 +382,75 @@ namespace aux {
 	{
 		TORRENT_UNUSED(buf);
 #if TORRENT_USE_INVARIANT_CHECKS
+		std::lock_guard<std::mutex> l(m_pool_mutex);
 		std::set<char*>::iterator i = m_buffers_in_use.find(buf);
 		TORRENT_ASSERT(i != m_buffers_in_use.end());
 		m_buffers_in_use.erase(i);
 #endif
 	}
 
-	void disk_buffer_pool::free_buffer_impl(char* buf, std::unique_lock<std::mutex>& l)
+	void disk_buffer_pool::free_buffer_impl(char* buf)
 	{
 		TORRENT_ASSERT(buf);
 		TORRENT_ASSERT(m_magic == 0x1337);
 		TORRENT_ASSERT(m_settings_set);
-		TORRENT_ASSERT(l.owns_lock());
-		TORRENT_UNUSED(l);
 
-		std::free(buf);
+		free_block(buf);
 
 		--m_in_use;
 	}
 
+	char* disk_buffer_pool::allocate_block()
+	{
+		if (!m_slabs) return static_cast<char*>(std::malloc(default_block_size));
+
+		thread_cache& cache = local_cache(m_slabs);
+		if (cache.blocks.empty())
+		{
+			try
+			{
+				if (!m_slabs->take(cache.blocks, slab_batch_size)) return nullptr;
+			}
+			catch (std::bad_alloc const&)
+			{
+				return nullptr;
+			}
+		}
+
+		char* ret = cache.blocks.back();
+		cache.blocks.pop_back();
+		return ret;
+	}
+
+	void disk_buffer_pool::free_block(char* buf)
+	{
+		if (!m_slabs)
+		{
+			std::free(buf);
+			return;
+		}
+
+		thread_cache& cache = local_cache(m_slabs);
+		try
+		{
+			cache.blocks.push_back(buf);
+		}
+		catch (std::bad_alloc const&)
+		{
+			// the depot has room for all blocks
+			m_slabs->give(&buf, 1);
+			return;
+		}
+
+		// blocks allocated by one thread and freed by another (like disk
+		// threads and the network thread) flow back through the depot
+		int const num_cached = int(cache.blocks.size());
+		if (num_cached >= 2 * slab_batch_size)
+		{
+			m_slabs->give(cache.blocks.data() + num_cached - slab_batch_size, slab_batch_size);
+			cache.blocks.resize(std::size_t(num_cached - slab_batch_size));
+		}
+	}
+
 }
 }
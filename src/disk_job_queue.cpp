@@ -0,0 +1,129 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "libtorrent/aux_/disk_job_queue.hpp"
+#include "libtorrent/assert.hpp"
+#include "libtorrent/disk_interface.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace libtorrent::aux {
+
+namespace {
+
+	// the stride of a class with weight 1. Strides of other classes are
+	// this divided by their weight
+	constexpr std::uint64_t max_stride = 1 << 20;
+}
+
+	job_class_t job_class(job_action_t const a)
+	{
+		switch (a)
+		{
+			case job_action_t::read:
+			case job_action_t::partial_read:
+				return job_class_t::read;
+			case job_action_t::write:
+				return job_class_t::write;
+			case job_action_t::hash:
+			case job_action_t::hash2:
+			case job_action_t::check_fastresume:
+				return job_class_t::hash;
+			case job_action_t::move_storage:
+			case job_action_t::release_files:
+			case job_action_t::delete_files:
+			case job_action_t::rename_file:
+			case job_action_t::stop_torrent:
+			case job_action_t::file_priority:
+			case job_action_t::clear_piece:
+			case job_action_t::num_job_ids:
+				break;
+		}
+		return job_class_t::other;
+	}
+
+	disk_job_queue::disk_job_queue()
+	{
+		set_weights(aux::array<int, num_job_classes>{{8, 4, 2, 1}});
+	}
+
+	void disk_job_queue::set_weights(aux::array<int, num_job_classes> const& weights)
+	{
+		for (int i = 0; i < num_job_classes; ++i)
+			m_classes[i].stride = max_stride / std::uint64_t(std::max(1, weights[i]));
+	}
+
+	void disk_job_queue::push_back(disk_io_job* j)
+	{
+		j->queued_time = clock_type::now();
+
+		if ((j->flags & disk_interface::time_critical)
+			&& job_class(j->action) == job_class_t::read)
+		{
+			m_time_critical.emplace(j->deadline, j);
+			++m_size;
+			return;
+		}
+
+		class_queue& c = m_classes[static_cast<int>(job_class(j->action))];
+		if (c.size == 0) c.pass = std::max(c.pass, m_virtual_time);
+
+		mmap_storage const* st = j->storage.get();
+		auto& q = c.queues[st];
+		if (q.empty()) c.round_robin.push_back(st);
+		q.push_back(j);
+		++c.size;
+		++m_size;
+	}
+
+	void disk_job_queue::append(tailqueue<disk_io_job>& jobs)
+	{
+		while (!jobs.empty()) push_back(jobs.pop_front());
+	}
+
+	disk_io_job* disk_job_queue::pop_front()
+	{
+		TORRENT_ASSERT(m_size > 0);
+
+		if (!m_time_critical.empty())
+		{
+			disk_io_job* j = m_time_critical.begin()->second;
+			m_time_critical.erase(m_time_critical.begin());
+			--m_size;
+			return j;
+		}
+
+		class_queue* next = nullptr;
+		for (auto& c : m_classes)
+		{
+			if (c.size == 0) continue;
+			if (next == nullptr || c.pass < next->pass) next = &c;
+		}
+		TORRENT_ASSERT(next != nullptr);
+		class_queue& c = *next;
+
+		m_virtual_time = c.pass;
+		c.pass += c.stride;
+
+		mmap_storage const* st = c.round_robin.front();
+		c.round_robin.pop_front();
+		auto const it = c.queues.find(st);
+		TORRENT_ASSERT(it != c.queues.end());
+		disk_io_job* j = it->second.pop_front();
+		if (it->second.empty())
+			c.queues.erase(it);
+		else
+			c.round_robin.push_back(st);
+
+		--c.size;
+		--m_size;
+		return j;
+	}
+}
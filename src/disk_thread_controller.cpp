@@ -0,0 +1,57 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "libtorrent/aux_/disk_thread_controller.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <algorithm>
+
+namespace libtorrent::aux {
+
+	void disk_thread_controller::job_done(time_duration const wait
+		, time_duration const service)
+	{
+		m_wait += std::max(std::int64_t(0), total_microseconds(wait));
+		m_service += std::max(std::int64_t(0), total_microseconds(service));
+		++m_jobs;
+	}
+
+	disk_thread_controller::decision disk_thread_controller::update(int const limit
+		, int const max_threads)
+	{
+		TORRENT_ASSERT(max_threads > 0);
+
+		decision ret;
+		ret.jobs = m_jobs.exchange(0);
+		std::int64_t const wait = m_wait.exchange(0);
+		std::int64_t const service = m_service.exchange(0);
+		ret.limit = std::max(1, std::min(limit, max_threads));
+
+		// without any jobs, there's nothing to base a decision on. Idle
+		// threads are taken care of by the thread pool's reaper
+		if (ret.jobs == 0) return ret;
+
+		ret.queue_wait = wait / ret.jobs;
+		ret.service_time = service / ret.jobs;
+
+		if (ret.queue_wait > ret.service_time)
+		{
+			// jobs are waiting longer than it takes to run them, we need more
+			// threads
+			ret.limit = std::min(max_threads, ret.limit + std::max(1, ret.limit / 4));
+		}
+		else if (ret.queue_wait * 8 < ret.service_time)
+		{
+			// jobs are picked up almost immediately, we can probably do with
+			// fewer threads
+			ret.limit = std::max(1, ret.limit - 1);
+		}
+		return ret;
+	}
+}
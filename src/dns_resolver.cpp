@@ -0,0 +1,753 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "libtorrent/aux_/dns_resolver.hpp"
+#include "libtorrent/aux_/debug.hpp"
+#include "libtorrent/aux_/io.hpp"
+#include "libtorrent/aux_/ip_helpers.hpp"
+#include "libtorrent/aux_/random.hpp"
+#include "libtorrent/aux_/string_util.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+using namespace std::placeholders;
+
+namespace libtorrent::aux {
+
+namespace {
+
+	enum : std::uint16_t
+	{
+		flag_response = 0x8000,
+		flag_truncated = 0x0200,
+		flag_recursion_desired = 0x0100,
+
+		type_cname = 5,
+		type_soa = 6,
+		class_in = 1
+	};
+
+	// the cache time for negative responses without an SOA record
+	constexpr seconds default_negative_ttl(60);
+
+	std::string_view strip_root(std::string const& name)
+	{
+		std::string_view ret = name;
+		if (!ret.empty() && ret.back() == '.') ret.remove_suffix(1);
+		return ret;
+	}
+
+	std::uint16_t read16(span<char const> buf, std::ptrdiff_t const pos)
+	{
+		return std::uint16_t((std::uint8_t(buf[pos]) << 8) | std::uint8_t(buf[pos + 1]));
+	}
+
+	std::uint32_t read32(span<char const> buf, std::ptrdiff_t const pos)
+	{
+		return (std::uint32_t(read16(buf, pos)) << 16) | read16(buf, pos + 2);
+	}
+
+	// TTLs with the most significant bit set are treated as 0 (RFC 2181)
+	std::int64_t read_ttl(span<char const> buf, std::ptrdiff_t const pos)
+	{
+		std::uint32_t const ttl = read32(buf, pos);
+		return (ttl & 0x80000000) ? 0 : std::int64_t(ttl);
+	}
+
+	// reads a (possibly compressed) name at ``pos`` and moves ``pos`` past
+	// it. If ``out`` is set, the name is stored there
+	bool read_name(span<char const> buf, std::ptrdiff_t& pos, std::string* out)
+	{
+		std::ptrdiff_t p = pos;
+		bool jumped = false;
+		int jumps = 0;
+		for (;;)
+		{
+			if (p >= buf.size()) return false;
+			std::uint8_t const len = std::uint8_t(buf[p]);
+			if ((len & 0xc0) == 0xc0)
+			{
+				// a pointer to a name earlier in the packet. Limit the number
+				// of them, to not loop forever
+				if (p + 1 >= buf.size() || ++jumps > 16) return false;
+				if (!jumped) pos = p + 2;
+				jumped = true;
+				p = ((len & 0x3f) << 8) | std::uint8_t(buf[p + 1]);
+				continue;
+			}
+			if (len & 0xc0) return false;
+			++p;
+			if (len == 0) break;
+			if (p + len > buf.size()) return false;
+			if (out != nullptr)
+			{
+				if (!out->empty()) out->push_back('.');
+				out->append(buf.data() + p, len);
+			}
+			p += len;
+		}
+		if (!jumped) pos = p;
+		return true;
+	}
+
+	void update_ttl(std::int64_t& ttl, std::int64_t const t)
+	{
+		if (t < 0) return;
+		ttl = ttl < 0 ? t : std::min(ttl, t);
+	}
+}
+
+	bool write_dns_query(std::uint16_t const id, std::string const& hostname
+		, dns_type const type, std::vector<char>& out)
+	{
+		std::string_view name = strip_root(hostname);
+		if (name.empty() || name.size() > 253) return false;
+
+		out.resize(12);
+		span<char> header = out;
+		aux::write_uint16(id, header);
+		aux::write_uint16(flag_recursion_desired, header);
+		aux::write_uint16(1, header); // questions
+		aux::write_uint16(0, header); // answers
+		aux::write_uint16(0, header); // authority records
+		aux::write_uint16(0, header); // additional records
+
+		while (!name.empty())
+		{
+			auto const dot = name.find('.');
+			std::string_view const label = name.substr(0, dot);
+			if (label.empty() || label.size() > 63) return false;
+			out.push_back(char(label.size()));
+			out.insert(out.end(), label.begin(), label.end());
+			if (dot == std::string_view::npos) break;
+			name.remove_prefix(dot + 1);
+			if (name.empty()) return false;
+		}
+		out.push_back(0);
+
+		auto const t = static_cast<std::uint16_t>(type);
+		out.push_back(char(t >> 8));
+		out.push_back(char(t & 0xff));
+		out.push_back(0);
+		out.push_back(char(class_in));
+		return true;
+	}
+
+	bool parse_dns_response(span<char const> const buf
+		, std::string const& hostname, dns_type const type, dns_response& resp)
+	{
+		if (buf.size() < 12) return false;
+
+		resp.id = read16(buf, 0);
+		std::uint16_t const flags = read16(buf, 2);
+		int const num_questions = read16(buf, 4);
+		int const num_answers = read16(buf, 6);
+		int const num_authority = read16(buf, 8);
+
+		if (!(flags & flag_response)) return false;
+		resp.rcode = flags & 0xf;
+		resp.truncated = (flags & flag_truncated) != 0;
+		resp.addresses.clear();
+		resp.ttl = -1;
+
+		// the question must be the one we asked
+		if (num_questions != 1) return false;
+		std::ptrdiff_t pos = 12;
+		std::string qname;
+		if (!read_name(buf, pos, &qname)) return false;
+		if (pos + 4 > buf.size()) return false;
+		if (read16(buf, pos) != static_cast<std::uint16_t>(type)) return false;
+		if (read16(buf, pos + 2) != class_in) return false;
+		if (!string_equal_no_case(qname, strip_root(hostname))) return false;
+		pos += 4;
+
+		auto const t = static_cast<std::uint16_t>(type);
+		for (int i = 0; i < num_answers; ++i)
+		{
+			if (!read_name(buf, pos, nullptr)) return false;
+			if (pos + 10 > buf.size()) return false;
+			std::uint16_t const rtype = read16(buf, pos);
+			std::uint16_t const rclass = read16(buf, pos + 2);
+			std::int64_t const ttl = read_ttl(buf, pos + 4);
+			int const len = read16(buf, pos + 8);
+			pos += 10;
+			if (pos + len > buf.size()) return false;
+
+			if (rclass == class_in && rtype == t)
+			{
+				if (type == dns_type::a && len == 4)
+				{
+					address_v4::bytes_type b;
+					std::memcpy(b.data(), buf.data() + pos, 4);
+					resp.addresses.emplace_back(address_v4(b));
+					update_ttl(resp.ttl, ttl);
+				}
+				else if (type == dns_type::aaaa && len == 16)
+				{
+					address_v6::bytes_type b;
+					std::memcpy(b.data(), buf.data() + pos, 16);
+					resp.addresses.emplace_back(address_v6(b));
+					update_ttl(resp.ttl, ttl);
+				}
+			}
+			else if (rclass == class_in && rtype == type_cname)
+			{
+				// the addresses are only valid for as long as the alias is
+				update_ttl(resp.ttl, ttl);
+			}
+			pos += len;
+		}
+
+		if (!resp.addresses.empty()) return true;
+
+		// a negative response. How long to cache it is the lower of the TTL
+		// of the SOA record and its MINIMUM field (RFC 2308)
+		std::int64_t cname_ttl = resp.ttl;
+		resp.ttl = -1;
+		for (int i = 0; i < num_authority; ++i)
+		{
+			if (!read_name(buf, pos, nullptr)) break;
+			if (pos + 10 > buf.size()) break;
+			std::uint16_t const rtype = read16(buf, pos);
+			std::int64_t const ttl = read_ttl(buf, pos + 4);
+			int const len = read16(buf, pos + 8);
+			pos += 10;
+			if (pos + len > buf.size()) break;
+
+			if (rtype == type_soa)
+			{
+				std::ptrdiff_t p = pos;
+				// MNAME and RNAME, followed by five 32 bit fields, the last one
+				// being MINIMUM
+				if (read_name(buf, p, nullptr) && read_name(buf, p, nullptr)
+					&& p + 20 <= pos + len)
+				{
+					update_ttl(resp.ttl, std::min(ttl, read_ttl(buf, p + 16)));
+				}
+				break;
+			}
+			pos += len;
+		}
+		if (resp.ttl >= 0) update_ttl(resp.ttl, cname_ttl);
+		return true;
+	}
+
+	dns_resolver::dns_resolver(io_context& ios)
+		: m_ios(ios)
+	{}
+
+	dns_resolver::~dns_resolver()
+	{
+		for (auto const& q : m_queries)
+			close_sockets(*q.second);
+	}
+
+	std::vector<udp::endpoint> dns_resolver::system_servers(std::string const& resolv_conf)
+	{
+		std::vector<udp::endpoint> ret;
+		std::ifstream f(resolv_conf);
+		std::string line;
+		while (std::getline(f, line))
+		{
+			std::istringstream words(line);
+			std::string keyword;
+			std::string server;
+			if (!(words >> keyword >> server) || keyword != "nameserver") continue;
+
+			// IPv6 link-local servers may have a zone index, which we don't
+			// support
+			error_code ec;
+			address const addr = make_address(server, ec);
+			if (ec) continue;
+			ret.emplace_back(addr, std::uint16_t(53));
+		}
+		return ret;
+	}
+
+	std::vector<udp::endpoint> const& dns_resolver::servers()
+	{
+		if (!m_servers_loaded)
+		{
+			m_servers = system_servers();
+			m_servers_loaded = true;
+		}
+		return m_servers;
+	}
+
+	void dns_resolver::set_servers(std::vector<udp::endpoint> servers)
+	{
+		m_servers = std::move(servers);
+		m_servers_loaded = !m_servers.empty();
+	}
+
+	void dns_resolver::set_query_timeout(time_duration const timeout, int const attempts)
+	{
+		m_query_timeout = timeout;
+		m_max_attempts = std::max(1, attempts);
+	}
+
+	void dns_resolver::set_cache_timeout(seconds const timeout)
+	{
+		m_timeout = std::max(timeout, seconds(0));
+	}
+
+	void dns_resolver::async_resolve(std::string const& host, resolver_flags const flags
+		, resolver_interface::callback_t h)
+	{
+		// special handling for raw IP addresses. There's no need to get in line
+		// behind actual lookups if we can just resolve it immediately.
+		error_code ec;
+		address const ip = make_address(host, ec);
+		if (!ec)
+		{
+			post(m_ios, [=]{ h(ec, std::vector<address>{ip}); });
+			return;
+		}
+
+		time_point const now = clock_type::now();
+		auto const i = m_cache.find(host);
+		if (i != m_cache.end())
+		{
+			cache_entry& e = i->second;
+			if ((flags & resolver_interface::cache_only) || now < e.expires)
+			{
+				// if the entry is about to expire, refresh it in the
+				// background, so the next lookup finds it in the cache
+				if (!(flags & resolver_interface::cache_only)
+					&& !e.addresses.empty()
+					&& !e.prefetching
+					&& e.expires - now < std::max(e.ttl / 8, time_duration(seconds(1))))
+				{
+					e.prefetching = true;
+					start_query(host, resolver_interface::abort_on_shutdown, {});
+				}
+
+				std::vector<address> ips = e.addresses;
+				error_code const err = ips.empty()
+					? error_code(boost::asio::error::host_not_found) : error_code();
+				post(m_ios, [=] { h(err, ips); });
+				return;
+			}
+		}
+
+		if (flags & resolver_interface::cache_only)
+		{
+			// we did not find a cache entry, fail the lookup
+			post(m_ios, [=] {
+				h(boost::asio::error::host_not_found, std::vector<address>{});
+			});
+			return;
+		}
+
+		start_query(host, flags, std::move(h));
+	}
+
+	void dns_resolver::start_query(std::string const& hostname
+		, resolver_flags const flags, callback_t h)
+	{
+		bool const critical = !(flags & resolver_interface::abort_on_shutdown);
+
+		// if there is an outstanding lookup for this name, our callback
+		// will be called once it completes
+		auto const i = m_queries.find(hostname);
+		if (i != m_queries.end())
+		{
+			if (h) i->second->callbacks.push_back(std::move(h));
+			if (critical) i->second->critical = true;
+			return;
+		}
+
+		auto q = std::make_shared<query>(m_ios);
+		q->hostname = hostname;
+		q->critical = critical;
+		if (h) q->callbacks.push_back(std::move(h));
+		m_queries.emplace(hostname, q);
+		send_query(q);
+	}
+
+	void dns_resolver::send_query(std::shared_ptr<query> const& q)
+	{
+		std::vector<udp::endpoint> const& srv = servers();
+		if (srv.empty())
+		{
+			finish_query(q, boost::asio::error::host_not_found, false);
+			return;
+		}
+
+		// every attempt goes to the next server
+		udp::endpoint const server = srv[std::size_t(q->attempts) % srv.size()];
+		++q->attempts;
+
+		// every attempt is sent from a new socket, bound to a port picked
+		// by the OS, and gets new transaction IDs. That way late responses to
+		// an earlier attempt are ignored, and a spoofed response has to guess
+		// both the port and the ID
+		close_sockets(*q);
+		auto a = std::make_shared<udp_attempt>(m_ios);
+		a->server = server;
+		error_code ec;
+		bool const v4 = aux::is_v4(server);
+		a->sock.open(v4 ? udp::v4() : udp::v6(), ec);
+		if (!ec) a->sock.bind(udp::endpoint(v4
+			? address(address_v4::any()) : address(address_v6::any()), 0), ec);
+		if (ec)
+		{
+			finish_query(q, ec, false);
+			return;
+		}
+		q->udp = a;
+		start_receive(q, a);
+
+		std::vector<char> packet;
+		for (int k = 0; k < 2; ++k)
+		{
+			auto const idx = std::size_t(k);
+			if (q->answered[idx]) continue;
+
+			std::uint16_t& id = q->ids[idx];
+			do
+			{
+				id = std::uint16_t(random(0xfffe) + 1);
+			} while (k == 1 && id == q->ids[0]);
+
+			if (!write_dns_query(id, q->hostname, k == 0 ? dns_type::a : dns_type::aaaa
+				, packet))
+			{
+				finish_query(q, boost::asio::error::host_not_found, false);
+				return;
+			}
+
+			// if sending fails, the timeout will have us try again
+			a->sock.send_to(boost::asio::buffer(packet), server, 0, ec);
+		}
+
+		start_timer(q);
+	}
+
+	void dns_resolver::start_timer(std::shared_ptr<query> const& q)
+	{
+		q->timer.expires_after(m_query_timeout);
+		ADD_OUTSTANDING_ASYNC("dns_resolver::on_timeout");
+		q->timer.async_wait(std::bind(&dns_resolver::on_timeout, this
+			, std::weak_ptr<query>(q), _1));
+	}
+
+	void dns_resolver::on_timeout(std::weak_ptr<query> wq, error_code const& ec)
+	{
+		COMPLETE_ASYNC("dns_resolver::on_timeout");
+		if (ec) return;
+		auto const q = wq.lock();
+		if (!q) return;
+		auto const i = m_queries.find(q->hostname);
+		if (i == m_queries.end() || i->second != q) return;
+
+		if (q->attempts >= m_max_attempts)
+			finish_query(q, boost::asio::error::timed_out, false);
+		else
+			send_query(q);
+	}
+
+	void dns_resolver::start_receive(std::weak_ptr<query> q
+		, std::shared_ptr<udp_attempt> a)
+	{
+		ADD_OUTSTANDING_ASYNC("dns_resolver::on_receive");
+		udp_attempt& att = *a;
+		att.sock.async_receive_from(boost::asio::buffer(att.buffer), att.from
+			, std::bind(&dns_resolver::on_receive, this, std::move(q), std::move(a)
+				, _1, _2));
+	}
+
+	void dns_resolver::on_receive(std::weak_ptr<query> wq
+		, std::shared_ptr<udp_attempt> a, error_code const& ec
+		, std::size_t const bytes)
+	{
+		COMPLETE_ASYNC("dns_resolver::on_receive");
+		if (ec == boost::asio::error::operation_aborted) return;
+		auto const q = wq.lock();
+		if (!q || q->udp != a || !a->sock.is_open()) return;
+
+		span<char const> const buf(a->buffer.data(), std::ptrdiff_t(ec ? 0 : bytes));
+
+		// ignore responses from other hosts than the name server we asked,
+		// and to questions we didn't ask
+		if (buf.size() >= 2 && a->from == a->server)
+		{
+			std::uint16_t const id = read16(buf, 0);
+			int const question = id == 0 ? -1
+				: q->ids[0] == id ? 0
+				: q->ids[1] == id ? 1
+				: -1;
+			dns_response resp;
+			if (question >= 0 && parse_dns_response(buf, q->hostname
+				, question == 0 ? dns_type::a : dns_type::aaaa, resp))
+			{
+				on_response(q, question, resp);
+			}
+		}
+
+		// on_response() may have completed the lookup or started a new
+		// attempt
+		if (q->udp == a && a->sock.is_open())
+			start_receive(q, a);
+	}
+
+	void dns_resolver::on_response(std::shared_ptr<query> const& q, int const question
+		, dns_response const& resp)
+	{
+		auto const k = std::size_t(question);
+		q->ids[k] = 0;
+
+		if (resp.truncated)
+		{
+			start_tcp(q, question, tcp::endpoint(q->udp->server.address()
+				, q->udp->server.port()));
+			return;
+		}
+
+		// 0 is success, 3 is NXDOMAIN. Anything else is a failure of the name
+		// server (like SERVFAIL or REFUSED), ask the next one
+		if (resp.rcode != 0 && resp.rcode != 3)
+		{
+			if (q->attempts >= m_max_attempts)
+				finish_query(q, boost::asio::error::host_not_found_try_again, false);
+			else
+				send_query(q);
+			return;
+		}
+
+		q->answered[k] = true;
+		q->addresses.insert(q->addresses.end(), resp.addresses.begin(), resp.addresses.end());
+		update_ttl(q->ttl, resp.ttl);
+
+		if (!q->answered[0] || !q->answered[1]) return;
+
+		finish_query(q, q->addresses.empty()
+			? error_code(boost::asio::error::host_not_found) : error_code(), true);
+	}
+
+	void dns_resolver::start_tcp(std::shared_ptr<query> const& q, int const question
+		, tcp::endpoint const& server)
+	{
+		auto t = std::make_shared<tcp_lookup>(m_ios);
+		t->id = std::uint16_t(random(0xfffe) + 1);
+		if (!write_dns_query(t->id, q->hostname
+			, question == 0 ? dns_type::a : dns_type::aaaa, t->query))
+		{
+			finish_query(q, boost::asio::error::host_not_found, false);
+			return;
+		}
+		// over TCP, messages are prefixed by their length (RFC 1035 4.2.2)
+		auto const len = std::uint16_t(t->query.size());
+		t->query.insert(t->query.begin(), {char(len >> 8), char(len & 0xff)});
+		q->tcp[std::size_t(question)] = t;
+
+		// the connection gets the full timeout
+		start_timer(q);
+
+		ADD_OUTSTANDING_ASYNC("dns_resolver::on_tcp_connect");
+		tcp_lookup& l = *t;
+		l.sock.async_connect(server, std::bind(&dns_resolver::on_tcp_connect, this
+			, std::weak_ptr<query>(q), question, std::move(t), _1));
+	}
+
+	std::shared_ptr<dns_resolver::query> dns_resolver::tcp_query(
+		std::weak_ptr<query> const& wq, int const question
+		, std::shared_ptr<tcp_lookup> const& t) const
+	{
+		auto q = wq.lock();
+		if (!q || q->tcp[std::size_t(question)] != t) return {};
+		auto const i = m_queries.find(q->hostname);
+		if (i == m_queries.end() || i->second != q) return {};
+		return q;
+	}
+
+	void dns_resolver::on_tcp_connect(std::weak_ptr<query> wq, int const question
+		, std::shared_ptr<tcp_lookup> t, error_code const& ec)
+	{
+		COMPLETE_ASYNC("dns_resolver::on_tcp_connect");
+		if (ec == boost::asio::error::operation_aborted) return;
+		auto const q = tcp_query(wq, question, t);
+		if (!q) return;
+		if (ec)
+		{
+			tcp_failed(q);
+			return;
+		}
+
+		ADD_OUTSTANDING_ASYNC("dns_resolver::on_tcp_write");
+		tcp_lookup& l = *t;
+		boost::asio::async_write(l.sock, boost::asio::buffer(l.query)
+			, std::bind(&dns_resolver::on_tcp_write, this, std::move(wq), question
+				, std::move(t), _1));
+	}
+
+	void dns_resolver::on_tcp_write(std::weak_ptr<query> wq, int const question
+		, std::shared_ptr<tcp_lookup> t, error_code const& ec)
+	{
+		COMPLETE_ASYNC("dns_resolver::on_tcp_write");
+		if (ec == boost::asio::error::operation_aborted) return;
+		auto const q = tcp_query(wq, question, t);
+		if (!q) return;
+		if (ec)
+		{
+			tcp_failed(q);
+			return;
+		}
+
+		ADD_OUTSTANDING_ASYNC("dns_resolver::on_tcp_length");
+		tcp_lookup& l = *t;
+		boost::asio::async_read(l.sock, boost::asio::buffer(l.length)
+			, std::bind(&dns_resolver::on_tcp_length, this, std::move(wq), question
+				, std::move(t), _1));
+	}
+
+	void dns_resolver::on_tcp_length(std::weak_ptr<query> wq, int const question
+		, std::shared_ptr<tcp_lookup> t, error_code const& ec)
+	{
+		COMPLETE_ASYNC("dns_resolver::on_tcp_length");
+		if (ec == boost::asio::error::operation_aborted) return;
+		auto const q = tcp_query(wq, question, t);
+		if (!q) return;
+		int const len = read16(t->length, 0);
+		if (ec || len < 12)
+		{
+			tcp_failed(q);
+			return;
+		}
+
+		ADD_OUTSTANDING_ASYNC("dns_resolver::on_tcp_read");
+		tcp_lookup& l = *t;
+		l.buffer.resize(std::size_t(len));
+		boost::asio::async_read(l.sock, boost::asio::buffer(l.buffer)
+			, std::bind(&dns_resolver::on_tcp_read, this, std::move(wq), question
+				, std::move(t), _1));
+	}
+
+	void dns_resolver::on_tcp_read(std::weak_ptr<query> wq, int const question
+		, std::shared_ptr<tcp_lookup> t, error_code const& ec)
+	{
+		COMPLETE_ASYNC("dns_resolver::on_tcp_read");
+		if (ec == boost::asio::error::operation_aborted) return;
+		auto const q = tcp_query(wq, question, t);
+		if (!q) return;
+
+		dns_response resp;
+		if (ec || !parse_dns_response(t->buffer, q->hostname
+			, question == 0 ? dns_type::a : dns_type::aaaa, resp)
+			|| resp.id != t->id)
+		{
+			tcp_failed(q);
+			return;
+		}
+
+		error_code ignore;
+		t->sock.close(ignore);
+		q->tcp[std::size_t(question)].reset();
+
+		// whatever didn't fit in the response over TCP, we won't get
+		resp.truncated = false;
+		on_response(q, question, resp);
+	}
+
+	void dns_resolver::tcp_failed(std::shared_ptr<query> const& q)
+	{
+		if (q->attempts >= m_max_attempts)
+			finish_query(q, boost::asio::error::host_not_found_try_again, false);
+		else
+			send_query(q);
+	}
+
+	void dns_resolver::finish_query(std::shared_ptr<query> const& q
+		, error_code const& ec, bool const cache)
+	{
+		q->timer.cancel();
+		close_sockets(*q);
+		m_queries.erase(q->hostname);
+
+		std::vector<address> const addresses = ec ? std::vector<address>() : q->addresses;
+		if (cache)
+		{
+			time_duration const ttl = q->ttl >= 0 ? seconds(q->ttl)
+				: addresses.empty() ? default_negative_ttl : m_timeout;
+			add_cache_entry(q->hostname, addresses, ttl);
+		}
+		else
+		{
+			// if a refresh in the background failed, the entry is used until
+			// it expires
+			auto const i = m_cache.find(q->hostname);
+			if (i != m_cache.end()) i->second.prefetching = false;
+		}
+
+		for (auto& h : q->callbacks)
+			post(m_ios, [h = std::move(h), ec, addresses] { h(ec, addresses); });
+		q->callbacks.clear();
+	}
+
+	void dns_resolver::add_cache_entry(std::string const& hostname
+		, std::vector<address> addresses, time_duration ttl)
+	{
+		ttl = std::min(ttl, m_timeout);
+
+		// a TTL of 0 means the answer must not be cached
+		if (ttl <= time_duration(0))
+		{
+			m_cache.erase(hostname);
+			return;
+		}
+
+		time_point const now = clock_type::now();
+		cache_entry& e = m_cache[hostname];
+		e.addresses = std::move(addresses);
+		e.expires = now + ttl;
+		e.ttl = ttl;
+		e.prefetching = false;
+
+		// if m_cache grows too big, weed out the entry expiring first
+		if (int(m_cache.size()) > m_max_size)
+		{
+			auto const oldest = std::min_element(m_cache.begin(), m_cache.end()
+				, [](auto const& lhs, auto const& rhs)
+				{ return lhs.second.expires < rhs.second.expires; });
+			m_cache.erase(oldest);
+		}
+	}
+
+	void dns_resolver::abort()
+	{
+		// lookups that are critical during shutdown are allowed to complete
+		std::vector<std::shared_ptr<query>> aborted;
+		for (auto const& q : m_queries)
+			if (!q.second->critical) aborted.push_back(q.second);
+		for (auto const& q : aborted)
+			finish_query(q, boost::asio::error::operation_aborted, false);
+	}
+
+	void dns_resolver::close_sockets(query& q)
+	{
+		error_code ignore;
+		if (q.udp)
+		{
+			q.udp->sock.close(ignore);
+			q.udp.reset();
+		}
+		for (auto& t : q.tcp)
+		{
+			if (!t) continue;
+			t->sock.close(ignore);
+			t.reset();
+		}
+		q.ids = {};
+	}
+}
@@ -87,6 +87,7 @@ struct iovec
 // posix part
 
 #include <unistd.h>
+#include <fcntl.h> // for open, posix_fallocate
 #include <sys/types.h>
 #include <cerrno>
 #include <dirent.h>
@@ -304,4 +305,37 @@ namespace {
 
 		return ret;
 	}
+
+	void file::allocate(std::int64_t const offset, std::int64_t const length
+		, error_code& ec)
+	{
+		if (m_file_handle == INVALID_HANDLE_VALUE)
+		{
+#ifdef TORRENT_WINDOWS
+			ec = error_code(ERROR_INVALID_HANDLE, system_category());
+#else
+			ec = error_code(boost::system::errc::bad_file_descriptor, generic_category());
+#endif
+			return;
+		}
+		TORRENT_ASSERT(offset >= 0);
+		TORRENT_ASSERT(length >= 0);
+
+#if defined TORRENT_LINUX && TORRENT_HAS_FALLOCATE
+		// posix_fallocate() is not used, since it's emulated on filesystems
+		// that don't support allocating space, by writing zeroes to the
+		// blocks that read back as zero. That's slow, and it races with
+		// writes to the same range. fallocate() fails on those filesystems
+		// instead, in which case nothing is allocated
+		if (::fallocate(m_file_handle, 0, offset, length) != 0
+			&& errno != EOPNOTSUPP && errno != ENOSYS && errno != EINVAL)
+		{
+			ec.assign(errno, system_category());
+		}
+#else
+		TORRENT_UNUSED(offset);
+		TORRENT_UNUSED(length);
+		TORRENT_UNUSED(ec);
+#endif
+	}
 }
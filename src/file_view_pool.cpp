@@ -23,15 +23,30 @@ see LICENSE file.
 #include "libtorrent/aux_/win_util.hpp"
 #endif
 
+#include <algorithm>
 #include <limits>
 
 using namespace libtorrent::flags;
 
 namespace libtorrent { namespace aux {
 
-	file_view_pool::file_view_pool(int size) : m_size(size) {}
+	file_view_pool::file_view_pool(int const size, int const shards)
+		: m_size(size)
+		, m_num_shards(std::max(1, shards))
+		, m_shards(new shard[std::size_t(m_num_shards)])
+	{}
+
 	file_view_pool::~file_view_pool() = default;
 
+	file_view_pool::shard& file_view_pool::shard_for(file_id const& k) const
+	{
+		// consecutive files of a torrent are likely to be accessed at the same
+		// time, make sure they end up in different shards
+		auto const h = static_cast<std::uint32_t>(static_cast<int>(k.first)) * 0x9e3779b1U
+			+ static_cast<std::uint32_t>(static_cast<int>(k.second));
+		return m_shards[h % std::uint32_t(m_num_shards)];
+	}
+
 	file_view file_view_pool::open_file(storage_index_t st, std::string const& p
 		, file_index_t const file_index, file_storage const& fs
 		, open_mode_t const m
@@ -48,11 +63,13 @@ namespace libtorrent { namespace aux {
 		std::shared_ptr<file_mapping> defer_destruction1;
 		std::shared_ptr<file_mapping> defer_destruction2;
 
-		std::unique_lock<std::mutex> l(m_mutex);
+		file_id const key{st, file_index};
+		shard& sh = shard_for(key);
+		std::unique_lock<std::mutex> l(sh.mutex);
 
 		TORRENT_ASSERT(is_complete(p));
-		auto& key_view = m_files.get<0>();
-		auto i = key_view.find(file_id{st, file_index});
+		auto& key_view = sh.files.get<0>();
+		auto i = key_view.find(key);
 
 		// make sure the write bit is set if we asked for it
 		// it's OK to use a read-write file if we just asked for read. But if
@@ -66,25 +83,25 @@ namespace libtorrent { namespace aux {
 				e.last_use = aux::time_now();
 			});
 
-			auto& lru_view = m_files.get<1>();
-			lru_view.relocate(m_files.project<1>(i), lru_view.begin());
+			auto& lru_view = sh.files.get<1>();
+			lru_view.relocate(sh.files.project<1>(i), lru_view.begin());
 
 			return i->mapping->view();
 		}
 
-		if (int(m_files.size()) >= m_size - 1)
+		l.unlock();
+
+		if (m_num_files >= m_size - 1)
 		{
 			// the file cache is at its maximum size, close
 			// the least recently used file
-			defer_destruction1 = remove_oldest(l);
+			defer_destruction1 = remove_oldest();
 		}
 
-		l.unlock();
-
 #if TORRENT_HAVE_MAP_VIEW_OF_FILE
 		std::unique_lock<std::mutex> lou(*open_unmap_lock);
 #endif
-		file_entry e({st, file_index}, fs.file_path(file_index, p), m
+		file_entry e(key, fs.file_path(file_index, p), m
 			, fs.file_size(file_index)
 #if TORRENT_HAVE_MAP_VIEW_OF_FILE
 			, open_unmap_lock
@@ -106,7 +123,11 @@ namespace libtorrent { namespace aux {
 		// entry. If not, overwrite it with the newly opened file ``e``.
 		bool added;
 		std::tie(i, added) = key_view.insert(e);
-		if (added == false)
+		if (added)
+		{
+			++m_num_files;
+		}
+		else
 		{
 			// this is the case where this file was already in the pool. Make
 			// sure we can use it. If we asked for write mode, it must have been
@@ -122,8 +143,8 @@ namespace libtorrent { namespace aux {
 				});
 			}
 
-			auto& lru_view = m_files.get<1>();
-			lru_view.relocate(m_files.project<1>(i), lru_view.begin());
+			auto& lru_view = sh.files.get<1>();
+			lru_view.relocate(sh.files.project<1>(i), lru_view.begin());
 		}
 
 		return i->mapping->view();
@@ -141,10 +162,12 @@ namespace libtorrent { namespace aux {
 	std::vector<open_file_state> file_view_pool::get_status(storage_index_t const st) const
 	{
 		std::vector<open_file_state> ret;
+		for (int s = 0; s < m_num_shards; ++s)
 		{
-			std::unique_lock<std::mutex> l(m_mutex);
+			shard const& sh = m_shards[std::size_t(s)];
+			std::unique_lock<std::mutex> l(sh.mutex);
 
-			auto const& key_view = m_files.get<0>();
+			auto const& key_view = sh.files.get<0>();
 			auto const start = key_view.lower_bound(file_id{st, file_index_t(0)});
 			auto const end = key_view.upper_bound(file_id{st, std::numeric_limits<file_index_t>::max()});
 
@@ -155,16 +178,37 @@ namespace libtorrent { namespace aux {
 					, i->last_use});
 			}
 		}
+		std::sort(ret.begin(), ret.end(), [](open_file_state const& lhs, open_file_state const& rhs)
+			{ return lhs.file_index < rhs.file_index; });
 		return ret;
 	}
 
-	std::shared_ptr<file_mapping> file_view_pool::remove_oldest(std::unique_lock<std::mutex>&)
+	std::shared_ptr<file_mapping> file_view_pool::remove_oldest()
 	{
-		auto& lru_view = m_files.get<1>();
-		if (lru_view.size() == 0) return {};
+		// find the shard whose least recently used file is the oldest. The
+		// shards are only locked one at a time, so by the time we remove it,
+		// it may have been used again. That's fine, the LRU is approximate
+		int oldest_shard = -1;
+		time_point oldest = max_time();
+		for (int s = 0; s < m_num_shards; ++s)
+		{
+			shard& sh = m_shards[std::size_t(s)];
+			std::unique_lock<std::mutex> l(sh.mutex);
+			auto const& lru_view = sh.files.get<1>();
+			if (lru_view.empty() || lru_view.back().last_use > oldest) continue;
+			oldest = lru_view.back().last_use;
+			oldest_shard = s;
+		}
+		if (oldest_shard < 0) return {};
+
+		shard& sh = m_shards[std::size_t(oldest_shard)];
+		std::unique_lock<std::mutex> l(sh.mutex);
+		auto& lru_view = sh.files.get<1>();
+		if (lru_view.empty()) return {};
 
 		auto mapping = std::move(lru_view.back().mapping);
 		lru_view.pop_back();
+		--m_num_files;
 
 		// closing a file may be long running operation (mac os x)
 		// let the caller destruct it once it has released the mutex
@@ -173,14 +217,17 @@ namespace libtorrent { namespace aux {
 
 	void file_view_pool::release(storage_index_t const st, file_index_t file_index)
 	{
-		std::unique_lock<std::mutex> l(m_mutex);
+		file_id const key{st, file_index};
+		shard& sh = shard_for(key);
+		std::unique_lock<std::mutex> l(sh.mutex);
 
-		auto& key_view = m_files.get<0>();
-		auto const i = key_view.find(file_id{st, file_index});
+		auto& key_view = sh.files.get<0>();
+		auto const i = key_view.find(key);
 		if (i == key_view.end()) return;
 
 		auto mapping = std::move(i->mapping);
 		key_view.erase(i);
+		--m_num_files;
 
 		// closing a file may take a long time (mac os x), so make sure
 		// we're not holding the mutex
@@ -191,60 +238,68 @@ namespace libtorrent { namespace aux {
 	// storage, or all if none is specified.
 	void file_view_pool::release()
 	{
-		std::unique_lock<std::mutex> l(m_mutex);
-		std::unique_lock<std::mutex> l2(m_destruction_mutex);
-		m_deferred_destruction = std::move(m_files);
-		l.unlock();
-
-		// the files and mappings will be destructed here, not holding the main
-		// mutex
-		m_deferred_destruction.clear();
+		for (int s = 0; s < m_num_shards; ++s)
+		{
+			shard& sh = m_shards[std::size_t(s)];
+			std::unique_lock<std::mutex> l(sh.mutex);
+			std::unique_lock<std::mutex> l2(sh.destruction_mutex);
+			m_num_files -= int(sh.files.size());
+			sh.deferred_destruction = std::move(sh.files);
+			l.unlock();
+
+			// the files and mappings will be destructed here, not holding the
+			// shard mutex
+			sh.deferred_destruction.clear();
+		}
 	}
 
 	void file_view_pool::release(storage_index_t const st)
 	{
 		std::vector<std::shared_ptr<file_mapping>> defer_destruction;
 
-		std::unique_lock<std::mutex> l(m_mutex);
+		for (int s = 0; s < m_num_shards; ++s)
+		{
+			shard& sh = m_shards[std::size_t(s)];
+			std::unique_lock<std::mutex> l(sh.mutex);
 
-		auto& key_view = m_files.get<0>();
-		auto const begin = key_view.lower_bound(file_id{st, file_index_t(0)});
-		auto const end = key_view.upper_bound(file_id{st, std::numeric_limits<file_index_t>::max()});
+			auto& key_view = sh.files.get<0>();
+			auto const begin = key_view.lower_bound(file_id{st, file_index_t(0)});
+			auto const end = key_view.upper_bound(file_id{st, std::numeric_limits<file_index_t>::max()});
 
-		for (auto it = begin; it != end; ++it)
-			defer_destruction.emplace_back(std::move(it->mapping));
+			for (auto it = begin; it != end; ++it)
+			{
+				defer_destruction.emplace_back(std::move(it->mapping));
+				--m_num_files;
+			}
 
-		if (begin != end) key_view.erase(begin, end);
-		l.unlock();
+			if (begin != end) key_view.erase(begin, end);
+		}
 		// the files are closed here while the lock is not held
 	}
 
 	void file_view_pool::resize(int const size)
 	{
-		// these are destructed _after_ the mutex is released
-		std::vector<std::shared_ptr<file_mapping>> defer_destruction;
-
-		std::unique_lock<std::mutex> l(m_mutex);
-
 		TORRENT_ASSERT(size > 0);
 
-		if (size == m_size) return;
-		m_size = size;
-		if (int(m_files.size()) <= m_size) return;
+		if (m_size.exchange(size) == size) return;
+
+		// these are destructed _after_ the mutex is released
+		std::vector<std::shared_ptr<file_mapping>> defer_destruction;
 
 		// close the least recently used files
-		while (int(m_files.size()) > m_size)
-			defer_destruction.emplace_back(remove_oldest(l));
+		while (m_num_files > size)
+		{
+			auto mapping = remove_oldest();
+			if (!mapping) break;
+			defer_destruction.emplace_back(std::move(mapping));
+		}
 	}
 
 	void file_view_pool::close_oldest()
 	{
 		// closing a file may be long running operation (mac os x)
 		// destruct it after the mutex is released
-		std::shared_ptr<file_mapping> deferred_destruction;
-
-		std::unique_lock<std::mutex> l(m_mutex);
-		deferred_destruction = remove_oldest(l);
+		std::shared_ptr<file_mapping> deferred_destruction = remove_oldest();
 	}
 }
 }
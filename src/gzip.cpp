@@ -9,9 +9,12 @@ see LICENSE file.
 */
 
 #include "libtorrent/assert.hpp"
-#include "libtorrent/aux_/puff.hpp"
 #include "libtorrent/gzip.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
 #include <string>
 
 namespace {
@@ -155,88 +158,557 @@ namespace {
 
 		return static_cast<int>(in.size() - buffer.size());
 	}
-	} // anonymous namespace
 
-	void inflate_gzip(span<char const> in
-		, std::vector<char>& buffer
-		, int maximum_size
-		, error_code& ec)
+	// entries of the Huffman decoding tables. The ``op`` field is one of these
+	// kinds, ORed with the number of extra bits (for lengths and distances)
+	// or the number of index bits of the second level table (for links)
+	enum : std::uint8_t
 	{
-		ec.clear();
-		TORRENT_ASSERT(maximum_size > 0);
+		op_literal = 0x00,
+		op_base = 0x10,
+		op_end = 0x20,
+		op_link = 0x40,
+		op_invalid = 0x80,
+		op_low_mask = 0x0f
+	};
 
-		int const header_len = gzip_header(in);
-		if (header_len < 0)
+	struct huffman_entry
+	{
+		// the literal byte (or code length symbol), or the base of a length
+		// or distance. For links, the offset of the second level table
+		std::uint16_t value;
+
+		// the number of bits this code consumes. For links, the number of
+		// bits indexing the first level table
+		std::uint8_t bits;
+		std::uint8_t op;
+	};
+
+	// the number of bits indexing the first level of the literal/length and
+	// the distance tables. Longer codes continue in a second level table.
+	// Code length codes are at most 7 bits, they always fit in one level
+	constexpr int lit_bits = 10;
+	constexpr int dist_bits = 8;
+	constexpr int code_bits = 7;
+
+	constexpr huffman_entry invalid_entry{0, 0, op_invalid};
+
+	// the entries of each symbol of the three alphabets, without the length
+	// of the code
+	struct alphabets
+	{
+		alphabets()
 		{
-			ec = gzip_errors::invalid_gzip_header;
-			return;
+			static std::uint16_t const length_base[] = {
+				3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+				35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+			static std::uint8_t const length_extra[] = {
+				0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+				3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+			static std::uint16_t const dist_base[] = {
+				1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+				257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+				8193, 12289, 16385, 24577};
+			static std::uint8_t const dist_extra[] = {
+				0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+				7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+			for (int i = 0; i < 256; ++i)
+				lit[std::size_t(i)] = {std::uint16_t(i), 0, op_literal};
+			lit[256] = {0, 0, op_end};
+			for (int i = 0; i < 29; ++i)
+			{
+				lit[std::size_t(257 + i)] = {length_base[i], 0
+					, std::uint8_t(op_base | length_extra[i])};
+			}
+			lit[286] = invalid_entry;
+			lit[287] = invalid_entry;
+
+			for (int i = 0; i < 30; ++i)
+				dist[std::size_t(i)] = {dist_base[i], 0, std::uint8_t(op_base | dist_extra[i])};
+			dist[30] = invalid_entry;
+			dist[31] = invalid_entry;
+
+			for (int i = 0; i < 19; ++i)
+				code[std::size_t(i)] = {std::uint16_t(i), 0, op_literal};
+		}
+
+		std::array<huffman_entry, 288> lit;
+		std::array<huffman_entry, 32> dist;
+		std::array<huffman_entry, 19> code;
+	};
+
+	alphabets const& symbols()
+	{
+		static alphabets const a;
+		return a;
+	}
+
+	std::uint32_t reverse_bits(std::uint32_t code, int len)
+	{
+		std::uint32_t ret = 0;
+		for (int i = 0; i < len; ++i)
+		{
+			ret = (ret << 1) | (code & 1);
+			code >>= 1;
+		}
+		return ret;
+	}
+
+	// builds the decoding table for the canonical Huffman code with these
+	// code lengths. Entry i of the first level table is the code whose bits
+	// (in the order they appear in the stream) are a prefix of i, codes
+	// longer than table_bits link to a second level table indexed by the
+	// bits following the first table_bits. Returns -1 if the code is
+	// over-subscribed, 0 if it's complete (or empty) and a positive number
+	// if it's incomplete
+	int build_table(std::vector<huffman_entry>& table, int const table_bits
+		, span<std::uint8_t const> lengths, huffman_entry const* symbol)
+	{
+		std::array<int, 16> count{};
+		for (auto const l : lengths) ++count[l];
+
+		int const num_codes = int(lengths.size()) - count[0];
+		count[0] = 0;
+		int left = 1;
+		int max_len = 0;
+		for (int len = 1; len < 16; ++len)
+		{
+			left <<= 1;
+			left -= count[std::size_t(len)];
+			if (left < 0) return -1;
+			if (count[std::size_t(len)] > 0) max_len = len;
+		}
+
+		table.assign(std::size_t(1) << table_bits, invalid_entry);
+		if (num_codes == 0) return 0;
+
+		// the first code of each length
+		std::array<std::uint32_t, 16> next{};
+		std::uint32_t code = 0;
+		for (int len = 1; len < 16; ++len)
+		{
+			code = (code + std::uint32_t(count[std::size_t(len - 1)])) << 1;
+			next[std::size_t(len)] = code;
+		}
+
+		int const sub_bits = std::max(0, max_len - table_bits);
+		std::uint32_t const first_mask = (1u << table_bits) - 1;
+		for (int sym = 0; sym < int(lengths.size()); ++sym)
+		{
+			int const len = lengths[sym];
+			if (len == 0) continue;
+
+			std::uint32_t const rev = reverse_bits(next[std::size_t(len)]++, len);
+			huffman_entry e = symbol[sym];
+
+			if (len <= table_bits)
+			{
+				e.bits = std::uint8_t(len);
+				for (std::uint32_t i = rev; i <= first_mask; i += 1u << len)
+					table[i] = e;
+				continue;
+			}
+
+			huffman_entry link = table[rev & first_mask];
+			if (link.op != (op_link | sub_bits))
+			{
+				link = {std::uint16_t(table.size()), std::uint8_t(table_bits)
+					, std::uint8_t(op_link | sub_bits)};
+				table[rev & first_mask] = link;
+				table.resize(table.size() + (std::size_t(1) << sub_bits), invalid_entry);
+			}
+
+			int const sub_len = len - table_bits;
+			e.bits = std::uint8_t(sub_len);
+			for (std::uint32_t i = rev >> table_bits; i < (1u << sub_bits); i += 1u << sub_len)
+				table[link.value + i] = e;
+		}
+		return left;
+	}
+
+	// an incomplete literal/length or distance code is allowed if it only
+	// has a single code, of length 1
+	bool single_code(span<std::uint8_t const> lengths)
+	{
+		return std::all_of(lengths.begin(), lengths.end()
+			, [](std::uint8_t const l) { return l <= 1; });
+	}
+
+	struct fixed_tables
+	{
+		fixed_tables()
+		{
+			std::array<std::uint8_t, 288> lengths;
+			std::fill(lengths.begin(), lengths.begin() + 144, std::uint8_t(8));
+			std::fill(lengths.begin() + 144, lengths.begin() + 256, std::uint8_t(9));
+			std::fill(lengths.begin() + 256, lengths.begin() + 280, std::uint8_t(7));
+			std::fill(lengths.begin() + 280, lengths.end(), std::uint8_t(8));
+			build_table(lit, lit_bits, lengths, symbols().lit.data());
+
+			std::array<std::uint8_t, 32> dist_lengths;
+			dist_lengths.fill(5);
+			build_table(dist, dist_bits, dist_lengths, symbols().dist.data());
+		}
+
+		std::vector<huffman_entry> lit;
+		std::vector<huffman_entry> dist;
+	};
+
+	// inflates a raw deflate stream (RFC 1951). The input is read through a
+	// 64 bit wide bit buffer, which is refilled a whole word at a time while
+	// there's enough input left. Huffman codes are decoded by table lookup.
+	// The output buffer grows as needed, up to the maximum size
+	struct inflater
+	{
+		inflater(span<char const> in, std::vector<char>& out, std::size_t const max_size)
+			: m_in(reinterpret_cast<std::uint8_t const*>(in.data()))
+			, m_end(m_in + in.size())
+			, m_out(out)
+			, m_max_size(max_size)
+		{}
+
+		error_code inflate()
+		{
+			bool last = false;
+			while (!last)
+			{
+				refill();
+				if (m_count < 3) return gzip_errors::data_did_not_terminate;
+				last = (m_bits & 1) != 0;
+				int const type = int((m_bits >> 1) & 3);
+				consume(3);
+
+				bool ok = false;
+				switch (type)
+				{
+					case 0: ok = stored(); break;
+					case 1:
+					{
+						static fixed_tables const fixed;
+						ok = codes(fixed.lit, fixed.dist);
+						break;
+					}
+					case 2: ok = dynamic(); break;
+					default: m_error = gzip_errors::invalid_block_type; break;
+				}
+				if (!ok) return m_error;
+			}
+			m_out.resize(m_pos);
+			return {};
+		}
+
+	private:
+
+		static std::uint64_t load_le64(std::uint8_t const* p)
+		{
+			std::uint64_t ret = 0;
+			for (int i = 7; i >= 0; --i) ret = (ret << 8) | p[i];
+			return ret;
+		}
+
+		// fill the bit buffer with at least 56 bits, or as much input as
+		// there is left
+		void refill()
+		{
+			if (m_end - m_in >= 8)
+			{
+				// the bits past m_count are the same whole input bytes, they
+				// are OR-ed in again by the next refill
+				m_bits |= load_le64(m_in) << m_count;
+				m_in += (63 - m_count) >> 3;
+				m_count |= 56;
+				return;
+			}
+			while (m_count < 56 && m_in != m_end)
+			{
+				m_bits |= std::uint64_t(*m_in++) << m_count;
+				m_count += 8;
+			}
+		}
+
+		std::uint32_t peek(int const n) const
+		{ return std::uint32_t(m_bits & ((std::uint64_t(1) << n) - 1)); }
+
+		void consume(int const n)
+		{
+			TORRENT_ASSERT(n <= m_count);
+			m_bits >>= n;
+			m_count -= n;
+		}
+
+		// reads n bits. The caller is expected to have made sure there are
+		// enough in the bit buffer
+		std::uint32_t read(int const n)
+		{
+			std::uint32_t const ret = peek(n);
+			consume(n);
+			return ret;
 		}
 
-		// start off with 4 kilobytes and grow
-		// if needed
-		unsigned long destlen = 4096;
-		int ret = 0;
-		in = in.subspan(header_len);
-		unsigned long srclen = std::uint32_t(in.size());
+		bool fail(gzip_errors::error_code_enum const e)
+		{
+			m_error = e;
+			return false;
+		}
+
+		// look up the next code in ``table``. Returns an invalid entry if
+		// there isn't one, or if the input ends before it
+		huffman_entry decode(std::vector<huffman_entry> const& table, int const table_bits)
+		{
+			huffman_entry e = table[peek(table_bits)];
+			if (e.op & op_link)
+			{
+				int const sub_bits = e.op & op_low_mask;
+				e = table[e.value + ((m_bits >> table_bits) & ((1u << sub_bits) - 1))];
+				e.bits = std::uint8_t(e.bits + table_bits);
+			}
+			// without the bits of the longest code, an invalid code may just
+			// be a truncated one
+			if (e.bits > m_count || ((e.op & op_invalid) && m_count < 15))
+			{
+				m_error = gzip_errors::data_did_not_terminate;
+				return invalid_entry;
+			}
+			consume(e.bits);
+			return e;
+		}
 
-		do
+		// make room for n more bytes of output
+		bool reserve(std::size_t const n)
 		{
+			if (m_out.size() - m_pos >= n) return true;
+			if (m_pos + n > m_max_size) return fail(gzip_errors::inflated_data_too_large);
+			std::size_t const size = std::min(m_max_size
+				, std::max(m_out.size() * 2, m_pos + n));
 			TORRENT_TRY {
-				buffer.resize(destlen);
+				m_out.resize(size);
 			} TORRENT_CATCH (std::exception const&) {
-				ec = errors::no_memory;
-				return;
+				return fail(gzip_errors::space_exhausted);
+			}
+			return true;
+		}
+
+		bool stored()
+		{
+			// skip to the byte boundary, and hand the whole bytes left in
+			// the bit buffer back to the input
+			consume(m_count & 7);
+			m_in -= m_count >> 3;
+			m_bits = 0;
+			m_count = 0;
+
+			if (m_end - m_in < 4) return fail(gzip_errors::data_did_not_terminate);
+			std::size_t const len = std::size_t(m_in[0] | (m_in[1] << 8));
+			std::size_t const nlen = std::size_t(m_in[2] | (m_in[3] << 8));
+			if (len != (~nlen & 0xffff)) return fail(gzip_errors::invalid_stored_block_length);
+			m_in += 4;
+
+			if (std::size_t(m_end - m_in) < len) return fail(gzip_errors::data_did_not_terminate);
+			if (!reserve(len)) return false;
+			if (len > 0) std::memcpy(m_out.data() + m_pos, m_in, len);
+			m_in += len;
+			m_pos += len;
+			return true;
+		}
+
+		bool dynamic()
+		{
+			static std::uint8_t const order[19] = {
+				16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+			refill();
+			if (m_count < 14) return fail(gzip_errors::data_did_not_terminate);
+			int const nlen = int(read(5)) + 257;
+			int const ndist = int(read(5)) + 1;
+			int const ncode = int(read(4)) + 4;
+			if (nlen > 286 || ndist > 30)
+				return fail(gzip_errors::too_many_length_or_distance_codes);
+
+			std::array<std::uint8_t, 19> code_lengths{};
+			for (int i = 0; i < ncode; ++i)
+			{
+				if (m_count < 3) refill();
+				if (m_count < 3) return fail(gzip_errors::data_did_not_terminate);
+				code_lengths[order[i]] = std::uint8_t(read(3));
 			}
 
-			ret = puff(reinterpret_cast<unsigned char*>(buffer.data())
-				, &destlen
-				, reinterpret_cast<const unsigned char*>(in.data())
-				, &srclen);
+			if (build_table(m_lit, code_bits, code_lengths, symbols().code.data()) != 0)
+				return fail(gzip_errors::code_lengths_codes_incomplete);
 
-			// if the destination buffer wasn't large enough, double its
-			// size and try again. Unless it's already at its max, in which
-			// case we fail
-			if (ret == 1) // 1:  output space exhausted before completing inflate
+			std::array<std::uint8_t, 286 + 30> lengths{};
+			int index = 0;
+			while (index < nlen + ndist)
 			{
-				if (destlen == std::uint32_t(maximum_size))
+				// a code length code and its extra bits are at most 14 bits
+				if (m_count < 14) refill();
+				huffman_entry const e = decode(m_lit, code_bits);
+				if (e.op != op_literal)
 				{
-					ec = gzip_errors::inflated_data_too_large;
-					return;
+					if (m_error) return false;
+					return fail(gzip_errors::invalid_literal_code_in_block);
 				}
 
-				destlen *= 2;
-				if (destlen > std::uint32_t(maximum_size))
-					destlen = std::uint32_t(maximum_size);
+				if (e.value < 16)
+				{
+					lengths[std::size_t(index++)] = std::uint8_t(e.value);
+					continue;
+				}
+
+				std::uint8_t len = 0;
+				int repeat = 0;
+				int const extra = e.value == 16 ? 2 : e.value == 17 ? 3 : 7;
+				if (m_count < extra) return fail(gzip_errors::data_did_not_terminate);
+				if (e.value == 16)
+				{
+					if (index == 0) return fail(gzip_errors::repeat_lengths_with_no_first_length);
+					len = lengths[std::size_t(index - 1)];
+					repeat = 3 + int(read(2));
+				}
+				else if (e.value == 17)
+				{
+					repeat = 3 + int(read(3));
+				}
+				else
+				{
+					repeat = 11 + int(read(7));
+				}
+				if (index + repeat > nlen + ndist)
+					return fail(gzip_errors::repeat_more_than_specified_lengths);
+				std::fill_n(lengths.begin() + index, repeat, len);
+				index += repeat;
 			}
-		} while (ret == 1);
 
-		if (ret != 0)
+			// the end-of-block code must be present
+			if (lengths[256] == 0) return fail(gzip_errors::invalid_literal_length_code_lengths);
+
+			span<std::uint8_t const> const lit_lengths = span<std::uint8_t const>(lengths).first(nlen);
+			int err = build_table(m_lit, lit_bits, lit_lengths, symbols().lit.data());
+			if (err < 0 || (err > 0 && !single_code(lit_lengths)))
+				return fail(gzip_errors::invalid_literal_length_code_lengths);
+
+			span<std::uint8_t const> const dist_lengths = span<std::uint8_t const>(lengths).subspan(nlen, ndist);
+			err = build_table(m_dist, dist_bits, dist_lengths, symbols().dist.data());
+			if (err < 0 || (err > 0 && !single_code(dist_lengths)))
+				return fail(gzip_errors::invalid_distance_code_lengths);
+
+			return codes(m_lit, m_dist);
+		}
+
+		// decode the literals and matches of a block, until the end-of-block
+		// code
+		bool codes(std::vector<huffman_entry> const& lit, std::vector<huffman_entry> const& dist)
 		{
-			switch (ret)
+			for (;;)
 			{
-				case   2: ec = gzip_errors::data_did_not_terminate; return;
-				case   1: ec = gzip_errors::space_exhausted; return;
-				case  -1: ec = gzip_errors::invalid_block_type; return;
-				case  -2: ec = gzip_errors::invalid_stored_block_length; return;
-				case  -3: ec = gzip_errors::too_many_length_or_distance_codes; return;
-				case  -4: ec = gzip_errors::code_lengths_codes_incomplete; return;
-				case  -5: ec = gzip_errors::repeat_lengths_with_no_first_length; return;
-				case  -6: ec = gzip_errors::repeat_more_than_specified_lengths; return;
-				case  -7: ec = gzip_errors::invalid_literal_length_code_lengths; return;
-				case  -8: ec = gzip_errors::invalid_distance_code_lengths; return;
-				case  -9: ec = gzip_errors::invalid_literal_code_in_block; return;
-				case -10: ec = gzip_errors::distance_too_far_back_in_block; return;
-				default: ec = gzip_errors::unknown_gzip_error; return;
+				// a literal/length code with its extra bits and a distance
+				// code with its extra bits are at most 48 bits
+				if (m_count < 48) refill();
+
+				huffman_entry e = decode(lit, lit_bits);
+				if (e.op == op_literal)
+				{
+					if (m_pos == m_out.size() && !reserve(1)) return false;
+					m_out[m_pos++] = char(e.value);
+					continue;
+				}
+				if (e.op == op_end) return true;
+				if (!(e.op & op_base))
+				{
+					if (m_error) return false;
+					return fail(gzip_errors::invalid_literal_code_in_block);
+				}
+
+				int extra = e.op & op_low_mask;
+				if (m_count < extra) return fail(gzip_errors::data_did_not_terminate);
+				std::size_t const len = e.value + read(extra);
+
+				e = decode(dist, dist_bits);
+				if (!(e.op & op_base))
+				{
+					if (m_error) return false;
+					return fail(gzip_errors::invalid_literal_code_in_block);
+				}
+				extra = e.op & op_low_mask;
+				if (m_count < extra) return fail(gzip_errors::data_did_not_terminate);
+				std::size_t const distance = e.value + read(extra);
+				if (distance > m_pos) return fail(gzip_errors::distance_too_far_back_in_block);
+
+				if (!reserve(len)) return false;
+				char* dst = m_out.data() + m_pos;
+				char const* src = dst - distance;
+				if (distance >= len)
+					std::memcpy(dst, src, len);
+				else if (distance == 1)
+					std::memset(dst, *src, len);
+				else
+					for (std::size_t i = 0; i < len; ++i) dst[i] = src[i];
+				m_pos += len;
 			}
 		}
 
-		if (destlen > buffer.size())
+		std::uint8_t const* m_in;
+		std::uint8_t const* const m_end;
+
+		// the bit buffer. The next bit of input is the lowest one, m_count
+		// bits are valid
+		std::uint64_t m_bits = 0;
+		int m_count = 0;
+
+		std::vector<char>& m_out;
+		std::size_t m_pos = 0;
+		std::size_t const m_max_size;
+
+		// the tables of the current dynamic block
+		std::vector<huffman_entry> m_lit;
+		std::vector<huffman_entry> m_dist;
+
+		gzip_errors::error_code_enum m_error = gzip_errors::no_error;
+	};
+
+	} // anonymous namespace
+
+	void inflate_gzip(span<char const> in
+		, std::vector<char>& buffer
+		, int maximum_size
+		, error_code& ec)
+	{
+		ec.clear();
+		TORRENT_ASSERT(maximum_size > 0);
+
+		int const header_len = gzip_header(in);
+		if (header_len < 0)
+		{
+			ec = gzip_errors::invalid_gzip_header;
+			return;
+		}
+
+		// the gzip trailer ends with the size of the uncompressed data
+		// (modulo 2^32). Use it to size the output buffer, within reason.
+		// It's just a hint, the buffer grows if it's wrong. Since it comes
+		// from the input, it's not trusted beyond a typical compression ratio,
+		// for a small input not to allocate maximum_size up-front
+		std::size_t size_hint = 4096;
+		if (in.size() >= header_len + 8)
 		{
-			ec = gzip_errors::unknown_gzip_error;
+			auto const* trailer = reinterpret_cast<std::uint8_t const*>(in.data() + in.size() - 4);
+			std::size_t const isize = std::size_t(trailer[0])
+				| (std::size_t(trailer[1]) << 8)
+				| (std::size_t(trailer[2]) << 16)
+				| (std::size_t(trailer[3]) << 24);
+			size_hint = std::max(size_hint, std::min(isize, std::size_t(in.size()) * 8));
+		}
+		size_hint = std::min(size_hint, std::size_t(maximum_size));
+
+		TORRENT_TRY {
+			buffer.resize(size_hint);
+		} TORRENT_CATCH (std::exception const&) {
+			ec = errors::no_memory;
 			return;
 		}
 
-		buffer.resize(destlen);
+		inflater inf(in.subspan(header_len), buffer, std::size_t(maximum_size));
+		ec = inf.inflate();
 	}
 
 }
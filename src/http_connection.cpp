@@ -183,7 +183,10 @@ void http_connection::get(std::string const& url, time_duration timeout, int pri
 	if (!auth.empty())
 		request << "Authorization: Basic " << base64encode(auth) << "\r\n";
 
-	request << "Connection: close\r\n\r\n";
+	if (m_keep_alive)
+		request << "Connection: keep-alive\r\n\r\n";
+	else
+		request << "Connection: close\r\n\r\n";
 
 	m_sendbuffer.assign(request.str());
 	m_url = url;
@@ -230,9 +233,36 @@ void http_connection::start(std::string const& hostname, int port
 	TORRENT_ASSERT(!ssl || m_ssl_ctx != nullptr);
 #endif
 
-	if (m_sock && m_sock->is_open() && m_hostname == hostname && m_port == port
-		&& m_ssl == ssl && m_bind_addr == bind_addr)
+	// a connection left open by the previous request is used if it's to
+	// the same host
+	bool reuse = m_sock && m_sock->is_open() && m_hostname == hostname
+		&& m_port == port && m_ssl == ssl && m_bind_addr == bind_addr;
+	tcp::endpoint remote;
+	if (reuse)
+	{
+		error_code ec;
+		remote = m_sock->remote_endpoint(ec);
+		if (ec) reuse = false;
+	}
+
+	if (reuse)
 	{
+		// the endpoint we're connected to still has to pass the filter of
+		// this request
+		if (m_filter_handler)
+		{
+			std::vector<tcp::endpoint> endpoints{remote};
+			m_filter_handler(*this, endpoints);
+			if (endpoints.empty())
+			{
+				close();
+				return;
+			}
+		}
+
+		m_reused = true;
+		m_last_receive = clock_type::now();
+		m_start_time = m_last_receive;
 		ADD_OUTSTANDING_ASYNC("http_connection::on_write");
 		async_write(*m_sock, boost::asio::buffer(m_sendbuffer)
 			, std::bind(&http_connection::on_write, me, _1));
@@ -241,6 +271,7 @@ void http_connection::start(std::string const& hostname, int port
 	{
 		m_ssl = ssl;
 		m_bind_addr = bind_addr;
+		m_reused = false;
 		error_code err;
 		if (m_sock && m_sock->is_open()) m_sock->close(err);
 
@@ -319,6 +350,16 @@ void http_connection::start(std::string const& hostname, int port
 			return;
 		}
 
+#if TORRENT_USE_SSL
+		// if the server doesn't have the session anymore, this just falls
+		// back to a full handshake
+		if (m_ssl && m_ssl_session)
+		{
+			error_code ignore;
+			set_ssl_session(*m_sock, m_ssl_session, ignore);
+		}
+#endif
+
 		m_endpoints.clear();
 		m_next_ep = 0;
 
@@ -429,6 +470,64 @@ void http_connection::close(bool force)
 	m_abort = true;
 }
 
+bool http_connection::idle() const
+{
+	return m_keep_alive && m_bottled && m_called && !m_abort
+		&& m_parser.finished() && !m_parser.connection_close()
+		&& m_sock && m_sock->is_open();
+}
+
+void http_connection::set_handlers(http_handler handler
+	, http_connect_handler ch, http_filter_handler fh
+	, hostname_filter_handler hfh)
+{
+	m_handler = std::move(handler);
+	m_connect_handler = std::move(ch);
+	m_filter_handler = std::move(fh);
+	m_hostname_filter_handler = std::move(hfh);
+}
+
+#if TORRENT_USE_SSL
+ssl::session_handle http_connection::ssl_session()
+{
+	if (!m_ssl || !m_sock || !m_sock->is_open()) return {};
+	return get_ssl_session(*m_sock);
+}
+
+bool http_connection::ssl_session_resumed()
+{
+	if (!m_ssl || !m_sock) return false;
+	return aux::ssl_session_resumed(*m_sock);
+}
+#endif
+
+bool http_connection::retry_stale_connection(error_code const& e)
+{
+	if (!m_reused || m_abort) return false;
+	m_reused = false;
+
+	if (e != boost::asio::error::eof
+		&& e != boost::asio::error::shut_down
+		&& e != boost::asio::error::connection_reset
+		&& e != boost::asio::error::connection_aborted
+		&& e != boost::asio::error::broken_pipe)
+	{
+		return false;
+	}
+
+	error_code ec;
+	m_sock->close(ec);
+	std::string const hostname = m_hostname;
+	aux::proxy_settings const proxy = m_proxy;
+	start(hostname, m_port, m_completion_timeout, m_priority, &proxy
+		, m_ssl, m_redirects, m_bind_addr, m_resolve_flags
+#if TORRENT_USE_I2P
+		, m_i2p_conn
+#endif
+		);
+	return true;
+}
+
 #if TORRENT_USE_I2P
 void http_connection::connect_i2p_tracker(char const* destination)
 {
@@ -549,6 +648,8 @@ void http_connection::connect()
 	tcp::endpoint target_address = m_endpoints[m_next_ep];
 	++m_next_ep;
 
+	m_connect_start = clock_type::now();
+
 	ADD_OUTSTANDING_ASYNC("http_connection::on_connect");
 	TORRENT_ASSERT(!m_connecting);
 	m_connecting = true;
@@ -566,6 +667,7 @@ void http_connection::on_connect(error_code const& e)
 	m_start_time = m_last_receive;
 	if (!e)
 	{
+		m_connect_time = m_last_receive - m_connect_start;
 		if (m_connect_handler) m_connect_handler(*this);
 		ADD_OUTSTANDING_ASYNC("http_connection::on_write");
 		async_write(*m_sock, boost::asio::buffer(m_sendbuffer)
@@ -627,13 +729,14 @@ void http_connection::on_write(error_code const& e)
 
 	if (e)
 	{
+		if (retry_stale_connection(e)) return;
 		callback(e);
 		return;
 	}
 
 	if (m_abort) return;
 
-	std::string().swap(m_sendbuffer);
+	if (!m_reused) std::string().swap(m_sendbuffer);
 	m_recvbuffer.resize(4096);
 
 	int amount_to_read = int(m_recvbuffer.size()) - m_read_pos;
@@ -678,6 +781,15 @@ void http_connection::on_read(error_code const& e
 
 	// when using the asio SSL wrapper, it seems like
 	// we get the shut_down error instead of EOF
+	if (e && retry_stale_connection(e)) return;
+
+	if (m_reused)
+	{
+		// the server is responding, this connection is good
+		m_reused = false;
+		std::string().swap(m_sendbuffer);
+	}
+
 	if (e == boost::asio::error::eof || e == boost::asio::error::shut_down)
 	{
 		error_code ec = boost::asio::error::eof;
@@ -765,9 +877,13 @@ void http_connection::on_read(error_code const& e
 		else if (m_bottled && m_parser.finished())
 		{
 			m_timer.cancel();
+			// if the server keeps the connection open, stop reading. The
+			// handler may already have sent the next request over it
+			bool const keep_alive = m_keep_alive && !m_parser.connection_close();
 			callback(e, span<char>(m_recvbuffer)
 				.first(m_read_pos)
 				.subspan(m_parser.body_start()));
+			if (keep_alive) return;
 		}
 	}
 	else
@@ -252,6 +252,21 @@ restart_response:
 					// the header is finished and the body
 					// starts.
 					m_state = read_body;
+					if (m_chunked_encoding)
+					{
+						m_body_state = body_chunk_size;
+						m_body_left = 0;
+						m_chunk_digits = 0;
+					}
+					else if (m_content_length >= 0)
+					{
+						m_body_state = m_content_length == 0 ? body_done : body_content;
+						m_body_left = m_content_length;
+					}
+					else
+					{
+						m_body_state = body_until_close;
+					}
 					// if this is a request (not a response)
 					// we're done once we reach the end of the headers
 //					if (!m_method.empty()) m_finished = true;
@@ -553,6 +568,125 @@ restart_response:
 		return false;
 	}
 
+	span<char const> http_parser::parse_body(span<char const>& buf, bool& error)
+	{
+		TORRENT_ASSERT(m_state == read_body);
+
+		char const* pos = buf.data();
+		char const* const end = buf.data() + buf.size();
+		span<char const> payload;
+
+		while (pos != end && payload.empty())
+		{
+			switch (m_body_state)
+			{
+				case body_content:
+				case body_chunk_data:
+				{
+					TORRENT_ASSERT(m_body_left > 0);
+					auto const n = std::ptrdiff_t(std::min(m_body_left, std::int64_t(end - pos)));
+					payload = {pos, n};
+					pos += n;
+					m_body_left -= n;
+					if (m_body_left == 0)
+						m_body_state = m_body_state == body_content ? body_done : body_chunk_end;
+					break;
+				}
+				case body_until_close:
+					payload = {pos, end - pos};
+					pos = end;
+					break;
+				case body_chunk_size:
+				{
+					int const digit = aux::hex_to_int(*pos);
+					if (digit >= 0)
+					{
+						if (m_body_left >= std::numeric_limits<std::int64_t>::max() / 16)
+						{
+							m_body_state = body_error;
+							break;
+						}
+						m_body_left = m_body_left * 16 + digit;
+						++m_chunk_digits;
+						++pos;
+						break;
+					}
+					if (*pos == ';' || *pos == ' ' || *pos == '\t')
+					{
+						m_body_state = body_chunk_ext;
+						++pos;
+						break;
+					}
+					if (*pos == '\r')
+					{
+						// the header must end right here
+						m_body_state = body_chunk_lf;
+						++pos;
+						break;
+					}
+					if (*pos != '\n')
+					{
+						m_body_state = body_error;
+						break;
+					}
+					BOOST_FALLTHROUGH;
+				}
+				case body_chunk_ext:
+					if (*pos != '\n')
+					{
+						++pos;
+						break;
+					}
+					BOOST_FALLTHROUGH;
+				case body_chunk_lf:
+					if (*pos++ != '\n' || m_chunk_digits == 0)
+					{
+						m_body_state = body_error;
+						break;
+					}
+					m_chunk_digits = 0;
+					// a chunk size of zero terminates the body. It's followed by
+					// the (optional) trailer headers and a blank line
+					m_body_state = m_body_left == 0 ? body_trailer_start : body_chunk_data;
+					break;
+				case body_chunk_end:
+					if (*pos == '\r') { ++pos; break; }
+					if (*pos != '\n')
+					{
+						m_body_state = body_error;
+						break;
+					}
+					++pos;
+					m_body_left = 0;
+					m_body_state = body_chunk_size;
+					break;
+				case body_trailer_start:
+					if (*pos == '\r') { ++pos; break; }
+					m_body_state = *pos == '\n' ? body_done : body_trailer_line;
+					++pos;
+					break;
+				case body_trailer_line:
+					if (*pos++ == '\n') m_body_state = body_trailer_start;
+					break;
+				case body_done:
+				case body_error:
+					goto out;
+			}
+			if (m_body_state == body_done) break;
+		}
+out:
+		if (m_body_state == body_error) error = true;
+		buf = buf.subspan(pos - buf.data());
+		return payload;
+	}
+
+	bool http_parser::finish_body()
+	{
+		if (m_state == read_body && m_body_state == body_until_close)
+			m_body_state = body_done;
+		return body_finished();
+	}
+
 	span<char const> http_parser::get_body() const
 	{
 		TORRENT_ASSERT(m_state == read_body);
@@ -583,6 +717,9 @@ restart_response:
 		m_cur_chunk_end = -1;
 		m_chunk_header_size = 0;
 		m_partial_chunk_header = 0;
+		m_body_state = body_until_close;
+		m_body_left = 0;
+		m_chunk_digits = 0;
 	}
 
 	span<char> http_parser::collapse_chunk_headers(span<char> buffer) const
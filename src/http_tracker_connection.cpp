@@ -98,6 +98,11 @@ namespace libtorrent::aux {
 
 		url += "info_hash=";
 		url += lt::escape_string({tracker_req().info_hash.data(), 20});
+		for (auto const& b : m_batch)
+		{
+			url += "&info_hash=";
+			url += lt::escape_string({b.req.info_hash.data(), 20});
+		}
 
 		if (!(tracker_req().kind & tracker_request::scrape_request))
 		{
@@ -197,17 +202,61 @@ namespace libtorrent::aux {
 			return;
 		}
 
+		aux::proxy_settings ps(settings);
+
+		// connections to the tracker are shared with other requests, unless
+		// they go through a proxy
+		if (!i2p && !(ps.proxy_tracker_connections && ps.type != settings_pack::none))
+		{
+			error_code ec;
+			std::string protocol;
+			http_tracker_key key;
+			std::tie(protocol, std::ignore, key.hostname, key.port, std::ignore)
+				= parse_url_components(url, ec);
+			if (!ec)
+			{
+				key.ssl = protocol == "https";
+				if (key.port == -1) key.port = key.ssl ? 443 : 80;
+				key.bind_address = bind_interface();
+#if TORRENT_USE_SSL
+				key.ssl_ctx_id = tracker_req().ssl_ctx_id;
+#endif
+				m_pool_key = std::move(key);
+			}
+		}
+
 		using namespace std::placeholders;
-		m_tracker_connection = std::make_shared<aux::http_connection>(m_ioc, m_man.host_resolver()
-			, std::bind(&http_tracker_connection::on_response, shared_from_this(), _1, _2, _3)
-			, true, settings.get_int(settings_pack::max_http_recv_buffer_size)
-			, std::bind(&http_tracker_connection::on_connect, shared_from_this(), _1)
-			, std::bind(&http_tracker_connection::on_filter, shared_from_this(), _1, _2)
-			, std::bind(&http_tracker_connection::on_filter_hostname, shared_from_this(), _1, _2)
+		if (m_pool_key) m_tracker_connection = m_man.take_http_connection(*m_pool_key);
+		if (m_tracker_connection)
+		{
+			m_tracker_connection->set_handlers(
+				std::bind(&http_tracker_connection::on_response, shared_from_this(), _1, _2, _3)
+				, std::bind(&http_tracker_connection::on_connect, shared_from_this(), _1)
+				, std::bind(&http_tracker_connection::on_filter, shared_from_this(), _1, _2)
+				, std::bind(&http_tracker_connection::on_filter_hostname, shared_from_this(), _1, _2));
+
+			error_code ec;
+			m_tracker_ip = m_tracker_connection->socket().remote_endpoint(ec).address();
+		}
+		else
+		{
+			m_tracker_connection = std::make_shared<aux::http_connection>(m_ioc, m_man.host_resolver()
+				, std::bind(&http_tracker_connection::on_response, shared_from_this(), _1, _2, _3)
+				, true, settings.get_int(settings_pack::max_http_recv_buffer_size)
+				, std::bind(&http_tracker_connection::on_connect, shared_from_this(), _1)
+				, std::bind(&http_tracker_connection::on_filter, shared_from_this(), _1, _2)
+				, std::bind(&http_tracker_connection::on_filter_hostname, shared_from_this(), _1, _2)
 #if TORRENT_USE_SSL
-			, tracker_req().ssl_ctx
+				, tracker_req().ssl_ctx
 #endif
-			);
+				);
+#if TORRENT_USE_SSL
+			if (m_pool_key)
+				m_tracker_connection->resume_ssl_session(m_man.ssl_session(*m_pool_key));
+#endif
+		}
+		m_tracker_connection->keep_alive(m_pool_key
+			&& settings.get_int(settings_pack::tracker_keep_alive_timeout) > 0);
 
 		int const timeout = tracker_req().event == event_t::stopped
 			? settings.get_int(settings_pack::stop_tracker_timeout)
@@ -223,7 +272,6 @@ namespace libtorrent::aux {
 		// to avoid being blocked for slow or failing responses. Chances
 		// are that we're shutting down, and this should be a best-effort
 		// attempt. It's not worth stalling shutdown.
-		aux::proxy_settings ps(settings);
 		m_tracker_connection->get(url, seconds(timeout)
 			, tracker_req().event == event_t::stopped ? 2 : 1
 			, ps.proxy_tracker_connections ? &ps : nullptr
@@ -258,7 +306,17 @@ namespace libtorrent::aux {
 	{
 		if (m_tracker_connection)
 		{
-			m_tracker_connection->close();
+			if (m_pool_key)
+			{
+#if TORRENT_USE_SSL
+				m_man.save_ssl_session(*m_pool_key, m_tracker_connection->ssl_session());
+#endif
+				// if the response was received in full and the tracker keeps
+				// the connection open, the next request may use it
+				if (m_tracker_connection->idle())
+					m_man.return_http_connection(m_ioc, *m_pool_key, std::move(m_tracker_connection));
+			}
+			if (m_tracker_connection) m_tracker_connection->close();
 			m_tracker_connection.reset();
 		}
 		cancel();
@@ -360,6 +418,13 @@ namespace libtorrent::aux {
 		error_code ec;
 		tcp::endpoint ep = c.socket().remote_endpoint(ec);
 		m_tracker_ip = ep.address();
+
+#if TORRENT_USE_SSL
+		bool const ssl_resumed = c.ssl_session_resumed();
+#else
+		bool const ssl_resumed = false;
+#endif
+		m_man.http_connection_opened(c.connect_time(), ssl_resumed);
 	}
 
 	void http_tracker_connection::on_response(error_code const& ec
@@ -390,6 +455,12 @@ namespace libtorrent::aux {
 
 		received_bytes(static_cast<int>(data.size()) + parser.body_start());
 
+		if (tracker_req().kind & tracker_request::scrape_request)
+		{
+			on_scrape_response(data);
+			return;
+		}
+
 		// handle tracker response
 		error_code ecode;
 
@@ -418,25 +489,74 @@ namespace libtorrent::aux {
 			return;
 		}
 
-		// do slightly different things for scrape requests
-		if (tracker_req().kind & tracker_request::scrape_request)
+		std::list<address> ip_list;
+		if (m_tracker_connection)
 		{
-			cb->tracker_scrape_response(tracker_req(), resp.complete
-				, resp.incomplete, resp.downloaded, resp.downloaders);
+			for (auto const& endp : m_tracker_connection->endpoints())
+			{
+				ip_list.push_back(endp.address());
+			}
 		}
-		else
+
+		cb->tracker_response(tracker_req(), m_tracker_ip, ip_list, resp);
+		close();
+	}
+
+	void http_tracker_connection::on_scrape_response(span<char const> data)
+	{
+		// the requests are reported in the order their info-hashes were
+		// added to the URL
+		std::vector<sha1_hash> info_hashes;
+		info_hashes.reserve(m_batch.size() + 1);
+		info_hashes.push_back(tracker_req().info_hash);
+		for (auto const& b : m_batch)
+			info_hashes.push_back(b.req.info_hash);
+
+		error_code ec;
+		std::vector<scrape_entry> entries;
+		tracker_response resp = parse_scrape_response(data, ec, info_hashes, entries);
+
+		resp.interval = std::max(resp.interval
+				, seconds32{m_man.settings().get_int(settings_pack::min_announce_interval)});
+
+		if (!resp.warning_message.empty())
 		{
-			std::list<address> ip_list;
-			if (m_tracker_connection)
+			if (auto cb = requester())
+				cb->tracker_warning(tracker_req(), resp.warning_message);
+			for (auto const& b : m_batch)
 			{
-				for (auto const& endp : m_tracker_connection->endpoints())
-				{
-					ip_list.push_back(endp.address());
-				}
+				if (auto cb = b.requester.lock())
+					cb->tracker_warning(b.req, resp.warning_message);
 			}
+		}
 
-			cb->tracker_response(tracker_req(), m_tracker_ip, ip_list, resp);
+		if (ec)
+		{
+			fail(ec, operation_t::bittorrent
+				, resp.failure_reason.c_str()
+				, resp.interval, resp.min_interval);
+			close();
+			return;
 		}
+
+		auto const report = [&](tracker_request const& req
+			, std::shared_ptr<request_callback> const& cb, scrape_entry const& e)
+		{
+			if (!cb) return;
+			if (e.ec)
+			{
+				cb->tracker_request_error(req, e.ec, operation_t::bittorrent
+					, "", resp.interval);
+				return;
+			}
+			cb->tracker_scrape_response(req, e.complete
+				, e.incomplete, e.downloaded, e.downloaders);
+		};
+
+		TORRENT_ASSERT(entries.size() == m_batch.size() + 1);
+		report(tracker_req(), requester(), entries[0]);
+		for (std::size_t i = 0; i < m_batch.size(); ++i)
+			report(m_batch[i].req, m_batch[i].requester.lock(), entries[i + 1]);
 		close();
 	}
 
@@ -482,20 +602,22 @@ namespace libtorrent::aux {
 		return true;
 	}
 
-	tracker_response parse_tracker_response(span<char const> const data, error_code& ec
-		, tracker_request_flags_t const flags, sha1_hash const& scrape_ih)
-	{
-		tracker_response resp;
+namespace {
 
+	// decodes a tracker response and parses the fields that are common to
+	// announce and scrape responses. On failure, ``ec`` is set
+	bdecode_node parse_response_common(span<char const> const data
+		, tracker_response& resp, error_code& ec)
+	{
 		bdecode_node e;
 		int const res = bdecode(data.begin(), data.end(), e, ec);
 
-		if (ec) return resp;
+		if (ec) return e;
 
 		if (res != 0 || e.type() != bdecode_node::dict_t)
 		{
 			ec = errors::invalid_tracker_response;
-			return resp;
+			return e;
 		}
 
 		// if no interval is specified, default to 30 minutes
@@ -512,13 +634,62 @@ namespace libtorrent::aux {
 		{
 			resp.failure_reason = failure.string_value();
 			ec = errors::tracker_failure;
-			return resp;
+			return e;
 		}
 
 		bdecode_node const warning = e.dict_find_string("warning message");
 		if (warning)
 			resp.warning_message = warning.string_value();
 
+		return e;
+	}
+}
+
+	tracker_response parse_scrape_response(span<char const> const data, error_code& ec
+		, span<sha1_hash const> const info_hashes, std::vector<scrape_entry>& entries)
+	{
+		tracker_response resp;
+		entries.clear();
+
+		bdecode_node const e = parse_response_common(data, resp, ec);
+		if (ec) return resp;
+
+		bdecode_node const files = e.dict_find_dict("files");
+		if (!files)
+		{
+			ec = errors::invalid_files_entry;
+			return resp;
+		}
+
+		entries.resize(std::size_t(info_hashes.size()));
+		auto entry = entries.begin();
+		for (sha1_hash const& ih : info_hashes)
+		{
+			bdecode_node const scrape_data = files.dict_find_dict(ih.to_string());
+			if (!scrape_data)
+			{
+				entry->ec = errors::invalid_hash_entry;
+			}
+			else
+			{
+				entry->complete = int(scrape_data.dict_find_int_value("complete", -1));
+				entry->incomplete = int(scrape_data.dict_find_int_value("incomplete", -1));
+				entry->downloaded = int(scrape_data.dict_find_int_value("downloaded", -1));
+				entry->downloaders = int(scrape_data.dict_find_int_value("downloaders", -1));
+			}
+			++entry;
+		}
+		return resp;
+	}
+
+	tracker_response parse_tracker_response(span<char const> const data, error_code& ec
+		, tracker_request_flags_t const flags, sha1_hash const& scrape_ih)
+	{
+		tracker_response resp;
+
+		bdecode_node const e = parse_response_common(data, resp, ec);
+		if (ec) return resp;
+
 		if (flags & tracker_request::scrape_request)
 		{
 			bdecode_node const files = e.dict_find_dict("files");
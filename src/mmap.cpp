@@ -31,7 +31,8 @@ see LICENSE file.
 #if TORRENT_HAVE_MMAP
 #include <sys/mman.h> // for mmap
 #include <sys/stat.h>
-#include <fcntl.h> // for open
+#include <fcntl.h> // for open, sync_file_range
+#include <unistd.h> // for sysconf
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 auto const map_failed = MAP_FAILED;
@@ -628,6 +629,36 @@ file_mapping::file_mapping(file_mapping&& rhs)
 		return file_view(shared_from_this());
 	}
 
+	void file_mapping::flush(std::int64_t const offset, std::int64_t const len
+		, bool const wait, error_code& ec)
+	{
+		if (m_mapping == nullptr || len <= 0 || offset >= m_size) return;
+		std::int64_t const size = std::min(len, m_size - offset);
+#if TORRENT_USE_SYNC_FILE_RANGE
+		// on linux, msync() with MS_ASYNC is a no-op. sync_file_range() lets
+		// us start the writeback of a range and wait for it separately
+		unsigned int const flags = wait
+			? SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER
+			: SYNC_FILE_RANGE_WRITE;
+		if (::sync_file_range(m_file.fd(), offset, size, flags) != 0)
+			ec.assign(errno, system_category());
+#elif TORRENT_HAVE_MMAP
+		// msync() requires the address to be page aligned
+		std::int64_t const page = ::sysconf(_SC_PAGESIZE);
+		std::int64_t const start = offset - offset % page;
+		if (::msync(static_cast<char*>(m_mapping) + start
+			, static_cast<std::size_t>(size + offset - start), wait ? MS_SYNC : MS_ASYNC) != 0)
+			ec.assign(errno, system_category());
+#else
+		// FlushViewOfFile() starts writing back the range, without waiting
+		// for it to reach the disk
+		TORRENT_UNUSED(wait);
+		if (!FlushViewOfFile(static_cast<char*>(m_mapping) + offset
+			, static_cast<std::size_t>(size)))
+			ec.assign(GetLastError(), system_category());
+#endif
+	}
+
 } // aux
 } // libtorrent
 
@@ -30,7 +30,10 @@ see LICENSE file.
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/aux_/disk_job_pool.hpp"
 #include "libtorrent/aux_/disk_io_thread_pool.hpp"
+#include "libtorrent/aux_/disk_thread_controller.hpp"
+#include "libtorrent/aux_/disk_job_queue.hpp"
 #include "libtorrent/aux_/store_buffer.hpp"
+#include "libtorrent/aux_/read_cache.hpp"
 #include "libtorrent/aux_/time.hpp"
 #include "libtorrent/aux_/alloca.hpp"
 #include "libtorrent/aux_/array.hpp"
@@ -149,6 +152,10 @@ struct TORRENT_EXTRA_EXPORT mmap_disk_io final
 	void async_read(storage_index_t storage, peer_request const& r
 		, std::function<void(disk_buffer_holder, storage_error const&)> handler
 		, disk_job_flags_t flags = {}) override;
+	void async_read_deadline(storage_index_t storage, peer_request const& r
+		, time_point deadline
+		, std::function<void(disk_buffer_holder, storage_error const&)> handler
+		, disk_job_flags_t flags = {}) override;
 	bool async_write(storage_index_t storage, peer_request const& r
 		, char const* buf, std::shared_ptr<disk_observer> o
 		, std::function<void(storage_error const&)> handler
@@ -160,6 +167,9 @@ struct TORRENT_EXTRA_EXPORT mmap_disk_io final
 		, std::function<void(piece_index_t, sha256_hash const&, storage_error const&)> handler) override;
 	void async_move_storage(storage_index_t storage, std::string p, move_flags_t flags
 		, std::function<void(status_t, std::string const&, storage_error const&)> handler) override;
+	void async_move_storage_progress(storage_index_t storage, std::string p, move_flags_t flags
+		, std::function<void(status_t, std::string const&, storage_error const&)> handler
+		, std::function<void(std::int64_t, std::int64_t)> progress) override;
 	void async_release_files(storage_index_t storage
 		, std::function<void()> handler = std::function<void()>()) override;
 	void async_delete_files(storage_index_t storage, remove_flags_t options
@@ -238,7 +248,7 @@ private:
 		std::condition_variable m_job_cond;
 
 		// jobs queued for servicing
-		jobqueue_t m_queued_jobs;
+		aux::disk_job_queue m_queued_jobs;
 	};
 
 	void thread_fun(job_queue& queue, aux::disk_io_thread_pool& pool);
@@ -254,6 +264,13 @@ private:
 
 	void perform_job(aux::disk_io_job* j, jobqueue_t& completed_jobs);
 
+	// the implementation of async_read() and async_read_deadline().
+	// ``deadline`` is only used if the time_critical flag is set
+	void issue_read(storage_index_t storage, peer_request const& r
+		, time_point deadline
+		, std::function<void(disk_buffer_holder, storage_error const&)> handler
+		, disk_job_flags_t flags);
+
 	// this queues up another job to be submitted
 	void add_job(aux::disk_io_job* j, bool user_add = true);
 	void add_fence_job(aux::disk_io_job* j, bool user_add = true);
@@ -263,6 +280,19 @@ private:
 	void abort_jobs();
 	void abort_hash_jobs(storage_index_t storage);
 
+	// serve the read job from the read cache, or read it from disk along
+	// with the blocks following it and insert them into the cache. Returns
+	// false if the job should be performed as a plain read instead
+	bool read_through_cache(aux::disk_io_job* j, char* buf);
+
+	// write back the dirty ranges of the job's storage, in offset order
+	void flush_dirty(aux::disk_io_job* j);
+
+	// adjust the number of generic and hash threads based on the job
+	// latencies measured since the last call, if adaptive_disk_threads is
+	// enabled. Called once per second by the first generic disk thread
+	void adapt_threads();
+
 	// returns the maximum number of threads
 	// the actual number of threads may be less
 	int num_threads() const;
@@ -291,6 +321,12 @@ private:
 	job_queue m_hash_io_jobs;
 	aux::disk_io_thread_pool m_hash_threads;
 
+	// measure the queue wait and service time of the jobs executed by each
+	// thread pool, and pick the number of threads when
+	// adaptive_disk_threads is enabled
+	aux::disk_thread_controller m_generic_controller;
+	aux::disk_thread_controller m_hash_controller;
+
 	// every write job is inserted into this map while it is in the job queue.
 	// It is removed after the write completes. This will let subsequent reads
 	// pull the buffers straight out of the queue instead of having to
@@ -303,12 +339,21 @@ private:
 	// time we should call it
 	time_point m_next_close_oldest_file = min_time();
 
+	// the next time to call adapt_threads()
+	time_point m_next_adapt_threads = min_time();
+
 	// LRU cache of open files
 	aux::file_view_pool m_file_pool;
 
 	// disk cache
 	aux::disk_buffer_pool m_buffer_pool;
 
+	// blocks recently read from disk, when enabled by
+	// settings_pack::read_cache_size. Hits are served directly in
+	// async_read(), without posting a job to the disk threads. The blocks
+	// are allocated from m_buffer_pool, so this must be destructed first
+	aux::read_cache m_read_cache;
+
 	// total number of blocks in use by both the read
 	// and the write cache. This is not supposed to
 	// exceed m_cache_size
@@ -402,6 +447,8 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 	void mmap_disk_io::remove_torrent(storage_index_t const idx)
 	{
+		m_stats_counters.inc_stats_counter(counters::read_cache_evictions
+			, m_read_cache.evict_storage(idx));
 		m_torrents[idx].reset();
 		m_free_slots.push_back(idx);
 	}
@@ -434,8 +481,8 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		// abort outstanding jobs belonging to this torrent
 
 		DLOG("aborting hash jobs\n");
-		for (auto i = m_hash_io_jobs.m_queued_jobs.iterate(); i.get(); i.next())
-			i.get()->flags |= aux::disk_io_job::aborted;
+		m_hash_io_jobs.m_queued_jobs.for_each([](aux::disk_io_job* j)
+			{ j->flags |= aux::disk_io_job::aborted; });
 		l.unlock();
 
 		// if there are no disk threads, we can't wait for the jobs here, because
@@ -458,13 +505,78 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		TORRENT_ASSERT(m_magic == 0x1337);
 		m_buffer_pool.set_settings(m_settings);
 		m_file_pool.resize(m_settings.get_int(settings_pack::file_pool_size));
+		m_stats_counters.inc_stats_counter(counters::read_cache_evictions
+			, m_read_cache.set_max_size(m_settings.get_int(settings_pack::read_cache_size)));
+
+		int num_threads = m_settings.get_int(settings_pack::aio_threads);
+		int num_hash_threads = m_settings.get_int(settings_pack::hashing_threads);
 
-		int const num_threads = m_settings.get_int(settings_pack::aio_threads);
-		int const num_hash_threads = m_settings.get_int(settings_pack::hashing_threads);
+		// the adaptive limits are kept, as long as they're within the new
+		// bounds. A pool that's disabled stays disabled, since that decides
+		// which queue hash jobs go to
+		if (m_settings.get_bool(settings_pack::adaptive_disk_threads))
+		{
+			if (num_threads > 0 && m_generic_threads.max_threads() > 0)
+				num_threads = std::min(num_threads, m_generic_threads.max_threads());
+			if (num_hash_threads > 0 && m_hash_threads.max_threads() > 0)
+				num_hash_threads = std::min(num_hash_threads, m_hash_threads.max_threads());
+		}
 		DLOG("set max threads(%d, %d)\n", num_threads, num_hash_threads);
 
 		m_generic_threads.set_max_threads(num_threads);
 		m_hash_threads.set_max_threads(num_hash_threads);
+
+		aux::array<int, aux::num_job_classes> const weights{{
+			m_settings.get_int(settings_pack::disk_queue_read_weight),
+			m_settings.get_int(settings_pack::disk_queue_write_weight),
+			m_settings.get_int(settings_pack::disk_queue_hash_weight),
+			m_settings.get_int(settings_pack::disk_queue_other_weight)}};
+		{
+			std::lock_guard<std::mutex> l(m_job_mutex);
+			m_generic_io_jobs.m_queued_jobs.set_weights(weights);
+			m_hash_io_jobs.m_queued_jobs.set_weights(weights);
+		}
+		m_stats_counters.set_value(counters::disk_generic_thread_limit, num_threads);
+		m_stats_counters.set_value(counters::disk_hash_thread_limit, num_hash_threads);
+	}
+
+	void mmap_disk_io::adapt_threads()
+	{
+		bool const adaptive = m_settings.get_bool(settings_pack::adaptive_disk_threads);
+		int const max_threads = m_settings.get_int(settings_pack::aio_threads);
+		int const max_hash_threads = m_settings.get_int(settings_pack::hashing_threads);
+
+		auto adapt = [&](aux::disk_thread_controller& c, aux::disk_io_thread_pool& pool
+			, int const max, counters::stats_gauge_t const limit_gauge
+			, counters::stats_gauge_t const wait_gauge
+			, counters::stats_gauge_t const service_gauge)
+		{
+			int const limit = pool.max_threads();
+			if (max <= 0 || limit <= 0) return;
+			auto const d = c.update(limit, max);
+			if (d.jobs > 0)
+			{
+				m_stats_counters.set_value(wait_gauge, d.queue_wait);
+				m_stats_counters.set_value(service_gauge, d.service_time);
+			}
+			if (!adaptive || d.limit == limit) return;
+
+			DLOG("adapt threads: %d -> %d (wait: %d us service: %d us)\n"
+				, limit, d.limit, int(d.queue_wait), int(d.service_time));
+			m_stats_counters.inc_stats_counter(d.limit > limit
+				? counters::disk_threads_grown : counters::disk_threads_shrunk);
+			m_stats_counters.set_value(limit_gauge, d.limit);
+			pool.set_max_threads(d.limit);
+		};
+
+		adapt(m_generic_controller, m_generic_threads, max_threads
+			, counters::disk_generic_thread_limit
+			, counters::disk_generic_queue_wait
+			, counters::disk_generic_service_time);
+		adapt(m_hash_controller, m_hash_threads, max_hash_threads
+			, counters::disk_hash_thread_limit
+			, counters::disk_hash_queue_wait
+			, counters::disk_hash_service_time);
 	}
 
 	void mmap_disk_io::fail_jobs_impl(storage_error const& e, jobqueue_t& src, jobqueue_t& dst)
@@ -610,6 +722,15 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 			return status_t::fatal_disk_error;
 		}
 
+		// reads made on behalf of checking don't go through the cache, they
+		// would just push out the blocks peers are interested in
+		if (m_settings.get_int(settings_pack::read_cache_size) > 0
+			&& !(j->flags & disk_interface::volatile_read)
+			&& read_through_cache(j, buffer.data()))
+		{
+			return status_t::no_error;
+		}
+
 		time_point const start_time = clock_type::now();
 
 		aux::open_mode_t const file_flags = file_flags_for_job(j);
@@ -634,6 +755,94 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		return status_t::no_error;
 	}
 
+	bool mmap_disk_io::read_through_cache(aux::disk_io_job* j, char* const buf)
+	{
+		storage_index_t const st = j->storage->storage_index();
+		int const start = j->d.io.offset;
+		int const length = j->d.io.buffer_size;
+
+		// another job may have pulled this block into the cache since this
+		// one was issued
+		if (m_read_cache.get(st, j->piece, start, length, [=] { return buf; }))
+		{
+			m_stats_counters.inc_stats_counter(counters::read_cache_hits);
+			return true;
+		}
+		m_stats_counters.inc_stats_counter(counters::read_cache_misses);
+
+		int const piece_size = j->storage->files().piece_size(j->piece);
+		int const blocks_in_piece = (piece_size + default_block_size - 1) / default_block_size;
+		int const first_block = start / default_block_size;
+		int const end_block = (start + length - 1) / default_block_size + 1;
+		int const cache_size = m_settings.get_int(settings_pack::read_cache_size);
+
+		// when we suggest pieces to peers, we do so because we expect them to
+		// be in the cache. Make sure that's true by reading the whole piece.
+		// Otherwise read a cache line worth of blocks following the request
+		int begin = 0;
+		int end = blocks_in_piece;
+		if (m_settings.get_int(settings_pack::suggest_mode) != settings_pack::suggest_read_cache
+			|| blocks_in_piece > cache_size)
+		{
+			int const line = std::max(1, std::min(cache_size
+				, m_settings.get_int(settings_pack::read_cache_line_size)));
+			begin = first_block;
+			end = std::min(blocks_in_piece, std::max(end_block, first_block + line));
+		}
+		int const num_blocks = end - begin;
+		TORRENT_ASSERT(num_blocks > 0);
+		TORRENT_ASSERT(begin <= first_block && end >= end_block);
+
+		std::vector<aux::read_cache::buffer_t> blocks(static_cast<std::size_t>(num_blocks));
+		TORRENT_ALLOCA(iov, iovec_t, num_blocks);
+		for (int i = 0; i < num_blocks; ++i)
+		{
+			int const block_size = std::min(default_block_size
+				, piece_size - (begin + i) * default_block_size);
+			char* const b = m_buffer_pool.allocate_buffer("read cache");
+			// if we're out of memory, just read the requested range
+			if (b == nullptr) return false;
+			blocks[std::size_t(i)] = aux::read_cache::buffer_t(b, {this});
+			iov[i] = iovec_t(b, block_size);
+		}
+		int const read_start = begin * default_block_size;
+		int const read_len = std::min(piece_size, end * default_block_size) - read_start;
+
+		std::uint32_t const token = m_read_cache.begin_fill(st, j->piece);
+		auto cancel_fill = aux::scope_end([&] { m_read_cache.cancel_fill(st, j->piece); });
+
+		time_point const start_time = clock_type::now();
+		int const ret = j->storage->readv(m_settings, iov
+			, j->piece, read_start, file_flags_for_job(j), j->error);
+
+		// if the read failed, the job is complete. A short read is retried as
+		// a plain read of just the requested range
+		if (j->error.ec) return true;
+		if (ret < read_len) return false;
+
+		std::int64_t const read_time = total_microseconds(clock_type::now() - start_time);
+		m_stats_counters.inc_stats_counter(counters::num_read_back);
+		m_stats_counters.inc_stats_counter(counters::num_blocks_read, num_blocks);
+		m_stats_counters.inc_stats_counter(counters::num_read_ops);
+		m_stats_counters.inc_stats_counter(counters::disk_read_time, read_time);
+		m_stats_counters.inc_stats_counter(counters::disk_job_time, read_time);
+
+		for (int pos = start; pos < start + length;)
+		{
+			int const block = pos / default_block_size;
+			int const block_offset = pos - block * default_block_size;
+			int const n = std::min(default_block_size - block_offset, start + length - pos);
+			std::memcpy(buf + (pos - start)
+				, blocks[std::size_t(block - begin)].get() + block_offset, std::size_t(n));
+			pos += n;
+		}
+
+		cancel_fill.disarm();
+		m_stats_counters.inc_stats_counter(counters::read_cache_evictions
+			, m_read_cache.insert(st, j->piece, begin, blocks_in_piece, blocks, token));
+		return true;
+	}
+
 	status_t mmap_disk_io::do_write(aux::disk_io_job* j)
 	{
 		time_point const start_time = clock_type::now();
@@ -658,6 +867,10 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 			m_stats_counters.inc_stats_counter(counters::num_write_ops);
 			m_stats_counters.inc_stats_counter(counters::disk_write_time, write_time);
 			m_stats_counters.inc_stats_counter(counters::disk_job_time, write_time);
+
+			int const max_dirty = m_settings.get_int(settings_pack::max_dirty_bytes);
+			if (max_dirty > 0 && j->storage->dirty_bytes() >= max_dirty)
+				flush_dirty(j);
 		}
 
 		{
@@ -666,15 +879,63 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 				m_need_tick.push_back({aux::time_now() + minutes(2), j->storage});
 		}
 
+		// this must happen after the write, to also invalidate blocks of this
+		// piece being read into the cache right now. It must also happen
+		// before the block is removed from the store buffer. async_read()
+		// looks in the store buffer first, and would otherwise find the stale
+		// block in the read cache in between
+		if (m_settings.get_int(settings_pack::read_cache_size) > 0)
+		{
+			m_stats_counters.inc_stats_counter(counters::read_cache_evictions
+				, m_read_cache.evict_piece(j->storage->storage_index(), j->piece));
+		}
+
 		m_store_buffer.erase({j->storage->storage_index(), j->piece, j->d.io.offset});
 
-		return ret != j->d.io.buffer_size
+		return ret != j->d.io.buffer_size || j->error
 			? status_t::fatal_disk_error : status_t::no_error;
 	}
 
+	void mmap_disk_io::flush_dirty(aux::disk_io_job* j)
+	{
+		time_point const start_time = clock_type::now();
+
+		// the data has already been written to the file when we get here, a
+		// failure to start its writeback doesn't fail the write job. The
+		// kernel will still write back the pages eventually
+		storage_error ignore;
+		auto const flushed = j->storage->flush_dirty(m_settings, ignore);
+		if (flushed.ranges == 0) return;
+
+		std::int64_t const flush_time = total_microseconds(clock_type::now() - start_time);
+		m_stats_counters.inc_stats_counter(counters::num_disk_flushes);
+		m_stats_counters.inc_stats_counter(counters::num_flush_ranges, flushed.ranges);
+		m_stats_counters.inc_stats_counter(counters::disk_flush_bytes, flushed.bytes);
+		m_stats_counters.inc_stats_counter(counters::disk_flush_time, flush_time);
+		m_stats_counters.inc_stats_counter(counters::disk_job_time, flush_time);
+	}
+
 	void mmap_disk_io::async_read(storage_index_t storage, peer_request const& r
 		, std::function<void(disk_buffer_holder, storage_error const&)> handler
 		, disk_job_flags_t const flags)
+	{
+		issue_read(storage, r, time_point{}, std::move(handler)
+			, flags & ~disk_interface::time_critical);
+	}
+
+	void mmap_disk_io::async_read_deadline(storage_index_t storage, peer_request const& r
+		, time_point const deadline
+		, std::function<void(disk_buffer_holder, storage_error const&)> handler
+		, disk_job_flags_t const flags)
+	{
+		issue_read(storage, r, deadline, std::move(handler)
+			, flags | disk_interface::time_critical);
+	}
+
+	void mmap_disk_io::issue_read(storage_index_t const storage, peer_request const& r
+		, time_point const deadline
+		, std::function<void(disk_buffer_holder, storage_error const&)> handler
+		, disk_job_flags_t const flags)
 	{
 		TORRENT_ASSERT(r.length <= default_block_size);
 		TORRENT_ASSERT(r.length > 0);
@@ -755,6 +1016,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 				j->d.io.buffer_size = std::uint16_t((ret == 1) ? len1 : r.length - len1);
 				j->d.io.buffer_offset = std::uint16_t((ret == 1) ? 0 : len1);
 				j->flags = flags;
+				j->deadline = deadline;
 				j->callback = std::move(handler);
 
 				if (j->storage->is_blocked(j))
@@ -795,12 +1057,30 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 			}
 		}
 
+		if (m_settings.get_int(settings_pack::read_cache_size) > 0
+			&& m_read_cache.get(storage, r.piece, r.start, r.length, [&]() -> char*
+			{
+				buffer = disk_buffer_holder(*this, m_buffer_pool.allocate_buffer("send buffer"), r.length);
+				if (!buffer)
+				{
+					ec.ec = error::no_memory;
+					ec.operation = operation_t::alloc_cache_piece;
+				}
+				return buffer.data();
+			}))
+		{
+			m_stats_counters.inc_stats_counter(counters::read_cache_hits);
+			handler(std::move(buffer), ec);
+			return;
+		}
+
 		aux::disk_io_job* j = m_job_pool.allocate_job(aux::job_action_t::read);
 		j->storage = m_torrents[storage]->shared_from_this();
 		j->piece = r.piece;
 		j->d.io.offset = r.start;
 		j->d.io.buffer_size = std::uint16_t(r.length);
 		j->flags = flags;
+		j->deadline = deadline;
 		j->callback = std::move(handler);
 
 		if (j->storage->is_blocked(j))
@@ -886,12 +1166,21 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 	void mmap_disk_io::async_move_storage(storage_index_t const storage
 		, std::string p, move_flags_t const flags
 		, std::function<void(status_t, std::string const&, storage_error const&)> handler)
+	{
+		async_move_storage_progress(storage, std::move(p), flags, std::move(handler), {});
+	}
+
+	void mmap_disk_io::async_move_storage_progress(storage_index_t const storage
+		, std::string p, move_flags_t const flags
+		, std::function<void(status_t, std::string const&, storage_error const&)> handler
+		, std::function<void(std::int64_t, std::int64_t)> progress)
 	{
 		aux::disk_io_job* j = m_job_pool.allocate_job(aux::job_action_t::move_storage);
 		j->storage = m_torrents[storage]->shared_from_this();
 		j->argument = std::move(p);
 		j->callback = std::move(handler);
 		j->move_flags = flags;
+		j->move_progress = std::move(progress);
 
 		add_fence_job(j);
 	}
@@ -913,17 +1202,16 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		auto st = m_torrents[storage]->shared_from_this();
 		// hash jobs
-		for (auto i = m_hash_io_jobs.m_queued_jobs.iterate(); i.get(); i.next())
+		m_hash_io_jobs.m_queued_jobs.for_each([&](aux::disk_io_job* j)
 		{
-			aux::disk_io_job* j = i.get();
-			if (j->storage != st) continue;
+			if (j->storage != st) return;
 			// only cancel volatile-read jobs. This means only full checking
 			// jobs. These jobs are likely to have a pretty deep queue and
 			// really gain from being cancelled. They can also be restarted
 			// easily.
-			if (!(j->flags & disk_interface::volatile_read)) continue;
+			if (!(j->flags & disk_interface::volatile_read)) return;
 			j->flags |= aux::disk_io_job::aborted;
-		}
+		});
 	}
 
 	void mmap_disk_io::async_delete_files(storage_index_t const storage
@@ -1144,9 +1432,19 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		// if this assert fails, something's wrong with the fence logic
 		TORRENT_ASSERT(j->storage->num_outstanding_jobs() == 1);
 
+		std::function<void(std::int64_t, std::int64_t)> progress;
+		if (j->move_progress)
+		{
+			progress = [this, j](std::int64_t const copied, std::int64_t const total)
+			{
+				post(m_ios, [f = j->move_progress, copied, total] { f(copied, total); });
+			};
+		}
+
 		// if files have to be closed, that's the storage's responsibility
 		auto const [ret, p] = j->storage->move_storage(std::get<std::string>(j->argument)
-			, j->move_flags, j->error);
+			, j->move_flags, m_settings.get_int(settings_pack::move_storage_threads)
+			, progress, j->error);
 
 		std::get<std::string>(j->argument) = p;
 		return ret;
@@ -1166,6 +1464,8 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		// if this assert fails, something's wrong with the fence logic
 		TORRENT_ASSERT(j->storage->num_outstanding_jobs() == 1);
+		m_stats_counters.inc_stats_counter(counters::read_cache_evictions
+			, m_read_cache.evict_storage(j->storage->storage_index()));
 		j->storage->delete_files(std::get<remove_flags_t>(j->argument), j->error);
 		return j->error ? status_t::fatal_disk_error : status_t::no_error;
 	}
@@ -1191,6 +1491,10 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		TORRENT_ASSERT(j->storage->files().piece_length() > 0);
 
+		// the files may have been replaced since we last read from them
+		m_stats_counters.inc_stats_counter(counters::read_cache_evictions
+			, m_read_cache.evict_storage(j->storage->storage_index()));
+
 		// always initialize the storage
 		j->storage->initialize(m_settings, j->error);
 		if (j->error) return status_t::fatal_disk_error;
@@ -1237,6 +1541,8 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 	{
 		// if this assert fails, something's wrong with the fence logic
 		TORRENT_ASSERT(j->storage->num_outstanding_jobs() == 1);
+		m_stats_counters.inc_stats_counter(counters::read_cache_evictions
+			, m_read_cache.evict_storage(j->storage->storage_index()));
 		j->storage->release_files(j->error);
 		return j->error ? status_t::fatal_disk_error : status_t::no_error;
 	}
@@ -1257,6 +1563,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 
 		// gauges
 		c.set_value(counters::disk_blocks_in_use, m_buffer_pool.in_use());
+		c.set_value(counters::read_cache_blocks, m_read_cache.size());
 	}
 
 	status_t mmap_disk_io::do_file_priority(aux::disk_io_job* j)
@@ -1270,10 +1577,13 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 	// this job won't return until all outstanding jobs on this
 	// piece are completed or cancelled and the buffers for it
 	// have been evicted
-	status_t mmap_disk_io::do_clear_piece(aux::disk_io_job*)
+	status_t mmap_disk_io::do_clear_piece(aux::disk_io_job* j)
 	{
-		// there's nothing to do here, by the time this is called the jobs for
-		// this storage has been completed since this is a fence job
+		// by the time this is called the jobs for this storage has been
+		// completed since this is a fence job. All that's left is to drop the
+		// piece from the read cache
+		m_stats_counters.inc_stats_counter(counters::read_cache_evictions
+			, m_read_cache.evict_piece(j->storage->storage_index(), j->piece));
 		return status_t::no_error;
 	}
 
@@ -1527,10 +1837,24 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 						m_file_pool.close_oldest();
 					}
 				}
+
+				if (now > m_next_adapt_threads)
+				{
+					m_next_adapt_threads = now + seconds(1);
+					adapt_threads();
+				}
 			}
 
+			time_point const start_time = clock_type::now();
+			time_duration const queue_wait = start_time - j->queued_time;
+			m_stats_counters.inc_stats_counter(counters::disk_read_queue_time
+				+ static_cast<int>(aux::job_class(j->action)), total_microseconds(queue_wait));
+
 			execute_job(j);
 
+			((&pool == &m_generic_threads) ? m_generic_controller : m_hash_controller)
+				.job_done(queue_wait, clock_type::now() - start_time);
+
 			l.lock();
 		}
 
@@ -1591,6 +1915,7 @@ TORRENT_EXPORT std::unique_ptr<disk_interface> mmap_disk_io_constructor(
 		// the disk thread in parallel with stopping
 		// trackers.
 		m_file_pool.release();
+		m_read_cache.clear();
 		TORRENT_ASSERT(m_magic == 0x1337);
 	}
 
@@ -455,6 +455,10 @@ namespace libtorrent::aux {
 		// make sure we don't have the files open
 		m_pool.release(storage_index());
 
+		// closing the files doesn't lose the writes, but there's no point in
+		// flushing them from here on
+		clear_dirty_ranges();
+
 		// make sure we can pick up new files added to the download directory when
 		// we start the torrent again
 		m_stat_cache.clear();
@@ -464,6 +468,7 @@ namespace libtorrent::aux {
 	{
 		// make sure we don't have the files open
 		m_pool.release(storage_index());
+		clear_dirty_ranges();
 
 		// if there's a part file open, make sure to destruct it to have it
 		// release the underlying part file. Otherwise we may not be able to
@@ -482,10 +487,15 @@ namespace libtorrent::aux {
 	}
 
 	std::pair<status_t, std::string> mmap_storage::move_storage(std::string save_path
-		, move_flags_t const flags, storage_error& ec)
+		, move_flags_t const flags, int const copy_threads
+		, std::function<void(std::int64_t, std::int64_t)> const& progress
+		, storage_error& ec)
 	{
 		m_pool.release(storage_index());
 
+		// the dirty ranges refer to the files in the old location
+		clear_dirty_ranges();
+
 		status_t ret;
 		auto move_partfile = [&](std::string const& new_save_path, error_code& e)
 		{
@@ -493,7 +503,7 @@ namespace libtorrent::aux {
 			m_part_file->move_partfile(new_save_path, e);
 		};
 		std::tie(ret, m_save_path) = aux::move_storage(files(), m_save_path, std::move(save_path)
-			, std::move(move_partfile), flags, ec);
+			, std::move(move_partfile), flags, copy_threads, progress, ec);
 
 		// clear the stat cache in case the new location has new files
 		m_stat_cache.clear();
@@ -651,6 +661,9 @@ namespace libtorrent::aux {
 				return -1;
 			}
 
+			if (sett.get_int(settings_pack::max_dirty_bytes) > 0)
+				add_dirty_range(file_index, file_offset, ret);
+
 			return ret;
 		});
 	}
@@ -877,6 +890,115 @@ namespace libtorrent::aux {
 		}
 	}
 
+	void mmap_storage::add_dirty_range(file_index_t const file
+		, std::int64_t start, std::int64_t const len)
+	{
+		std::int64_t end = start + len;
+		std::int64_t removed = 0;
+
+		std::lock_guard<std::mutex> l(m_dirty_mutex);
+		auto it = m_dirty_ranges.lower_bound({file, start});
+
+		// merge with the range before this one, if they touch
+		if (it != m_dirty_ranges.begin())
+		{
+			auto const prev = std::prev(it);
+			if (prev->first.first == file && prev->second >= start)
+			{
+				start = prev->first.second;
+				end = std::max(end, prev->second);
+				removed += prev->second - prev->first.second;
+				m_dirty_ranges.erase(prev);
+			}
+		}
+
+		// and with the ranges following it
+		while (it != m_dirty_ranges.end() && it->first.first == file
+			&& it->first.second <= end)
+		{
+			end = std::max(end, it->second);
+			removed += it->second - it->first.second;
+			it = m_dirty_ranges.erase(it);
+		}
+
+		m_dirty_ranges.emplace_hint(it, std::make_pair(file, start), end);
+		m_dirty_bytes += end - start - removed;
+	}
+
+	mmap_storage::flush_result mmap_storage::flush_dirty(settings_interface const& sett
+		, storage_error& ec)
+	{
+		flush_result ret;
+
+		// other threads keep writing while we flush, the next flush picks up
+		// their ranges
+		std::unique_lock<std::mutex> fl(m_flush_mutex, std::try_to_lock);
+		if (!fl.owns_lock()) return ret;
+
+		dirty_ranges_t ranges;
+		{
+			std::lock_guard<std::mutex> l(m_dirty_mutex);
+			ranges.swap(m_dirty_ranges);
+		}
+
+		auto flush_ranges = [&](dirty_ranges_t const& rs, bool const wait)
+		{
+			for (auto const& r : rs)
+			{
+				file_index_t const file = r.first.first;
+
+				// the file has been written to, so it normally exists already.
+				// Opening it read-only makes sure a file deleted or moved in the
+				// meantime isn't created again. A file opened for writing is
+				// reused if it's still in the pool
+				storage_error se;
+				auto f = open_file_impl(sett, file, aux::open_mode::read_only, se);
+				if (se.ec == boost::system::errc::no_such_file_or_directory) continue;
+				if (se)
+				{
+					ec = se;
+					ec.file(file);
+					ec.operation = operation_t::file_open;
+					return;
+				}
+
+				error_code e;
+				f->flush(r.first.second, r.second - r.first.second, wait, e);
+				if (e)
+				{
+					ec.ec = e;
+					ec.file(file);
+					ec.operation = operation_t::file_write;
+					return;
+				}
+			}
+		};
+
+		// wait for the writeback started last time to complete before adding
+		// more
+		flush_ranges(m_writeback, true);
+		m_writeback.clear();
+		if (!ec) flush_ranges(ranges, false);
+
+		for (auto const& r : ranges)
+		{
+			++ret.ranges;
+			ret.bytes += r.second - r.first.second;
+		}
+		m_dirty_bytes -= ret.bytes;
+		m_writeback = std::move(ranges);
+		return ret;
+	}
+
+	void mmap_storage::clear_dirty_ranges()
+	{
+		std::lock_guard<std::mutex> fl(m_flush_mutex);
+		std::lock_guard<std::mutex> l(m_dirty_mutex);
+		m_dirty_ranges.clear();
+		m_writeback.clear();
+		m_dirty_bytes = 0;
+	}
+
 	bool mmap_storage::tick()
 	{
 		error_code ec;
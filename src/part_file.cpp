@@ -39,6 +39,10 @@ see LICENSE file.
   // header to an even multiple of 1024 bytes.
   uint8_t padding[n];
 
+  The header is kept in memory as a flat array indexed by piece. When it's
+  flushed, only the 1 kiB blocks of the header whose entries changed are
+  written back.
+
 */
 
 #include "libtorrent/aux_/part_file.hpp"
@@ -50,12 +54,24 @@ see LICENSE file.
 
 #include <functional> // for std::function
 #include <cstdint>
+#include <algorithm>
+#include <cstring>
 
 namespace {
 
 	// round up to even kilobyte
 	int round_up(int n)
 	{ return (n + 1023) & ~0x3ff; }
+
+	// the header is flushed in blocks of this size
+	constexpr int header_block_size = 1024;
+
+	// the offset of the first slot entry in the header, after num_pieces
+	// and piece_size
+	constexpr int slots_offset = 8;
+
+	// the most disk space to reserve ahead of the slots in use at a time
+	constexpr int max_reserve_bytes = 64 * 1024 * 1024;
 }
 
 namespace libtorrent::aux {
@@ -71,6 +87,9 @@ namespace libtorrent::aux {
 		TORRENT_ASSERT(num_pieces > 0);
 		TORRENT_ASSERT(m_piece_size > 0);
 
+		m_piece_map.resize(num_pieces, slot_index_t(-1));
+		m_dirty_blocks.resize(m_header_size / header_block_size, false);
+
 		error_code ec;
 		auto f = open_file(aux::open_mode::read_only, ec);
 		if (ec) return;
@@ -113,8 +132,12 @@ namespace libtorrent::aux {
 
 			free_slots[slot] = false;
 			m_piece_map[i] = slot;
+			++m_num_pieces;
 		}
 
+		m_num_reserved = m_num_allocated;
+		m_header_on_disk = true;
+
 		// now, populate the free_list with the "holes"
 		for (slot_index_t i(0); i < m_num_allocated; ++i)
 		{
@@ -128,28 +151,57 @@ namespace libtorrent::aux {
 		flush_metadata_impl(ec);
 	}
 
-	slot_index_t part_file::allocate_slot(piece_index_t const piece)
+	slot_index_t part_file::allocate_slot(piece_index_t const piece
+		, file& f)
 	{
 		// the mutex is assumed to be held here, since this is a private function
 
-		TORRENT_ASSERT(m_piece_map.find(piece) == m_piece_map.end());
+		TORRENT_ASSERT(m_piece_map[piece] == slot_index_t(-1));
 		slot_index_t slot(-1);
 		if (!m_free_slots.empty())
 		{
-			slot = m_free_slots.front();
-			m_free_slots.erase(m_free_slots.begin());
+			slot = m_free_slots.back();
+			m_free_slots.pop_back();
 		}
 		else
 		{
 			slot = m_num_allocated;
 			++m_num_allocated;
+
+			if (m_num_allocated > m_num_reserved)
+			{
+				// grow the file by 1/8 of the slots already allocated at a
+				// time. At least one slot, but not more than max_reserve_bytes
+				int const max_chunk = std::max(1, max_reserve_bytes / m_piece_size);
+				int const chunk = std::clamp(static_cast<int>(m_num_allocated) / 8
+					, 1, max_chunk);
+				std::int64_t const reserved_end = slot_offset(m_num_reserved);
+				m_num_reserved = slot_index_t(std::min(m_max_pieces
+					, static_cast<int>(slot) + chunk));
+
+				// only the newly reserved range is allocated. It's done with
+				// the mutex held, for no other thread to write to a slot in
+				// it at the same time. Failing to reserve space is not fatal,
+				// the write will extend the file anyway
+				error_code ignore;
+				f.allocate(reserved_end, slot_offset(m_num_reserved) - reserved_end
+					, ignore);
+			}
 		}
 
 		m_piece_map[piece] = slot;
-		m_dirty_metadata = true;
+		++m_num_pieces;
+		set_dirty(piece);
 		return slot;
 	}
 
+	void part_file::set_dirty(piece_index_t const piece)
+	{
+		int const block = (slots_offset + static_cast<int>(piece) * 4) / header_block_size;
+		m_dirty_blocks.set_bit(block);
+		m_dirty_metadata = true;
+	}
+
 	int part_file::writev(span<iovec_t const> bufs, piece_index_t const piece
 		, int const offset, error_code& ec)
 	{
@@ -160,9 +212,8 @@ namespace libtorrent::aux {
 		auto f = open_file(aux::open_mode::write | aux::open_mode::hidden, ec);
 		if (ec) return -1;
 
-		auto const i = m_piece_map.find(piece);
-		slot_index_t const slot = (i == m_piece_map.end())
-			? allocate_slot(piece) : i->second;
+		slot_index_t slot = m_piece_map[piece];
+		if (slot == slot_index_t(-1)) slot = allocate_slot(piece, f);
 
 		l.unlock();
 
@@ -177,14 +228,13 @@ namespace libtorrent::aux {
 		TORRENT_ASSERT(int(bufs.size()) + offset <= m_piece_size);
 		std::unique_lock<std::mutex> l(m_mutex);
 
-		auto const i = m_piece_map.find(piece);
-		if (i == m_piece_map.end())
+		slot_index_t const slot = m_piece_map[piece];
+		if (slot == slot_index_t(-1))
 		{
 			ec = make_error_code(boost::system::errc::no_such_file_or_directory);
 			return -1;
 		}
 
-		slot_index_t const slot = i->second;
 		l.unlock();
 
 		auto f = open_file(aux::open_mode::read_only | aux::open_mode::hidden, ec);
@@ -220,15 +270,14 @@ namespace libtorrent::aux {
 		TORRENT_ASSERT(int(len) + offset <= m_piece_size);
 		std::unique_lock<std::mutex> l(m_mutex);
 
-		auto const i = m_piece_map.find(piece);
-		if (i == m_piece_map.end())
+		slot_index_t const slot = m_piece_map[piece];
+		if (slot == slot_index_t(-1))
 		{
 			ec = error_code(boost::system::errc::no_such_file_or_directory
 				, boost::system::generic_category());
 			return -1;
 		}
 
-		slot_index_t const slot = i->second;
 		auto f = open_file(aux::open_mode::read_only | aux::open_mode::hidden, ec);
 		if (ec) return -1;
 
@@ -265,17 +314,18 @@ namespace libtorrent::aux {
 	{
 		std::lock_guard<std::mutex> l(m_mutex);
 
-		auto const i = m_piece_map.find(piece);
-		if (i == m_piece_map.end()) return;
+		slot_index_t const slot = m_piece_map[piece];
+		if (slot == slot_index_t(-1)) return;
 
 		// TODO: what do we do if someone is currently reading from the disk
 		// from this piece? does it matter? Since we won't actively erase the
 		// data from disk, but it may be overwritten soon, it's probably not that
 		// big of a deal
 
-		m_free_slots.push_back(i->second);
-		m_piece_map.erase(i);
-		m_dirty_metadata = true;
+		m_free_slots.push_back(slot);
+		m_piece_map[piece] = slot_index_t(-1);
+		--m_num_pieces;
+		set_dirty(piece);
 	}
 
 	void part_file::move_partfile(std::string const& path, error_code& ec)
@@ -285,7 +335,7 @@ namespace libtorrent::aux {
 		flush_metadata_impl(ec);
 		if (ec) return;
 
-		if (!m_piece_map.empty())
+		if (m_num_pieces > 0)
 		{
 			std::string old_path = combine_path(m_path, m_name);
 			std::string new_path = combine_path(path, m_name);
@@ -310,7 +360,7 @@ namespace libtorrent::aux {
 		std::unique_lock<std::mutex> l(m_mutex);
 
 		// there's nothing stored in the part_file. Nothing to do
-		if (m_piece_map.empty()) return;
+		if (m_num_pieces == 0) return;
 
 		piece_index_t piece(int(offset / m_piece_size));
 		piece_index_t const end = piece_index_t(int(((offset + size) + m_piece_size - 1) / m_piece_size));
@@ -325,11 +375,10 @@ namespace libtorrent::aux {
 
 		for (; piece < end; ++piece)
 		{
-			auto const i = m_piece_map.find(piece);
+			slot_index_t const slot = m_piece_map[piece];
 			int const block_to_copy = int(std::min(m_piece_size - piece_offset, size));
-			if (i != m_piece_map.end())
+			if (slot != slot_index_t(-1))
 			{
-				slot_index_t const slot = i->second;
 
 				if (!buf) buf.reset(new char[std::size_t(m_piece_size)]);
 
@@ -351,17 +400,17 @@ namespace libtorrent::aux {
 				if (block_to_copy == m_piece_size)
 				{
 					// since we released the lock, it's technically possible that
-					// another thread removed this slot map entry, and invalidated
-					// our iterator. Now that we hold the lock again, perform
-					// another lookup to be sure.
-					auto const j = m_piece_map.find(piece);
-					if (j != m_piece_map.end())
+					// another thread removed this slot map entry. Now that we
+					// hold the lock again, perform another lookup to be sure.
+					slot_index_t const current = m_piece_map[piece];
+					if (current != slot_index_t(-1))
 					{
 						// if the slot moved, that's really suspicious
-						TORRENT_ASSERT(j->second == slot);
-						m_free_slots.push_back(j->second);
-						m_piece_map.erase(j);
-						m_dirty_metadata = true;
+						TORRENT_ASSERT(current == slot);
+						m_free_slots.push_back(current);
+						m_piece_map[piece] = slot_index_t(-1);
+						--m_num_pieces;
+						set_dirty(piece);
 					}
 				}
 			}
@@ -378,14 +427,12 @@ namespace libtorrent::aux {
 		flush_metadata_impl(ec);
 	}
 
-	// TODO: instead of rebuilding the whole file header
-	// and flushing it, update the slot entries as we go
 	void part_file::flush_metadata_impl(error_code& ec)
 	{
 		// do we need to flush the metadata?
 		if (m_dirty_metadata == false) return;
 
-		if (m_piece_map.empty())
+		if (m_num_pieces == 0)
 		{
 			// if we don't have any pieces left in the
 			// part file, remove it
@@ -394,31 +441,70 @@ namespace libtorrent::aux {
 
 			if (ec == boost::system::errc::no_such_file_or_directory)
 				ec.clear();
+
+			// if the file is created again, it starts out empty, without a
+			// header
+			m_free_slots.clear();
+			m_num_allocated = slot_index_t(0);
+			m_num_reserved = slot_index_t(0);
+			m_header_on_disk = false;
 			return;
 		}
 
 		auto f = open_file(aux::open_mode::write | aux::open_mode::hidden, ec);
 		if (ec) return;
 
-		std::vector<char> header(static_cast<std::size_t>(m_header_size));
+		// a new file needs the whole header, not just the entries that
+		// changed. Its unwritten parts would otherwise read back as slot 0
+		if (!m_header_on_disk) m_dirty_blocks.set_all();
 
 		using namespace libtorrent::aux;
 
-		char* ptr = header.data();
-		write_uint32(m_max_pieces, ptr);
-		write_uint32(m_piece_size, ptr);
-
-		for (piece_index_t piece(0); piece < piece_index_t(m_max_pieces); ++piece)
+		// write every contiguous run of dirty blocks with a single call
+		std::vector<char> header;
+		int const num_blocks = m_dirty_blocks.size();
+		for (int block = 0; block < num_blocks;)
 		{
-			auto const i = m_piece_map.find(piece);
-			slot_index_t const slot(i == m_piece_map.end()
-				? slot_index_t(-1) : i->second);
-			write_int32(static_cast<int>(slot), ptr);
+			if (!m_dirty_blocks.get_bit(block))
+			{
+				++block;
+				continue;
+			}
+			int end_block = block + 1;
+			while (end_block < num_blocks && m_dirty_blocks.get_bit(end_block))
+				++end_block;
+
+			header.resize(static_cast<std::size_t>((end_block - block) * header_block_size));
+			char* ptr = header.data();
+
+			// the slot entries are 4 bytes and aligned, so they never straddle
+			// two blocks
+			piece_index_t first(0);
+			if (block == 0)
+			{
+				write_uint32(m_max_pieces, ptr);
+				write_uint32(m_piece_size, ptr);
+			}
+			else
+			{
+				first = piece_index_t((block * header_block_size - slots_offset) / 4);
+			}
+			piece_index_t const last(std::min(m_max_pieces
+				, (end_block * header_block_size - slots_offset) / 4));
+
+			for (piece_index_t piece = first; piece < last; ++piece)
+				write_int32(static_cast<int>(m_piece_map[piece]), ptr);
+
+			std::memset(ptr, 0, std::size_t(int(header.size()) - (ptr - header.data())));
+			iovec_t b = header;
+			f.writev(std::int64_t(block) * header_block_size, b, ec);
+			if (ec) return;
+
+			block = end_block;
 		}
-		std::memset(ptr, 0, std::size_t(m_header_size - (ptr - header.data())));
-		iovec_t b = header;
-		f.writev(0, b, ec);
-		if (ec) return;
+
+		m_dirty_blocks.clear_all();
+		m_header_on_disk = true;
 		m_dirty_metadata = false;
 	}
 }
@@ -83,6 +83,7 @@ see LICENSE file.
 // linux specifics
 
 #include <sys/ioctl.h>
+#include <linux/fs.h> // for FICLONE
 
 #elif defined __APPLE__ && defined __MACH__ && MAC_OS_X_VERSION_MIN_REQUIRED >= 1050
 // mac specifics
@@ -474,6 +475,13 @@ namespace {
 	}
 
 	void copy_file(std::string const& inf, std::string const& newf, error_code& ec)
+	{
+		copy_file(inf, newf, 0, {}, ec);
+	}
+
+	void copy_file(std::string const& inf, std::string const& newf
+		, std::int64_t const offset, std::function<void(std::int64_t)> const& progress
+		, error_code& ec)
 	{
 		ec.clear();
 		native_path_string f1 = convert_to_native_path_string(inf);
@@ -481,10 +489,14 @@ namespace {
 
 #ifdef TORRENT_WINDOWS
 
+		TORRENT_UNUSED(offset);
+		TORRENT_UNUSED(progress);
 		if (CopyFileW(f1.c_str(), f2.c_str(), false) == 0)
 			ec.assign(GetLastError(), system_category());
 
 #elif defined __APPLE__ && defined __MACH__ && MAC_OS_X_VERSION_MIN_REQUIRED >= 1050
+		TORRENT_UNUSED(offset);
+		TORRENT_UNUSED(progress);
 		// this only works on 10.5
 		copyfile_state_t state = copyfile_state_alloc();
 		if (copyfile(f1.c_str(), f2.c_str(), state, COPYFILE_ALL) < 0)
@@ -511,24 +523,95 @@ namespace {
 			ec.assign(errno, system_category());
 			return;
 		}
-		char buffer[4096];
-		for (;;)
+
+		// anything past offset may be the partial result of a write that was
+		// interrupted
+		if (::ftruncate(outfd, offset) < 0)
+		{
+			ec.assign(errno, system_category());
+			close(infd);
+			close(outfd);
+			return;
+		}
+
+		std::int64_t pos = offset;
+		bool done = false;
+
+#ifdef FICLONE
+		// if both files are on the same file system (e.g. different subvolumes
+		// of a btrfs file system), the copy can share the source's extents
+		// instead of copying any data
+		if (offset == 0 && ::ioctl(outfd, FICLONE, infd) == 0)
+		{
+			struct ::stat st;
+			if (progress && ::fstat(infd, &st) == 0) progress(std::int64_t(st.st_size));
+			done = true;
+		}
+#endif
+
+#if TORRENT_USE_COPY_FILE_RANGE
+		while (!done)
 		{
-			int const num_read = int(read(infd, buffer, sizeof(buffer)));
-			if (num_read == 0) break;
-			if (num_read < 0)
+			loff_t in_pos = pos;
+			loff_t out_pos = pos;
+			ssize_t const ret = ::copy_file_range(infd, &in_pos, outfd, &out_pos
+				, 4 * 1024 * 1024, 0);
+			if (ret == 0)
 			{
-				ec.assign(errno, system_category());
+				done = true;
 				break;
 			}
-			int const num_written = int(write(outfd, buffer, std::size_t(num_read)));
-			if (num_written < num_read)
+			if (ret < 0)
 			{
+				// older kernels don't support copying across file systems, fall
+				// back to copying in user space
+				if (errno == EXDEV || errno == EINVAL || errno == ENOSYS
+					|| errno == EOPNOTSUPP)
+					break;
 				ec.assign(errno, system_category());
+				done = true;
 				break;
 			}
-			if (num_read < int(sizeof(buffer))) break;
+			pos += ret;
+			if (progress) progress(std::int64_t(ret));
+		}
+#endif
+
+		if (!done)
+		{
+			std::size_t const buffer_size = 256 * 1024;
+			std::unique_ptr<char[]> buffer(new char[buffer_size]);
+			for (;;)
+			{
+				auto const num_read = ::pread(infd, buffer.get(), buffer_size, pos);
+				if (num_read == 0) break;
+				if (num_read < 0)
+				{
+					ec.assign(errno, system_category());
+					break;
+				}
+				auto const num_written = ::pwrite(outfd, buffer.get()
+					, std::size_t(num_read), pos);
+				if (num_written < 0)
+				{
+					ec.assign(errno, system_category());
+					break;
+				}
+				// in case of a short write, the rest is read again
+				pos += num_written;
+				if (progress) progress(std::int64_t(num_written));
+			}
 		}
+
+		// the copy is typically renamed into place once complete. Make sure
+		// its content is on disk before that, or a crash could leave a
+		// truncated file under the final name
+#if TORRENT_USE_FDATASYNC
+		if (!ec && ::fdatasync(outfd) != 0)
+#else
+		if (!ec && ::fsync(outfd) != 0)
+#endif
+			ec.assign(errno, system_category());
 		close(infd);
 		close(outfd);
 #endif // TORRENT_WINDOWS
@@ -258,11 +258,28 @@ namespace {
 		void async_move_storage(storage_index_t const storage, std::string p
 			, move_flags_t const flags
 			, std::function<void(status_t, std::string const&, storage_error const&)> handler) override
+		{
+			async_move_storage_progress(storage, std::move(p), flags, std::move(handler), {});
+		}
+
+		void async_move_storage_progress(storage_index_t const storage, std::string p
+			, move_flags_t const flags
+			, std::function<void(status_t, std::string const&, storage_error const&)> handler
+			, std::function<void(std::int64_t, std::int64_t)> progress) override
 		{
 			posix_storage* st = m_torrents[storage].get();
 			storage_error ec;
 			status_t ret;
-			std::tie(ret, p) = st->move_storage(p, flags, ec);
+			std::function<void(std::int64_t, std::int64_t)> report;
+			if (progress)
+			{
+				report = [this, &progress](std::int64_t const copied, std::int64_t const total)
+				{
+					post(m_ios, [progress, copied, total] { progress(copied, total); });
+				};
+			}
+			std::tie(ret, p) = st->move_storage(p, flags
+				, m_settings.get_int(settings_pack::move_storage_threads), report, ec);
 			post(m_ios, [=, h = std::move(handler)]{ h(ret, p, ec); });
 		}
 
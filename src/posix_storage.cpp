@@ -312,11 +312,14 @@ namespace aux {
 		// release the underlying part file. Otherwise we may not be able to
 		// delete it
 		if (m_part_file) m_part_file.reset();
+
 		aux::delete_files(files(), m_save_path, m_part_file_name, options, error);
 	}
 
 	std::pair<status_t, std::string> posix_storage::move_storage(std::string const& sp
-		, move_flags_t const flags, storage_error& ec)
+		, move_flags_t const flags, int const copy_threads
+		, std::function<void(std::int64_t, std::int64_t)> const& progress
+		, storage_error& ec)
 	{
 		lt::status_t ret;
 		auto move_partfile = [&](std::string const& new_save_path, error_code& e)
@@ -325,7 +328,7 @@ namespace aux {
 			m_part_file->move_partfile(new_save_path, e);
 		};
 		std::tie(ret, m_save_path) = aux::move_storage(files(), m_save_path, sp
-			, std::move(move_partfile), flags, ec);
+			, std::move(move_partfile), flags, copy_threads, progress, ec);
 
 		// clear the stat cache in case the new location has new files
 		m_stat_cache.clear();
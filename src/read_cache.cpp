@@ -0,0 +1,257 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "libtorrent/aux_/read_cache.hpp"
+#include "libtorrent/assert.hpp"
+
+namespace libtorrent::aux {
+
+	read_cache::read_cache(int const max_blocks)
+		: m_max_blocks(std::max(0, max_blocks))
+	{}
+
+	int read_cache::set_max_size(int const blocks)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		m_max_blocks = std::max(0, blocks);
+		int const ret = make_room();
+		if (m_max_blocks == 0)
+		{
+			m_a1out.clear();
+			m_ghosts.clear();
+		}
+		return ret;
+	}
+
+	int read_cache::max_size() const
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		return m_max_blocks;
+	}
+
+	int read_cache::size() const
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		return m_num_blocks;
+	}
+
+	read_cache::cached_piece* read_cache::find_range(storage_index_t const st
+		, piece_index_t const piece, int const start, int const length)
+	{
+		TORRENT_ASSERT(start >= 0);
+		TORRENT_ASSERT(length > 0);
+		auto const it = m_pieces.find({st, piece});
+		if (it == m_pieces.end()) return nullptr;
+
+		cached_piece& p = it->second;
+		int const first = start / default_block_size;
+		int const last = (start + length - 1) / default_block_size;
+		TORRENT_ASSERT(last - first <= 1);
+		if (last >= int(p.blocks.size())) return nullptr;
+		for (int i = first; i <= last; ++i)
+			if (!p.blocks[std::size_t(i)]) return nullptr;
+
+		// hits in A1in don't count as re-use. Those are most likely correlated
+		// references, i.e. the same peer reading the next block of a piece
+		if (p.queue == queue_t::am)
+			m_am.splice(m_am.begin(), m_am, p.lru);
+		return &p;
+	}
+
+	bool read_cache::has_block(storage_index_t const st, piece_index_t const piece
+		, int const offset) const
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		auto const it = m_pieces.find({st, piece});
+		if (it == m_pieces.end()) return false;
+		auto const block = std::size_t(offset / default_block_size);
+		return block < it->second.blocks.size() && it->second.blocks[block];
+	}
+
+	std::uint32_t read_cache::begin_fill(storage_index_t const st, piece_index_t const piece)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		fill_state& f = m_filling[{st, piece}];
+		++f.refs;
+		return f.generation;
+	}
+
+	void read_cache::cancel_fill(storage_index_t const st, piece_index_t const piece)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		auto const it = m_filling.find({st, piece});
+		TORRENT_ASSERT(it != m_filling.end());
+		if (it == m_filling.end()) return;
+		if (--it->second.refs == 0) m_filling.erase(it);
+	}
+
+	int read_cache::insert(storage_index_t const st, piece_index_t const piece
+		, int const first_block, int const blocks_in_piece
+		, span<buffer_t> const blocks, std::uint32_t const token)
+	{
+		TORRENT_ASSERT(first_block >= 0);
+		TORRENT_ASSERT(first_block + int(blocks.size()) <= blocks_in_piece);
+
+		cached_piece_key const key{st, piece};
+		std::lock_guard<std::mutex> l(m_mutex);
+
+		auto const fill = m_filling.find(key);
+		TORRENT_ASSERT(fill != m_filling.end());
+		if (fill == m_filling.end()) return 0;
+		bool const stale = fill->second.generation != token;
+		if (--fill->second.refs == 0) m_filling.erase(fill);
+
+		if (stale || m_max_blocks == 0) return 0;
+
+		auto it = m_pieces.find(key);
+		if (it == m_pieces.end())
+		{
+			cached_piece p;
+			auto const ghost = m_ghosts.find(key);
+			if (ghost != m_ghosts.end())
+			{
+				// this piece was evicted from A1in recently. It's popular enough
+				// to go in the main LRU
+				m_a1out.erase(ghost->second);
+				m_ghosts.erase(ghost);
+				p.queue = queue_t::am;
+			}
+			p.blocks.resize(std::size_t(blocks_in_piece));
+			auto& q = queue(p.queue);
+			q.push_front(key);
+			p.lru = q.begin();
+			it = m_pieces.emplace(key, std::move(p)).first;
+		}
+		else if (it->second.queue == queue_t::am)
+		{
+			m_am.splice(m_am.begin(), m_am, it->second.lru);
+		}
+
+		cached_piece& p = it->second;
+		TORRENT_ASSERT(int(p.blocks.size()) == blocks_in_piece);
+		for (int i = 0; i < int(blocks.size()); ++i)
+		{
+			auto& slot = p.blocks[std::size_t(first_block + i)];
+			auto& b = blocks[i];
+			if (!b || slot) continue;
+			slot = std::move(b);
+			++p.num_blocks;
+			++m_num_blocks;
+			if (p.queue == queue_t::a1in) ++m_a1in_blocks;
+		}
+
+		return make_room();
+	}
+
+	int read_cache::make_room()
+	{
+		int ret = 0;
+		while (m_num_blocks > m_max_blocks)
+		{
+			TORRENT_ASSERT(!m_a1in.empty() || !m_am.empty());
+			if (!m_a1in.empty() && (m_a1in_blocks > m_max_blocks / 4 || m_am.empty()))
+			{
+				cached_piece_key const key = m_a1in.back();
+				ret += evict_piece_impl(key);
+				add_ghost(key);
+			}
+			else
+			{
+				ret += evict_piece_impl(m_am.back());
+			}
+		}
+		return ret;
+	}
+
+	void read_cache::add_ghost(cached_piece_key const& key)
+	{
+		if (m_ghosts.count(key)) return;
+		m_a1out.push_front(key);
+		m_ghosts.emplace(key, m_a1out.begin());
+
+		// the ghost queue only holds keys, but is bounded to keep it from
+		// growing without limit. Pieces are typically many blocks, so this
+		// remembers a lot more pieces than fit in the cache
+		std::size_t const limit = std::size_t(std::max(1, m_max_blocks / 2));
+		while (m_a1out.size() > limit)
+		{
+			m_ghosts.erase(m_a1out.back());
+			m_a1out.pop_back();
+		}
+	}
+
+	int read_cache::evict_piece_impl(cached_piece_key const& key)
+	{
+		auto const it = m_pieces.find(key);
+		if (it == m_pieces.end()) return 0;
+		cached_piece& p = it->second;
+		int const ret = p.num_blocks;
+		m_num_blocks -= ret;
+		if (p.queue == queue_t::a1in) m_a1in_blocks -= ret;
+		queue(p.queue).erase(p.lru);
+		m_pieces.erase(it);
+		TORRENT_ASSERT(m_num_blocks >= 0);
+		TORRENT_ASSERT(m_a1in_blocks >= 0);
+		return ret;
+	}
+
+	void read_cache::invalidate_fill(cached_piece_key const& key)
+	{
+		auto const it = m_filling.find(key);
+		if (it != m_filling.end()) ++it->second.generation;
+	}
+
+	int read_cache::evict_piece(storage_index_t const st, piece_index_t const piece)
+	{
+		cached_piece_key const key{st, piece};
+		std::lock_guard<std::mutex> l(m_mutex);
+		invalidate_fill(key);
+		return evict_piece_impl(key);
+	}
+
+	int read_cache::evict_storage(storage_index_t const st)
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		for (auto& f : m_filling)
+			if (f.first.storage == st) ++f.second.generation;
+
+		std::vector<cached_piece_key> to_evict;
+		for (auto const& p : m_pieces)
+			if (p.first.storage == st) to_evict.push_back(p.first);
+
+		int ret = 0;
+		for (auto const& key : to_evict)
+			ret += evict_piece_impl(key);
+
+		// the storage index may be re-used by another torrent, forget
+		// everything about this one
+		for (auto i = m_a1out.begin(); i != m_a1out.end();)
+		{
+			if (i->storage != st) { ++i; continue; }
+			m_ghosts.erase(*i);
+			i = m_a1out.erase(i);
+		}
+		return ret;
+	}
+
+	int read_cache::clear()
+	{
+		std::lock_guard<std::mutex> l(m_mutex);
+		for (auto& f : m_filling) ++f.second.generation;
+		int const ret = m_num_blocks;
+		m_pieces.clear();
+		m_a1in.clear();
+		m_am.clear();
+		m_a1out.clear();
+		m_ghosts.clear();
+		m_num_blocks = 0;
+		m_a1in_blocks = 0;
+		return ret;
+	}
+}
@@ -20,6 +20,7 @@ namespace libtorrent::aux {
 		, m_critical_resolver(ios)
 		, m_max_size(700)
 		, m_timeout(seconds(1200))
+		, m_builtin(ios)
 	{}
 
 	void resolver::callback(resolver_interface::callback_t h
@@ -75,6 +76,12 @@ namespace libtorrent::aux {
 	void resolver::async_resolve(std::string const& host, resolver_flags const flags
 		, resolver_interface::callback_t h)
 	{
+		if (m_use_builtin)
+		{
+			m_builtin.async_resolve(host, flags, std::move(h));
+			return;
+		}
+
 		// special handling for raw IP addresses. There's no need to get in line
 		// behind actual lookups if we can just resolve it immediately.
 		error_code ec;
@@ -135,6 +142,19 @@ namespace libtorrent::aux {
 	void resolver::abort()
 	{
 		m_resolver.cancel();
+		m_builtin.abort();
+	}
+
+	void resolver::use_builtin(bool const enable, std::vector<udp::endpoint> servers)
+	{
+#ifdef TORRENT_WINDOWS
+		// there is no resolv.conf to find the name servers in, without any
+		// configured ones the system resolver is the only one that works
+		m_use_builtin = enable && !servers.empty();
+#else
+		m_use_builtin = enable;
+#endif
+		m_builtin.set_servers(std::move(servers));
 	}
 
 	void resolver::set_cache_timeout(seconds const timeout)
@@ -143,5 +163,6 @@ namespace libtorrent::aux {
 			m_timeout = timeout;
 		else
 			m_timeout = seconds(0);
+		m_builtin.set_cache_timeout(timeout);
 	}
 }
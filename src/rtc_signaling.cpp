@@ -20,12 +20,19 @@ see LICENSE file.
 #include "libtorrent/aux_/rtc_signaling.hpp"
 #include "libtorrent/aux_/rtc_stream.hpp"
 #include "libtorrent/aux_/session_interface.hpp"
+#include "libtorrent/aux_/session_settings.hpp"
+#include "libtorrent/aux_/ffs.hpp"
 #include "libtorrent/aux_/generate_peer_id.hpp"
+#include "libtorrent/hex.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/string_view.hpp"
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <rtc/rtc.hpp>
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cstdarg>
 #include <utility>
 #include <sstream>
@@ -47,6 +54,88 @@ namespace {
 
 template <class T> std::weak_ptr<T> make_weak_ptr(std::shared_ptr<T> ptr) { return ptr; }
 
+rtc_offer_id random_offer_id()
+{
+	rtc_offer_id id;
+	aux::random_bytes({id.data(), int(id.size())});
+	return id;
+}
+
+rtc::Configuration make_configuration(session_settings const& sett)
+{
+	rtc::Configuration config;
+	std::string stun_server = sett.get_str(settings_pack::webtorrent_stun_server);
+	if (!stun_server.empty())
+		config.iceServers.emplace_back(std::move(stun_server));
+
+	return config;
+}
+
+time_duration connection_timeout(session_settings const& sett)
+{
+	int const timeout = sett.get_int(settings_pack::webtorrent_connection_timeout);
+	return seconds(std::max(timeout, 1));
+}
+
+void record_generation_time(counters& cnt, time_point const start_time)
+{
+	cnt.inc_stats_counter(counters::rtc_offers_generated);
+	cnt.inc_stats_counter(counters::rtc_offer_generation_time
+		, total_microseconds(clock_type::now() - start_time));
+}
+
+void record_connect_time(counters& cnt, time_duration const duration)
+{
+	cnt.inc_stats_counter(counters::rtc_data_channels_opened);
+	cnt.inc_stats_counter(counters::rtc_data_channel_open_time, total_microseconds(duration));
+
+	int const index = std::min(aux::log2p1(std::uint32_t(std::max(
+		total_milliseconds(duration), std::int64_t(0)) >> 5)), 10);
+	cnt.inc_stats_counter(counters::rtc_connect_time5 + index);
+}
+
+// session-level SDP attributes used to share PeerConnections between
+// torrents. Clients which don't know them ignore them.
+string_view const transport_attribute = "a=x-libtorrent-transport:";
+string_view const shared_attribute = "a=x-libtorrent-shared";
+string_view const fingerprint_attribute = "a=fingerprint:";
+
+// returns the value of the given attribute, or an empty string if the
+// session description doesn't have it
+std::string find_attribute(std::string const& sdp, string_view attribute)
+{
+	auto pos = sdp.find(attribute.data(), 0, attribute.size());
+	if (pos == std::string::npos) return {};
+
+	pos += attribute.size();
+	auto const end = sdp.find_first_of("\r\n", pos);
+	return sdp.substr(pos, end == std::string::npos ? end : end - pos);
+}
+
+bool has_attribute(std::string const& sdp, string_view attribute)
+{
+	return sdp.find(attribute.data(), 0, attribute.size()) != std::string::npos;
+}
+
+// inserts a session-level attribute, i.e. before the first media section
+void add_attribute(std::string& sdp, string_view attribute, string_view value = {})
+{
+	std::string line;
+	line.append(attribute.data(), attribute.size());
+	line.append(value.data(), value.size());
+	line.append("\r\n");
+
+	auto const pos = sdp.find("\r\nm=");
+	if (pos != std::string::npos)
+	{
+		sdp.insert(pos + 2, line);
+		return;
+	}
+
+	if (!sdp.empty() && sdp.back() != '\n') sdp.append("\r\n");
+	sdp.append(line);
+}
+
 #if DEBUG_RTC
 class plog_appender : public plog::IAppender
 {
@@ -128,9 +217,7 @@ void rtc_signaling::close()
 
 rtc_offer_id rtc_signaling::generate_offer_id() const
 {
-	rtc_offer_id id;
-	aux::random_bytes({id.data(), int(id.size())});
-	return id;
+	return random_offer_id();
 }
 
 void rtc_signaling::generate_offers(int count, offers_handler handler)
@@ -139,11 +226,25 @@ void rtc_signaling::generate_offers(int count, offers_handler handler)
 	debug_log("*** RTC signaling generating %d offers", count);
 #endif
 	m_offer_batches.push({count, std::move(handler)});
+	auto& pool = m_torrent->session().rtc_offers();
 	while (count--)
 	{
-		rtc_offer_id offer_id = generate_offer_id();
 		peer_id pid = aux::generate_peer_id(m_torrent->settings());
 
+		if (auto pregenerated = pool.take())
+		{
+			rtc_offer offer{pregenerated->id, std::move(pid), std::move(pregenerated->sdp), {}};
+			adopt_connection(std::move(*pregenerated));
+			post(m_io_context, std::bind(&rtc_signaling::on_generated_offer
+				, shared_from_this()
+				, error_code{}
+				, std::move(offer)
+			));
+			continue;
+		}
+
+		rtc_offer_id offer_id = generate_offer_id();
+
 		auto& conn = create_connection(offer_id, [weak_this = weak_from_this(), offer_id, pid]
 			(error_code const& ec, std::string sdp)
 		{
@@ -159,26 +260,35 @@ void rtc_signaling::generate_offers(int count, offers_handler handler)
 			));
 		});
 
-		auto dc = conn.peer_connection->createDataChannel("webtorrent");
-		dc->onOpen([weak_this = weak_from_this(), offer_id, weak_dc = make_weak_ptr(dc)]()
-		{
-			// Warning: this is called from another thread
-			auto self = weak_this.lock();
-			auto dc_ = weak_dc.lock();
-			if (!self || !dc_) return;
+		conn.start_time = clock_type::now();
+		set_data_channel(conn, offer_id, conn.peer_connection->createDataChannel("webtorrent"));
+	}
 
-			auto& io_context = self->m_io_context;
-			post(io_context, std::bind(&rtc_signaling::on_data_channel
-				, std::move(self)
-				, error_code{}
-				, std::move(offer_id)
-				, std::move(dc_)
-			));
-		});
+	// Replace the offers we took
+	pool.refill();
+}
 
-		// We need to maintain the DataChannel alive
-		conn.data_channel = std::move(dc);
-	}
+void rtc_signaling::set_data_channel(connection& conn, rtc_offer_id const& offer_id
+	, std::shared_ptr<rtc::DataChannel> dc)
+{
+	dc->onOpen([weak_this = weak_from_this(), offer_id, weak_dc = make_weak_ptr(dc)]()
+	{
+		// Warning: this is called from another thread
+		auto self = weak_this.lock();
+		auto dc_ = weak_dc.lock();
+		if (!self || !dc_) return;
+
+		auto& io_context = self->m_io_context;
+		post(io_context, std::bind(&rtc_signaling::on_data_channel
+			, std::move(self)
+			, error_code{}
+			, std::move(offer_id)
+			, std::move(dc_)
+		));
+	});
+
+	// We need to maintain the DataChannel alive
+	conn.data_channel = std::move(dc);
 }
 
 void rtc_signaling::process_offer(rtc_offer const& offer)
@@ -191,6 +301,10 @@ void rtc_signaling::process_offer(rtc_offer const& offer)
 #ifndef TORRENT_DISABLE_LOGGING
 	debug_log("*** RTC signaling processing remote offer");
 #endif
+	std::string remote_id = parse_transport_id(offer.sdp);
+	if (!remote_id.empty() && share_connection(offer, remote_id))
+		return;
+
 	auto& conn = create_connection(offer.id, [weak_this = weak_from_this(), offer]
 		(error_code const& ec, std::string sdp)
 	{
@@ -208,6 +322,9 @@ void rtc_signaling::process_offer(rtc_offer const& offer)
 	});
 
 	conn.pid = offer.pid;
+	conn.remote_transport_id = std::move(remote_id);
+	conn.remote_fingerprint = find_attribute(offer.sdp, fingerprint_attribute);
+	conn.negotiation_time = clock_type::now();
 
 	try {
 		conn.peer_connection->setRemoteDescription({offer.sdp, "offer"});
@@ -238,6 +355,26 @@ void rtc_signaling::process_answer(rtc_answer const& answer)
 	}
 
 	conn.pid = answer.pid;
+	conn.negotiation_time = clock_type::now();
+
+	if (conn.offer_time)
+	{
+		auto& cnt = m_torrent->session().stats_counters();
+		cnt.inc_stats_counter(counters::rtc_answers_received);
+		cnt.inc_stats_counter(counters::rtc_answer_time
+			, total_microseconds(*conn.negotiation_time - *conn.offer_time));
+	}
+
+	std::string remote_id = parse_transport_id(answer.sdp);
+	if (!remote_id.empty() && has_attribute(answer.sdp, shared_attribute))
+	{
+		on_shared_answer(conn, answer.offer_id, remote_id
+			, find_attribute(answer.sdp, fingerprint_attribute));
+		return;
+	}
+
+	conn.remote_transport_id = std::move(remote_id);
+	conn.remote_fingerprint = find_attribute(answer.sdp, fingerprint_attribute);
 
 	try {
 		conn.peer_connection->setRemoteDescription({answer.sdp, "answer"});
@@ -258,12 +395,7 @@ rtc_signaling::connection& rtc_signaling::create_connection(rtc_offer_id const&
 	debug_log("*** RTC signaling creating connection");
 #endif
 
-	rtc::Configuration config;
-	std::string stun_server = m_torrent->settings().get_str(settings_pack::webtorrent_stun_server);
-	if (!stun_server.empty())
-		config.iceServers.emplace_back(std::move(stun_server));
-
-	auto pc = std::make_shared<rtc::PeerConnection>(config);
+	auto pc = std::make_shared<rtc::PeerConnection>(make_configuration(m_torrent->settings()));
 	pc->onStateChange([weak_this = weak_from_this(), weak_pc = make_weak_ptr(pc), offer_id, handler]
 		(rtc::PeerConnection::State state)
 	{
@@ -272,7 +404,16 @@ rtc_signaling::connection& rtc_signaling::create_connection(rtc_offer_id const&
 		auto pc_ = weak_pc.lock();
 		if (!self || !pc_) return;
 
-		if (state == rtc::PeerConnection::State::Failed)
+		if (state == rtc::PeerConnection::State::Connected)
+		{
+			auto& io_context = self->m_io_context;
+			post(io_context, std::bind(&rtc_signaling::on_connected
+				, std::move(self)
+				, offer_id
+				, clock_type::now()
+			));
+		}
+		else if (state == rtc::PeerConnection::State::Failed)
 		{
 			error_code const ec = boost::asio::error::connection_refused;
 			auto& io_context = self->m_io_context;
@@ -322,11 +463,57 @@ rtc_signaling::connection& rtc_signaling::create_connection(rtc_offer_id const&
 		));
 	});
 
-	int const connection_timeout = m_torrent->settings().get_int(settings_pack::webtorrent_connection_timeout);
-	time_duration const timeout = seconds(std::max(connection_timeout, 1));
+	return add_connection(offer_id, std::move(pc));
+}
+
+rtc_signaling::connection& rtc_signaling::adopt_connection(rtc_pregenerated_offer offer)
+{
+#ifndef TORRENT_DISABLE_LOGGING
+	debug_log("*** RTC signaling taking pre-generated offer");
+#endif
+
+	// The pool's callbacks are replaced, this connection now belongs to us.
+	// ICE gathering is already complete, so only failure matters.
+	auto& pc = offer.peer_connection;
+	pc->onStateChange([weak_this = weak_from_this(), offer_id = offer.id]
+		(rtc::PeerConnection::State state)
+	{
+		// Warning: this is called from another thread
+		auto self = weak_this.lock();
+		if (!self) return;
+
+		if (state == rtc::PeerConnection::State::Connected)
+		{
+			auto& io_context = self->m_io_context;
+			post(io_context, std::bind(&rtc_signaling::on_connected
+				, std::move(self)
+				, offer_id
+				, clock_type::now()
+			));
+		}
+		else if (state == rtc::PeerConnection::State::Failed)
+		{
+			auto& io_context = self->m_io_context;
+			post(io_context, std::bind(&rtc_signaling::on_data_channel
+				, std::move(self)
+				, boost::asio::error::connection_refused
+				, std::move(offer_id)
+				, nullptr
+			));
+		}
+	});
+
+	auto& conn = add_connection(offer.id, std::move(pc));
+	set_data_channel(conn, offer.id, std::move(offer.data_channel));
+	return conn;
+}
+
+rtc_signaling::connection& rtc_signaling::add_connection(rtc_offer_id const& offer_id
+	, std::shared_ptr<rtc::PeerConnection> pc)
+{
 	connection conn(m_io_context);
 	conn.peer_connection = std::move(pc);
-	conn.timer.expires_after(timeout);
+	conn.timer.expires_after(connection_timeout(m_torrent->settings()));
 	conn.timer.async_wait(std::bind(&rtc_signaling::on_data_channel
 		, shared_from_this()
 		, boost::asio::error::timed_out
@@ -343,6 +530,17 @@ void rtc_signaling::on_generated_offer(error_code const& ec, rtc_offer offer)
 #ifndef TORRENT_DISABLE_LOGGING
 	debug_log("*** RTC signaling generated offer");
 #endif
+	if (auto it = m_connections.find(offer.id); !ec && it != m_connections.end())
+	{
+		connection& conn = it->second;
+		if (conn.start_time)
+			record_generation_time(m_torrent->session().stats_counters(), *conn.start_time);
+		conn.offer_time = clock_type::now();
+	}
+
+	if (!ec && m_torrent->settings().get_bool(settings_pack::webtorrent_share_connections))
+		add_attribute(offer.sdp, transport_attribute, m_torrent->session().rtc_transports().local_id());
+
 	while (!m_offer_batches.empty() && m_offer_batches.front().is_complete())
 		m_offer_batches.pop();
 
@@ -360,6 +558,12 @@ void rtc_signaling::on_generated_answer(error_code const& ec, rtc_answer answer,
 #ifndef TORRENT_DISABLE_LOGGING
 	debug_log("*** RTC signaling generated answer");
 #endif
+	if (m_torrent->settings().get_bool(settings_pack::webtorrent_share_connections)
+		&& !has_attribute(answer.sdp, transport_attribute))
+	{
+		add_attribute(answer.sdp, transport_attribute, m_torrent->session().rtc_transports().local_id());
+	}
+
 	TORRENT_ASSERT(offer.answer_callback);
 	peer_id pid = aux::generate_peer_id(m_torrent->settings());
 	offer.answer_callback(pid, answer);
@@ -375,20 +579,157 @@ void rtc_signaling::on_data_channel(error_code const& ec
 	connection conn = std::move(it->second);
 	m_connections.erase(it);
 
+	auto& session = m_torrent->session();
+	if (conn.shared) session.rtc_transports().cancel_channel(offer_id);
+
 	if (ec)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
-		debug_log("*** RTC negotiation failed");
+		debug_log("*** RTC negotiation failed: %s", ec.message().c_str());
 #endif
+		// offers nobody answered are not failures
+		if (conn.negotiation_time)
+		{
+			session.stats_counters().inc_stats_counter(ec == boost::asio::error::timed_out
+				? counters::rtc_connection_timeouts : counters::rtc_connection_failures);
+		}
 		return;
 	}
 
 #ifndef TORRENT_DISABLE_LOGGING
-	debug_log("*** RTC data channel open");
+	debug_log("*** RTC data channel open%s", conn.shared ? " on shared connection" : "");
 #endif
 
 	TORRENT_ASSERT(dc);
-	m_rtc_stream_handler(rtc_stream_init{conn.peer_connection, dc});
+	if (conn.negotiation_time)
+		record_connect_time(session.stats_counters(), clock_type::now() - *conn.negotiation_time);
+
+	if (conn.shared)
+		session.stats_counters().inc_stats_counter(counters::rtc_shared_connections);
+	else if (!conn.remote_transport_id.empty())
+		session.rtc_transports().add(conn.remote_transport_id, conn.remote_fingerprint
+			, conn.peer_connection);
+
+	auto const& sett = m_torrent->settings();
+	rtc_stream_init init{conn.peer_connection, dc};
+	init.send_buffer_low_watermark = std::size_t(std::max(0
+		, sett.get_int(settings_pack::webtorrent_send_buffer_low_watermark)));
+	init.send_buffer_high_watermark = std::size_t(std::max(0
+		, sett.get_int(settings_pack::webtorrent_send_buffer_high_watermark)));
+	init.stats_counters = &session.stats_counters();
+	m_rtc_stream_handler(std::move(init));
+}
+
+void rtc_signaling::on_connected(rtc_offer_id const& offer_id, time_point const connect_time)
+{
+	auto it = m_connections.find(offer_id);
+	if (it == m_connections.end()) return;
+
+	connection& conn = it->second;
+	if (conn.ice_connected || !conn.negotiation_time) return;
+	conn.ice_connected = true;
+
+#ifndef TORRENT_DISABLE_LOGGING
+	debug_log("*** RTC connection established");
+#endif
+
+	auto& cnt = m_torrent->session().stats_counters();
+	cnt.inc_stats_counter(counters::rtc_ice_connected);
+	cnt.inc_stats_counter(counters::rtc_ice_connect_time
+		, total_microseconds(connect_time - *conn.negotiation_time));
+}
+
+std::string rtc_signaling::parse_transport_id(std::string const& sdp) const
+{
+	if (!m_torrent->settings().get_bool(settings_pack::webtorrent_share_connections))
+		return {};
+
+	std::string id = find_attribute(sdp, transport_attribute);
+
+	// don't share connections with ourselves
+	if (id == m_torrent->session().rtc_transports().local_id())
+		return {};
+
+	return id;
+}
+
+bool rtc_signaling::share_connection(rtc_offer const& offer, std::string const& remote_id)
+{
+	auto& transports = m_torrent->session().rtc_transports();
+	auto pc = transports.find(remote_id, find_attribute(offer.sdp, fingerprint_attribute));
+	if (!pc) return false;
+
+	// the offerer checks our fingerprint the same way
+	auto const local = pc->localDescription();
+	std::string const fingerprint = local
+		? find_attribute(std::string(*local), fingerprint_attribute) : std::string();
+	if (fingerprint.empty()) return false;
+
+#ifndef TORRENT_DISABLE_LOGGING
+	debug_log("*** RTC signaling sharing an existing connection");
+#endif
+
+	// The offerer will open the DataChannel on the shared connection, the
+	// answer only tells it which connection to use
+	auto& conn = add_connection(offer.id, std::move(pc));
+	conn.pid = offer.pid;
+	conn.remote_transport_id = remote_id;
+	conn.shared = true;
+	conn.negotiation_time = clock_type::now();
+	transports.expect_channel(offer.id, weak_from_this(), conn.peer_connection);
+
+	std::string sdp = "v=0\r\n";
+	add_attribute(sdp, transport_attribute, transports.local_id());
+	add_attribute(sdp, fingerprint_attribute, fingerprint);
+	add_attribute(sdp, shared_attribute);
+
+	rtc_answer answer{offer.id, offer.pid, std::move(sdp)};
+	post(m_io_context, std::bind(&rtc_signaling::on_generated_answer
+		, shared_from_this()
+		, error_code{}
+		, std::move(answer)
+		, offer
+	));
+	return true;
+}
+
+void rtc_signaling::on_shared_answer(connection& conn, rtc_offer_id const& offer_id
+	, std::string const& remote_id, std::string const& fingerprint)
+{
+	std::shared_ptr<rtc::DataChannel> dc;
+	auto pc = m_torrent->session().rtc_transports().find(remote_id, fingerprint);
+	if (pc)
+	{
+		rtc::DataChannelInit init;
+		init.protocol = aux::to_hex(offer_id);
+		try {
+			dc = pc->createDataChannel("webtorrent", std::move(init));
+		}
+		catch (std::exception const& e) {
+#ifndef TORRENT_DISABLE_LOGGING
+			debug_log("*** Failed to open RTC data channel on shared connection: %s", e.what());
+#endif
+		}
+	}
+
+	if (!dc)
+	{
+#ifndef TORRENT_DISABLE_LOGGING
+		debug_log("*** Shared RTC connection is gone");
+#endif
+		m_connections.erase(offer_id);
+		return;
+	}
+
+#ifndef TORRENT_DISABLE_LOGGING
+	debug_log("*** RTC signaling opening data channel on shared connection");
+#endif
+
+	// This drops the PeerConnection created for the offer
+	conn.peer_connection = std::move(pc);
+	conn.remote_transport_id = remote_id;
+	conn.shared = true;
+	set_data_channel(conn, offer_id, std::move(dc));
 }
 
 rtc_signaling::offer_batch::offer_batch(int count, rtc_signaling::offers_handler handler)
@@ -411,6 +752,322 @@ bool rtc_signaling::offer_batch::is_complete() const
 	return int(m_offers.size()) == m_count;
 }
 
+rtc_offer_pool::rtc_offer_pool(io_context& ioc, session_settings const& settings, counters& cnt)
+	: m_io_context(ioc)
+	, m_settings(settings)
+	, m_stats_counters(cnt)
+{}
+
+rtc_offer_pool::~rtc_offer_pool()
+{
+	close();
+}
+
+void rtc_offer_pool::close()
+{
+	m_abort = true;
+	m_entries.clear();
+	m_ready.clear();
+	update_gauge();
+}
+
+std::optional<rtc_pregenerated_offer> rtc_offer_pool::take()
+{
+	// the pool is disabled, this is not a miss
+	if (m_entries.empty()
+		&& m_settings.get_int(settings_pack::webtorrent_offer_pool_size) <= 0)
+		return std::nullopt;
+
+	while (!m_ready.empty())
+	{
+		rtc_offer_id const offer_id = std::move(m_ready.front());
+		m_ready.pop_front();
+
+		auto it = m_entries.find(offer_id);
+		if (it == m_entries.end()) continue;
+
+		rtc_pregenerated_offer offer = std::move(it->second.offer);
+		m_entries.erase(it);
+		update_gauge();
+
+		m_stats_counters.inc_stats_counter(counters::rtc_offer_pool_hits);
+		return offer;
+	}
+
+	m_stats_counters.inc_stats_counter(counters::rtc_offer_pool_misses);
+	return std::nullopt;
+}
+
+void rtc_offer_pool::refill()
+{
+	if (m_abort) return;
+
+	trim();
+
+	int const pool_size = m_settings.get_int(settings_pack::webtorrent_offer_pool_size);
+	while (int(m_entries.size()) < pool_size)
+	{
+		rtc_offer_id const offer_id = random_offer_id();
+
+		auto pc = std::make_shared<rtc::PeerConnection>(make_configuration(m_settings));
+		pc->onStateChange([weak_this = weak_from_this(), offer_id]
+			(rtc::PeerConnection::State state)
+		{
+			// Warning: this is called from another thread
+			auto self = weak_this.lock();
+			if (!self) return;
+
+			if (state == rtc::PeerConnection::State::Failed)
+			{
+				auto& io_context = self->m_io_context;
+				post(io_context, std::bind(&rtc_offer_pool::on_generated
+					, std::move(self)
+					, boost::asio::error::connection_refused
+					, std::move(offer_id)
+					, std::string{}
+				));
+			}
+		});
+
+		pc->onGatheringStateChange([weak_this = weak_from_this(), weak_pc = make_weak_ptr(pc), offer_id]
+			(rtc::PeerConnection::GatheringState state)
+		{
+			// Warning: this is called from another thread
+			auto self = weak_this.lock();
+			auto pc_ = weak_pc.lock();
+			if (!self || !pc_) return;
+
+			if (state == rtc::PeerConnection::GatheringState::Complete)
+			{
+				auto& io_context = self->m_io_context;
+				std::string description = *pc_->localDescription();
+				post(io_context, std::bind(&rtc_offer_pool::on_generated
+					, std::move(self)
+					, error_code{}
+					, std::move(offer_id)
+					, std::move(description)
+				));
+			}
+		});
+
+		// Creating the DataChannel triggers ICE gathering
+		auto dc = pc->createDataChannel("webtorrent");
+
+		entry e(m_io_context);
+		e.offer = rtc_pregenerated_offer{offer_id, {}, std::move(pc), std::move(dc)};
+		e.start_time = clock_type::now();
+		e.timer.expires_after(connection_timeout(m_settings));
+		e.timer.async_wait([weak_this = weak_from_this(), offer_id](error_code const& ec)
+		{
+			if (auto self = weak_this.lock())
+				self->on_expired(ec, offer_id);
+		});
+
+		m_entries.emplace(offer_id, std::move(e));
+	}
+
+	update_gauge();
+}
+
+void rtc_offer_pool::trim()
+{
+	int const pool_size = std::max(0
+		, m_settings.get_int(settings_pack::webtorrent_offer_pool_size));
+	if (int(m_entries.size()) <= pool_size) return;
+
+	// drop the offers still gathering ICE candidates first, then the oldest
+	// ready ones
+	for (auto it = m_entries.begin(); it != m_entries.end()
+		&& int(m_entries.size()) > pool_size;)
+	{
+		if (it->second.offer.sdp.empty()) it = m_entries.erase(it);
+		else ++it;
+	}
+
+	while (int(m_entries.size()) > pool_size && !m_ready.empty())
+	{
+		m_entries.erase(m_ready.front());
+		m_ready.pop_front();
+	}
+
+	update_gauge();
+}
+
+void rtc_offer_pool::on_generated(error_code const& ec, rtc_offer_id offer_id, std::string sdp)
+{
+	auto it = m_entries.find(offer_id);
+	if (it == m_entries.end()) return;
+
+	if (ec)
+	{
+		// A failed offer is not replaced immediately, to avoid a busy loop
+		// if the network is down. The next take() will refill the pool.
+		remove(offer_id);
+		return;
+	}
+
+	entry& e = it->second;
+	if (!e.offer.sdp.empty()) return;
+
+	record_generation_time(m_stats_counters, e.start_time);
+
+	e.offer.sdp = std::move(sdp);
+	int const expiry = m_settings.get_int(settings_pack::webtorrent_offer_pool_expiry);
+	e.timer.expires_after(seconds(std::max(expiry, 1)));
+	e.timer.async_wait([weak_this = weak_from_this(), offer_id](error_code const& ec)
+	{
+		if (auto self = weak_this.lock())
+			self->on_expired(ec, offer_id);
+	});
+
+	m_ready.push_back(std::move(offer_id));
+}
+
+void rtc_offer_pool::on_expired(error_code const& ec, rtc_offer_id offer_id)
+{
+	// the timer was re-armed or the entry was taken
+	if (ec == boost::asio::error::operation_aborted) return;
+	if (m_entries.find(offer_id) == m_entries.end()) return;
+
+	remove(offer_id);
+	refill();
+}
+
+void rtc_offer_pool::remove(rtc_offer_id const& offer_id)
+{
+	m_entries.erase(offer_id);
+	auto it = std::find(m_ready.begin(), m_ready.end(), offer_id);
+	if (it != m_ready.end()) m_ready.erase(it);
+	update_gauge();
+}
+
+void rtc_offer_pool::update_gauge()
+{
+	m_stats_counters.set_value(counters::num_rtc_pooled_offers, std::int64_t(m_entries.size()));
+}
+
+rtc_transport_cache::rtc_transport_cache(io_context& ioc)
+	: m_io_context(ioc)
+{
+	std::array<char, 12> id;
+	aux::random_bytes({id.data(), int(id.size())});
+	m_local_id = aux::to_hex({id.data(), int(id.size())});
+}
+
+rtc_transport_cache::~rtc_transport_cache()
+{
+	close();
+}
+
+void rtc_transport_cache::close()
+{
+	m_abort = true;
+	m_transports.clear();
+	m_expected_channels.clear();
+}
+
+void rtc_transport_cache::add(std::string const& remote_id, std::string const& fingerprint
+	, std::shared_ptr<rtc::PeerConnection> const& pc)
+{
+	if (m_abort) return;
+
+	// without the fingerprint, we couldn't tell whether a later session
+	// description really comes from the same client
+	if (fingerprint.empty()) return;
+
+	// forget about the connections nobody uses anymore
+	for (auto it = m_transports.begin(); it != m_transports.end();)
+	{
+		if (it->second.peer_connection.expired()) it = m_transports.erase(it);
+		else ++it;
+	}
+
+	// The remote client opens additional DataChannels for other torrents on
+	// this connection. This replaces the handler of the signaling which
+	// created it, which only expected the first one.
+	pc->onDataChannel([weak_this = weak_from_this(), weak_pc = make_weak_ptr(pc)]
+		(std::shared_ptr<rtc::DataChannel> dc)
+	{
+		// Warning: this is called from another thread
+		auto self = weak_this.lock();
+		if (!self) return;
+
+		auto& io_context = self->m_io_context;
+		post(io_context, std::bind(&rtc_transport_cache::on_data_channel
+			, std::move(self)
+			, std::move(dc)
+			, weak_pc
+		));
+	});
+
+	m_transports[remote_id] = transport{pc, fingerprint};
+}
+
+std::shared_ptr<rtc::PeerConnection> rtc_transport_cache::find(std::string const& remote_id
+	, std::string const& fingerprint)
+{
+	auto it = m_transports.find(remote_id);
+	if (it == m_transports.end()) return {};
+
+	auto pc = it->second.peer_connection.lock();
+	if (!pc || pc->state() != rtc::PeerConnection::State::Connected)
+	{
+		m_transports.erase(it);
+		return {};
+	}
+
+	// anybody can claim a transport id, it's only a hint
+	if (fingerprint != it->second.fingerprint) return {};
+
+	return pc;
+}
+
+void rtc_transport_cache::expect_channel(rtc_offer_id const& offer_id
+	, std::weak_ptr<rtc_signaling> sig, std::shared_ptr<rtc::PeerConnection> const& pc)
+{
+	if (m_abort) return;
+	m_expected_channels[offer_id] = expected_channel{std::move(sig), pc};
+}
+
+void rtc_transport_cache::cancel_channel(rtc_offer_id const& offer_id)
+{
+	m_expected_channels.erase(offer_id);
+}
+
+void rtc_transport_cache::on_data_channel(std::shared_ptr<rtc::DataChannel> dc
+	, std::weak_ptr<rtc::PeerConnection> pc)
+{
+	std::string const protocol = dc->protocol();
+	rtc_offer_id offer_id;
+	auto it = m_expected_channels.end();
+	if (protocol.size() == offer_id.size() * 2
+		&& aux::from_hex(protocol, offer_id.data()))
+	{
+		it = m_expected_channels.find(offer_id);
+	}
+
+	std::shared_ptr<rtc_signaling> sig;
+	if (it != m_expected_channels.end())
+	{
+		// the channel must arrive on the connection the offer was matched
+		// with, not on any connection that learned the offer id
+		auto const expected_pc = it->second.peer_connection.lock();
+		if (expected_pc && expected_pc == pc.lock())
+		{
+			sig = it->second.signaling.lock();
+			m_expected_channels.erase(it);
+		}
+	}
+
+	if (!sig)
+	{
+		dc->close();
+		return;
+	}
+
+	sig->on_data_channel(error_code{}, std::move(offer_id), std::move(dc));
+}
+
 #ifndef TORRENT_DISABLE_LOGGING
 bool rtc_signaling::should_log() const
 {
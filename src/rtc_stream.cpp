@@ -14,12 +14,15 @@ see LICENSE file.
 
 #include "libtorrent/aux_/rtc_stream.hpp"
 #include "libtorrent/error.hpp"
+#include "libtorrent/performance_counters.hpp"
 #include "libtorrent/span.hpp"
 
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <rtc/rtc.hpp>
 #include "libtorrent/aux_/disable_warnings_pop.hpp"
 
+#include <algorithm>
+
 namespace libtorrent {
 namespace aux {
 
@@ -33,6 +36,10 @@ rtc_stream_impl::rtc_stream_impl(io_context& ioc, rtc_stream_init init)
 	: m_io_context(ioc)
 	, m_peer_connection(std::move(init.peer_connection))
 	, m_data_channel(std::move(init.data_channel))
+	, m_send_buffer_low_watermark(std::min(init.send_buffer_low_watermark
+		, init.send_buffer_high_watermark))
+	, m_send_buffer_high_watermark(init.send_buffer_high_watermark)
+	, m_stats_counters(init.stats_counters)
 {
 
 }
@@ -53,7 +60,7 @@ void rtc_stream_impl::init()
 		));
 	});
 
-	m_data_channel->setBufferedAmountLowThreshold(0);
+	m_data_channel->setBufferedAmountLowThreshold(m_send_buffer_low_watermark);
 	m_data_channel->onBufferedAmountLow([this, weak_this]()
 	{
 		// Warning: this is called from another thread
@@ -106,11 +113,15 @@ void rtc_stream_impl::on_buffered_low(error_code const& ec)
 {
 	if (!m_write_handler) return;
 
-	std::size_t const bytes_written = ec ? 0 : m_write_buffer_size;
+	if (ec)
+	{
+		clear_write_buffers();
+		post(m_io_context, std::bind(std::exchange(m_write_handler, nullptr), ec, 0));
+		return;
+	}
 
-	m_write_buffer.clear();
-	m_write_buffer_size = 0;
-	post(m_io_context, std::bind(std::exchange(m_write_handler, nullptr), ec, bytes_written));
+	// Resume pending write
+	issue_write();
 }
 
 bool rtc_stream_impl::is_open() const
@@ -209,24 +220,21 @@ void rtc_stream_impl::issue_write()
 
 	if (!ensure_open()) return;
 
-	std::size_t const max_message_size = m_data_channel->maxMessageSize();
-	std::size_t bytes_written = 0;
-	bool is_buffered = false;
-	while (!m_write_buffer.empty())
+	// The handler stays pending until the DataChannel drains, on_buffered_low()
+	// will call us again
+	if (is_write_blocked())
 	{
-		std::size_t bytes;
-		std::tie(bytes, is_buffered) = write_data(max_message_size);
-		bytes_written += bytes;
+		if (!m_write_stalled) inc_stats_counter(counters::rtc_send_stalls);
+		m_write_stalled = true;
+		return;
 	}
 
-	TORRENT_ASSERT(bytes_written == m_write_buffer_size);
+	m_write_stalled = false;
 
-	if (!is_buffered)
-	{
-		m_write_buffer.clear();
-		m_write_buffer_size = 0;
-		post(m_io_context, std::bind(std::exchange(m_write_handler, nullptr), error_code{}, bytes_written));
-	}
+	error_code ec;
+	std::size_t const bytes_written = write_some(ec);
+	clear_write_buffers();
+	post(m_io_context, std::bind(std::exchange(m_write_handler, nullptr), ec, bytes_written));
 }
 
 std::size_t rtc_stream_impl::read_some(error_code& ec)
@@ -263,6 +271,8 @@ std::size_t rtc_stream_impl::read_some(error_code& ec)
 			{
 				char const *data = reinterpret_cast<char const*>(bin.data());
 				std::size_t const size = bin.size();
+				inc_stats_counter(counters::rtc_messages_in);
+				inc_stats_counter(counters::rtc_bytes_in, std::int64_t(size));
 				std::size_t const copied = incoming_data(span<char const>{data, long(size)});
 				bytes_read += copied;
 				if (copied < size)
@@ -287,22 +297,24 @@ std::size_t rtc_stream_impl::write_some(error_code& ec)
 		return 0;
 	}
 
-	if (m_data_channel->bufferedAmount() > 0)
+	if (is_write_blocked())
 	{
 		ec = boost::asio::error::would_block;
 		return 0;
 	}
 
-	std::size_t const max_message_size = m_data_channel->maxMessageSize();
+	// Queued buffers are coalesced into messages as large as the remote
+	// accepts, and we keep sending until the high watermark is reached
+	std::size_t const max_message_size = std::max(m_data_channel->maxMessageSize(), std::size_t(1));
 	std::size_t bytes_written = 0;
-	bool is_buffered = false;
-	while (!m_write_buffer.empty() && !is_buffered)
+	while (!m_write_buffer.empty() && !ec)
 	{
-		std::size_t bytes = 0;
-		std::tie(bytes, is_buffered) = write_data(max_message_size);
-		bytes_written += bytes;
+		bytes_written += write_data(max_message_size, ec);
+		if (is_write_blocked()) break;
 	}
 
+	// A partial write is not an error
+	if (bytes_written > 0) ec.clear();
 	return bytes_written;
 }
 
@@ -336,30 +348,51 @@ std::size_t rtc_stream_impl::incoming_data(span<char const> data)
 	return bytes_read;
 }
 
-std::pair<std::size_t, bool> rtc_stream_impl::write_data(std::size_t size)
+std::size_t rtc_stream_impl::write_data(std::size_t const max_size, error_code& ec)
 {
+	// Gather as many queued buffers as fit in a single message
 	std::size_t total = 0;
-	auto target = m_write_buffer.begin();
-	while (target != m_write_buffer.end())
+	auto last = m_write_buffer.begin();
+	while (last != m_write_buffer.end() && total + last->size() <= max_size)
 	{
-		total += target->size();
-		if (total >= size) break;
-		++target;
+		total += last->size();
+		++last;
 	}
 
-	if (total > size)
+	if (last != m_write_buffer.end() && total < max_size)
 	{
-		TORRENT_ASSERT(target != m_write_buffer.end());
-		std::size_t const left = total - size;
-		std::size_t const to_copy = target->size() - left;
-		m_write_buffer.insert(target, boost::asio::const_buffer(target->data(), to_copy));
-		(*target) += to_copy;
-		total = size;
+		// Split the buffer straddling the message boundary
+		std::size_t const to_copy = max_size - total;
+		m_write_buffer.insert(last, const_buffer(last->data(), to_copy));
+		(*last) += to_copy;
+		total = max_size;
+	}
+
+	try {
+		m_data_channel->sendBuffer(m_write_buffer.begin(), last);
 	}
+	catch (std::exception const&) {
+		ec = boost::asio::error::connection_reset;
+		return 0;
+	}
+
+	m_write_buffer.erase(m_write_buffer.begin(), last);
+	TORRENT_ASSERT(m_write_buffer_size >= total);
+	m_write_buffer_size -= total;
 
-	bool is_buffered = !m_data_channel->sendBuffer(m_write_buffer.begin(), target);
-	m_write_buffer.erase(m_write_buffer.begin(), target);
-	return std::make_pair(total, is_buffered);
+	inc_stats_counter(counters::rtc_messages_out);
+	inc_stats_counter(counters::rtc_bytes_out, std::int64_t(total));
+	return total;
+}
+
+bool rtc_stream_impl::is_write_blocked() const
+{
+	return m_data_channel->bufferedAmount() > m_send_buffer_high_watermark;
+}
+
+void rtc_stream_impl::inc_stats_counter(int const c, std::int64_t const value)
+{
+	if (m_stats_counters) m_stats_counters->inc_stats_counter(c, value);
 }
 
 rtc_stream::rtc_stream(io_context& ioc, rtc_stream_init init)
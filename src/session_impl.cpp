@@ -988,6 +988,11 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 		// about to send event=stopped to
 		m_host_resolver.abort();
 
+#if TORRENT_USE_RTC
+		if (m_rtc_offer_pool) m_rtc_offer_pool->close();
+		if (m_rtc_transports) m_rtc_transports->close();
+#endif
+
 		m_close_file_timer.cancel();
 
 		// abort the main thread
@@ -1207,12 +1212,6 @@ bool ssl_server_name_callback(ssl::stream_handle_type stream_handle, std::string
 		return ret;
 	}
 
-namespace {
-
-	std::uint16_t make_announce_port(std::uint16_t const p)
-	{ return p == 0 ? 1 : p; }
-}
-
 	void session_impl::queue_tracker_request(tracker_request req
 		, std::weak_ptr<request_callback> c)
 	{
@@ -1229,21 +1228,21 @@ namespace {
 		bool const use_ssl = req.ssl_ctx != nullptr && req.ssl_ctx != &m_ssl_ctx;
 		if (!use_ssl)
 #endif
+		{
 			req.ssl_ctx = &m_ssl_ctx;
+			req.ssl_ctx_id = 0;
+		}
 #endif
 
 		TORRENT_ASSERT(req.outgoing_socket);
 		auto* ls = req.outgoing_socket.get();
 
-		req.listen_port =
-#if TORRENT_USE_I2P
-			(req.kind == tracker_request::i2p) ? 1 :
-#endif
+		req.listen_port = announce_port(req,
 #ifdef TORRENT_SSL_PEERS
 			// SSL torrents use the SSL listen port
-			use_ssl ? make_announce_port(ssl_listen_port(ls)) :
+			use_ssl ? ssl_listen_port(ls) :
 #endif
-			make_announce_port(listen_port(ls));
+			listen_port(ls));
 		m_tracker_manager.queue_request(get_context(), std::move(req), m_settings, c);
 	}
 
@@ -5289,6 +5288,64 @@ namespace {
 		m_host_resolver.set_cache_timeout(seconds(timeout));
 	}
 
+	void session_impl::update_dns_resolver()
+	{
+		std::vector<std::string> list;
+		parse_comma_separated_string(m_settings.get_str(settings_pack::dns_servers), list);
+
+		// the port is optional, it defaults to 53
+		std::vector<udp::endpoint> servers;
+		for (auto const& s : list)
+		{
+			error_code ec;
+			address const addr = make_address(s, ec);
+			if (!ec)
+			{
+				servers.emplace_back(addr, std::uint16_t(53));
+				continue;
+			}
+			ec.clear();
+			tcp::endpoint const ep = parse_endpoint(s, ec);
+			if (!ec)
+			{
+				servers.push_back(make_udp(ep));
+				continue;
+			}
+#ifndef TORRENT_DISABLE_LOGGING
+			session_log("ERROR: invalid DNS server: %s", s.c_str());
+#endif
+		}
+
+		m_host_resolver.use_builtin(m_settings.get_bool(settings_pack::builtin_dns_resolver)
+			, std::move(servers));
+	}
+
+	void session_impl::update_webtorrent_offer_pool_size()
+	{
+#if TORRENT_USE_RTC
+		if (m_rtc_offer_pool) m_rtc_offer_pool->trim();
+#endif
+	}
+
+#if TORRENT_USE_RTC
+	rtc_offer_pool& session_impl::rtc_offers()
+	{
+		if (!m_rtc_offer_pool)
+		{
+			m_rtc_offer_pool = std::make_shared<rtc_offer_pool>(m_io_context
+				, m_settings, m_stats_counters);
+		}
+		return *m_rtc_offer_pool;
+	}
+
+	rtc_transport_cache& session_impl::rtc_transports()
+	{
+		if (!m_rtc_transports)
+			m_rtc_transports = std::make_shared<rtc_transport_cache>(m_io_context);
+		return *m_rtc_transports;
+	}
+#endif
+
 	void session_impl::update_proxy()
 	{
 		for (auto& i : m_listen_sockets)
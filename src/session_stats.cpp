@@ -307,6 +307,25 @@ namespace {
 
 		METRIC(disk, disk_blocks_in_use)
 
+		// the number of blocks currently held by the read cache (see
+		// settings_pack::read_cache_size)
+		METRIC(disk, read_cache_blocks)
+
+		// the current thread limits of the generic and hashing disk thread
+		// pools. With settings_pack::adaptive_disk_threads enabled, these are
+		// adjusted within the bounds of aio_threads and hashing_threads
+		METRIC(disk, disk_generic_thread_limit)
+		METRIC(disk, disk_hash_thread_limit)
+
+		// the average time disk jobs spent in the job queue before a thread
+		// picked them up, and the average time it took to execute them, in
+		// microseconds. Sampled once per second by the adaptive disk thread
+		// controller, separately for the generic and hashing thread pools
+		METRIC(disk, disk_generic_queue_wait)
+		METRIC(disk, disk_generic_service_time)
+		METRIC(disk, disk_hash_queue_wait)
+		METRIC(disk, disk_hash_service_time)
+
 		// ``queued_disk_jobs`` is the number of disk jobs currently queued,
 		// waiting to be executed by a disk thread.
 		METRIC(disk, queued_disk_jobs)
@@ -344,6 +363,37 @@ namespace {
 		// hash a piece (when verifying against the piece hash)
 		METRIC(disk, num_read_back)
 
+		// the number of block reads satisfied by the read cache, the number of
+		// read jobs that had to go to disk while the read cache was enabled,
+		// and the number of blocks evicted from the read cache
+		METRIC(disk, read_cache_hits)
+		METRIC(disk, read_cache_misses)
+		METRIC(disk, read_cache_evictions)
+
+		// the number of times a torrent's dirty writes were flushed (see
+		// settings_pack::max_dirty_bytes), the number of contiguous ranges
+		// they were coalesced into, and the number of bytes flushed.
+		// ``disk_flush_time`` is the cumulative time spent flushing, in
+		// microseconds, including waiting for the previous flush to complete
+		METRIC(disk, num_disk_flushes)
+		METRIC(disk, num_flush_ranges)
+		METRIC(disk, disk_flush_bytes)
+		METRIC(disk, disk_flush_time)
+
+		// the number of times the adaptive disk thread controller raised or
+		// lowered the thread limit of a disk thread pool (see
+		// settings_pack::adaptive_disk_threads)
+		METRIC(disk, disk_threads_grown)
+		METRIC(disk, disk_threads_shrunk)
+
+		// the cumulative time disk jobs spent in the job queue before being
+		// picked up by a disk thread, in microseconds. Split by job class, see
+		// settings_pack::disk_queue_read_weight
+		METRIC(disk, disk_read_queue_time)
+		METRIC(disk, disk_write_queue_time)
+		METRIC(disk, disk_hash_queue_time)
+		METRIC(disk, disk_other_queue_time)
+
 		// cumulative time spent in various disk jobs, as well
 		// as total for all disk jobs. Measured in microseconds
 		METRIC(disk, disk_read_time)
@@ -481,6 +531,78 @@ namespace {
 		// the outgoing ACK is lost.
 		METRIC(utp, utp_redundant_pkts_in)
 
+		// the number of WebTorrent announces that could take a pre-generated
+		// offer from the session-wide pool (``rtc_offer_pool_hits``) and the
+		// number of offers that had to be generated on demand
+		// (``rtc_offer_pool_misses``).
+		METRIC(webtorrent, rtc_offer_pool_hits)
+		METRIC(webtorrent, rtc_offer_pool_misses)
+
+		// the number of WebRTC offers generated, and the cumulative time spent
+		// generating them (i.e. gathering ICE candidates), in microseconds.
+		// Dividing the time by the number of offers gives the average
+		// generation latency.
+		METRIC(webtorrent, rtc_offers_generated)
+		METRIC(webtorrent, rtc_offer_generation_time)
+
+		// the number of WebTorrent DataChannels opened on a WebRTC connection
+		// shared with another torrent, instead of a connection of their own.
+		METRIC(webtorrent, rtc_shared_connections)
+
+		// the number of answers received to our WebRTC offers, and the
+		// cumulative time between handing the offers to the tracker and
+		// receiving the answers, in microseconds.
+		METRIC(webtorrent, rtc_answers_received)
+		METRIC(webtorrent, rtc_answer_time)
+
+		// the number of WebRTC connections which completed ICE, and the
+		// cumulative time it took from the remote session description, in
+		// microseconds. This is mostly affected by the STUN server.
+		METRIC(webtorrent, rtc_ice_connected)
+		METRIC(webtorrent, rtc_ice_connect_time)
+
+		// the number of WebTorrent DataChannels opened, and the cumulative
+		// time it took from the remote session description, in microseconds.
+		// This includes ICE, DTLS and SCTP setup, except on shared connections.
+		METRIC(webtorrent, rtc_data_channels_opened)
+		METRIC(webtorrent, rtc_data_channel_open_time)
+
+		// the number of WebRTC connections which failed, or didn't open a
+		// DataChannel within ``webtorrent_connection_timeout``, after getting
+		// the remote session description. Offers nobody answered are not
+		// counted.
+		METRIC(webtorrent, rtc_connection_failures)
+		METRIC(webtorrent, rtc_connection_timeouts)
+
+		// the number of DataChannel messages and payload bytes received and
+		// sent by WebTorrent peers
+		METRIC(webtorrent, rtc_messages_in)
+		METRIC(webtorrent, rtc_messages_out)
+		METRIC(webtorrent, rtc_bytes_in)
+		METRIC(webtorrent, rtc_bytes_out)
+
+		// the number of times a write to a WebTorrent peer had to wait for
+		// the DataChannel's buffered amount to go below
+		// ``webtorrent_send_buffer_low_watermark``
+		METRIC(webtorrent, rtc_send_stalls)
+
+		// the time it took to open WebTorrent DataChannels, from the remote
+		// session description. The time is 1 << n milliseconds, where n is
+		// the number at the end of the counter name, i.e.
+		// 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768
+		// milliseconds. The last one also counts longer times.
+		METRIC(webtorrent, rtc_connect_time5)
+		METRIC(webtorrent, rtc_connect_time6)
+		METRIC(webtorrent, rtc_connect_time7)
+		METRIC(webtorrent, rtc_connect_time8)
+		METRIC(webtorrent, rtc_connect_time9)
+		METRIC(webtorrent, rtc_connect_time10)
+		METRIC(webtorrent, rtc_connect_time11)
+		METRIC(webtorrent, rtc_connect_time12)
+		METRIC(webtorrent, rtc_connect_time13)
+		METRIC(webtorrent, rtc_connect_time14)
+		METRIC(webtorrent, rtc_connect_time15)
+
 		// the number of uTP sockets in each respective state
 		METRIC(utp, num_utp_idle)
 		METRIC(utp, num_utp_syn_sent)
@@ -540,6 +662,51 @@ namespace {
 		// this measure the number of tracker announces currently in the
 		// queue
 		METRIC(tracker, num_queued_tracker_announces)
+
+		// the number of announces waiting in the announce scheduler, for a
+		// slot with their tracker host (see max_concurrent_host_announces)
+		// or for their jittered send time
+		METRIC(tracker, num_scheduled_tracker_announces)
+
+		// the number of announces sent by the announce scheduler that have
+		// completed, the cumulative time they spent queued in the scheduler
+		// and the cumulative time from being sent until completing, in
+		// microseconds.
+		METRIC(tracker, tracker_announces)
+		METRIC(tracker, tracker_announce_queue_time)
+		METRIC(tracker, tracker_announce_time)
+
+		// UDP tracker connection IDs are cached and shared by all torrents.
+		// These count announces and scrapes that found a valid connection ID
+		// (hits), had to send a connect request (misses) or waited for the
+		// connect request of another torrent to the same tracker (waits).
+		// ``udp_tracker_connection_id_refreshes`` is the number of connect
+		// requests sent ahead of time, to renew a connection ID about to
+		// expire
+		METRIC(tracker, udp_tracker_connection_id_hits)
+		METRIC(tracker, udp_tracker_connection_id_misses)
+		METRIC(tracker, udp_tracker_connection_id_waits)
+		METRIC(tracker, udp_tracker_connection_id_refreshes)
+
+		// HTTP tracker requests sent over a connection kept open from an
+		// earlier request (reused), and the connections that had to be
+		// opened. The reuse ratio is reused / (reused + opened).
+		// ``http_tracker_connect_time`` is the cumulative time spent
+		// connecting, including the SSL handshake, in microseconds.
+		// ``http_tracker_ssl_sessions_resumed`` counts the SSL handshakes that
+		// resumed the session of an earlier connection to the same tracker
+		METRIC(tracker, http_tracker_connections_reused)
+		METRIC(tracker, http_tracker_connections_opened)
+		METRIC(tracker, http_tracker_connect_time)
+		METRIC(tracker, http_tracker_ssl_sessions_resumed)
+
+		// the number of idle HTTP tracker connections kept open to be
+		// reused (see tracker_keep_alive_timeout)
+		METRIC(tracker, num_idle_http_tracker_connections)
+
+		// the number of pre-generated WebRTC offers currently in the pool,
+		// including the ones still gathering ICE candidates
+		METRIC(webtorrent, num_rtc_pooled_offers)
 		// ... more
 	}});
 #undef METRIC
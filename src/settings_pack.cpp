@@ -110,7 +110,8 @@ namespace libtorrent {
 		SET(i2p_hostname, "", &session_impl::update_i2p_bridge),
 		SET(peer_fingerprint, "-LT2020-", nullptr),
 		SET(dht_bootstrap_nodes, "dht.libtorrent.org:25401", &session_impl::update_dht_bootstrap_nodes),
-		SET(webtorrent_stun_server, "stun.l.google.com:19302", nullptr)
+		SET(webtorrent_stun_server, "stun.l.google.com:19302", nullptr),
+		SET(dns_servers, "", &session_impl::update_dns_resolver)
 	}});
 
 	CONSTEXPR_SETTINGS
@@ -199,6 +200,10 @@ namespace libtorrent {
 		SET(ssrf_mitigation, true, nullptr),
 		SET(allow_idna, false, nullptr),
 		SET(enable_set_file_valid_data, false, nullptr),
+		SET(webtorrent_share_connections, false, nullptr),
+		SET(disk_buffer_huge_pages, false, nullptr),
+		SET(adaptive_disk_threads, false, nullptr),
+		SET(builtin_dns_resolver, false, &session_impl::update_dns_resolver),
 	}});
 
 	CONSTEXPR_SETTINGS
@@ -356,7 +361,25 @@ namespace libtorrent {
 		SET(dht_max_infohashes_sample_count, 20, nullptr),
 		SET(max_piece_count, 0x200000, nullptr),
 		SET(min_websocket_announce_interval, 1 * 60, nullptr),
-		SET(webtorrent_connection_timeout, 2 * 60, nullptr)
+		SET(webtorrent_connection_timeout, 2 * 60, nullptr),
+		SET(webtorrent_send_buffer_low_watermark, 256 * 1024, nullptr),
+		SET(webtorrent_send_buffer_high_watermark, 1024 * 1024, nullptr),
+		SET(webtorrent_offer_pool_size, 0, &session_impl::update_webtorrent_offer_pool_size),
+		SET(webtorrent_offer_pool_expiry, 60, nullptr),
+		SET(disk_buffer_slab_size, 0, nullptr),
+		SET(read_cache_size, 0, nullptr),
+		SET(max_dirty_bytes, 0, nullptr),
+		SET(disk_queue_read_weight, 8, nullptr),
+		SET(disk_queue_write_weight, 4, nullptr),
+		SET(disk_queue_hash_weight, 2, nullptr),
+		SET(disk_queue_other_weight, 1, nullptr),
+		SET(move_storage_threads, 2, nullptr),
+		SET(scrape_batch_delay, 0, nullptr),
+		SET(max_concurrent_host_announces, 0, nullptr),
+		SET(announce_jitter, 0, nullptr),
+		SET(urlseed_connections, 1, nullptr),
+		SET(tracker_keep_alive_timeout, 60, nullptr),
+		SET(max_idle_tracker_connections, 16, nullptr)
 	}});
 
 #undef SET
@@ -191,6 +191,36 @@ namespace aux {
 #endif
 	}
 
+#if TORRENT_USE_SSL
+	struct ssl_handle_visitor
+	{
+		template <typename T>
+		ssl::stream_handle_type operator()(ssl_stream<T>& s) { return s.handle(); }
+		template <typename T>
+		ssl::stream_handle_type operator()(T&) { return nullptr; }
+	};
+
+	ssl::session_handle get_ssl_session(socket_type& s)
+	{
+		ssl::stream_handle_type const h = std::visit(ssl_handle_visitor{}, s.var());
+		if (!h) return {};
+		return ssl::get_session(h);
+	}
+
+	void set_ssl_session(socket_type& s, ssl::session_handle const& session, error_code& ec)
+	{
+		ssl::stream_handle_type const h = std::visit(ssl_handle_visitor{}, s.var());
+		if (!h) return;
+		ssl::set_session(h, session, ec);
+	}
+
+	bool ssl_session_resumed(socket_type& s)
+	{
+		ssl::stream_handle_type const h = std::visit(ssl_handle_visitor{}, s.var());
+		return h && ssl::session_resumed(h);
+	}
+#endif
+
 #if TORRENT_USE_SSL
 
 	struct socket_closer
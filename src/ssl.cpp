@@ -146,6 +146,50 @@ context_handle_type get_context(stream_handle_type s)
 #endif
 }
 
+session_handle get_session(stream_handle_type s)
+{
+#if defined TORRENT_USE_OPENSSL
+	if (!SSL_is_init_finished(s)) return {};
+	SSL_SESSION* session = SSL_get1_session(s);
+	if (session == nullptr) return {};
+	session_handle ret(session, &SSL_SESSION_free);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	if (!SSL_SESSION_is_resumable(session)) return {};
+#endif
+	return ret;
+#elif defined TORRENT_USE_GNUTLS
+	gnutls_datum_t data;
+	if (gnutls_session_get_data2(s->native_handle(), &data) != GNUTLS_E_SUCCESS)
+		return {};
+	auto ret = std::make_shared<std::vector<char>>(data.data, data.data + data.size);
+	gnutls_free(data.data);
+	return ret;
+#endif
+}
+
+void set_session(stream_handle_type s, session_handle const& session, error_code& ec)
+{
+	if (!session) return;
+#if defined TORRENT_USE_OPENSSL
+	if (SSL_set_session(s, session.get()) != 1)
+		ec = error_code(int(ERR_get_error()), error::get_ssl_category());
+#elif defined TORRENT_USE_GNUTLS
+	int const ret = gnutls_session_set_data(s->native_handle()
+		, session->data(), session->size());
+	if (ret != GNUTLS_E_SUCCESS)
+		ec = error_code(ret, error::get_ssl_category());
+#endif
+}
+
+bool session_resumed(stream_handle_type s)
+{
+#if defined TORRENT_USE_OPENSSL
+	return SSL_session_reused(s) == 1;
+#elif defined TORRENT_USE_GNUTLS
+	return gnutls_session_is_resumed(s->native_handle()) != 0;
+#endif
+}
+
 #if defined TORRENT_USE_OPENSSL
 namespace {
 	struct lifecycle
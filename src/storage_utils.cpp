@@ -15,13 +15,19 @@ see LICENSE file.
 #include "libtorrent/file_storage.hpp"
 #include "libtorrent/aux_/alloca.hpp"
 #include "libtorrent/aux_/path.hpp" // for count_bufs
+#include "libtorrent/aux_/file_pointer.hpp"
 #include "libtorrent/session.hpp" // for session::delete_files
 #include "libtorrent/aux_/stat_cache.hpp"
 #include "libtorrent/add_torrent_params.hpp"
 #include "libtorrent/torrent_status.hpp"
 #include "libtorrent/error_code.hpp"
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
 #include <set>
+#include <thread>
 
 namespace libtorrent { namespace aux {
 
@@ -185,11 +191,194 @@ namespace libtorrent { namespace aux {
 		return size;
 	}
 
+	namespace {
+
+	// files that can't be renamed into the new save path are copied to a
+	// file with this suffix first, and renamed once complete. If a move is
+	// interrupted, the next attempt picks up where it left off
+	char const move_suffix[] = ".moving";
+
+	// a copy is resumed at a multiple of this, in case the last bytes copied
+	// before the interruption didn't make it to disk
+	std::int64_t const resume_granularity = 1024 * 1024;
+
+	// reads ``buf.size()`` bytes at ``offset`` of the file ``p`` into ``buf``
+	void read_file_range(std::string const& p, std::int64_t const offset
+		, std::vector<char>& buf, error_code& ec)
+	{
+#ifdef TORRENT_WINDOWS
+		aux::file_pointer const f(::_wfopen(convert_to_native_path_string(p).c_str(), L"rb"));
+#else
+		aux::file_pointer const f(std::fopen(p.c_str(), "rb"));
+#endif
+		if (f.file() == nullptr)
+		{
+			ec.assign(errno, generic_category());
+			return;
+		}
+
+		if (aux::portable_fseeko(f.file(), offset, SEEK_SET) != 0)
+		{
+			ec.assign(errno, generic_category());
+			return;
+		}
+
+		if (std::fread(buf.data(), 1, buf.size(), f.file()) != buf.size())
+		{
+			ec = std::ferror(f.file())
+				? error_code(errno, generic_category())
+				: error_code(boost::asio::error::eof);
+		}
+	}
+
+	// returns true if the ``resume_granularity`` bytes before ``offset`` are
+	// the same in both files. That's the last block of an interrupted copy,
+	// the one most likely to be incomplete
+	bool same_last_block(std::string const& src, std::string const& dst
+		, std::int64_t const offset)
+	{
+		TORRENT_ASSERT(offset >= resume_granularity);
+		std::vector<char> src_buf(static_cast<std::size_t>(resume_granularity));
+		std::vector<char> dst_buf(static_cast<std::size_t>(resume_granularity));
+		error_code ec;
+		read_file_range(src, offset - resume_granularity, src_buf, ec);
+		if (ec) return false;
+		read_file_range(dst, offset - resume_granularity, dst_buf, ec);
+		if (ec) return false;
+		return src_buf == dst_buf;
+	}
+	}
+
+	void copy_files(file_storage const& f, std::string const& save_path
+		, std::string const& new_save_path, std::vector<file_index_t> const& files
+		, int const num_threads
+		, std::function<void(std::int64_t, std::int64_t)> const& progress
+		, aux::vector<bool, file_index_t>& copied, storage_error& ec)
+	{
+		std::int64_t total = 0;
+		std::atomic<std::int64_t> done{0};
+		std::vector<std::int64_t> offsets(files.size(), 0);
+		for (std::size_t k = 0; k < files.size(); ++k)
+		{
+			file_index_t const i = files[k];
+			error_code ignore;
+			file_status src;
+			stat_file(combine_path(save_path, f.file_path(i)), &src, ignore);
+			total += src.file_size;
+
+			// a partial copy from an earlier attempt can be resumed, unless the
+			// source has been modified since. A partial copy larger than the
+			// source isn't one of ours
+			file_status part;
+			stat_file(combine_path(new_save_path, f.file_path(i)) + move_suffix
+				, &part, ignore);
+			if (ignore || part.mtime <= src.mtime
+				|| part.file_size > src.file_size) continue;
+			offsets[k] = part.file_size - part.file_size % resume_granularity;
+		}
+
+		std::mutex mutex;
+		std::condition_variable cond;
+		std::size_t next = 0;
+		int running = std::max(1, std::min(num_threads, int(files.size())));
+
+		auto worker = [&]
+		{
+			for (;;)
+			{
+				std::size_t k;
+				{
+					std::lock_guard<std::mutex> l(mutex);
+					if (ec || next == files.size()) break;
+					k = next++;
+				}
+				file_index_t const i = files[k];
+				std::string const old_path = combine_path(save_path, f.file_path(i));
+				std::string const new_path = combine_path(new_save_path, f.file_path(i));
+				std::string const part_path = new_path + move_suffix;
+
+				// the partial copy is newer than the source and no larger (see
+				// above). It's resumed if its last block matches the source,
+				// otherwise it's copied from the start. Comparing all of it
+				// would cost about as much as copying it again
+				if (offsets[k] > 0)
+				{
+					if (!same_last_block(old_path, part_path, offsets[k]))
+						offsets[k] = 0;
+					done += offsets[k];
+				}
+
+				error_code e;
+				if (has_parent_path(new_path))
+					create_directories(parent_path(new_path), e);
+				if (!e)
+				{
+					copy_file(old_path, part_path, offsets[k]
+						, [&](std::int64_t const n) { done += n; }, e);
+				}
+				if (!e) rename(part_path, new_path, e);
+
+				std::lock_guard<std::mutex> l(mutex);
+				if (e)
+				{
+					if (!ec)
+					{
+						ec.ec = e;
+						ec.file(i);
+						ec.operation = operation_t::file_copy;
+					}
+				}
+				else
+				{
+					copied[i] = true;
+				}
+			}
+			std::lock_guard<std::mutex> l(mutex);
+			--running;
+			cond.notify_all();
+		};
+
+		std::vector<std::thread> threads;
+		int const num_workers = running;
+		try
+		{
+			for (int t = 0; t < num_workers; ++t)
+				threads.emplace_back(worker);
+		}
+		catch (std::system_error const&)
+		{
+			std::lock_guard<std::mutex> l(mutex);
+			running -= num_workers - int(threads.size());
+		}
+		if (threads.empty())
+		{
+			// we couldn't start any threads, copy the files in this one
+			running = 1;
+			worker();
+		}
+
+		{
+			std::unique_lock<std::mutex> l(mutex);
+			while (running > 0)
+			{
+				cond.wait_for(l, std::chrono::seconds(1));
+				if (running == 0 || !progress) continue;
+				l.unlock();
+				progress(done, total);
+				l.lock();
+			}
+		}
+		for (auto& t : threads) t.join();
+		if (progress) progress(done, total);
+	}
+
 	std::pair<status_t, std::string> move_storage(file_storage const& f
 		, std::string save_path
 		, std::string const& destination_save_path
 		, std::function<void(std::string const&, error_code&)> const& move_partfile
-		, move_flags_t const flags, storage_error& ec)
+		, move_flags_t const flags, int const copy_threads
+		, std::function<void(std::int64_t, std::int64_t)> const& progress
+		, storage_error& ec)
 	{
 		status_t ret = status_t::no_error;
 		std::string const new_save_path = complete(destination_save_path);
@@ -249,8 +438,15 @@ namespace libtorrent { namespace aux {
 		// later
 		aux::vector<bool, file_index_t> copied_files(std::size_t(f.num_files()), false);
 
-		// track how far we got in case of an error
-		file_index_t file_index{};
+		// indices of all files we renamed. These are moved back in case of an
+		// error
+		aux::vector<bool, file_index_t> renamed_files(std::size_t(f.num_files()), false);
+
+		// files that couldn't be renamed, typically because the new save path
+		// is on a different volume. These are copied once all renames are done,
+		// to not delete any source file until everything has been copied
+		std::vector<file_index_t> to_copy;
+
 		error_code e;
 		for (auto const i : f.file_range())
 		{
@@ -267,35 +463,44 @@ namespace libtorrent { namespace aux {
 				continue;
 			}
 
-			// TODO: ideally, if we end up copying files because of a move across
-			// volumes, the source should not be deleted until they've all been
-			// copied. That would let us rollback with higher confidence.
 			move_file(old_path, new_path, e);
 
+			if (!e)
+			{
+				renamed_files[i] = true;
+				continue;
+			}
+
 			// if the source file doesn't exist. That's not a problem
 			// we just ignore that file
 			if (e == boost::system::errc::no_such_file_or_directory)
+			{
 				e.clear();
-			else if (e
-				&& e != boost::system::errc::invalid_argument
+				continue;
+			}
+
+			if (e != boost::system::errc::invalid_argument
 				&& e != boost::system::errc::permission_denied)
 			{
 				// moving the file failed
 				// on OSX, the error when trying to rename a file across different
 				// volumes is EXDEV, which will make it fall back to copying.
 				e.clear();
-				copy_file(old_path, new_path, e);
-				if (!e) copied_files[i] = true;
+				to_copy.push_back(i);
+				continue;
 			}
 
-			if (e)
-			{
-				ec.ec = e;
-				ec.file(i);
-				ec.operation = operation_t::file_rename;
-				file_index = i;
-				break;
-			}
+			ec.ec = e;
+			ec.file(i);
+			ec.operation = operation_t::file_rename;
+			break;
+		}
+
+		if (!e && !to_copy.empty())
+		{
+			copy_files(f, save_path, new_save_path, to_copy, copy_threads
+				, progress, copied_files, ec);
+			e = ec.ec;
 		}
 
 		if (!e && move_partfile)
@@ -312,21 +517,30 @@ namespace libtorrent { namespace aux {
 		if (e)
 		{
 			// rollback
-			while (--file_index >= file_index_t(0))
+			for (auto const i : f.file_range())
 			{
-				// files moved out to absolute paths are not moved
-				if (f.file_absolute_path(file_index)) continue;
-
-				// if we ended up copying the file, don't do anything during
-				// roll-back
-				if (copied_files[file_index]) continue;
-
-				std::string const old_path = combine_path(save_path, f.file_path(file_index));
-				std::string const new_path = combine_path(new_save_path, f.file_path(file_index));
+				std::string const old_path = combine_path(save_path, f.file_path(i));
+				std::string const new_path = combine_path(new_save_path, f.file_path(i));
 
 				// ignore errors when rolling back
 				error_code ignore;
-				move_file(new_path, old_path, ignore);
+				if (renamed_files[i])
+				{
+					move_file(new_path, old_path, ignore);
+				}
+				else if (copied_files[i])
+				{
+					// the source is still in place
+					remove(new_path, ignore);
+				}
+			}
+
+			// nothing keeps track of the partial copies once the move has
+			// failed, so they're not kept around for the next attempt
+			for (auto const i : to_copy)
+			{
+				error_code ignore;
+				remove(combine_path(new_save_path, f.file_path(i)) + move_suffix, ignore);
 			}
 
 			return { status_t::fatal_disk_error, save_path };
@@ -347,6 +561,14 @@ namespace libtorrent { namespace aux {
 			if (has_parent_path(f.file_path(i)))
 				subdirs.insert(parent_path(f.file_path(i)));
 
+			// a partial copy left behind by an earlier, interrupted, attempt
+			// isn't needed anymore, if the file could be renamed this time
+			if (renamed_files[i])
+			{
+				error_code ignore;
+				remove(combine_path(new_save_path, f.file_path(i)) + move_suffix, ignore);
+			}
+
 			// if we ended up renaming the file instead of moving it, there's no
 			// need to delete the source.
 			if (copied_files[i] == false) continue;
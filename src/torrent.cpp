@@ -141,6 +141,77 @@ bool is_downloading_state(int const st)
 		peer_info.web_seed = true;
 	}
 
+	torrent_peer* web_seed_t::peer_info_for(peer_connection_interface const* p)
+	{
+		if (p == nullptr) return nullptr;
+		if (peer_info.connection == p) return &peer_info;
+		for (auto& pi : extra_peer_info)
+			if (pi.connection == p) return &pi;
+		return nullptr;
+	}
+
+	bool web_seed_t::has_connection(peer_connection_interface const* p) const
+	{
+		if (p == nullptr) return false;
+		if (peer_info.connection == p) return true;
+		return std::any_of(extra_peer_info.begin(), extra_peer_info.end()
+			, [p](ipv4_peer const& pi) { return pi.connection == p; });
+	}
+
+	int web_seed_t::num_connections() const
+	{
+		return (peer_info.connection != nullptr ? 1 : 0)
+			+ int(std::count_if(extra_peer_info.begin(), extra_peer_info.end()
+				, [](ipv4_peer const& pi) { return pi.connection != nullptr; }));
+	}
+
+	ipv4_peer& web_seed_t::free_peer_info()
+	{
+		if (peer_info.connection == nullptr) return peer_info;
+		for (auto& pi : extra_peer_info)
+			if (pi.connection == nullptr) return pi;
+		extra_peer_info.emplace_back(tcp::endpoint(), true, peer_source_flags_t{});
+		extra_peer_info.back().web_seed = true;
+		return extra_peer_info.back();
+	}
+
+	bool web_seed_t::banned() const
+	{
+		return peer_info.banned
+			|| std::any_of(extra_peer_info.begin(), extra_peer_info.end()
+				, [](ipv4_peer const& pi) { return pi.banned; });
+	}
+
+	int web_seed_t::save_restart_block(torrent_peer const* const slot
+		, peer_request const& r, std::vector<char>& data)
+	{
+		int discarded = 0;
+		for (auto i = restart_blocks.begin(); i != restart_blocks.end();)
+		{
+			if (i->first == slot || i->second.request == r)
+			{
+				discarded += int(i->second.data.size());
+				i = restart_blocks.erase(i);
+			}
+			else ++i;
+		}
+		restart_block& b = restart_blocks[slot];
+		b.request = r;
+		b.data.swap(data);
+		return discarded;
+	}
+
+	bool web_seed_t::take_restart_block(peer_request const& r, std::vector<char>& data)
+	{
+		auto const i = std::find_if(restart_blocks.begin(), restart_blocks.end()
+			, [&r](std::pair<torrent_peer const* const, restart_block> const& b)
+			{ return b.second.request == r; });
+		if (i == restart_blocks.end()) return false;
+		data.swap(i->second.data);
+		restart_blocks.erase(i);
+		return true;
+	}
+
 	torrent_hot_members::torrent_hot_members(aux::session_interface& ses
 		, add_torrent_params const& p, bool const session_paused)
 		: m_ses(ses)
@@ -683,6 +754,11 @@ bool is_downloading_state(int const st)
 	}
 
 	void torrent::read_piece(piece_index_t const piece)
+	{
+		read_piece_deadline(piece, max_time());
+	}
+
+	void torrent::read_piece_deadline(piece_index_t const piece, time_point const deadline)
 	{
 		error_code ec;
 		if (m_abort || m_deleted)
@@ -737,9 +813,12 @@ bool is_downloading_state(int const st)
 		for (int i = 0; i < blocks_in_piece; ++i, r.start += block_size())
 		{
 			r.length = std::min(piece_size - r.start, block_size());
-			m_ses.disk_thread().async_read(m_storage, r
-				, [self, r, rp](disk_buffer_holder block, storage_error const& se) mutable
-				{ self->on_disk_read_complete(std::move(block), se, r, rp); });
+			auto handler = [self, r, rp](disk_buffer_holder block, storage_error const& se) mutable
+				{ self->on_disk_read_complete(std::move(block), se, r, rp); };
+			if (deadline != max_time())
+				m_ses.disk_thread().async_read_deadline(m_storage, r, deadline, std::move(handler));
+			else
+				m_ses.disk_thread().async_read(m_storage, r, std::move(handler));
 		}
 		m_ses.deferred_submit_jobs();
 	}
@@ -1615,6 +1694,7 @@ bool is_downloading_state(int const st)
 
 		// if all went well, set the torrent ssl context to this one
 		m_ssl_ctx = std::move(ctx);
+		m_ssl_ctx_id = new_ssl_context_id();
 		// tell the client we need a cert for this torrent
 		alerts().emplace_alert<torrent_need_cert_alert>(get_handle());
 	}
@@ -2873,6 +2953,7 @@ namespace {
 		// if this torrent contains an SSL certificate, make sure
 		// any SSL tracker presents a certificate signed by it
 		req.ssl_ctx = m_ssl_ctx.get();
+		req.ssl_ctx_id = m_ssl_ctx_id;
 #endif
 
 		req.redundant = m_total_redundant_bytes;
@@ -2933,6 +3014,11 @@ namespace {
 		req.num_want = (req.event == event_t::stopped)
 			? 0 : settings().get_int(settings_pack::num_want);
 
+		// when trackers have a backlog of announces, the ones from downloading
+		// torrents with few peers go first
+		if (!is_finished() && num_peers() < req.num_want / 4)
+			req.kind |= tracker_request::needs_peers;
+
 // some older versions of clang had a bug where it would fire this warning here
 #ifdef __clang__
 #pragma clang diagnostic push
@@ -4933,7 +5019,7 @@ namespace {
 		if (is_seed() || (has_picker() && m_picker->has_piece_passed(piece)))
 		{
 			if (flags & torrent_handle::alert_when_available)
-				read_piece(piece);
+				read_piece_deadline(piece, deadline);
 			return;
 		}
 
@@ -5036,7 +5122,7 @@ namespace {
 			{
 				if (i->flags & torrent_handle::alert_when_available)
 				{
-					read_piece(i->piece);
+					read_piece_deadline(i->piece, i->deadline);
 				}
 
 				// if first_requested is min_time(), it wasn't requested as a critical piece
@@ -5775,6 +5861,10 @@ namespace {
 			return;
 		}
 
+		// connections and SSL sessions to trackers made with the old
+		// certificate must not be reused
+		m_ssl_ctx_id = new_ssl_context_id();
+
 		error_code ec;
 		m_ssl_ctx->set_password_callback(
 				[passphrase](std::size_t, ssl::context::password_purpose purpose)
@@ -5825,6 +5915,8 @@ namespace {
 	{
 		if (!m_ssl_ctx) return;
 
+		m_ssl_ctx_id = new_ssl_context_id();
+
 		boost::asio::const_buffer certificate_buf(certificate.c_str(), certificate.size());
 
 		error_code ec;
@@ -6085,17 +6177,20 @@ namespace {
 			debug_log("removing web seed: \"%s\"", web->url.c_str());
 #endif
 
-			auto* peer = static_cast<peer_connection*>(web->peer_info.connection);
-			if (peer != nullptr)
+			web->for_each_peer_info([this](ipv4_peer& pi)
 			{
-				// if we have a connection for this web seed, we also need to
-				// disconnect it and clear its reference to the peer_info object
-				// that's part of the web_seed_t we're about to remove
-				TORRENT_ASSERT(peer->m_in_use == 1337);
-				peer->disconnect(boost::asio::error::operation_aborted, operation_t::bittorrent);
-				peer->set_peer_info(nullptr);
-			}
-			if (has_picker()) picker().clear_peer(&web->peer_info);
+				auto* peer = static_cast<peer_connection*>(pi.connection);
+				if (peer != nullptr)
+				{
+					// if we have a connection for this web seed, we also need to
+					// disconnect it and clear its reference to the peer_info object
+					// that's part of the web_seed_t we're about to remove
+					TORRENT_ASSERT(peer->m_in_use == 1337);
+					peer->disconnect(boost::asio::error::operation_aborted, operation_t::bittorrent);
+					peer->set_peer_info(nullptr);
+				}
+				if (has_picker()) picker().clear_peer(&pi);
+			});
 
 			m_web_seeds.erase(web);
 		}
@@ -6161,7 +6256,7 @@ namespace {
 			return;
 		}
 
-		if (web->peer_info.banned)
+		if (web->banned())
 		{
 #ifndef TORRENT_DISABLE_LOGGING
 			debug_log("banned web seed: %s", web->url.c_str());
@@ -6454,12 +6549,16 @@ namespace {
 		}
 
 		TORRENT_ASSERT(!web->resolving);
-		TORRENT_ASSERT(web->peer_info.connection == nullptr);
+
+		// every connection to the web seed has its own peer_info, for the
+		// piece picker to tell their requests apart
+		ipv4_peer& peer_info = web->free_peer_info();
+		TORRENT_ASSERT(peer_info.connection == nullptr);
 
 		if (aux::is_v4(a))
 		{
-			web->peer_info.addr = a.address().to_v4();
-			web->peer_info.port = a.port();
+			peer_info.addr = a.address().to_v4();
+			peer_info.port = a.port();
 		}
 
 		if (is_paused()) return;
@@ -6525,7 +6624,7 @@ namespace {
 		// The SSRF mitigation for web seeds is that any HTTP server on the
 		// local network may not use any query string parameters
 		if (settings().get_bool(settings_pack::ssrf_mitigation)
-			&& aux::is_local(web->peer_info.addr)
+			&& aux::is_local(peer_info.addr)
 			&& path.find('?') != std::string::npos)
 		{
 #ifndef TORRENT_DISABLE_LOGGING
@@ -6586,7 +6685,7 @@ namespace {
 			, shared_from_this()
 			, std::move(s)
 			, a
-			, &web->peer_info
+			, &peer_info
 			, aux::generate_peer_id(settings())
 		};
 
@@ -6620,22 +6719,22 @@ namespace {
 		update_want_tick();
 		m_ses.insert_peer(c);
 
-		if (web->peer_info.seed)
+		if (peer_info.seed)
 		{
 			TORRENT_ASSERT(m_num_seeds < 0xffff);
 			++m_num_seeds;
 		}
 
-		TORRENT_ASSERT(!web->peer_info.connection);
-		web->peer_info.connection = c.get();
+		TORRENT_ASSERT(!peer_info.connection);
+		peer_info.connection = c.get();
 #if TORRENT_USE_ASSERTS
-		web->peer_info.in_use = true;
+		peer_info.in_use = true;
 #endif
 
-		c->add_stat(std::int64_t(web->peer_info.prev_amount_download) * 1024
-			, std::int64_t(web->peer_info.prev_amount_upload) * 1024);
-		web->peer_info.prev_amount_download = 0;
-		web->peer_info.prev_amount_upload = 0;
+		c->add_stat(std::int64_t(peer_info.prev_amount_download) * 1024
+			, std::int64_t(peer_info.prev_amount_upload) * 1024);
+		peer_info.prev_amount_download = 0;
+		peer_info.prev_amount_upload = 0;
 #ifndef TORRENT_DISABLE_LOGGING
 		if (should_log())
 		{
@@ -8449,8 +8548,9 @@ namespace {
 #else
 			std::string path = save_path;
 #endif
-			m_ses.disk_thread().async_move_storage(m_storage, std::move(path), flags
-				, std::bind(&torrent::on_storage_moved, shared_from_this(), _1, _2, _3));
+			m_ses.disk_thread().async_move_storage_progress(m_storage, std::move(path), flags
+				, std::bind(&torrent::on_storage_moved, shared_from_this(), _1, _2, _3)
+				, std::bind(&torrent::on_storage_move_progress, shared_from_this(), _1, _2));
 			m_moving_storage = true;
 			m_ses.deferred_submit_jobs();
 		}
@@ -8494,6 +8594,15 @@ namespace {
 	}
 	catch (...) { handle_exception(); }
 
+	void torrent::on_storage_move_progress(std::int64_t const copied
+		, std::int64_t const total) try
+	{
+		TORRENT_ASSERT(is_single_thread());
+		if (alerts().should_post<storage_moved_progress_alert>())
+			alerts().emplace_alert<storage_moved_progress_alert>(get_handle(), copied, total);
+	}
+	catch (...) { handle_exception(); }
+
 	torrent_handle torrent::get_handle()
 	{
 		TORRENT_ASSERT(is_single_thread());
@@ -9984,6 +10093,8 @@ namespace {
 		// when set to unlimited, use 100 as the limit
 		int limit = zero_or(settings().get_int(settings_pack::max_web_seed_connections)
 			, 100);
+		int const connections = std::max(1
+			, settings().get_int(settings_pack::urlseed_connections));
 
 		auto const now = aux::time_now32();
 
@@ -9996,8 +10107,22 @@ namespace {
 				continue;
 
 			--limit;
-			if (w->peer_info.connection || w->resolving)
-				continue;
+			if (w->resolving) continue;
+
+			// additional connections to a web seed are opened one at a time,
+			// once the previous one has connected.
+			// web_peer_connection::on_connected() asks for the next one
+			int const num_connections = w->num_connections();
+			if (num_connections >= connections) continue;
+			if (num_connections > 0)
+			{
+				bool connecting = false;
+				w->for_each_peer_info([&](ipv4_peer const& pi) {
+					auto const* pc = static_cast<peer_connection const*>(pi.connection);
+					if (pc && pc->is_connecting()) connecting = true;
+				});
+				if (connecting) continue;
+			}
 
 			connect_to_url_seed(w);
 		}
@@ -10705,7 +10830,7 @@ namespace {
 		std::set<std::string> ret;
 		for (auto const& s : m_web_seeds)
 		{
-			if (s.peer_info.banned) continue;
+			if (s.banned()) continue;
 			if (s.removed) continue;
 			ret.insert(s.url);
 		}
@@ -10727,7 +10852,7 @@ namespace {
 	void torrent::disconnect_web_seed(peer_connection* p)
 	{
 		auto const i = std::find_if(m_web_seeds.begin(), m_web_seeds.end()
-			, [p] (web_seed_t const& ws) { return ws.peer_info.connection == p; });
+			, [p] (web_seed_t const& ws) { return ws.has_connection(p); });
 
 		// this happens if the web server responded with a redirect
 		// or with something incorrect, so that we removed the web seed
@@ -10736,20 +10861,23 @@ namespace {
 
 		TORRENT_ASSERT(i->resolving == false);
 
-		TORRENT_ASSERT(i->peer_info.connection);
-		i->peer_info.connection = nullptr;
+		torrent_peer* pi = i->peer_info_for(p);
+		TORRENT_ASSERT(pi);
+		pi->connection = nullptr;
 	}
 
 	void torrent::remove_web_seed_conn(peer_connection* p, error_code const& ec
 		, operation_t const op, disconnect_severity_t const error)
 	{
 		auto const i = std::find_if(m_web_seeds.begin(), m_web_seeds.end()
-			, [p] (web_seed_t const& ws) { return ws.peer_info.connection == p; });
+			, [p] (web_seed_t const& ws) { return ws.has_connection(p); });
 
 		TORRENT_ASSERT(i != m_web_seeds.end());
 		if (i == m_web_seeds.end()) return;
 
-		auto* peer = static_cast<peer_connection*>(i->peer_info.connection);
+		// the other connections to this web seed are closed by
+		// remove_web_seed_iter()
+		auto* peer = static_cast<peer_connection*>(i->peer_info_for(p)->connection);
 		if (peer != nullptr)
 		{
 			// if we have a connection for this web seed, we also need to
@@ -10766,7 +10894,7 @@ namespace {
 	{
 		TORRENT_ASSERT(is_single_thread());
 		auto const i = std::find_if(m_web_seeds.begin(), m_web_seeds.end()
-			, [p] (web_seed_t const& ws) { return ws.peer_info.connection == p; });
+			, [p] (web_seed_t const& ws) { return ws.has_connection(p); });
 
 		TORRENT_ASSERT(i != m_web_seeds.end());
 		if (i == m_web_seeds.end()) return;
@@ -11,16 +11,21 @@ see LICENSE file.
 */
 
 #include <cctype>
+#include <atomic>
+#include <algorithm>
 
 #include "libtorrent/aux_/io.hpp"
 #include "libtorrent/aux_/session_interface.hpp"
 #include "libtorrent/aux_/session_settings.hpp"
 #include "libtorrent/aux_/http_tracker_connection.hpp"
+#include "libtorrent/aux_/http_connection.hpp"
 #include "libtorrent/performance_counters.hpp"
 #include "libtorrent/aux_/socket_io.hpp"
 #include "libtorrent/aux_/ssl.hpp"
 #include "libtorrent/aux_/tracker_manager.hpp"
 #include "libtorrent/aux_/udp_tracker_connection.hpp"
+#include "libtorrent/aux_/parse_url.hpp"
+#include "libtorrent/aux_/random.hpp"
 
 #if TORRENT_USE_RTC
 #include "libtorrent/aux_/websocket_tracker_connection.hpp"
@@ -30,6 +35,78 @@ using namespace std::placeholders;
 
 namespace libtorrent::aux {
 
+namespace {
+
+#if TORRENT_USE_SSL
+	// the most SSL sessions to remember, and for how long. Servers rarely
+	// let sessions be resumed after more than an hour
+	constexpr int max_ssl_sessions = 100;
+	constexpr minutes32 max_ssl_session_age(60);
+#endif
+
+	std::string url_protocol(std::string const& url)
+	{
+		return url.substr(0, url.find(':'));
+	}
+
+	// the max number of torrents to scrape with a single request, or 0 if
+	// scrapes with this protocol can't be batched
+	int max_scrape_batch(std::string const& protocol)
+	{
+		if (protocol == "udp") return udp_tracker_connection::max_scrape_hashes;
+#if TORRENT_USE_SSL
+		if (protocol == "http" || protocol == "https")
+#else
+		if (protocol == "http")
+#endif
+			return http_tracker_connection::max_scrape_hashes;
+		return 0;
+	}
+
+	// announces are scheduled per tracker host, regardless of port and path
+	std::string tracker_host(std::string const& url)
+	{
+		error_code ec;
+		std::string host;
+		std::tie(std::ignore, std::ignore, host, std::ignore, std::ignore)
+			= parse_url_components(url, ec);
+		return ec ? url : host;
+	}
+
+	// whether two scrape requests can be sent to the tracker as one
+	bool same_scrape_group(tracker_request const& a, tracker_request const& b)
+	{
+		return a.url == b.url
+			&& a.outgoing_socket == b.outgoing_socket
+			&& a.kind == b.kind
+			&& a.private_torrent == b.private_torrent
+			&& a.filter == b.filter
+			&& a.ipv4 == b.ipv4
+			&& a.ipv6 == b.ipv6
+#if TORRENT_ABI_VERSION == 1
+			&& a.auth == b.auth
+#endif
+#if TORRENT_USE_SSL
+			&& a.ssl_ctx == b.ssl_ctx
+#endif
+#if TORRENT_USE_I2P
+			&& a.i2pconn == b.i2pconn
+#endif
+			;
+	}
+}
+
+	std::uint16_t announce_port(tracker_request const& req
+		, std::uint16_t const listen_port)
+	{
+#if TORRENT_USE_I2P
+		if (req.kind & tracker_request::i2p) return 1;
+#else
+		TORRENT_UNUSED(req);
+#endif
+		return listen_port == 0 ? 1 : listen_port;
+	}
+
 	timeout_handler::timeout_handler(io_context& ios)
 		: m_start_time(clock_type::now())
 		, m_read_time(m_start_time)
@@ -148,9 +225,14 @@ namespace libtorrent::aux {
 	void tracker_connection::fail_impl(error_code const& ec, operation_t const op
 		, std::string const msg, seconds32 const interval, seconds32 const min_interval)
 	{
+		seconds32 const retry = interval.count() == 0 ? min_interval : interval;
 		std::shared_ptr<request_callback> cb = requester();
-		if (cb) cb->tracker_request_error(m_req, ec, op, msg
-			, interval.count() == 0 ? min_interval : interval);
+		if (cb) cb->tracker_request_error(m_req, ec, op, msg, retry);
+		for (auto const& b : m_batch)
+		{
+			if (auto bcb = b.requester.lock())
+				bcb->tracker_request_error(b.req, ec, op, msg, retry);
+		}
 		close();
 	}
 
@@ -212,6 +294,10 @@ namespace libtorrent::aux {
 			, [c] (std::shared_ptr<aux::http_tracker_connection> const& ptr) { return ptr.get() == c; });
 		if (i != m_http_conns.end())
 		{
+			// finishing the announce may start the next one to the same host,
+			// which adds to m_http_conns. So it's done last, with the
+			// connection already removed
+			auto const con = std::move(*i);
 			m_http_conns.erase(i);
 			if (!m_queued.empty())
 			{
@@ -221,6 +307,7 @@ namespace libtorrent::aux {
 				m_http_conns.back()->start();
 				m_stats_counters.set_value(counters::num_queued_tracker_announces, std::int64_t(m_queued.size()));
 			}
+			announce_finished(*con);
 			return;
 		}
 
@@ -228,15 +315,21 @@ namespace libtorrent::aux {
 			, [c] (std::shared_ptr<aux::http_tracker_connection> const& ptr) { return ptr.get() == c; });
 		if (j != m_queued.end())
 		{
+			auto const con = std::move(*j);
 			m_queued.erase(j);
 			m_stats_counters.set_value(counters::num_queued_tracker_announces, std::int64_t(m_queued.size()));
+			announce_finished(*con);
 		}
 	}
 
 	void tracker_manager::remove_request(aux::udp_tracker_connection const* c)
 	{
 		TORRENT_ASSERT(is_single_thread());
-		m_udp_conns.erase(c->transaction_id());
+		auto const i = m_udp_conns.find(c->transaction_id());
+		if (i == m_udp_conns.end()) return;
+		auto const con = i->second;
+		m_udp_conns.erase(i);
+		announce_finished(*con);
 	}
 
 #if TORRENT_USE_RTC
@@ -257,6 +350,171 @@ namespace libtorrent::aux {
 		m_udp_conns[tid] = c;
 	}
 
+	tracker_manager::connection_id_status tracker_manager::get_connection_id(
+		std::shared_ptr<aux::udp_tracker_connection> const& c, std::int64_t& id)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		time_point const now = clock_type::now();
+		udp_tracker_key key = c->cache_key();
+
+		auto i = m_connection_ids.find(key);
+		if (i == m_connection_ids.end())
+		{
+			// before adding a tracker, drop the ones we're not using anymore
+			for (auto k = m_connection_ids.begin(); k != m_connection_ids.end();)
+			{
+				connection_id_entry const& e = k->second;
+				if (e.expires <= now && e.connecting.expired() && e.waiting.empty())
+				{
+					if (e.refresh_tid != 0) m_connection_id_refresh.erase(e.refresh_tid);
+					k = m_connection_ids.erase(k);
+				}
+				else ++k;
+			}
+			i = m_connection_ids.emplace(std::move(key), connection_id_entry{}).first;
+		}
+		connection_id_entry& e = i->second;
+
+		if (now < e.expires)
+		{
+			id = e.connection_id;
+			m_stats_counters.inc_stats_counter(counters::udp_tracker_connection_id_hits);
+			refresh_connection_id(i->first, e, now);
+			return connection_id_status::valid;
+		}
+
+		auto const owner = e.connecting.lock();
+		if (owner && owner != c && !owner->cancelled())
+		{
+			e.waiting.push_back(c);
+			m_stats_counters.inc_stats_counter(counters::udp_tracker_connection_id_waits);
+			return connection_id_status::pending;
+		}
+
+		e.connecting = c;
+		m_stats_counters.inc_stats_counter(counters::udp_tracker_connection_id_misses);
+		return connection_id_status::missing;
+	}
+
+	void tracker_manager::connection_id_received(udp_tracker_key const& key
+		, std::int64_t const id)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		auto const i = m_connection_ids.find(key);
+		if (i == m_connection_ids.end()) return;
+		connection_id_entry& e = i->second;
+
+		e.connection_id = id;
+		e.expires = clock_type::now()
+			+ seconds(m_settings.get_int(settings_pack::udp_tracker_token_expiry));
+		e.connecting.reset();
+		if (e.refresh_tid != 0)
+		{
+			m_connection_id_refresh.erase(e.refresh_tid);
+			e.refresh_tid = 0;
+		}
+
+		// sending the requests may fail the connections, don't hold on to
+		// the entry while doing so
+		auto const waiting = std::move(e.waiting);
+		e.waiting.clear();
+		for (auto const& w : waiting)
+		{
+			auto const c = w.lock();
+			if (c) c->on_connection_id(key, id);
+		}
+	}
+
+	void tracker_manager::connection_id_failed(udp_tracker_key const& key
+		, aux::udp_tracker_connection const* c)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		auto const i = m_connection_ids.find(key);
+		if (i == m_connection_ids.end()) return;
+		connection_id_entry& e = i->second;
+		if (e.connecting.lock().get() != c) return;
+
+		e.connecting.reset();
+		auto const waiting = std::move(e.waiting);
+		e.waiting.clear();
+
+		// the waiting connections send their own connect requests. This is
+		// deferred, since we may be in the middle of aborting all of them
+		for (auto const& w : waiting)
+		{
+			auto const con = w.lock();
+			if (!con) continue;
+			post(con->get_executor(), [con, key] { con->on_connection_id_failed(key); });
+		}
+	}
+
+	void tracker_manager::refresh_connection_id(udp_tracker_key const& key
+		, connection_id_entry& e, time_point const now)
+	{
+		time_duration const expiry = seconds(m_settings.get_int(settings_pack::udp_tracker_token_expiry));
+		if (e.expires - now > expiry / 4) return;
+
+		// a refresh is already in flight
+		if (e.refresh_tid != 0 && now - e.refresh_sent < expiry / 4) return;
+		if (m_abort) return;
+
+		if (e.refresh_tid != 0) m_connection_id_refresh.erase(e.refresh_tid);
+		e.refresh_tid = 0;
+
+		std::uint32_t tid;
+		do
+		{
+			tid = random(0xfffffffe) + 1;
+		} while (m_udp_conns.count(tid) || m_connection_id_refresh.count(tid));
+
+		std::array<char, 16> const buf = udp_tracker_connection::connect_packet(tid);
+		error_code ec;
+		if (!key.hostname.empty())
+		{
+			send_hostname(key.socket, key.hostname.c_str(), key.ep.port(), buf, ec
+				, udp_socket::tracker_connection);
+		}
+		else
+		{
+			send(key.socket, key.ep, buf, ec, udp_socket::tracker_connection);
+		}
+		if (ec) return;
+
+		sent_bytes(16 + 28); // assuming UDP/IP header
+		e.refresh_tid = tid;
+		e.refresh_sent = now;
+		m_connection_id_refresh.emplace(tid, key);
+		m_stats_counters.inc_stats_counter(counters::udp_tracker_connection_id_refreshes);
+	}
+
+	bool tracker_manager::on_refresh_response(std::uint32_t const tid
+		, udp::endpoint const* ep, span<char const> buf)
+	{
+		auto const r = m_connection_id_refresh.find(tid);
+		TORRENT_ASSERT(r != m_connection_id_refresh.end());
+		udp_tracker_key const key = r->second;
+
+		// ignore packets not sent from the tracker
+		if (ep != nullptr && key.hostname.empty() && *ep != key.ep) return false;
+
+		span<char const> ptr = buf;
+		auto const action = aux::read_uint32(ptr);
+		aux::read_uint32(ptr);
+
+		m_connection_id_refresh.erase(r);
+		auto const i = m_connection_ids.find(key);
+		if (i == m_connection_ids.end()) return true;
+		i->second.refresh_tid = 0;
+
+		// if the refresh failed, the current connection ID is used until it
+		// expires
+		if (action != 0 || ptr.size() < 8) return true;
+
+		received_bytes(int(buf.size()) + 28); // assuming UDP/IP header
+		connection_id_received(key, aux::read_int64(ptr));
+		return true;
+	}
+
 	void tracker_manager::queue_request(
 		io_context& ios
 		, tracker_request&& req
@@ -273,7 +531,263 @@ namespace libtorrent::aux {
 			cb->debug_log("*** QUEUE_TRACKER_REQUEST [ listen_port: %d ]", req.listen_port);
 #endif
 
-		std::string const protocol = req.url.substr(0, req.url.find(':'));
+		if ((req.kind & tracker_request::scrape_request)
+			&& sett.get_int(settings_pack::scrape_batch_delay) > 0
+			&& max_scrape_batch(url_protocol(req.url)) > 1)
+		{
+			queue_scrape(ios, std::move(req), std::move(c));
+			return;
+		}
+
+		// once the torrent has stopped, the announces it scheduled earlier
+		// to this tracker are stale. They must not be sent after this one
+		if (!(req.kind & tracker_request::scrape_request)
+			&& req.event == event_t::stopped)
+		{
+			drop_scheduled_announces(req);
+		}
+
+		if (!(req.kind & tracker_request::scrape_request)
+			&& req.event != event_t::stopped
+			&& sett.get_int(settings_pack::max_concurrent_host_announces) > 0
+			&& max_scrape_batch(url_protocol(req.url)) > 0)
+		{
+			schedule_announce(ios, std::move(req), std::move(c));
+			return;
+		}
+
+		start_request(ios, std::move(req), std::move(c), {});
+	}
+
+	void tracker_manager::schedule_announce(io_context& ios, tracker_request&& req
+		, std::weak_ptr<request_callback> c)
+	{
+		m_announce_ios = &ios;
+		time_point const now = clock_type::now();
+
+		// regular re-announces are not urgent, they are spread out over the
+		// jitter window. Announces with an event, or triggered by the user,
+		// are sent as soon as the tracker host has a free slot
+		time_point deadline = now;
+		int const jitter = m_settings.get_int(settings_pack::announce_jitter);
+		if (jitter > 0 && !req.triggered_manually
+			&& (req.event == event_t::none || req.event == event_t::paused))
+		{
+			deadline += milliseconds(random(std::uint32_t(jitter)));
+		}
+
+		int const priority = (req.kind & tracker_request::needs_peers) ? 0 : 1;
+		announce_host& h = m_announce_hosts[tracker_host(req.url)];
+		h.queue[priority].emplace(deadline, queued_announce{std::move(req), std::move(c), now});
+		++m_num_scheduled_announces;
+		m_stats_counters.set_value(counters::num_scheduled_tracker_announces
+			, m_num_scheduled_announces);
+
+		dispatch_announces();
+	}
+
+	void tracker_manager::drop_scheduled_announces(tracker_request const& req)
+	{
+		auto const i = m_announce_hosts.find(tracker_host(req.url));
+		if (i == m_announce_hosts.end()) return;
+
+		announce_host& h = i->second;
+		for (auto& q : h.queue)
+		{
+			for (auto a = q.begin(); a != q.end();)
+			{
+				tracker_request const& r = a->second.req;
+				if (r.info_hash == req.info_hash
+					&& r.url == req.url
+					&& r.outgoing_socket == req.outgoing_socket)
+				{
+					a = q.erase(a);
+					--m_num_scheduled_announces;
+				}
+				else ++a;
+			}
+		}
+		m_stats_counters.set_value(counters::num_scheduled_tracker_announces
+			, m_num_scheduled_announces);
+
+		if (h.in_flight == 0 && h.queue[0].empty() && h.queue[1].empty())
+			m_announce_hosts.erase(i);
+	}
+
+	void tracker_manager::dispatch_announces()
+	{
+		TORRENT_ASSERT(is_single_thread());
+		if (m_announce_ios == nullptr) return;
+
+		int const limit = std::max(1
+			, m_settings.get_int(settings_pack::max_concurrent_host_announces));
+		time_point const now = clock_type::now();
+
+		// the earliest time an announce that's waiting for its deadline (and
+		// not for a slot) may be sent
+		time_point next = max_time();
+
+		// the announces are started once we're done with m_announce_hosts,
+		// since starting one may end up calling back into the scheduler
+		std::vector<std::pair<std::string, queued_announce>> ready;
+
+		for (auto i = m_announce_hosts.begin(); i != m_announce_hosts.end();)
+		{
+			announce_host& h = i->second;
+			while (h.in_flight < limit)
+			{
+				// pick the announce that's due from the highest priority queue
+				auto q = std::find_if(h.queue.begin(), h.queue.end()
+					, [now](std::multimap<time_point, queued_announce> const& e)
+					{ return !e.empty() && e.begin()->first <= now; });
+				if (q == h.queue.end()) break;
+
+				queued_announce a = std::move(q->begin()->second);
+				q->erase(q->begin());
+				--m_num_scheduled_announces;
+				m_stats_counters.inc_stats_counter(counters::tracker_announce_queue_time
+					, total_microseconds(now - a.queued));
+
+				++h.in_flight;
+				ready.emplace_back(i->first, std::move(a));
+			}
+
+			if (h.in_flight < limit)
+			{
+				for (auto const& q : h.queue)
+					if (!q.empty()) next = std::min(next, q.begin()->first);
+			}
+
+			if (h.in_flight == 0 && h.queue[0].empty() && h.queue[1].empty())
+				i = m_announce_hosts.erase(i);
+			else
+				++i;
+		}
+		m_stats_counters.set_value(counters::num_scheduled_tracker_announces
+			, m_num_scheduled_announces);
+
+		if (next != max_time())
+		{
+			if (!m_announce_timer) m_announce_timer.emplace(*m_announce_ios);
+			ADD_OUTSTANDING_ASYNC("tracker_manager::dispatch_announces");
+			m_announce_timer->expires_at(next);
+			m_announce_timer->async_wait([this](error_code const& ec)
+			{
+				COMPLETE_ASYNC("tracker_manager::dispatch_announces");
+				if (ec) return;
+				dispatch_announces();
+			});
+		}
+
+		for (auto& r : ready)
+		{
+			std::string const host = r.first;
+			if (start_request(*m_announce_ios, std::move(r.second.req)
+				, std::move(r.second.requester), {}, std::move(r.first)))
+				continue;
+
+			// no connection was created, there's nothing to wait for
+			auto const i = m_announce_hosts.find(host);
+			TORRENT_ASSERT(i != m_announce_hosts.end());
+			if (i != m_announce_hosts.end()) --i->second.in_flight;
+		}
+	}
+
+	void tracker_manager::announce_finished(tracker_connection& c)
+	{
+		if (c.scheduled_host().empty()) return;
+
+		auto const i = m_announce_hosts.find(c.scheduled_host());
+		TORRENT_ASSERT(i != m_announce_hosts.end());
+		c.set_scheduled_host({});
+		if (i == m_announce_hosts.end()) return;
+
+		TORRENT_ASSERT(i->second.in_flight > 0);
+		--i->second.in_flight;
+		m_stats_counters.inc_stats_counter(counters::tracker_announces);
+		m_stats_counters.inc_stats_counter(counters::tracker_announce_time
+			, total_microseconds(clock_type::now() - c.dispatch_time()));
+
+		dispatch_announces();
+	}
+
+	void tracker_manager::queue_scrape(io_context& ios, tracker_request&& req
+		, std::weak_ptr<request_callback> c)
+	{
+		auto group = std::find_if(m_pending_scrapes.begin(), m_pending_scrapes.end()
+			, [&](std::vector<batched_request> const& g)
+			{ return same_scrape_group(g.front().req, req); });
+		if (group == m_pending_scrapes.end())
+		{
+			m_pending_scrapes.emplace_back();
+			group = std::prev(m_pending_scrapes.end());
+		}
+		int const max_batch = max_scrape_batch(url_protocol(req.url));
+		group->push_back({std::move(req), std::move(c)});
+		++m_num_pending_scrapes;
+
+		if (int(group->size()) >= max_batch)
+		{
+			// this group is as large as it gets, there's no point in waiting
+			// any longer
+			std::vector<batched_request> batch = std::move(*group);
+			m_pending_scrapes.erase(group);
+			m_num_pending_scrapes -= int(batch.size());
+			start_scrapes(ios, std::move(batch));
+			return;
+		}
+
+		// the timer is already running for the scrapes queued before this one
+		if (m_num_pending_scrapes > 1) return;
+
+		if (!m_scrape_timer) m_scrape_timer.emplace(ios);
+		ADD_OUTSTANDING_ASYNC("tracker_manager::flush_scrapes");
+		m_scrape_timer->expires_after(milliseconds(
+			m_settings.get_int(settings_pack::scrape_batch_delay)));
+		m_scrape_timer->async_wait([this, &ios](error_code const& ec)
+		{
+			COMPLETE_ASYNC("tracker_manager::flush_scrapes");
+			if (ec) return;
+			flush_scrapes(ios);
+		});
+	}
+
+	void tracker_manager::flush_scrapes(io_context& ios)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		std::vector<std::vector<batched_request>> groups;
+		groups.swap(m_pending_scrapes);
+		m_num_pending_scrapes = 0;
+
+		for (auto& g : groups)
+			start_scrapes(ios, std::move(g));
+	}
+
+	void tracker_manager::start_scrapes(io_context& ios
+		, std::vector<batched_request> batch)
+	{
+		TORRENT_ASSERT(!batch.empty());
+#ifndef TORRENT_DISABLE_LOGGING
+		if (m_ses.should_log())
+		{
+			m_ses.session_log("sending %d scrapes to %s in one request"
+				, int(batch.size()), batch.front().req.url.c_str());
+		}
+#endif
+		tracker_request req = std::move(batch.front().req);
+		std::weak_ptr<request_callback> c = std::move(batch.front().requester);
+		batch.erase(batch.begin());
+		start_request(ios, std::move(req), std::move(c), std::move(batch));
+	}
+
+	bool tracker_manager::start_request(io_context& ios
+		, tracker_request&& req
+		, std::weak_ptr<request_callback> c
+		, std::vector<batched_request> batch
+		, std::string scheduled_host)
+	{
+		aux::session_settings const& sett = m_settings;
+		std::string const protocol = url_protocol(req.url);
 
 #if TORRENT_USE_SSL
 		if (protocol == "http" || protocol == "https")
@@ -282,6 +796,8 @@ namespace libtorrent::aux {
 #endif
 		{
 			auto con = std::make_shared<aux::http_tracker_connection>(ios, *this, std::move(req), c);
+			con->set_batch(std::move(batch));
+			if (!scheduled_host.empty()) con->set_scheduled_host(std::move(scheduled_host));
 			if (m_http_conns.size() < std::size_t(sett.get_int(settings_pack::max_concurrent_http_announces)))
 			{
 				m_http_conns.push_back(std::move(con));
@@ -292,20 +808,24 @@ namespace libtorrent::aux {
 				m_queued.push_back(std::move(con));
 				m_stats_counters.set_value(counters::num_queued_tracker_announces, std::int64_t(m_queued.size()));
 			}
-			return;
+			return true;
 		}
 		else if (protocol == "udp")
 		{
 			auto con = std::make_shared<aux::udp_tracker_connection>(ios, *this, std::move(req), c);
+			con->set_batch(std::move(batch));
+			if (!scheduled_host.empty()) con->set_scheduled_host(std::move(scheduled_host));
 			m_udp_conns[con->transaction_id()] = con;
 			con->start();
-			return;
+			return true;
         }
 #if TORRENT_USE_RTC
         else if (protocol == "ws" || protocol == "wss")
         {
+			TORRENT_ASSERT(batch.empty());
+			TORRENT_ASSERT(scheduled_host.empty());
 			std::shared_ptr<request_callback> cb = c.lock();
-			if (!cb) return;
+			if (!cb) return false;
 
 			// TODO: introduce a setting for max_offers
 			const int max_offers = 10;
@@ -336,7 +856,7 @@ namespace libtorrent::aux {
 					m_websocket_conns[req.url] = con;
 				}
 			});
-			return;
+			return false;
         }
 #endif
 		// we need to post the error to avoid deadlock
@@ -344,6 +864,7 @@ namespace libtorrent::aux {
 			post(ios, std::bind(&request_callback::tracker_request_error, r, std::move(req)
 				, errors::unsupported_url_protocol, operation_t::parse_address
 				, "", seconds32(0)));
+		return false;
 	}
 
 	bool tracker_manager::incoming_packet(udp::endpoint const& ep
@@ -370,6 +891,9 @@ namespace libtorrent::aux {
 		if (action > 3) return false;
 
 		std::uint32_t const transaction = aux::read_uint32(ptr);
+		if (m_connection_id_refresh.count(transaction))
+			return on_refresh_response(transaction, &ep, buf);
+
 		auto const i = m_udp_conns.find(transaction);
 
 		if (i == m_udp_conns.end())
@@ -411,6 +935,9 @@ namespace libtorrent::aux {
 		if (action > 3) return false;
 
 		std::uint32_t const transaction = aux::read_uint32(ptr);
+		if (m_connection_id_refresh.count(transaction))
+			return on_refresh_response(transaction, nullptr, buf);
+
 		auto const i = m_udp_conns.find(transaction);
 
 		if (i == m_udp_conns.end())
@@ -446,6 +973,168 @@ namespace libtorrent::aux {
 		m_send_fun(sock, ep, p, ec, flags);
 	}
 
+	std::shared_ptr<aux::http_connection> tracker_manager::take_http_connection(
+		http_tracker_key const& key)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		auto const i = m_idle_http_conns.find(key);
+		if (i == m_idle_http_conns.end()) return {};
+
+		time_point const now = clock_type::now();
+		std::shared_ptr<aux::http_connection> ret;
+		while (!ret && !i->second.empty())
+		{
+			idle_http_connection c = std::move(i->second.back());
+			i->second.pop_back();
+			--m_num_idle_http_conns;
+			if (c.expires > now && c.connection->idle())
+				ret = std::move(c.connection);
+			else
+				c.connection->close();
+		}
+		if (i->second.empty()) m_idle_http_conns.erase(i);
+		m_stats_counters.set_value(counters::num_idle_http_tracker_connections
+			, m_num_idle_http_conns);
+
+		if (ret) m_stats_counters.inc_stats_counter(counters::http_tracker_connections_reused);
+		return ret;
+	}
+
+	void tracker_manager::return_http_connection(io_context& ios
+		, http_tracker_key const& key, std::shared_ptr<aux::http_connection> c)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		TORRENT_ASSERT(c->idle());
+
+		int const timeout = m_settings.get_int(settings_pack::tracker_keep_alive_timeout);
+		int const max_idle = m_settings.get_int(settings_pack::max_idle_tracker_connections);
+		auto const i = m_idle_http_conns.find(key);
+		if (m_abort || timeout <= 0 || max_idle <= 0
+			|| (i != m_idle_http_conns.end() && int(i->second.size()) >= max_idle))
+		{
+			c->close();
+			return;
+		}
+
+		// don't keep the previous owner alive
+		c->set_handlers(nullptr, nullptr, nullptr, nullptr);
+
+		m_idle_http_conns[key].push_back({std::move(c)
+			, clock_type::now() + seconds(timeout)});
+		++m_num_idle_http_conns;
+		m_stats_counters.set_value(counters::num_idle_http_tracker_connections
+			, m_num_idle_http_conns);
+
+		// the timer is already set for the connections returned before this
+		// one, and they expire first
+		if (m_num_idle_http_conns > 1) return;
+		if (!m_idle_http_timer) m_idle_http_timer.emplace(ios);
+		expire_http_connections();
+	}
+
+	void tracker_manager::expire_http_connections()
+	{
+		TORRENT_ASSERT(is_single_thread());
+		time_point const now = clock_type::now();
+		time_point next = max_time();
+		for (auto i = m_idle_http_conns.begin(); i != m_idle_http_conns.end();)
+		{
+			// the connections are in the order they were returned in, so the
+			// expired ones are first
+			auto& conns = i->second;
+			auto const end = std::find_if(conns.begin(), conns.end()
+				, [now](idle_http_connection const& c) { return c.expires > now; });
+			for (auto c = conns.begin(); c != end; ++c)
+				c->connection->close();
+			m_num_idle_http_conns -= int(end - conns.begin());
+			conns.erase(conns.begin(), end);
+
+			if (conns.empty())
+			{
+				i = m_idle_http_conns.erase(i);
+				continue;
+			}
+			next = std::min(next, conns.front().expires);
+			++i;
+		}
+		m_stats_counters.set_value(counters::num_idle_http_tracker_connections
+			, m_num_idle_http_conns);
+
+		if (next == max_time()) return;
+
+		TORRENT_ASSERT(m_idle_http_timer);
+		ADD_OUTSTANDING_ASYNC("tracker_manager::expire_http_connections");
+		m_idle_http_timer->expires_at(next);
+		m_idle_http_timer->async_wait([this](error_code const& ec)
+		{
+			COMPLETE_ASYNC("tracker_manager::expire_http_connections");
+			if (ec) return;
+			expire_http_connections();
+		});
+	}
+
+	void tracker_manager::close_idle_http_connections()
+	{
+		for (auto& i : m_idle_http_conns)
+			for (auto& c : i.second) c.connection->close();
+		m_idle_http_conns.clear();
+		m_num_idle_http_conns = 0;
+		m_stats_counters.set_value(counters::num_idle_http_tracker_connections, 0);
+		if (m_idle_http_timer) m_idle_http_timer->cancel();
+	}
+
+	void tracker_manager::http_connection_opened(time_duration const connect_time
+		, bool const ssl_resumed)
+	{
+		TORRENT_ASSERT(is_single_thread());
+		m_stats_counters.inc_stats_counter(counters::http_tracker_connections_opened);
+		m_stats_counters.inc_stats_counter(counters::http_tracker_connect_time
+			, total_microseconds(connect_time));
+		if (ssl_resumed)
+			m_stats_counters.inc_stats_counter(counters::http_tracker_ssl_sessions_resumed);
+	}
+
+#if TORRENT_USE_SSL
+	std::uint32_t new_ssl_context_id()
+	{
+		static std::atomic<std::uint32_t> id{0};
+		return ++id;
+	}
+
+	ssl::session_handle tracker_manager::ssl_session(http_tracker_key const& key) const
+	{
+		auto const i = m_ssl_sessions.find(key);
+		if (i == m_ssl_sessions.end()) return {};
+		if (clock_type::now() - i->second.saved > max_ssl_session_age) return {};
+		return i->second.session;
+	}
+
+	void tracker_manager::save_ssl_session(http_tracker_key const& key
+		, ssl::session_handle s)
+	{
+		if (!s) return;
+		time_point const now = clock_type::now();
+		m_ssl_sessions[key] = {std::move(s), now};
+
+		// servers don't resume sessions this old anyway, and the keys of
+		// trackers we don't announce to anymore would stay forever
+		for (auto i = m_ssl_sessions.begin(); i != m_ssl_sessions.end();)
+		{
+			if (now - i->second.saved > max_ssl_session_age)
+				i = m_ssl_sessions.erase(i);
+			else
+				++i;
+		}
+		if (int(m_ssl_sessions.size()) > max_ssl_sessions)
+		{
+			auto const oldest = std::min_element(m_ssl_sessions.begin(), m_ssl_sessions.end()
+				, [](auto const& lhs, auto const& rhs)
+				{ return lhs.second.saved < rhs.second.saved; });
+			m_ssl_sessions.erase(oldest);
+		}
+	}
+#endif
+
 	void tracker_manager::stop()
 	{
 		abort_all_requests();
@@ -462,6 +1151,41 @@ namespace libtorrent::aux {
 		std::vector<std::shared_ptr<aux::http_tracker_connection>> close_http_connections;
 		std::vector<std::shared_ptr<aux::udp_tracker_connection>> close_udp_connections;
 
+		// scrapes are never event=stopped requests and neither are the
+		// announces in the scheduler. The ones that haven't been sent yet are
+		// dropped, just like the connections closed below, without reporting
+		// an error. The timer exists as long as there are pending scrapes
+#ifndef TORRENT_DISABLE_LOGGING
+		for (auto const& g : m_pending_scrapes)
+		{
+			for (auto const& b : g)
+			{
+				std::shared_ptr<request_callback> rc = b.requester.lock();
+				if (rc) rc->debug_log("aborting: %s", b.req.url.c_str());
+			}
+		}
+#endif
+		if (m_scrape_timer) m_scrape_timer->cancel();
+		m_pending_scrapes.clear();
+		m_num_pending_scrapes = 0;
+		for (auto& h : m_announce_hosts)
+		{
+			for (auto& q : h.second.queue)
+			{
+#ifndef TORRENT_DISABLE_LOGGING
+				for (auto const& a : q)
+				{
+					std::shared_ptr<request_callback> rc = a.second.requester.lock();
+					if (rc) rc->debug_log("aborting: %s", a.second.req.url.c_str());
+				}
+#endif
+				q.clear();
+			}
+		}
+		m_num_scheduled_announces = 0;
+		m_stats_counters.set_value(counters::num_scheduled_tracker_announces, 0);
+		if (m_announce_timer) m_announce_timer->cancel();
+
 		for (auto const& c : m_queued)
 		{
 			tracker_request const& req = c->tracker_req();
@@ -520,6 +1244,10 @@ namespace libtorrent::aux {
 		for (auto const& c : close_http_connections)
 			c->close();
 
+		// closing the requests may have returned their connections to the
+		// pool
+		close_idle_http_connections();
+
 		for (auto const& c : close_udp_connections)
 			c->close();
 
@@ -533,6 +1261,8 @@ namespace libtorrent::aux {
 	{
 		TORRENT_ASSERT(is_single_thread());
 		return m_http_conns.empty() && m_udp_conns.empty()
+			&& m_num_pending_scrapes == 0
+			&& m_num_scheduled_announces == 0
 #if TORRENT_USE_RTC
 			&& m_websocket_conns.empty()
 #endif
@@ -546,6 +1276,6 @@ namespace libtorrent::aux {
 #if TORRENT_USE_RTC
 			+ m_websocket_conns.size()
 #endif
-			);
+			) + m_num_pending_scrapes + m_num_scheduled_announces;
 	}
 }
@@ -15,6 +15,7 @@ see LICENSE file.
 #include <cctype>
 #include <functional>
 #include <tuple>
+#include <array>
 
 #include "libtorrent/aux_/parse_url.hpp"
 #include "libtorrent/aux_/udp_tracker_connection.hpp"
@@ -35,11 +36,6 @@ see LICENSE file.
 
 namespace libtorrent::aux {
 
-	std::map<address, udp_tracker_connection::connection_cache_entry>
-		udp_tracker_connection::m_connection_cache;
-
-	std::mutex udp_tracker_connection::m_cache_mutex;
-
 	udp_tracker_connection::udp_tracker_connection(
 		io_context& ios
 		, tracker_manager& man
@@ -113,6 +109,9 @@ namespace libtorrent::aux {
 	void udp_tracker_connection::fail(error_code const& ec, operation_t const op
 		, char const* msg, seconds32 const interval, seconds32 const min_interval)
 	{
+		release_connect();
+		m_waiting_for_id = false;
+
 		// m_target failed. remove it from the endpoint list
 		auto const i = std::find(m_endpoints.begin()
 			, m_endpoints.end(), make_tcp(m_target));
@@ -236,28 +235,67 @@ namespace libtorrent::aux {
 		start_announce();
 	}
 
+	udp_tracker_key udp_tracker_connection::cache_key() const
+	{
+		return {bind_socket(), m_target, m_hostname};
+	}
+
 	void udp_tracker_connection::start_announce()
 	{
-		std::unique_lock<std::mutex> l(m_cache_mutex);
-		auto const cc = m_connection_cache.find(m_target.address());
-		if (cc != m_connection_cache.end())
+		if (cancelled()) return;
+
+		switch (m_man.get_connection_id(shared_from_this(), m_connection_id))
 		{
-			// we found a cached entry! Now, we can only
-			// use if if it hasn't expired
-			if (aux::time_now() < cc->second.expires)
-			{
-				if (tracker_req().kind & tracker_request::scrape_request)
-					send_udp_scrape();
-				else
-					send_udp_announce();
-				return;
-			}
-			// if it expired, remove it from the cache
-			m_connection_cache.erase(cc);
+			case tracker_manager::connection_id_status::valid:
+				send_request();
+				break;
+			case tracker_manager::connection_id_status::pending:
+#ifndef TORRENT_DISABLE_LOGGING
+				{
+					std::shared_ptr<request_callback> cb = requester();
+					if (cb) cb->debug_log("*** UDP_TRACKER [ waiting for connect in flight ]");
+				}
+#endif
+				m_waiting_for_id = true;
+				break;
+			case tracker_manager::connection_id_status::missing:
+				m_connect_owner = true;
+				send_udp_connect();
+				break;
 		}
-		l.unlock();
+	}
 
-		send_udp_connect();
+	void udp_tracker_connection::send_request()
+	{
+		if (tracker_req().kind & tracker_request::scrape_request)
+			send_udp_scrape();
+		else
+			send_udp_announce();
+	}
+
+	void udp_tracker_connection::on_connection_id(udp_tracker_key const& key
+		, std::int64_t const id)
+	{
+		if (!m_waiting_for_id || cancelled() || !(cache_key() == key)) return;
+		m_waiting_for_id = false;
+		m_connection_id = id;
+		send_request();
+	}
+
+	void udp_tracker_connection::on_connection_id_failed(udp_tracker_key const& key)
+	{
+		if (!m_waiting_for_id || cancelled() || !(cache_key() == key)) return;
+		m_waiting_for_id = false;
+		// send our own connect request. If others are waiting too, one of
+		// us will become the new owner and the rest will wait for it
+		start_announce();
+	}
+
+	void udp_tracker_connection::release_connect()
+	{
+		if (!m_connect_owner) return;
+		m_connect_owner = false;
+		m_man.connection_id_failed(cache_key(), this);
 	}
 
 	void udp_tracker_connection::on_timeout(error_code const& ec)
@@ -277,6 +315,7 @@ namespace libtorrent::aux {
 
 	void udp_tracker_connection::close()
 	{
+		release_connect();
 		cancel();
 		m_man.remove_request(this);
 	}
@@ -422,20 +461,33 @@ namespace libtorrent::aux {
 
 		// reset transaction
 		update_transaction_id();
-		std::int64_t const connection_id = aux::read_int64(buf);
+		m_connection_id = aux::read_int64(buf);
 
-		std::lock_guard<std::mutex> l(m_cache_mutex);
-		connection_cache_entry& cce = m_connection_cache[m_target.address()];
-		cce.connection_id = connection_id;
-		cce.expires = aux::time_now() + seconds(m_man.settings().get_int(settings_pack::udp_tracker_token_expiry));
+		// this lets the connections waiting for our connect request send
+		// their requests too
+		if (m_connect_owner)
+		{
+			m_connect_owner = false;
+			m_man.connection_id_received(cache_key(), m_connection_id);
+		}
 
-		if (!(tracker_req().kind & tracker_request::scrape_request))
-			send_udp_announce();
-		else if (tracker_req().kind & tracker_request::scrape_request)
-			send_udp_scrape();
+		send_request();
 		return true;
 	}
 
+	std::array<char, 16> udp_tracker_connection::connect_packet(std::uint32_t const tid)
+	{
+		std::array<char, 16> buf;
+		span<char> view = buf;
+
+		aux::write_uint32(0x417, view);
+		aux::write_uint32(0x27101980, view); // connection_id
+		aux::write_int32(action_t::connect, view); // action (connect)
+		aux::write_int32(tid, view); // transaction_id
+		TORRENT_ASSERT(view.empty());
+		return buf;
+	}
+
 	void udp_tracker_connection::send_udp_connect()
 	{
 #ifndef TORRENT_DISABLE_LOGGING
@@ -450,17 +502,8 @@ namespace libtorrent::aux {
 			return;
 		}
 
-		std::size_t const connect_packet_size = 16;
-		std::array<char, connect_packet_size> buf;
-		span<char> view = buf;
-
 		TORRENT_ASSERT(m_transaction_id != 0);
-
-		aux::write_uint32(0x417, view);
-		aux::write_uint32(0x27101980, view); // connection_id
-		aux::write_int32(action_t::connect, view); // action (connect)
-		aux::write_int32(m_transaction_id, view); // transaction_id
-		TORRENT_ASSERT(view.empty());
+		std::array<char, 16> const buf = connect_packet(m_transaction_id);
 
 		error_code ec;
 		if (!m_hostname.empty())
@@ -508,23 +551,25 @@ namespace libtorrent::aux {
 	{
 		if (m_abort) return;
 
-		auto const i = m_connection_cache.find(m_target.address());
-		// this isn't really supposed to happen
-		TORRENT_ASSERT(i != m_connection_cache.end());
-		if (i == m_connection_cache.end()) return;
-
-		char buf[8 + 4 + 4 + 20];
-		span<char> view = buf;
+		TORRENT_ASSERT(int(m_batch.size()) < max_scrape_hashes);
+		std::array<char, 8 + 4 + 4 + 20 * max_scrape_hashes> packet;
+		span<char> view = packet;
 
-		aux::write_int64(i->second.connection_id, view); // connection_id
+		aux::write_int64(m_connection_id, view); // connection_id
 		aux::write_int32(action_t::scrape, view); // action (scrape)
 		aux::write_int32(m_transaction_id, view); // transaction_id
-		// info_hash
-		std::copy(tracker_req().info_hash.begin(), tracker_req().info_hash.end()
-			, view.data());
-#if TORRENT_USE_ASSERTS
-		TORRENT_ASSERT(view.size() == 20);
-#endif
+		// info_hashes. The responses come back in the same order
+		auto const write_hash = [&view](sha1_hash const& ih)
+		{
+			std::copy(ih.begin(), ih.end(), view.data());
+			view = view.subspan(20);
+		};
+		write_hash(tracker_req().info_hash);
+		for (auto const& b : m_batch)
+			write_hash(b.req.info_hash);
+
+		span<char const> const buf = span<char const>(packet).first(
+			int(packet.size()) - view.size());
 
 		error_code ec;
 		if (!m_hostname.empty())
@@ -538,7 +583,7 @@ namespace libtorrent::aux {
 				, udp_socket::tracker_connection);
 		}
 		m_state = action_t::scrape;
-		sent_bytes(sizeof(buf) + 28); // assuming UDP/IP header
+		sent_bytes(int(buf.size()) + 28); // assuming UDP/IP header
 		++m_attempts;
 		if (ec)
 		{
@@ -651,19 +696,27 @@ namespace libtorrent::aux {
 			return true;
 		}
 
-		int const complete = aux::read_int32(buf);
-		int const downloaded = aux::read_int32(buf);
-		int const incomplete = aux::read_int32(buf);
-
-		std::shared_ptr<request_callback> cb = requester();
-		if (!cb)
+		// there is one entry per info-hash, in the order they were sent
+		auto const report = [&buf](tracker_request const& req
+			, std::shared_ptr<request_callback> const& cb)
 		{
-			close();
-			return true;
-		}
+			if (buf.size() < 12)
+			{
+				if (cb) cb->tracker_request_error(req
+					, errors::invalid_tracker_response_length
+					, operation_t::bittorrent, "", seconds32(0));
+				return;
+			}
+			int const complete = aux::read_int32(buf);
+			int const downloaded = aux::read_int32(buf);
+			int const incomplete = aux::read_int32(buf);
+			if (cb) cb->tracker_scrape_response(req
+				, complete, incomplete, downloaded, -1);
+		};
 
-		cb->tracker_scrape_response(tracker_req()
-			, complete, incomplete, downloaded, -1);
+		report(tracker_req(), requester());
+		for (auto const& b : m_batch)
+			report(b.req, b.requester.lock());
 
 		close();
 		return true;
@@ -679,12 +732,7 @@ namespace libtorrent::aux {
 		tracker_request const& req = tracker_req();
 		aux::session_settings const& settings = m_man.settings();
 
-		auto const i = m_connection_cache.find(m_target.address());
-		// this isn't really supposed to happen
-		TORRENT_ASSERT(i != m_connection_cache.end());
-		if (i == m_connection_cache.end()) return;
-
-		aux::write_int64(i->second.connection_id, out); // connection_id
+		aux::write_int64(m_connection_id, out); // connection_id
 		aux::write_int32(action_t::announce, out); // action (announce)
 		aux::write_int32(m_transaction_id, out); // transaction_id
 		std::copy(req.info_hash.begin(), req.info_hash.end(), out.data()); // info_hash
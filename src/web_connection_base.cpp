@@ -34,7 +34,7 @@ namespace libtorrent::aux {
 		, m_parser(aux::http_parser::dont_parse_chunks)
 		, m_body_start(0)
 	{
-		TORRENT_ASSERT(&web.peer_info == pack.peerinfo);
+		TORRENT_ASSERT(pack.peerinfo && pack.peerinfo->web_seed);
 		// when going through a proxy, we don't necessarily have an endpoint here,
 		// since the proxy might be resolving the hostname, not us
 		TORRENT_ASSERT(web.endpoints.empty() || web.endpoints.front() == pack.endp);
@@ -47,8 +47,6 @@ web_peer_connection::web_peer_connection(peer_connection_args& pack
 	, m_url(web.url)
 	, m_web(&web)
 	, m_received_body(0)
-	, m_chunk_pos(0)
-	, m_partial_chunk_header(0)
 	, m_num_responses(0)
 {
 	INVARIANT_CHECK;
@@ -170,15 +168,20 @@ void web_peer_connection::on_connected()
 		}
 	}
 
-	// TODO: 3 this should be an optional<piece_index_t>, piece index -1 should
-	// not be allowed
-	if (m_web->restart_request.piece != piece_index_t(-1))
+	// increase the chances of requesting the blocks
+	// we have partial data for already, to finish them
+	for (auto const& b : m_web->restart_blocks)
+		incoming_suggest(b.second.request.piece);
+	web_connection_base::on_connected();
+
+	// now that we know the server is reachable, open the next connection to
+	// it, if we want more than one
+	if (m_web->num_connections() < m_settings.get_int(settings_pack::urlseed_connections))
 	{
-		// increase the chances of requesting the block
-		// we have partial data for already, to finish it
-		incoming_suggest(m_web->restart_request.piece);
+		auto t = associated_torrent().lock();
+		if (t) post(get_context()
+			, std::bind(&aux::torrent::maybe_connect_web_seeds, t));
 	}
-	web_connection_base::on_connected();
 }
 
 void web_peer_connection::disconnect(error_code const& ec
@@ -209,10 +212,12 @@ void web_peer_connection::disconnect(error_code const& ec
 		return;
 	}
 
-	if (op == operation_t::connect && m_web && !m_web->endpoints.empty())
+	if (op == operation_t::connect && m_web && !m_web->endpoints.empty()
+		&& m_web->endpoints.front() == remote())
 	{
 		// we failed to connect to this IP. remove it so that the next attempt
-		// uses the next IP in the list.
+		// uses the next IP in the list. Another connection to the same web
+		// seed may already have done so
 		m_web->endpoints.erase(m_web->endpoints.begin());
 	}
 
@@ -246,15 +251,12 @@ void web_peer_connection::disconnect(error_code const& ec
 				, m_requests.front().start);
 		}
 #endif
-		m_web->restart_request = m_requests.front();
-		if (!m_web->restart_piece.empty())
-		{
-			// we're about to replace a different restart piece
-			// buffer. So it was wasted download
-			if (t) t->add_redundant_bytes(int(m_web->restart_piece.size())
-				, aux::waste_reason::piece_closing);
-		}
-		m_web->restart_piece.swap(m_piece);
+		// if this replaces a restart block saved earlier, that one was
+		// wasted download
+		int const discarded = m_web->save_restart_block(
+			m_web->peer_info_for(this), m_requests.front(), m_piece);
+		if (discarded > 0 && t)
+			t->add_redundant_bytes(discarded, aux::waste_reason::piece_closing);
 
 		// we have to do this to not count this data as redundant. The
 		// upper layer will call downloading_piece_progress and assume
@@ -276,6 +278,8 @@ void web_peer_connection::disconnect(error_code const& ec
 			+ seconds32(m_settings.get_int(settings_pack::urlseed_wait_retry)));
 	}
 
+	m_pending_requests.clear();
+
 	peer_connection::disconnect(ec, op, error);
 	if (t) t->disconnect_web_seed(this);
 }
@@ -309,6 +313,34 @@ piece_block_progress web_peer_connection::downloading_piece_progress() const
 	return ret;
 }
 
+bool add_pending_request(std::deque<peer_request>& pending
+	, peer_request const& r, int const piece_size, int const max_request_bytes)
+{
+	if (!pending.empty())
+	{
+		peer_request& back = pending.back();
+		std::int64_t const back_end = std::int64_t(static_cast<int>(back.piece))
+			* piece_size + back.start + back.length;
+		std::int64_t const req_start = std::int64_t(static_cast<int>(r.piece))
+			* piece_size + r.start;
+		if (back_end == req_start
+			&& std::int64_t(back.length) + r.length <= max_request_bytes)
+		{
+			back.length += r.length;
+			return true;
+		}
+	}
+	pending.push_back(r);
+	return false;
+}
+
+int web_seed_pipeline_depth(bool const keepalive, int const pipeline_size)
+{
+	// a server that closes the connection after every response won't see
+	// any request but the first, so don't pipeline to it
+	return keepalive ? std::max(1, pipeline_size) : 1;
+}
+
 void web_peer_connection::write_request(peer_request const& r)
 {
 	INVARIANT_CHECK;
@@ -318,12 +350,8 @@ void web_peer_connection::write_request(peer_request const& r)
 
 	TORRENT_ASSERT(t->valid_metadata());
 
-	torrent_info const& info = t->torrent_file();
 	peer_request req = r;
 
-	std::string request;
-	request.reserve(400);
-
 	int size = r.length;
 	const int block_size = t->block_size();
 	const int piece_size = t->torrent_file().piece_length();
@@ -337,9 +365,9 @@ void web_peer_connection::write_request(peer_request const& r)
 		pr.piece = piece_index_t(static_cast<int>(r.piece) + request_offset / piece_size);
 		m_requests.push_back(pr);
 
-		if (m_web->restart_request == m_requests.front())
+		if (m_requests.size() == 1
+			&& m_web->take_restart_block(m_requests.front(), m_piece))
 		{
-			m_piece.swap(m_web->restart_piece);
 			peer_request const& front = m_requests.front();
 			TORRENT_ASSERT(front.length > int(m_piece.size()));
 
@@ -358,7 +386,6 @@ void web_peer_connection::write_request(peer_request const& r)
 			// just to keep the accounting straight for the upper layer.
 			// it doesn't know we just re-wrote the request
 			incoming_piece_fragment(int(m_piece.size()));
-			m_web->restart_request.piece = piece_index_t(-1);
 		}
 
 #if 0
@@ -373,6 +400,49 @@ void web_peer_connection::write_request(peer_request const& r)
 		, static_cast<int>(pr.piece), pr.start + pr.length);
 #endif
 
+	if (add_pending_request(m_pending_requests, req, piece_size
+		, m_settings.get_int(settings_pack::urlseed_max_request_bytes)))
+	{
+#ifndef TORRENT_DISABLE_LOGGING
+		peer_request const& back = m_pending_requests.back();
+		peer_log(peer_log_alert::info, "MERGING_REQUESTS"
+			, "piece: %d start: %d length: %d", static_cast<int>(back.piece)
+			, back.start, back.length);
+#endif
+		return;
+	}
+
+	issue_requests();
+}
+
+void web_peer_connection::issue_requests()
+{
+	// once the server has said it will close the connection (or closed its
+	// read end), there's no point in sending more requests
+	if (is_disconnecting() || has_peer_choked() || m_web == nullptr) return;
+
+	int const depth = web_seed_pipeline_depth(m_web->supports_keepalive
+		, m_settings.get_int(settings_pack::urlseed_pipeline_size));
+
+	while (!m_pending_requests.empty() && int(m_file_requests.size()) < depth)
+	{
+		peer_request const req = m_pending_requests.front();
+		m_pending_requests.pop_front();
+		write_http_request(req);
+		if (is_disconnecting()) return;
+	}
+}
+
+void web_peer_connection::write_http_request(peer_request const& req)
+{
+	auto t = associated_torrent().lock();
+	TORRENT_ASSERT(t);
+
+	torrent_info const& info = t->torrent_file();
+
+	std::string request;
+	request.reserve(400);
+
 	bool const single_file_request = t->torrent_file().num_files() == 1;
 	int const proxy_type = m_settings.get_int(settings_pack::proxy_type);
 	bool const using_proxy = (proxy_type == settings_pack::http
@@ -584,6 +654,7 @@ bool web_peer_connection::received_invalid_data(piece_index_t const index, bool
 void web_peer_connection::on_receive_padfile()
 {
 	handle_padfile();
+	issue_requests();
 }
 
 void web_peer_connection::handle_error(int const bytes_left)
@@ -682,9 +753,10 @@ void web_peer_connection::handle_redirect(int const bytes_left)
 		{
 			web->have_files.set_bit(file_index);
 
-			if (web->peer_info.connection != nullptr)
+			web->for_each_peer_info([&](torrent_peer const& pi)
 			{
-				auto* pc = static_cast<peer_connection*>(web->peer_info.connection);
+				if (pi.connection == nullptr) return;
+				auto* pc = static_cast<peer_connection*>(pi.connection);
 
 				// we just learned that this host has this file, and we're currently
 				// connected to it. Make it advertise that it has this file to the
@@ -693,7 +765,7 @@ void web_peer_connection::handle_redirect(int const bytes_left)
 				auto const range = aux::file_piece_range_inclusive(fs, file_index);
 				for (piece_index_t i = std::get<0>(range); i < std::get<1>(range); ++i)
 					pc->incoming_have(i);
-			}
+			});
 			// we just learned about another file this web server has, make sure
 			// it's marked interesting to enable connecting to it
 			web->interesting = true;
@@ -744,6 +816,26 @@ void web_peer_connection::on_receive(error_code const& error
 				, "web_peer_connection error: %s", error.message().c_str());
 		}
 #endif
+
+		// a response without a content-length or chunked encoding ends when
+		// the server closes the connection
+		if (error == boost::asio::error::eof
+			&& !associated_torrent().expired()
+			&& m_parser.header_finished()
+			&& !m_file_requests.empty()
+			&& m_parser.finish_body()
+			&& m_received_body == m_file_requests.front().length)
+		{
+			// we just completed an HTTP file request. pop it from m_file_requests
+			m_file_requests.pop_front();
+			m_parser.reset();
+			m_body_start = 0;
+			m_received_body = 0;
+
+			// in between each file request, there may be an implicit
+			// pad-file request
+			handle_padfile();
+		}
 		return;
 	}
 
@@ -900,149 +992,76 @@ void web_peer_connection::on_receive(error_code const& error
 			return;
 		}
 
-		if (m_parser.chunked_encoding())
+		// deliver the payload in the receive buffer to the bittorrent engine.
+		// The parser strips the chunk framing of chunked responses in place,
+		// remembering where it is in a chunk header across reads
+		while (!recv_buffer.empty())
 		{
+			bool parse_error = false;
+			std::ptrdiff_t const before = recv_buffer.size();
+			span<char const> const payload = m_parser.parse_body(recv_buffer, parse_error);
+			received_bytes(0, int(before - recv_buffer.size() - payload.size()));
 
-			// =========================
-			// === CHUNKED ENCODING  ===
-			// =========================
-
-			while (m_chunk_pos >= 0 && !recv_buffer.empty())
+			if (parse_error || m_received_body + payload.size() > file_req.length)
 			{
-				// first deliver any payload we have in the buffer so far, ahead of
-				// the next chunk header.
-				if (m_chunk_pos > 0)
-				{
-					int const copy_size = std::min(m_chunk_pos, int(recv_buffer.size()));
-					TORRENT_ASSERT(copy_size > 0);
-
-					if (m_received_body + copy_size > file_req.length)
-					{
-						// the byte range in the http response is different what we expected
-						received_bytes(0, int(recv_buffer.size()));
+				// the byte range in the http response is different what we expected
+				received_bytes(0, int(recv_buffer.size()));
 
 #ifndef TORRENT_DISABLE_LOGGING
-						peer_log(peer_log_alert::incoming, "INVALID HTTP RESPONSE"
-							, "received body: %d request size: %d"
-							, m_received_body, file_req.length);
+				peer_log(peer_log_alert::incoming, "INVALID HTTP RESPONSE"
+					, "received body: %d request size: %d"
+					, m_received_body, file_req.length);
 #endif
-						disconnect(errors::invalid_range, operation_t::bittorrent, peer_error);
-						return;
-					}
-					incoming_payload(recv_buffer.data(), copy_size);
-
-					recv_buffer = recv_buffer.subspan(copy_size);
-					m_chunk_pos -= copy_size;
+				disconnect(parse_error ? errors::http_parse_error : errors::invalid_range
+					, operation_t::bittorrent, peer_error);
+				return;
+			}
+			if (!payload.empty())
+			{
+				incoming_payload(payload.data(), int(payload.size()));
+				if (is_disconnecting()) return;
+			}
 
-					if (recv_buffer.empty()) goto done;
-				}
+			// a chunked response isn't complete until its terminating chunk
+			if (!m_parser.body_finished()) continue;
 
-				TORRENT_ASSERT(m_chunk_pos == 0);
+			// the response may have ended (by its terminating chunk) before
+			// we got all the bytes we asked for
+			if (m_received_body != file_req.length)
+			{
+				// the byte range in the http response is different what we expected
+				received_bytes(0, int(recv_buffer.size()));
 
-				int header_size = 0;
-				std::int64_t chunk_size = 0;
-				span<char const> chunk_start = recv_buffer.subspan(m_chunk_pos);
-				TORRENT_ASSERT(chunk_start[0] == '\r'
-					|| aux::is_hex({chunk_start.data(), 1}));
-				bool const ret = m_parser.parse_chunk_header(chunk_start, &chunk_size, &header_size);
-				if (!ret)
-				{
-					received_bytes(0, int(chunk_start.size()) - m_partial_chunk_header);
-					m_partial_chunk_header = int(chunk_start.size());
-					goto done;
-				}
 #ifndef TORRENT_DISABLE_LOGGING
-				peer_log(peer_log_alert::info, "CHUNKED_ENCODING"
-					, "parsed chunk: %" PRId64 " header_size: %d"
-					, chunk_size, header_size);
-#endif
-				received_bytes(0, header_size - m_partial_chunk_header);
-				m_partial_chunk_header = 0;
-				TORRENT_ASSERT(chunk_size != 0
-					|| int(chunk_start.size()) <= header_size || chunk_start[header_size] == 'H');
-				TORRENT_ASSERT(m_body_start + m_chunk_pos < INT_MAX);
-				m_chunk_pos += int(chunk_size);
-				recv_buffer = recv_buffer.subspan(header_size);
-
-				// a chunk size of zero means the request is complete. Make sure the
-				// number of payload bytes we've received matches the number we
-				// requested. If that's not the case, we got an invalid response.
-				if (chunk_size == 0)
-				{
-					TORRENT_ASSERT_VAL(m_chunk_pos == 0, m_chunk_pos);
-
-#if TORRENT_USE_ASSERTS
-					span<char const> chunk = recv_buffer.subspan(m_chunk_pos);
-					TORRENT_ASSERT(chunk.size() == 0 || chunk[0] == 'H');
+				peer_log(peer_log_alert::incoming, "INVALID HTTP RESPONSE"
+					, "received body: %d request size: %d"
+					, m_received_body, file_req.length);
 #endif
-					m_chunk_pos = -1;
-
-					TORRENT_ASSERT(m_received_body <= file_req.length);
-					if (m_received_body != file_req.length)
-					{
-						// the byte range in the http response is different what we expected
-						received_bytes(0, int(recv_buffer.size()));
+				disconnect(errors::invalid_range, operation_t::bittorrent, peer_error);
+				return;
+			}
 
-#ifndef TORRENT_DISABLE_LOGGING
-						peer_log(peer_log_alert::incoming, "INVALID HTTP RESPONSE"
-							, "received body: %d request size: %d"
-							, m_received_body, file_req.length);
-#endif
-						disconnect(errors::invalid_range, operation_t::bittorrent, peer_error);
-						return;
-					}
-					// we just completed an HTTP file request. pop it from m_file_requests
-					m_file_requests.pop_front();
-					m_parser.reset();
-					m_body_start = 0;
-					m_received_body = 0;
-					m_chunk_pos = 0;
-					m_partial_chunk_header = 0;
-
-					// in between each file request, there may be an implicit
-					// pad-file request
-					handle_padfile();
-					break;
-				}
+			// we just completed an HTTP file request. pop it from m_file_requests
+			m_file_requests.pop_front();
+			m_parser.reset();
+			m_body_start = 0;
+			m_received_body = 0;
 
-				// if all of the receive buffer was just consumed as chunk
-				// header, we're done
-				if (recv_buffer.empty()) goto done;
-			}
-		}
-		else
-		{
-			// this is the simple case, where we don't have chunked encoding
-			TORRENT_ASSERT(m_received_body <= file_req.length);
-			int const copy_size = std::min(file_req.length - m_received_body
-				, int(recv_buffer.size()));
-			incoming_payload(recv_buffer.data(), copy_size);
-			recv_buffer = recv_buffer.subspan(copy_size);
-
-			TORRENT_ASSERT(m_received_body <= file_req.length);
-			if (m_received_body == file_req.length)
-			{
-				// we just completed an HTTP file request. pop it from m_file_requests
-				m_file_requests.pop_front();
-				m_parser.reset();
-				m_body_start = 0;
-				m_received_body = 0;
-				m_chunk_pos = 0;
-				m_partial_chunk_header = 0;
-
-				// in between each file request, there may be an implicit
-				// pad-file request
-				handle_padfile();
-			}
+			// in between each file request, there may be an implicit
+			// pad-file request
+			handle_padfile();
+			break;
 		}
 
 		if (recv_buffer.empty()) break;
 	}
-done:
 
 	// now, remove all the bytes we've processed from the receive buffer
 	m_recv_buffer.cut(int(recv_buffer.data() - m_recv_buffer.get().begin())
 		, t->block_size() + request_size_overhead);
+
+	// the responses we completed made room in the pipeline
+	issue_requests();
 }
 
 void web_peer_connection::incoming_payload(char const* buf, int len)
@@ -27,6 +27,9 @@ see LICENSE file.
 #include "libtorrent/aux_/disable_warnings_push.hpp"
 #include <boost/system/system_error.hpp>
 #include <boost/json.hpp>
+#if __has_include(<boost/json/basic_parser_impl.hpp>)
+#include <boost/json/basic_parser_impl.hpp>
+#endif
 #ifdef BOOST_JSON_HEADER_ONLY
 #include <boost/json/src.hpp>
 #endif
@@ -34,13 +37,17 @@ see LICENSE file.
 
 #include <algorithm>
 #include <cctype>
+#include <cinttypes> // for PRId64
+#include <cmath> // for isfinite
 #include <cstdio> // for snprintf
 #include <exception>
 #include <functional>
+#include <limits>
 #include <list>
 #include <locale>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <vector>
 
 namespace libtorrent::aux {
@@ -52,12 +59,263 @@ namespace json = boost::json;
 
 namespace {
 
-// Overload for JSON strings
-std::string utf8_latin1(json::string_view sv)
+// the amount of encoded messages after which we stop adding pending messages
+// to a write batch
+constexpr std::size_t max_write_batch_size = 256 * 1024;
+
+// Appends s as a JSON string. If latin1 is true, s is binary data to be
+// encoded as latin1, like the WebTorrent protocol expects for hashes and IDs.
+void write_escaped(std::string& out, std::string_view s, bool const latin1)
 {
-	return aux::utf8_latin1(std::string_view{sv.data(), sv.size()});
+	static char const hex_chars[] = "0123456789abcdef";
+
+	out += '"';
+	for (char const c : s)
+	{
+		auto const u = static_cast<unsigned char>(c);
+		switch (c)
+		{
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\b': out += "\\b"; break;
+			case '\f': out += "\\f"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (u < 0x20)
+				{
+					out += "\\u00";
+					out += hex_chars[u >> 4];
+					out += hex_chars[u & 0xf];
+				}
+				else if (u >= 0x80 && latin1)
+				{
+					out += char(0xc0 | (u >> 6));
+					out += char(0x80 | (u & 0x3f));
+				}
+				else
+				{
+					out += c;
+				}
+		}
+	}
+	out += '"';
 }
 
+void write_string(std::string& out, std::string_view s)
+{
+	write_escaped(out, s, false);
+}
+
+void write_binary(std::string& out, span<char const> s)
+{
+	write_escaped(out, std::string_view{s.data(), std::size_t(s.size())}, true);
+}
+
+void write_key(std::string& out, char const* key)
+{
+	if (out.back() != '{') out += ',';
+	out += '"';
+	out += key;
+	out += "\":";
+}
+
+void write_int(std::string& out, std::int64_t const value)
+{
+	char buf[21];
+	std::snprintf(buf, sizeof(buf), "%" PRId64, value);
+	out += buf;
+}
+
+// The SAX handler for incoming tracker messages. It records the fields of
+// interest, nested objects are only inspected for the offer and answer SDP.
+struct tracker_message_handler
+{
+	static constexpr std::size_t max_object_size = std::size_t(-1);
+	static constexpr std::size_t max_array_size = std::size_t(-1);
+	static constexpr std::size_t max_key_size = std::size_t(-1);
+	static constexpr std::size_t max_string_size = std::size_t(-1);
+
+	void reset()
+	{
+		depth = 0;
+		key.clear();
+		parent.clear();
+		value.clear();
+		info_hash.reset();
+		offer_id.reset();
+		peer_id.reset();
+		offer_sdp.reset();
+		answer_sdp.reset();
+		interval.reset();
+		min_interval.reset();
+		complete.reset();
+		incomplete.reset();
+		downloaded.reset();
+	}
+
+	bool on_document_begin(json::error_code&) { return true; }
+	bool on_document_end(json::error_code&) { return true; }
+
+	bool on_object_begin(json::error_code&)
+	{
+		if (depth == 1) parent = key;
+		key.clear();
+		++depth;
+		return true;
+	}
+
+	bool on_object_end(std::size_t, json::error_code&)
+	{
+		--depth;
+		return true;
+	}
+
+	bool on_array_begin(json::error_code& ec)
+	{
+		// the message itself must be an object
+		if (depth == 0)
+		{
+			ec = json::error::syntax;
+			return false;
+		}
+		key.clear();
+		++depth;
+		return true;
+	}
+
+	bool on_array_end(std::size_t, json::error_code&)
+	{
+		--depth;
+		return true;
+	}
+
+	bool on_key_part(json::string_view s, std::size_t, json::error_code&)
+	{
+		key.append(s.data(), s.size());
+		return true;
+	}
+
+	bool on_key(json::string_view s, std::size_t, json::error_code&)
+	{
+		key.append(s.data(), s.size());
+		return true;
+	}
+
+	bool on_string_part(json::string_view s, std::size_t, json::error_code&)
+	{
+		value.append(s.data(), s.size());
+		return true;
+	}
+
+	bool on_string(json::string_view s, std::size_t, json::error_code& ec)
+	{
+		if (depth == 0)
+		{
+			ec = json::error::syntax;
+			return false;
+		}
+
+		value.append(s.data(), s.size());
+		if (depth == 1)
+		{
+			if (key == "info_hash") info_hash = value;
+			else if (key == "offer_id") offer_id = value;
+			else if (key == "peer_id") peer_id = value;
+		}
+		else if (depth == 2 && key == "sdp")
+		{
+			if (parent == "offer") offer_sdp = value;
+			else if (parent == "answer") answer_sdp = value;
+		}
+		value.clear();
+		key.clear();
+		return true;
+	}
+
+	bool on_number_part(json::string_view, json::error_code&) { return true; }
+
+	bool on_int64(std::int64_t const i, json::string_view, json::error_code& ec)
+	{
+		if (depth == 0)
+		{
+			ec = json::error::syntax;
+			return false;
+		}
+
+		if (depth == 1)
+		{
+			if (key == "interval") interval = i;
+			else if (key == "min_interval") min_interval = i;
+			else if (key == "complete") complete = i;
+			else if (key == "incomplete") incomplete = i;
+			else if (key == "downloaded") downloaded = i;
+		}
+		key.clear();
+		return true;
+	}
+
+	bool on_uint64(std::uint64_t const u, json::string_view s, json::error_code& ec)
+	{
+		return on_int64(std::int64_t(std::min(u
+			, std::uint64_t(std::numeric_limits<std::int64_t>::max()))), s, ec);
+	}
+
+	bool on_double(double const d, json::string_view s, json::error_code& ec)
+	{
+		if (!std::isfinite(d))
+		{
+			ec = json::error::syntax;
+			return false;
+		}
+
+		// converting a double outside the range of std::int64_t is undefined
+		// behavior. 2^63 is exactly representable, but std::int64_t's maximum
+		// is not
+		double const limit = 9223372036854775808.0;
+		std::int64_t const i = d >= limit ? std::numeric_limits<std::int64_t>::max()
+			: d < -limit ? std::numeric_limits<std::int64_t>::min()
+			: std::int64_t(d);
+		return on_int64(i, s, ec);
+	}
+
+	bool on_bool(bool, json::error_code& ec) { return on_literal(ec); }
+	bool on_null(json::error_code& ec) { return on_literal(ec); }
+
+	bool on_comment_part(json::string_view, json::error_code&) { return true; }
+	bool on_comment(json::string_view, json::error_code&) { return true; }
+
+	int depth = 0;
+	std::string key;
+	std::string parent; // the key of the object we're in, at depth 2
+	std::string value;
+
+	std::optional<std::string> info_hash;
+	std::optional<std::string> offer_id;
+	std::optional<std::string> peer_id;
+	std::optional<std::string> offer_sdp;
+	std::optional<std::string> answer_sdp;
+
+	std::optional<std::int64_t> interval;
+	std::optional<std::int64_t> min_interval;
+	std::optional<std::int64_t> complete;
+	std::optional<std::int64_t> incomplete;
+	std::optional<std::int64_t> downloaded;
+
+private:
+	bool on_literal(json::error_code& ec)
+	{
+		if (depth == 0)
+		{
+			ec = json::error::syntax;
+			return false;
+		}
+		key.clear();
+		return true;
+	}
+};
+
 }
 
 websocket_tracker_connection::websocket_tracker_connection(io_context& ios
@@ -151,100 +409,55 @@ void websocket_tracker_connection::send_pending()
 
 	m_sending = true;
 
-	auto [msg, callback] = std::move(m_pending.front());
-	m_pending.pop();
-
-	std::visit([this, callback = callback](auto const& m)
-		{
-			// Update requester and store callback
-			if (callback.lock())
-			{
-				m_requester = callback;
-				m_callbacks[m.info_hash] = std::move(callback);
-			}
-
-			do_send(m);
-		}
-		, msg);
-}
-
-void websocket_tracker_connection::do_send(tracker_request const& req)
-{
-	// Update request
-	m_req = req;
-
-	json::object payload;
-	payload["action"] = "announce";
-	payload["info_hash"] = latin1_utf8(req.info_hash);
-	payload["uploaded"] = req.uploaded;
-	payload["downloaded"] = req.downloaded;
-	payload["left"] = req.left;
-	payload["corrupt"] = req.corrupt;
-	payload["numwant"] = req.num_want;
-
-	char str_key[9];
-	std::snprintf(str_key, sizeof(str_key), "%08X", req.key);
-	payload["key"] = str_key;
+	// Encode as many pending messages as we can into a single batch, they are
+	// then written back to back
+	m_write_data.clear();
+	m_write_sizes.clear();
+	m_write_index = 0;
+	m_write_offset = 0;
 
-	if (req.event != event_t::none)
+	while (!m_pending.empty() && m_write_data.size() < max_write_batch_size)
 	{
-		static const char* event_string[] = { "completed", "started", "stopped", "paused" };
-		int event_index = static_cast<int>(req.event) - 1;
-		TORRENT_ASSERT(event_index >= 0 && event_index < 4);
-		payload["event"] = event_string[event_index];
-	}
-
-	payload["peer_id"] = latin1_utf8(req.pid);
+		auto [msg, callback] = std::move(m_pending.front());
+		m_pending.pop();
 
-	json::array &offers_array = payload["offers"].emplace_array();
-	for (auto const& offer : req.offers)
-	{
-		json::object payload_offer;
-		payload_offer["offer_id"] = latin1_utf8(offer.id);
-		json::object &obj = payload_offer["offer"].emplace_object();
-		obj["type"] = "offer";
-		obj["sdp"] = offer.sdp;
-		offers_array.emplace_back(std::move(payload_offer));
-	}
+		std::visit([this, callback = callback](auto const& m)
+			{
+				// Update requester and store callback
+				if (callback.lock())
+				{
+					m_requester = callback;
+					m_callbacks[m.info_hash] = std::move(callback);
+				}
 
-	std::string const data = json::serialize(payload);
-	m_write_data.assign(data.begin(), data.end());
+				// Update request
+				if constexpr (std::is_same_v<std::decay_t<decltype(m)>, tracker_request>)
+					m_req = m;
 
-#ifndef TORRENT_DISABLE_LOGGING
-	if (auto cb = requester())
-		cb->debug_log("*** WEBSOCKET_TRACKER_WRITE [ size: %ld, data: %s ]", long(m_write_data.size()), m_write_data.c_str());
-#endif
+				std::size_t const offset = m_write_data.size();
+				write_websocket_tracker_message(m_write_data, m);
+				m_write_sizes.push_back(m_write_data.size() - offset);
+			}
+			, msg);
+	}
 
-	ADD_OUTSTANDING_ASYNC("websocket_tracker_connection::on_write");
-	m_websocket->async_write(boost::asio::const_buffer(m_write_data.data(), m_write_data.size())
-			, std::bind(&websocket_tracker_connection::on_write, shared_from_this(), _1, _2));
+	do_write();
 }
 
-void websocket_tracker_connection::do_send(tracker_answer const& ans)
+void websocket_tracker_connection::do_write()
 {
-	if (!is_open()) return;
-
-	json::object payload;
-	payload["action"] = "announce";
-	payload["info_hash"] = latin1_utf8(ans.info_hash);
-	payload["offer_id"] = latin1_utf8(ans.answer.offer_id);
-	payload["to_peer_id"] = latin1_utf8(ans.answer.pid);
-	payload["peer_id"] =  latin1_utf8(ans.pid);
-	json::object &obj = payload["answer"].emplace_object();
-	obj["type"] = "answer";
-	obj["sdp"] = ans.answer.sdp;
-
-	std::string const data = json::serialize(payload);
-	m_write_data.assign(data.begin(), data.end());
+	TORRENT_ASSERT(m_write_index < m_write_sizes.size());
+	std::size_t const size = m_write_sizes[m_write_index];
+	char const* data = m_write_data.data() + m_write_offset;
 
 #ifndef TORRENT_DISABLE_LOGGING
-	if (auto cb = requester())
-		cb->debug_log("*** WEBSOCKET_TRACKER_WRITE [ size: %ld, data: %s ]"
-				, long(m_write_data.size()), m_write_data.c_str());
+	if (auto cb = requester(); cb && cb->should_log())
+		cb->debug_log("*** WEBSOCKET_TRACKER_WRITE [ size: %ld, data: %.*s ]"
+				, long(size), int(size), data);
 #endif
 
 	ADD_OUTSTANDING_ASYNC("websocket_tracker_connection::on_write");
-	m_websocket->async_write(boost::asio::const_buffer(m_write_data.data(), m_write_data.size())
+	m_websocket->async_write(boost::asio::const_buffer(data, size)
 			, std::bind(&websocket_tracker_connection::on_write, shared_from_this(), _1, _2));
 }
 
@@ -306,12 +519,12 @@ void websocket_tracker_connection::on_read(error_code ec, std::size_t /* bytes_r
 	auto const& buf = m_read_buffer.data();
 
 #ifndef TORRENT_DISABLE_LOGGING
-	std::string str(static_cast<char const*>(buf.data()), buf.size());
-	if (auto cb = requester())
-		cb->debug_log("*** WEBSOCKET_TRACKER_READ [ size: %ld, data: %s ]", long(str.size()), str.c_str());
+	if (auto cb = requester(); cb && cb->should_log())
+		cb->debug_log("*** WEBSOCKET_TRACKER_READ [ size: %ld, data: %.*s ]"
+			, long(buf.size()), int(buf.size()), static_cast<char const*>(buf.data()));
 #endif
 
-	auto ret = parse_websocket_tracker_response({static_cast<char const*>(buf.data()), long(buf.size())}, ec);
+	auto ret = m_parser.parse({static_cast<char const*>(buf.data()), long(buf.size())}, ec);
 	if(ec)
 	{
 #ifndef TORRENT_DISABLE_LOGGING
@@ -380,16 +593,23 @@ void websocket_tracker_connection::on_read(error_code ec, std::size_t /* bytes_r
 void websocket_tracker_connection::on_write(error_code const& ec, std::size_t /* bytes_written */)
 {
 	COMPLETE_ASYNC("websocket_tracker_connection::on_write");
-	m_write_data.clear();
-	m_sending = false;
 	if (ec)
 	{
+		m_sending = false;
 		fail(operation_t::sock_write, ec);
 		close();
 		return;
 	}
 
-	// Continue sending
+	// Continue with the current batch
+	m_write_offset += m_write_sizes[m_write_index];
+	if (++m_write_index < m_write_sizes.size())
+	{
+		do_write();
+		return;
+	}
+
+	m_sending = false;
 	send_pending();
 }
 
@@ -398,76 +618,164 @@ void websocket_tracker_connection::fail(operation_t op, error_code const& ec)
 	tracker_connection::fail(ec, op, ec.message().c_str(), seconds32{120}, seconds32{120});
 }
 
-TORRENT_EXTRA_EXPORT std::variant<websocket_tracker_response, std::string>
-	parse_websocket_tracker_response(span<char const> message, error_code& ec)
+void write_websocket_tracker_message(std::string& out, tracker_request const& req)
+{
+	out += '{';
+	write_key(out, "action");
+	write_string(out, "announce");
+	write_key(out, "info_hash");
+	write_binary(out, req.info_hash);
+	write_key(out, "uploaded");
+	write_int(out, req.uploaded);
+	write_key(out, "downloaded");
+	write_int(out, req.downloaded);
+	write_key(out, "left");
+	write_int(out, req.left);
+	write_key(out, "corrupt");
+	write_int(out, req.corrupt);
+	write_key(out, "numwant");
+	write_int(out, req.num_want);
+
+	char str_key[9];
+	std::snprintf(str_key, sizeof(str_key), "%08X", req.key);
+	write_key(out, "key");
+	write_string(out, str_key);
+
+	if (req.event != event_t::none)
+	{
+		static const char* event_string[] = { "completed", "started", "stopped", "paused" };
+		int event_index = static_cast<int>(req.event) - 1;
+		TORRENT_ASSERT(event_index >= 0 && event_index < 4);
+		write_key(out, "event");
+		write_string(out, event_string[event_index]);
+	}
+
+	write_key(out, "peer_id");
+	write_binary(out, req.pid);
+
+	write_key(out, "offers");
+	out += '[';
+	for (auto const& offer : req.offers)
+	{
+		if (out.back() != '[') out += ',';
+		out += '{';
+		write_key(out, "offer_id");
+		write_binary(out, offer.id);
+		write_key(out, "offer");
+		out += '{';
+		write_key(out, "type");
+		write_string(out, "offer");
+		write_key(out, "sdp");
+		write_string(out, offer.sdp);
+		out += "}}";
+	}
+	out += "]}";
+}
+
+void write_websocket_tracker_message(std::string& out, tracker_answer const& ans)
+{
+	out += '{';
+	write_key(out, "action");
+	write_string(out, "announce");
+	write_key(out, "info_hash");
+	write_binary(out, ans.info_hash);
+	write_key(out, "offer_id");
+	write_binary(out, ans.answer.offer_id);
+	write_key(out, "to_peer_id");
+	write_binary(out, ans.answer.pid);
+	write_key(out, "peer_id");
+	write_binary(out, ans.pid);
+	write_key(out, "answer");
+	out += '{';
+	write_key(out, "type");
+	write_string(out, "answer");
+	write_key(out, "sdp");
+	write_string(out, ans.answer.sdp);
+	out += "}}";
+}
+
+struct websocket_tracker_parser::impl
+{
+	impl() : parser(json::parse_options{}) {}
+
+	json::basic_parser<tracker_message_handler> parser;
+};
+
+websocket_tracker_parser::websocket_tracker_parser()
+	: m_impl(std::make_unique<impl>())
+{}
+
+websocket_tracker_parser::~websocket_tracker_parser() = default;
+
+std::variant<websocket_tracker_response, std::string>
+	websocket_tracker_parser::parse(span<char const> message, error_code& ec)
 try {
-	json::object payload = json::parse({message.data(), size_t(message.size())}).as_object();
+	auto& parser = m_impl->parser;
+	auto& h = parser.handler();
+	parser.reset();
+	h.reset();
+
+	json::error_code jec;
+	std::size_t const n = parser.write_some(false, message.data(), std::size_t(message.size()), jec);
+	if (!jec && n != std::size_t(message.size()))
+		jec = json::error::extra_data;
+	if (jec)
+	{
+		ec = errc::make_error_code(errc::bad_message);
+		return jec.message();
+	}
 
-	auto it_info_hash = payload.find("info_hash");
-	if (it_info_hash == payload.end())
+	if (!h.info_hash)
 		throw std::invalid_argument("no info hash in message");
 
-	auto const raw_info_hash = utf8_latin1(it_info_hash->value().as_string());
+	auto const raw_info_hash = utf8_latin1(*h.info_hash);
 	if (raw_info_hash.size() != 20)
 		throw std::invalid_argument("invalid info hash size " + std::to_string(raw_info_hash.size()));
 
 	websocket_tracker_response response;
 	response.info_hash = sha1_hash(span<char const>{raw_info_hash.data(), 20});
 
-	if (auto it = payload.find("offer"); it != payload.end())
+	auto const parse_ids = [&h]
 	{
-		json::object& payload_offer = it->value().as_object();
-		auto sdp = payload_offer["sdp"].as_string();
-		auto id = utf8_latin1(payload["offer_id"].as_string());
-		auto pid = utf8_latin1(payload["peer_id"].as_string());
+		if (!h.offer_id)
+			throw std::invalid_argument("no offer_id in message");
+		if (!h.peer_id)
+			throw std::invalid_argument("no peer_id in message");
+
+		auto id = utf8_latin1(*h.offer_id);
+		auto pid = utf8_latin1(*h.peer_id);
 		if (pid.size() != 20)
 			throw std::invalid_argument("invalid peer_id size " + std::to_string(pid.size()));
 
-		aux::rtc_offer_id oid{span<char const>(id)};
-		response.offer.emplace(aux::rtc_offer{std::move(oid), peer_id(pid), {sdp.data(), sdp.size()}, nullptr});
-	}
+		return std::make_pair(aux::rtc_offer_id{span<char const>(id)}, peer_id(pid));
+	};
 
-	if (auto it = payload.find("answer"); it != payload.end())
+	if (h.offer_sdp)
 	{
-		json::object& payload_answer = it->value().as_object();
-		auto sdp = payload_answer["sdp"].as_string();
-		auto id = utf8_latin1(payload["offer_id"].as_string());
-		auto pid = utf8_latin1(payload["peer_id"].as_string());
-		if (pid.size() != 20)
-			throw std::invalid_argument("invalid peer_id size " + std::to_string(pid.size()));
+		auto [oid, pid] = parse_ids();
+		response.offer.emplace(aux::rtc_offer{std::move(oid), pid, std::move(*h.offer_sdp), nullptr});
+	}
 
-		aux::rtc_offer_id oid{span<char const>(id)};
-		response.answer.emplace(aux::rtc_answer{std::move(oid), peer_id(pid), {sdp.data(), sdp.size()}});
+	if (h.answer_sdp)
+	{
+		auto [oid, pid] = parse_ids();
+		response.answer.emplace(aux::rtc_answer{std::move(oid), pid, std::move(*h.answer_sdp)});
 	}
 
-	if (payload.find("interval") != payload.end())
+	if (h.interval)
 	{
-		tracker_response& resp = response.resp.emplace();
+		auto const to_int = [](std::int64_t const v)
+		{
+			return int(std::clamp(v, std::int64_t(std::numeric_limits<int>::min())
+				, std::int64_t(std::numeric_limits<int>::max())));
+		};
 
-		if (auto it = payload.find("interval"); it != payload.end())
-			resp.interval = seconds32{it->value().as_int64()};
-		else
-			resp.interval = seconds32{120};
-
-		if (auto it = payload.find("min_interval"); it != payload.end())
-			resp.min_interval = seconds32{it->value().as_int64()};
-		else
-			resp.min_interval = seconds32{60};
-
-		if (auto it = payload.find("complete"); it != payload.end())
-			resp.complete = int(it->value().as_int64());
-		else
-			resp.complete = -1;
-
-		if (auto it = payload.find("incomplete"); it != payload.end())
-			resp.incomplete = int(it->value().as_int64());
-		else
-			resp.incomplete = -1;
-
-		if (auto it = payload.find("downloaded"); it != payload.end())
-			resp.downloaded = int(it->value().as_int64());
-		else
-			resp.downloaded = -1;
+		tracker_response& resp = response.resp.emplace();
+		resp.interval = seconds32{to_int(*h.interval)};
+		resp.min_interval = seconds32{to_int(h.min_interval.value_or(60))};
+		resp.complete = to_int(h.complete.value_or(-1));
+		resp.incomplete = to_int(h.incomplete.value_or(-1));
+		resp.downloaded = to_int(h.downloaded.value_or(-1));
 	}
 
 	return response;
@@ -483,6 +791,13 @@ catch(std::exception const& e)
 	return std::string(e.what());
 }
 
+TORRENT_EXTRA_EXPORT std::variant<websocket_tracker_response, std::string>
+	parse_websocket_tracker_response(span<char const> message, error_code& ec)
+{
+	websocket_tracker_parser parser;
+	return parser.parse(message, ec);
+}
+
 }
 
 #endif // TORRENT_USE_RTC
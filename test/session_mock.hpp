@@ -25,6 +25,10 @@ see LICENSE file.
 #include "libtorrent/aux_/ssl.hpp"
 #endif
 
+#if TORRENT_USE_RTC
+#include "libtorrent/aux_/rtc_signaling.hpp"
+#endif
+
 #include "libtorrent/io_context.hpp"
 
 #include <cstdio>
@@ -54,6 +58,20 @@ struct session_mock : aux::session_interface
 	aux::torrent_peer_allocator_interface& get_peer_allocator() override { return _torrent_peer_allocator; }
 	boost::asio::io_context& get_context() override { return _io_context; }
 	aux::resolver_interface& get_resolver() override { return _resolver; }
+#if TORRENT_USE_RTC
+	aux::rtc_offer_pool& rtc_offers() override
+	{
+		if (!_rtc_offer_pool)
+			_rtc_offer_pool = std::make_shared<aux::rtc_offer_pool>(_io_context, _session_settings, _counters);
+		return *_rtc_offer_pool;
+	}
+	aux::rtc_transport_cache& rtc_transports() override
+	{
+		if (!_rtc_transports)
+			_rtc_transports = std::make_shared<aux::rtc_transport_cache>(_io_context);
+		return *_rtc_transports;
+	}
+#endif
 
 	bool has_connection(aux::peer_connection*) const override { return false; }
 	void insert_peer(std::shared_ptr<aux::peer_connection> const&) override {}
@@ -222,6 +240,11 @@ struct session_mock : aux::session_interface
 
 	aux::vector<aux::torrent*> _torrent_list;
 	std::vector<block_info> _block_info_list;
+
+#if TORRENT_USE_RTC
+	std::shared_ptr<aux::rtc_offer_pool> _rtc_offer_pool;
+	std::shared_ptr<aux::rtc_transport_cache> _rtc_transports;
+#endif
 };
 
 }
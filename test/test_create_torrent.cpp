@@ -20,9 +20,12 @@ see LICENSE file.
 #include "libtorrent/aux_/escape_string.hpp" // for convert_path_to_posix
 #include "libtorrent/announce_entry.hpp"
 #include "libtorrent/units.hpp"
+#include "libtorrent/aux_/merkle.hpp"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <map>
 #include <fstream>
 #include <string>
 
@@ -502,3 +505,109 @@ TORRENT_TEST(piece_layer)
 	TEST_CHECK(info.piece_layer(lt::file_index_t(1)).size() == lt::sha256_hash::size());
 	TEST_CHECK(info.piece_layer(lt::file_index_t(2)).size() == lt::sha256_hash::size());
 }
+
+namespace {
+
+std::vector<char> write_test_file(std::string const& name, int const size)
+{
+	std::vector<char> data(std::size_t(size), '\0');
+	for (std::size_t i = 0; i < data.size(); ++i)
+		data[i] = char((i * 7) ^ (i >> 11) ^ name.size());
+	std::ofstream f(name, std::ios_base::binary);
+	f.write(data.data(), std::streamsize(data.size()));
+	return data;
+}
+
+}
+
+TORRENT_TEST(set_piece_hashes_hybrid)
+{
+	lt::error_code ec;
+	lt::create_directories("hash-test/sub", ec);
+
+	// the files are read in chunks of several pieces, make them span a few
+	// chunks, and end in the middle of them
+	std::map<std::string, std::vector<char>> contents;
+	contents["large"] = write_test_file("hash-test/large", 9 * 1024 * 1024 + 1000);
+	contents["block"] = write_test_file("hash-test/sub/block", 16 * 1024);
+	contents["small"] = write_test_file("hash-test/small", 1000);
+
+	lt::file_storage fs;
+	lt::add_files(fs, "hash-test");
+	lt::create_torrent t(fs, 16 * 1024);
+
+	int calls = 0;
+	lt::set_piece_hashes(t, ".", [&](lt::piece_index_t const p)
+	{
+		TEST_EQUAL(p, lt::piece_index_t(calls));
+		++calls;
+	}, ec);
+	TEST_CHECK(!ec);
+	TEST_EQUAL(calls, t.num_pieces());
+
+	std::vector<char> buffer;
+	lt::bencode(std::back_inserter(buffer), t.generate());
+	lt::torrent_info ti(buffer, lt::from_span);
+	lt::file_storage const& files = ti.files();
+
+	// the v1 pieces span the files back to back, including the pad files
+	std::vector<char> all;
+	for (auto const i : files.file_range())
+	{
+		if (files.pad_file_at(i))
+		{
+			all.resize(all.size() + std::size_t(files.file_size(i)), '\0');
+			continue;
+		}
+		std::vector<char> const& data = contents[std::string(files.file_name(i))];
+		all.insert(all.end(), data.begin(), data.end());
+
+		// the v2 root is the merkle tree of the file's blocks
+		std::vector<lt::sha256_hash> leaves;
+		for (std::size_t offset = 0; offset < data.size(); offset += 16 * 1024)
+		{
+			int const len = int(std::min(data.size() - offset, std::size_t(16 * 1024)));
+			leaves.push_back(lt::hasher256(data.data() + offset, len).final());
+		}
+		TEST_CHECK(files.root(i) == lt::merkle_root(leaves));
+	}
+
+	for (auto const p : files.piece_range())
+	{
+		TEST_CHECK(ti.hash_for_piece(p) == lt::hasher(all.data()
+			+ static_cast<int>(p) * std::ptrdiff_t(files.piece_length())
+			, files.piece_size(p)).final());
+	}
+}
+
+TORRENT_TEST(set_piece_hashes_missing_file)
+{
+	lt::error_code ec;
+	lt::create_directories("missing-test", ec);
+	write_test_file("missing-test/a", 100000);
+	write_test_file("missing-test/b", 100000);
+
+	lt::file_storage fs;
+	lt::add_files(fs, "missing-test");
+	lt::create_torrent t(fs, 16 * 1024);
+
+	lt::remove("missing-test/b", ec);
+	lt::set_piece_hashes(t, ".", ec);
+	TEST_CHECK(ec == boost::system::errc::no_such_file_or_directory);
+}
+
+TORRENT_TEST(set_piece_hashes_short_file)
+{
+	lt::error_code ec;
+	lt::create_directories("short-test", ec);
+	write_test_file("short-test/a", 100000);
+	write_test_file("short-test/b", 100000);
+
+	lt::file_storage fs;
+	lt::add_files(fs, "short-test");
+	lt::create_torrent t(fs, 16 * 1024);
+
+	write_test_file("short-test/a", 50000);
+	lt::set_piece_hashes(t, ".", ec);
+	TEST_EQUAL(ec, lt::error_code(lt::errors::file_too_short));
+}
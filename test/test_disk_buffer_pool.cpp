@@ -0,0 +1,197 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/disk_buffer_pool.hpp"
+#include "libtorrent/disk_interface.hpp" // for default_block_size
+#include "libtorrent/disk_observer.hpp"
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/io_context.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+using lt::aux::disk_buffer_pool;
+
+namespace {
+
+struct test_observer final : lt::disk_observer
+{
+	void on_disk() override { ++called; }
+	int called = 0;
+};
+
+lt::settings_pack pool_settings(int const slab_size, int const max_blocks)
+{
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::disk_buffer_slab_size, slab_size);
+	pack.set_int(lt::settings_pack::max_queued_disk_bytes, max_blocks * lt::default_block_size);
+	return pack;
+}
+
+void test_allocate_free(int const slab_size)
+{
+	lt::io_context ios;
+	disk_buffer_pool pool(ios);
+	pool.set_settings(pool_settings(slab_size, 1000));
+
+	int const num_buffers = 300;
+	std::vector<char*> buffers;
+	for (int i = 0; i < num_buffers; ++i)
+	{
+		char* buf = pool.allocate_buffer("test");
+		TEST_CHECK(buf != nullptr);
+		if (buf == nullptr) break;
+		std::memset(buf, i & 0xff, lt::default_block_size);
+		buffers.push_back(buf);
+	}
+	TEST_EQUAL(pool.in_use(), num_buffers);
+
+	// every block is distinct and didn't get overwritten by another one
+	TEST_EQUAL(int(std::set<char*>(buffers.begin(), buffers.end()).size()), num_buffers);
+	for (int i = 0; i < int(buffers.size()); ++i)
+	{
+		char const* buf = buffers[std::size_t(i)];
+		TEST_CHECK(std::all_of(buf, buf + lt::default_block_size
+			, [=](char c) { return c == char(i & 0xff); }));
+	}
+
+	pool.free_buffer(buffers.back());
+	buffers.pop_back();
+	TEST_EQUAL(pool.in_use(), num_buffers - 1);
+
+	pool.free_multiple_buffers(buffers);
+	TEST_EQUAL(pool.in_use(), 0);
+}
+
+void test_watermark(int const slab_size)
+{
+	lt::io_context ios;
+	disk_buffer_pool pool(ios);
+	int const max_blocks = 16;
+	pool.set_settings(pool_settings(slab_size, max_blocks));
+
+	auto observer = std::make_shared<test_observer>();
+
+	std::vector<char*> buffers;
+	bool exceeded = false;
+	while (!exceeded && int(buffers.size()) < max_blocks * 2)
+		buffers.push_back(pool.allocate_buffer(exceeded, observer, "test"));
+
+	TEST_CHECK(exceeded);
+	// the high watermark is halfway between the low watermark (half the
+	// limit) and the limit
+	TEST_EQUAL(int(buffers.size()), max_blocks * 3 / 4);
+
+	// freeing down to the low watermark notifies the observer
+	while (pool.in_use() > max_blocks / 2)
+	{
+		pool.free_buffer(buffers.back());
+		buffers.pop_back();
+	}
+	ios.run();
+	TEST_EQUAL(observer->called, 1);
+
+	exceeded = false;
+	buffers.push_back(pool.allocate_buffer(exceeded, observer, "test"));
+	TEST_CHECK(!exceeded);
+
+	pool.free_multiple_buffers(buffers);
+	TEST_EQUAL(pool.in_use(), 0);
+}
+
+// buffers are allocated by some threads and freed by others, the way disk
+// threads and the network thread do
+void test_threads(int const slab_size)
+{
+	lt::io_context ios;
+	disk_buffer_pool pool(ios);
+	pool.set_settings(pool_settings(slab_size, 1000));
+
+	int const num_threads = 4;
+	int const num_buffers = 2000;
+	std::vector<std::vector<char*>> allocated(num_threads);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&pool, &allocated, t]
+		{
+			auto& bufs = allocated[std::size_t(t)];
+			for (int i = 0; i < num_buffers; ++i)
+			{
+				char* buf = pool.allocate_buffer("test");
+				if (buf == nullptr) continue;
+				std::memset(buf, t, lt::default_block_size);
+				bufs.push_back(buf);
+				if (i % 3 == 0)
+				{
+					pool.free_buffer(bufs.back());
+					bufs.pop_back();
+				}
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+	threads.clear();
+
+	std::set<char*> unique;
+	for (int t = 0; t < num_threads; ++t)
+	{
+		for (char const* buf : allocated[std::size_t(t)])
+		{
+			TEST_CHECK(std::all_of(buf, buf + lt::default_block_size
+				, [=](char c) { return c == char(t); }));
+			unique.insert(const_cast<char*>(buf));
+		}
+	}
+	int const total = int(unique.size());
+	TEST_EQUAL(pool.in_use(), total);
+
+	// each thread frees the buffers of the next one
+	for (int t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&pool, &allocated, t]
+		{
+			auto& bufs = allocated[std::size_t((t + 1) % num_threads)];
+			for (char* buf : bufs) pool.free_buffer(buf);
+		});
+	}
+	for (auto& t : threads) t.join();
+
+	TEST_EQUAL(pool.in_use(), 0);
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(malloc_allocate_free) { test_allocate_free(0); }
+TORRENT_TEST(slab_allocate_free) { test_allocate_free(1024 * 1024); }
+TORRENT_TEST(slab_allocate_free_small) { test_allocate_free(1); }
+TORRENT_TEST(malloc_watermark) { test_watermark(0); }
+TORRENT_TEST(slab_watermark) { test_watermark(1024 * 1024); }
+TORRENT_TEST(malloc_threads) { test_threads(0); }
+TORRENT_TEST(slab_threads) { test_threads(1024 * 1024); }
+
+TORRENT_TEST(slab_huge_pages)
+{
+	lt::io_context ios;
+	disk_buffer_pool pool(ios);
+	auto pack = pool_settings(1, 1000);
+	pack.set_bool(lt::settings_pack::disk_buffer_huge_pages, true);
+	pool.set_settings(pack);
+
+	char* buf = pool.allocate_buffer("test");
+	TEST_CHECK(buf != nullptr);
+	std::memset(buf, 0x55, lt::default_block_size);
+	pool.free_buffer(buf);
+	TEST_EQUAL(pool.in_use(), 0);
+}
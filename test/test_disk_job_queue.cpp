@@ -0,0 +1,223 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/disk_job_queue.hpp"
+#include "libtorrent/aux_/disk_io_job.hpp"
+#include "libtorrent/aux_/mmap_storage.hpp"
+#include "libtorrent/aux_/file_view_pool.hpp"
+#include "libtorrent/file_storage.hpp"
+#include "libtorrent/disk_interface.hpp"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#if TORRENT_HAVE_MMAP
+
+using namespace lt;
+using lt::aux::disk_io_job;
+using lt::aux::disk_job_queue;
+using lt::aux::job_action_t;
+
+namespace {
+
+struct fixture
+{
+	fixture()
+	{
+		fs.add_file("test", 0x4000);
+	}
+
+	std::shared_ptr<aux::mmap_storage> make_storage()
+	{
+		storage_params p{fs, nullptr, save_path, storage_mode_sparse, prio, ih};
+		return std::make_shared<aux::mmap_storage>(p, pool);
+	}
+
+	// the jobs are owned here, the queue only links them together
+	disk_io_job* make_job(job_action_t const a
+		, std::shared_ptr<aux::mmap_storage> const& st, int const id = 0)
+	{
+		jobs.emplace_back(new disk_io_job);
+		disk_io_job* j = jobs.back().get();
+		j->action = a;
+		j->storage = st;
+		j->piece = piece_index_t(id);
+		return j;
+	}
+
+	file_storage fs;
+	std::string save_path = ".";
+	aux::vector<download_priority_t, file_index_t> prio;
+	sha1_hash ih;
+	aux::file_view_pool pool;
+	std::vector<std::unique_ptr<disk_io_job>> jobs;
+};
+
+} // anonymous namespace
+
+TORRENT_TEST(job_class)
+{
+	TEST_CHECK(aux::job_class(job_action_t::read) == aux::job_class_t::read);
+	TEST_CHECK(aux::job_class(job_action_t::partial_read) == aux::job_class_t::read);
+	TEST_CHECK(aux::job_class(job_action_t::write) == aux::job_class_t::write);
+	TEST_CHECK(aux::job_class(job_action_t::hash) == aux::job_class_t::hash);
+	TEST_CHECK(aux::job_class(job_action_t::hash2) == aux::job_class_t::hash);
+	TEST_CHECK(aux::job_class(job_action_t::move_storage) == aux::job_class_t::other);
+	TEST_CHECK(aux::job_class(job_action_t::release_files) == aux::job_class_t::other);
+}
+
+TORRENT_TEST(disk_job_queue_fifo)
+{
+	fixture f;
+	auto st = f.make_storage();
+	disk_job_queue q;
+	TEST_CHECK(q.empty());
+	for (int i = 0; i < 5; ++i)
+		q.push_back(f.make_job(job_action_t::read, st, i));
+	TEST_EQUAL(q.size(), 5);
+	TEST_EQUAL(q.size(aux::job_class_t::read), 5);
+	TEST_EQUAL(q.size(aux::job_class_t::write), 0);
+
+	int visited = 0;
+	q.for_each([&](disk_io_job*) { ++visited; });
+	TEST_EQUAL(visited, 5);
+
+	for (int i = 0; i < 5; ++i)
+		TEST_EQUAL(static_cast<int>(q.pop_front()->piece), i);
+	TEST_CHECK(q.empty());
+}
+
+TORRENT_TEST(disk_job_queue_weights)
+{
+	fixture f;
+	auto st = f.make_storage();
+	disk_job_queue q;
+	for (int i = 0; i < 100; ++i)
+	{
+		q.push_back(f.make_job(job_action_t::hash, st, i));
+		q.push_back(f.make_job(job_action_t::read, st, i));
+	}
+
+	// with the default weights, reads get 4 times as many jobs as hashes
+	std::array<int, aux::num_job_classes> popped{};
+	for (int i = 0; i < 50; ++i)
+		++popped[std::size_t(aux::job_class(q.pop_front()->action))];
+	TEST_EQUAL(popped[0], 40);
+	TEST_EQUAL(popped[2], 10);
+
+	q.set_weights(aux::array<int, aux::num_job_classes>{{1, 1, 1, 1}});
+	popped = {};
+	for (int i = 0; i < 20; ++i)
+		++popped[std::size_t(aux::job_class(q.pop_front()->action))];
+	TEST_EQUAL(popped[0], 10);
+	TEST_EQUAL(popped[2], 10);
+}
+
+TORRENT_TEST(disk_job_queue_storages_take_turns)
+{
+	fixture f;
+	auto st1 = f.make_storage();
+	auto st2 = f.make_storage();
+	disk_job_queue q;
+
+	// a torrent being checked has a deep queue
+	for (int i = 0; i < 10; ++i)
+		q.push_back(f.make_job(job_action_t::hash, st1, i));
+	q.push_back(f.make_job(job_action_t::hash, st2, 100));
+	q.push_back(f.make_job(job_action_t::hash, st2, 101));
+
+	std::vector<int> order;
+	while (!q.empty())
+		order.push_back(static_cast<int>(q.pop_front()->piece));
+	TEST_CHECK((order == std::vector<int>{0, 100, 1, 101, 2, 3, 4, 5, 6, 7, 8, 9}));
+}
+
+TORRENT_TEST(disk_job_queue_idle_class)
+{
+	fixture f;
+	auto st = f.make_storage();
+	disk_job_queue q;
+
+	// only hash jobs for a while
+	for (int i = 0; i < 50; ++i)
+		q.push_back(f.make_job(job_action_t::hash, st, i));
+	for (int i = 0; i < 50; ++i) q.pop_front();
+
+	// the write class was idle all that time. That doesn't entitle it to
+	// monopolize the disk threads now
+	for (int i = 0; i < 20; ++i)
+	{
+		q.push_back(f.make_job(job_action_t::write, st, i));
+		q.push_back(f.make_job(job_action_t::hash, st, i));
+	}
+	std::array<int, aux::num_job_classes> popped{};
+	for (int i = 0; i < 6; ++i)
+		++popped[std::size_t(aux::job_class(q.pop_front()->action))];
+	TEST_CHECK(popped[1] >= 3 && popped[1] <= 5);
+	TEST_CHECK(popped[2] >= 1);
+
+	while (!q.empty()) q.pop_front();
+}
+
+TORRENT_TEST(disk_job_queue_time_critical)
+{
+	fixture f;
+	auto st1 = f.make_storage();
+	auto st2 = f.make_storage();
+	disk_job_queue q;
+
+	for (int i = 0; i < 10; ++i)
+	{
+		q.push_back(f.make_job(job_action_t::read, st1, i));
+		q.push_back(f.make_job(job_action_t::hash, st1, i));
+	}
+
+	time_point const now = clock_type::now();
+	auto critical = [&](int const id, std::shared_ptr<aux::mmap_storage> const& st
+		, time_point const deadline)
+	{
+		disk_io_job* j = f.make_job(job_action_t::read, st, id);
+		j->flags |= disk_interface::time_critical;
+		j->deadline = deadline;
+		q.push_back(j);
+	};
+	critical(102, st2, now + seconds(3));
+	critical(100, st1, now + seconds(1));
+	critical(101, st2, now + seconds(2));
+	critical(103, st1, now + seconds(2));
+
+	TEST_EQUAL(q.size(), 24);
+	TEST_EQUAL(q.num_time_critical(), 4);
+	TEST_EQUAL(q.size(aux::job_class_t::read), 10);
+
+	int visited = 0;
+	q.for_each([&](disk_io_job*) { ++visited; });
+	TEST_EQUAL(visited, 24);
+
+	// the time-critical reads go first, earliest deadline first, regardless
+	// of storage. With equal deadlines, they keep their queue order
+	std::vector<int> order;
+	for (int i = 0; i < 4; ++i)
+		order.push_back(static_cast<int>(q.pop_front()->piece));
+	TEST_CHECK((order == std::vector<int>{100, 101, 103, 102}));
+	TEST_EQUAL(q.num_time_critical(), 0);
+
+	// the flag only affects reads
+	disk_io_job* j = f.make_job(job_action_t::hash, st2, 200);
+	j->flags |= disk_interface::time_critical;
+	q.push_back(j);
+	TEST_EQUAL(q.num_time_critical(), 0);
+	TEST_EQUAL(q.size(aux::job_class_t::hash), 11);
+
+	while (!q.empty()) q.pop_front();
+}
+
+#endif
@@ -0,0 +1,93 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/disk_thread_controller.hpp"
+
+#include <thread>
+#include <vector>
+
+using lt::aux::disk_thread_controller;
+using lt::microseconds;
+
+namespace {
+
+void add_jobs(disk_thread_controller& c, int const num, int const wait, int const service)
+{
+	for (int i = 0; i < num; ++i)
+		c.job_done(microseconds(wait), microseconds(service));
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(disk_thread_controller_no_jobs)
+{
+	disk_thread_controller c;
+	auto const d = c.update(4, 10);
+	TEST_EQUAL(d.limit, 4);
+	TEST_EQUAL(d.jobs, 0);
+
+	// the limit is clamped to the bounds
+	TEST_EQUAL(c.update(20, 10).limit, 10);
+	TEST_EQUAL(c.update(0, 10).limit, 1);
+}
+
+TORRENT_TEST(disk_thread_controller_grow)
+{
+	disk_thread_controller c;
+	add_jobs(c, 10, 3000, 1000);
+	auto const d = c.update(8, 16);
+	TEST_EQUAL(d.jobs, 10);
+	TEST_EQUAL(d.queue_wait, 3000);
+	TEST_EQUAL(d.service_time, 1000);
+	TEST_EQUAL(d.limit, 10);
+
+	// small pools grow by one thread at a time, and never past the max
+	add_jobs(c, 10, 3000, 1000);
+	TEST_EQUAL(c.update(2, 16).limit, 3);
+	add_jobs(c, 10, 3000, 1000);
+	TEST_EQUAL(c.update(15, 16).limit, 16);
+}
+
+TORRENT_TEST(disk_thread_controller_shrink)
+{
+	disk_thread_controller c;
+	add_jobs(c, 10, 10, 1000);
+	TEST_EQUAL(c.update(8, 16).limit, 7);
+
+	// there's always at least one thread
+	add_jobs(c, 10, 10, 1000);
+	TEST_EQUAL(c.update(1, 16).limit, 1);
+
+	// the samples are consumed by update()
+	TEST_EQUAL(c.update(8, 16).jobs, 0);
+}
+
+TORRENT_TEST(disk_thread_controller_steady)
+{
+	// jobs wait a little, but not more than they take to execute. This is
+	// the sweet spot, the limit is left alone
+	disk_thread_controller c;
+	add_jobs(c, 10, 500, 1000);
+	TEST_EQUAL(c.update(6, 16).limit, 6);
+}
+
+TORRENT_TEST(disk_thread_controller_threads)
+{
+	disk_thread_controller c;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+		threads.emplace_back([&c] { add_jobs(c, 1000, 2, 1); });
+	for (auto& t : threads) t.join();
+	auto const d = c.update(4, 8);
+	TEST_EQUAL(d.jobs, 4000);
+	TEST_EQUAL(d.queue_wait, 2);
+	TEST_EQUAL(d.service_time, 1);
+	TEST_EQUAL(d.limit, 5);
+}
@@ -0,0 +1,560 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/dns_resolver.hpp"
+#include "libtorrent/aux_/io.hpp"
+#include "libtorrent/time.hpp"
+
+#include <array>
+#include <map>
+#include <set>
+#include <thread>
+
+using namespace lt;
+using namespace lt::aux;
+
+namespace {
+
+struct stub_record
+{
+	std::vector<address> addresses;
+	std::uint32_t ttl = 300;
+
+	// respond with NXDOMAIN, and an SOA record with this TTL
+	bool nxdomain = false;
+
+	// the number of queries to ignore before responding
+	int drop = 0;
+
+	// respond over UDP with the TC bit set and without answers, the full
+	// response is only available over TCP
+	bool truncate = false;
+
+	// send the responses from another port than the queries were sent to
+	bool other_source = false;
+};
+
+// a name server answering A and AAAA queries from a table, over UDP and TCP
+struct stub_dns_server
+{
+	explicit stub_dns_server(io_context& ios)
+		: m_ios(ios)
+		, m_socket(ios)
+		, m_other_socket(ios)
+		, m_acceptor(ios)
+	{
+		m_socket.open(udp::v4());
+		m_socket.bind(udp::endpoint(make_address_v4("127.0.0.1"), 0));
+		m_other_socket.open(udp::v4());
+		m_other_socket.bind(udp::endpoint(make_address_v4("127.0.0.1"), 0));
+		m_acceptor.open(tcp::v4());
+		m_acceptor.bind(tcp::endpoint(make_address_v4("127.0.0.1")
+			, m_socket.local_endpoint().port()));
+		m_acceptor.listen();
+		start_receive();
+		start_accept();
+	}
+
+	udp::endpoint endpoint() const { return m_socket.local_endpoint(); }
+
+	void start_receive()
+	{
+		m_socket.async_receive_from(boost::asio::buffer(m_buf), m_from
+			, [this](error_code const& ec, std::size_t const bytes)
+		{
+			if (ec) return;
+			source_ports.insert(m_from.port());
+			std::vector<char> const r = on_query(
+				span<char const>(m_buf.data(), std::ptrdiff_t(bytes)), false);
+			if (!r.empty())
+			{
+				auto const i = records.find(query_name(m_buf));
+				udp::socket& s = i != records.end() && i->second.other_source
+					? m_other_socket : m_socket;
+				error_code ignore;
+				s.send_to(boost::asio::buffer(r), m_from, 0, ignore);
+			}
+			start_receive();
+		});
+	}
+
+	// every TCP connection is used for a single query
+	struct tcp_connection
+	{
+		explicit tcp_connection(io_context& ios) : sock(ios) {}
+		tcp::socket sock;
+		std::array<char, 2> length;
+		std::vector<char> buf;
+	};
+
+	void start_accept()
+	{
+		auto c = std::make_shared<tcp_connection>(m_ios);
+		m_acceptor.async_accept(c->sock, [this, c](error_code const& ec)
+		{
+			if (ec) return;
+			++num_tcp_connections;
+			boost::asio::async_read(c->sock, boost::asio::buffer(c->length)
+				, [this, c](error_code const& e, std::size_t)
+			{
+				if (e) return;
+				c->buf.resize(std::size_t((std::uint8_t(c->length[0]) << 8)
+					| std::uint8_t(c->length[1])));
+				boost::asio::async_read(c->sock, boost::asio::buffer(c->buf)
+					, [this, c](error_code const& err, std::size_t)
+				{
+					if (err) return;
+					std::vector<char> r = on_query(c->buf, true);
+					if (r.empty()) return;
+					auto const len = r.size();
+					r.insert(r.begin(), {char(len >> 8), char(len & 0xff)});
+					c->buf = std::move(r);
+					boost::asio::async_write(c->sock, boost::asio::buffer(c->buf)
+						, [c](error_code const&, std::size_t) {});
+				});
+			});
+			start_accept();
+		});
+	}
+
+	// the name in the question, skipping the header
+	static std::string query_name(span<char const> q)
+	{
+		std::string name;
+		std::ptrdiff_t pos = 12;
+		while (pos < q.size() && q[pos] != 0)
+		{
+			int const len = q[pos];
+			if (!name.empty()) name += '.';
+			name.append(q.data() + pos + 1, std::size_t(len));
+			pos += len + 1;
+		}
+		return name;
+	}
+
+	// returns the response to the query, or an empty buffer to not respond
+	std::vector<char> on_query(span<char const> q, bool const tcp)
+	{
+		++num_queries;
+
+		// the header, the encoded name and its terminating 0
+		std::string const name = query_name(q);
+		std::ptrdiff_t pos = 12 + std::ptrdiff_t(name.size()) + 2;
+		int const type = (std::uint8_t(q[pos]) << 8) | std::uint8_t(q[pos + 1]);
+		pos += 4;
+
+		auto const i = records.find(name);
+		if (i != records.end() && i->second.drop > 0)
+		{
+			--i->second.drop;
+			return {};
+		}
+
+		bool const truncated = !tcp && i != records.end() && i->second.truncate;
+		std::vector<address> answers;
+		if (i != records.end() && !truncated)
+		{
+			for (auto const& a : i->second.addresses)
+				if (a.is_v4() == (type == 1)) answers.push_back(a);
+		}
+		bool const nxdomain = !truncated && (i == records.end() || i->second.nxdomain);
+
+		std::vector<char> r(q.begin(), q.begin() + pos);
+		span<char> header(r);
+		aux::read_uint16(header); // the ID is copied from the query
+		aux::write_uint16(0x8180 | (truncated ? 0x200 : 0) | (nxdomain ? 3 : 0), header);
+		aux::write_uint16(1, header);
+		aux::write_uint16(answers.size(), header);
+		aux::write_uint16(nxdomain ? 1 : 0, header);
+		aux::write_uint16(0, header);
+
+		auto append = [&r](std::initializer_list<int> bytes)
+		{ for (int b : bytes) r.push_back(char(b)); };
+		auto append32 = [&r](std::uint32_t v)
+		{ for (int s = 24; s >= 0; s -= 8) r.push_back(char((v >> s) & 0xff)); };
+
+		std::uint32_t const ttl = i == records.end() ? 0 : i->second.ttl;
+		for (auto const& a : answers)
+		{
+			// a pointer to the name in the question
+			append({0xc0, 12, 0, type, 0, 1});
+			append32(ttl);
+			if (a.is_v4())
+			{
+				append({0, 4});
+				for (auto b : a.to_v4().to_bytes()) r.push_back(char(b));
+			}
+			else
+			{
+				append({0, 16});
+				for (auto b : a.to_v6().to_bytes()) r.push_back(char(b));
+			}
+		}
+		if (nxdomain)
+		{
+			// the SOA record's MINIMUM is the negative caching TTL
+			append({0xc0, 12, 0, 6, 0, 1});
+			append32(3600);
+			append({0, 7 + 20});
+			append({2, 'n', 's', 0, 1, 'h', 0});
+			append32(1);
+			append32(2);
+			append32(3);
+			append32(4);
+			append32(ttl);
+		}
+
+		return r;
+	}
+
+	std::map<std::string, stub_record> records;
+	int num_queries = 0;
+	int num_tcp_connections = 0;
+
+	// the ports the queries over UDP were sent from
+	std::set<int> source_ports;
+
+private:
+	io_context& m_ios;
+	udp::socket m_socket;
+	udp::socket m_other_socket;
+	tcp::acceptor m_acceptor;
+	std::array<char, 1500> m_buf;
+	udp::endpoint m_from;
+};
+
+struct lookup_result
+{
+	bool done = false;
+	error_code ec;
+	std::vector<address> addresses;
+};
+
+lookup_result resolve(io_context& ios, dns_resolver& r, std::string const& host
+	, resolver_flags const flags = {})
+{
+	auto ret = std::make_shared<lookup_result>();
+	r.async_resolve(host, flags, [ret](error_code const& ec, std::vector<address> const& a)
+	{
+		ret->done = true;
+		ret->ec = ec;
+		ret->addresses = a;
+	});
+	time_point const deadline = clock_type::now() + seconds(5);
+	while (!ret->done && clock_type::now() < deadline)
+		ios.run_one_for(milliseconds(50));
+	TEST_CHECK(ret->done);
+	return *ret;
+}
+
+// lets the resolver handle the packets in flight
+void settle(io_context& ios)
+{
+	ios.run_for(milliseconds(100));
+}
+
+}
+
+TORRENT_TEST(dns_query_format)
+{
+	std::vector<char> q;
+	TEST_CHECK(write_dns_query(0x1234, "a.example.com.", dns_type::aaaa, q));
+	std::vector<char> const expected = {0x12, 0x34, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0
+		, 1, 'a', 7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0
+		, 0, 28, 0, 1};
+	TEST_CHECK(q == expected);
+
+	TEST_CHECK(!write_dns_query(1, "", dns_type::a, q));
+	TEST_CHECK(!write_dns_query(1, "a..b", dns_type::a, q));
+	TEST_CHECK(!write_dns_query(1, std::string(64, 'a') + ".com", dns_type::a, q));
+}
+
+TORRENT_TEST(dns_parse_response)
+{
+	std::vector<char> q;
+	TEST_CHECK(write_dns_query(7, "www.test", dns_type::a, q));
+
+	// a CNAME to "x", then its A record. The answer is only valid for as
+	// long as the CNAME is
+	std::vector<char> r = q;
+	r[2] = char(0x81);
+	r[3] = char(0x80);
+	r[7] = 2;
+	std::vector<char> const answers = {
+		char(0xc0), 12, 0, 5, 0, 1, 0, 0, 0, 30, 0, 4, 1, 'x', char(0xc0), 16,
+		char(0xc0), char(q.size() + 12), 0, 1, 0, 1, 0, 0, 1, 0, 0, 4, 10, 0, 0, 1};
+	r.insert(r.end(), answers.begin(), answers.end());
+
+	dns_response resp;
+	TEST_CHECK(parse_dns_response(r, "WWW.test", dns_type::a, resp));
+	TEST_EQUAL(resp.id, 7);
+	TEST_EQUAL(resp.rcode, 0);
+	TEST_EQUAL(resp.addresses.size(), 1);
+	if (resp.addresses.size() == 1)
+		TEST_EQUAL(resp.addresses[0], make_address_v4("10.0.0.1"));
+	TEST_EQUAL(resp.ttl, 30);
+
+	// a response to another question
+	TEST_CHECK(!parse_dns_response(r, "www.test", dns_type::aaaa, resp));
+	TEST_CHECK(!parse_dns_response(r, "ww.test", dns_type::a, resp));
+	std::vector<char> chaos = r;
+	chaos[q.size() - 1] = 3;
+	TEST_CHECK(!parse_dns_response(chaos, "www.test", dns_type::a, resp));
+
+	// the TC bit
+	TEST_CHECK(!resp.truncated);
+	std::vector<char> tc = r;
+	tc[2] |= 0x02;
+	TEST_CHECK(parse_dns_response(tc, "www.test", dns_type::a, resp));
+	TEST_CHECK(resp.truncated);
+
+	// a compression pointer loop
+	r[r.size() - 16] = char(0xc0);
+	r[r.size() - 15] = char(r.size() - 16);
+	TEST_CHECK(!parse_dns_response(r, "www.test", dns_type::a, resp));
+
+	// truncated
+	TEST_CHECK(!parse_dns_response(span<char const>(r).first(20), "www.test"
+		, dns_type::a, resp));
+}
+
+TORRENT_TEST(dns_resolver_lookup)
+{
+	io_context ios;
+	stub_dns_server server(ios);
+	server.records["tracker.test"].addresses = {
+		make_address("10.0.0.1"), make_address("10.0.0.2"), make_address("::1")};
+
+	dns_resolver r(ios);
+	r.set_servers({server.endpoint()});
+
+	auto const res = resolve(ios, r, "tracker.test");
+	TEST_CHECK(!res.ec);
+	TEST_EQUAL(res.addresses.size(), 3);
+	// one query for A records and one for AAAA
+	TEST_EQUAL(server.num_queries, 2);
+
+	// the second lookup is served from the cache
+	auto const res2 = resolve(ios, r, "tracker.test");
+	TEST_CHECK(!res2.ec);
+	TEST_CHECK(res2.addresses == res.addresses);
+	TEST_EQUAL(server.num_queries, 2);
+
+	// IP addresses don't need a lookup
+	auto const res3 = resolve(ios, r, "10.1.2.3");
+	TEST_CHECK(!res3.ec);
+	TEST_EQUAL(server.num_queries, 2);
+}
+
+TORRENT_TEST(dns_resolver_concurrent_lookups)
+{
+	io_context ios;
+	stub_dns_server server(ios);
+	server.records["a.test"].addresses = {make_address("10.0.0.1")};
+	server.records["b.test"].addresses = {make_address("10.0.0.2")};
+
+	dns_resolver r(ios);
+	r.set_servers({server.endpoint()});
+
+	// lookups of the same name share the queries, different names are
+	// looked up in parallel
+	int done = 0;
+	auto const handler = [&done](error_code const& ec, std::vector<address> const& a)
+	{
+		TEST_CHECK(!ec);
+		TEST_EQUAL(a.size(), 1);
+		++done;
+	};
+	r.async_resolve("a.test", {}, handler);
+	r.async_resolve("a.test", {}, handler);
+	r.async_resolve("b.test", {}, handler);
+	time_point const deadline = clock_type::now() + seconds(5);
+	while (done < 3 && clock_type::now() < deadline)
+		ios.run_one_for(milliseconds(50));
+	TEST_EQUAL(done, 3);
+	TEST_EQUAL(server.num_queries, 4);
+}
+
+TORRENT_TEST(dns_resolver_negative_cache)
+{
+	io_context ios;
+	stub_dns_server server(ios);
+	server.records["gone.test"].nxdomain = true;
+	server.records["gone.test"].ttl = 1;
+
+	dns_resolver r(ios);
+	r.set_servers({server.endpoint()});
+
+	auto const res = resolve(ios, r, "gone.test");
+	TEST_CHECK(res.ec == boost::asio::error::host_not_found);
+	TEST_CHECK(res.addresses.empty());
+	TEST_EQUAL(server.num_queries, 2);
+
+	// the failure is cached
+	auto const res2 = resolve(ios, r, "gone.test");
+	TEST_CHECK(res2.ec == boost::asio::error::host_not_found);
+	TEST_EQUAL(server.num_queries, 2);
+
+	// for as long as the SOA record says
+	std::this_thread::sleep_for(milliseconds(1100));
+	auto const res3 = resolve(ios, r, "gone.test");
+	TEST_CHECK(res3.ec == boost::asio::error::host_not_found);
+	TEST_EQUAL(server.num_queries, 4);
+}
+
+TORRENT_TEST(dns_resolver_retry)
+{
+	io_context ios;
+	stub_dns_server server(ios);
+	server.records["slow.test"].addresses = {make_address("10.0.0.1")};
+	server.records["slow.test"].drop = 2;
+
+	dns_resolver r(ios);
+	r.set_servers({server.endpoint()});
+	r.set_query_timeout(milliseconds(200), 3);
+
+	// the first attempt times out, the second one succeeds
+	auto const res = resolve(ios, r, "slow.test");
+	TEST_CHECK(!res.ec);
+	TEST_EQUAL(res.addresses.size(), 1);
+	TEST_EQUAL(server.num_queries, 4);
+}
+
+TORRENT_TEST(dns_resolver_timeout)
+{
+	io_context ios;
+	stub_dns_server server(ios);
+	server.records["dead.test"].drop = 1000;
+
+	dns_resolver r(ios);
+	r.set_servers({server.endpoint()});
+	r.set_query_timeout(milliseconds(100), 3);
+
+	auto const res = resolve(ios, r, "dead.test");
+	TEST_CHECK(res.ec == boost::asio::error::timed_out);
+	TEST_EQUAL(server.num_queries, 6);
+
+	// timeouts are not cached
+	resolve(ios, r, "dead.test");
+	TEST_EQUAL(server.num_queries, 12);
+
+	// but the cache-only flag doesn't wait for the network
+	auto const res2 = resolve(ios, r, "dead.test", resolver_interface::cache_only);
+	TEST_CHECK(res2.ec == boost::asio::error::host_not_found);
+	TEST_EQUAL(server.num_queries, 12);
+}
+
+TORRENT_TEST(dns_resolver_prefetch)
+{
+	io_context ios;
+	stub_dns_server server(ios);
+	server.records["short.test"].addresses = {make_address("10.0.0.1")};
+	server.records["short.test"].ttl = 2;
+
+	dns_resolver r(ios);
+	r.set_servers({server.endpoint()});
+
+	resolve(ios, r, "short.test");
+	TEST_EQUAL(server.num_queries, 2);
+
+	// a lookup shortly before the entry expires is served from the cache,
+	// and refreshes it in the background
+	std::this_thread::sleep_for(milliseconds(1300));
+	auto const res = resolve(ios, r, "short.test");
+	TEST_CHECK(!res.ec);
+	settle(ios);
+	TEST_EQUAL(server.num_queries, 4);
+
+	// so it's still cached after the original entry would have expired
+	std::this_thread::sleep_for(milliseconds(800));
+	auto const res2 = resolve(ios, r, "short.test");
+	TEST_CHECK(!res2.ec);
+	TEST_EQUAL(res2.addresses.size(), 1);
+	TEST_EQUAL(server.num_queries, 4);
+}
+
+TORRENT_TEST(dns_resolver_abort)
+{
+	io_context ios;
+	stub_dns_server server(ios);
+	server.records["dead.test"].drop = 1000;
+
+	dns_resolver r(ios);
+	r.set_servers({server.endpoint()});
+
+	int aborted = 0;
+	r.async_resolve("dead.test", resolver_interface::abort_on_shutdown
+		, [&](error_code const& ec, std::vector<address> const&)
+		{
+			TEST_CHECK(ec == boost::asio::error::operation_aborted);
+			++aborted;
+		});
+	ios.poll();
+	r.abort();
+	ios.poll();
+	TEST_EQUAL(aborted, 1);
+}
+
+TORRENT_TEST(dns_resolver_source_ports)
+{
+	io_context ios;
+	stub_dns_server server(ios);
+	server.records["a.test"].addresses = {make_address("10.0.0.1")};
+	server.records["b.test"].addresses = {make_address("10.0.0.2")};
+	server.records["c.test"].addresses = {make_address("10.0.0.3")};
+
+	dns_resolver r(ios);
+	r.set_servers({server.endpoint()});
+
+	// every lookup is sent from a port of its own
+	resolve(ios, r, "a.test");
+	resolve(ios, r, "b.test");
+	resolve(ios, r, "c.test");
+	TEST_EQUAL(server.num_queries, 6);
+	TEST_EQUAL(server.source_ports.size(), 3);
+}
+
+TORRENT_TEST(dns_resolver_wrong_source)
+{
+	io_context ios;
+	stub_dns_server server(ios);
+	server.records["spoofed.test"].addresses = {make_address("10.0.0.1")};
+	server.records["spoofed.test"].other_source = true;
+
+	dns_resolver r(ios);
+	r.set_servers({server.endpoint()});
+	r.set_query_timeout(milliseconds(100), 2);
+
+	// responses from another address than the one of the name server are
+	// ignored
+	auto const res = resolve(ios, r, "spoofed.test");
+	TEST_CHECK(res.ec == boost::asio::error::timed_out);
+	TEST_CHECK(res.addresses.empty());
+	TEST_EQUAL(server.num_queries, 4);
+}
+
+TORRENT_TEST(dns_resolver_truncated)
+{
+	io_context ios;
+	stub_dns_server server(ios);
+	server.records["big.test"].addresses = {
+		make_address("10.0.0.1"), make_address("10.0.0.2"), make_address("::1")};
+	server.records["big.test"].truncate = true;
+
+	dns_resolver r(ios);
+	r.set_servers({server.endpoint()});
+
+	// both questions are asked again over TCP
+	auto const res = resolve(ios, r, "big.test");
+	TEST_CHECK(!res.ec);
+	TEST_EQUAL(res.addresses.size(), 3);
+	TEST_EQUAL(server.num_queries, 4);
+	TEST_EQUAL(server.num_tcp_connections, 2);
+}
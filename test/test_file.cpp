@@ -17,6 +17,7 @@ see LICENSE file.
 #include "libtorrent/aux_/numeric_cast.hpp"
 #include "libtorrent/string_view.hpp"
 #include "libtorrent/aux_/file_view_pool.hpp"
+#include "libtorrent/file_storage.hpp"
 #include "libtorrent/aux_/numeric_cast.hpp"
 #include "test.hpp"
 #include "test_utils.hpp"
@@ -388,6 +389,54 @@ TORRENT_TEST(hard_link)
 		std::printf("remove failed: [%s] %s\n", ec.category().name(), ec.message().c_str());
 }
 
+TORRENT_TEST(copy_file_resume)
+{
+	int const size = 300000;
+	touch_file("copy_source", size);
+
+	std::vector<char> source(static_cast<std::size_t>(size));
+	std::ifstream("copy_source", std::ios::binary).read(source.data(), size);
+
+	// a copy that was interrupted after 100000 bytes, with some garbage
+	// written past that
+	{
+		std::vector<char> partial(source.begin(), source.begin() + 105000);
+		std::fill(partial.begin() + 100000, partial.end(), 'x');
+		ofstream("copy_dest").write(partial.data(), std::streamsize(partial.size()));
+	}
+
+	std::int64_t copied = 0;
+	error_code ec;
+	copy_file("copy_source", "copy_dest", 100000
+		, [&](std::int64_t const n) { copied += n; }, ec);
+	TEST_CHECK(!ec);
+#if !defined TORRENT_WINDOWS && !(defined __APPLE__ && defined __MACH__)
+	TEST_EQUAL(copied, size - 100000);
+#endif
+
+	std::vector<char> dest(static_cast<std::size_t>(size) + 1);
+	std::ifstream in("copy_dest", std::ios::binary);
+	in.read(dest.data(), size + 1);
+	TEST_EQUAL(in.gcount(), size);
+	dest.resize(std::size_t(size));
+	TEST_CHECK(dest == source);
+
+	// a copy from the start replaces all of the destination
+	copied = 0;
+	copy_file("copy_source", "copy_dest", 0
+		, [&](std::int64_t const n) { copied += n; }, ec);
+	TEST_CHECK(!ec);
+#if !defined TORRENT_WINDOWS && !(defined __APPLE__ && defined __MACH__)
+	TEST_EQUAL(copied, size);
+#endif
+	file_status st;
+	stat_file("copy_dest", &st, ec);
+	TEST_EQUAL(st.file_size, size);
+
+	remove("copy_source", ec);
+	remove("copy_dest", ec);
+}
+
 TORRENT_TEST(stat_file)
 {
 	file_status st;
@@ -601,3 +650,102 @@ TORRENT_TEST(to_file_open_mode)
 
 
 #endif
+
+#if TORRENT_HAVE_MMAP
+namespace {
+
+file_storage pool_test_files(int const num_files)
+{
+	file_storage fs;
+	fs.set_piece_length(0x4000);
+	for (int i = 0; i < num_files; ++i)
+		fs.add_file(combine_path("pool_test", "file" + std::to_string(i)), 0x4000);
+	fs.set_num_pieces(num_files);
+	return fs;
+}
+
+std::vector<int> open_files(aux::file_view_pool const& pool, storage_index_t const st)
+{
+	std::vector<int> ret;
+	for (auto const& s : pool.get_status(st))
+		ret.push_back(static_cast<int>(s.file_index));
+	return ret;
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(file_view_pool_lru)
+{
+	std::string const save_path = complete(".");
+	error_code ec;
+	create_directory("pool_test", ec);
+	file_storage const fs = pool_test_files(6);
+	storage_index_t const st{0};
+
+	aux::file_view_pool pool(4);
+	for (file_index_t i : fs.file_range())
+		pool.open_file(st, save_path, i, fs, aux::open_mode::write);
+	TEST_EQUAL(pool.num_files(), 3);
+	TEST_CHECK((open_files(pool, st) == std::vector<int>{3, 4, 5}));
+
+	// file 3 is used again, so file 4 is the least recently used one
+	pool.open_file(st, save_path, file_index_t{3}, fs, aux::open_mode::read_only);
+	pool.open_file(st, save_path, file_index_t{0}, fs, aux::open_mode::write);
+	TEST_CHECK((open_files(pool, st) == std::vector<int>{0, 3, 5}));
+
+	pool.release(st, file_index_t{3});
+	TEST_EQUAL(pool.num_files(), 2);
+	TEST_CHECK(open_files(pool, storage_index_t{1}).empty());
+
+	pool.resize(1);
+	TEST_EQUAL(pool.num_files(), 1);
+	TEST_CHECK((open_files(pool, st) == std::vector<int>{0}));
+
+	pool.release(st);
+	TEST_EQUAL(pool.num_files(), 0);
+	remove_all("pool_test", ec);
+}
+
+TORRENT_TEST(file_view_pool_threads)
+{
+	std::string const save_path = complete(".");
+	error_code ec;
+	create_directory("pool_test", ec);
+	file_storage const fs = pool_test_files(20);
+
+	aux::file_view_pool pool(10);
+
+	// create the files, opening them read-only requires them to exist
+	for (file_index_t i : fs.file_range())
+		pool.open_file(storage_index_t{0}, save_path, i, fs, aux::open_mode::write);
+	pool.release();
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&, t]
+		{
+			storage_index_t const st{t % 2};
+			for (int i = 0; i < 2000; ++i)
+			{
+				file_index_t const f{(i * 7 + t) % fs.num_files()};
+				auto view = pool.open_file(st, save_path, f, fs
+					, (i % 3) ? aux::open_mode::read_only : aux::open_mode::write);
+				if (i % 100 == 0) pool.release(st, f);
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+
+	int const num_open = int(open_files(pool, storage_index_t{0}).size()
+		+ open_files(pool, storage_index_t{1}).size());
+	TEST_EQUAL(pool.num_files(), num_open);
+	// racing threads may each close a file to make room for their own, so
+	// the limit is approximate
+	TEST_CHECK(num_open <= 10 + 4);
+
+	pool.release();
+	TEST_EQUAL(pool.num_files(), 0);
+	remove_all("pool_test", ec);
+}
+#endif
@@ -76,3 +76,122 @@ TORRENT_TEST(empty)
 	inflate_gzip(empty, inflated, 1000000, ec);
 	TEST_CHECK(ec);
 }
+
+namespace {
+
+// "0 bottles of beer on the wall\n" ... "29 bottles of beer on the wall\n",
+// compressed with a dynamic Huffman block
+unsigned char const dynamic_gz[] = {
+	0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x85, 0xd2,
+	0xcb, 0x09, 0x80, 0x30, 0x14, 0x05, 0xd1, 0xbd, 0x55, 0xbc, 0x12, 0xbc,
+	0xd7, 0x7f, 0x39, 0x06, 0x22, 0x2e, 0x82, 0x01, 0x0d, 0xd8, 0xbe, 0x1d,
+	0x8c, 0xeb, 0xd9, 0x1d, 0xa6, 0x8f, 0x54, 0x5b, 0x2b, 0xf9, 0x89, 0x7a,
+	0x44, 0xca, 0xf9, 0x8e, 0x7a, 0x45, 0x3b, 0x73, 0xbc, 0x7b, 0x29, 0x9d,
+	0xb0, 0x1a, 0xeb, 0x80, 0x75, 0xc4, 0x3a, 0x61, 0x9d, 0xb1, 0x2e, 0x58,
+	0x57, 0xac, 0x1b, 0x6b, 0xf4, 0x9c, 0x59, 0x4b, 0xcc, 0x25, 0xf6, 0x12,
+	0x83, 0x89, 0xc5, 0xc4, 0x64, 0x62, 0x33, 0x31, 0x9a, 0x58, 0xcd, 0xac,
+	0xe6, 0x9f, 0xc7, 0x58, 0xcd, 0xac, 0x66, 0x56, 0x33, 0xab, 0x99, 0xd5,
+	0xcc, 0x6a, 0x66, 0x35, 0xb3, 0xda, 0x07, 0xfb, 0xc7, 0xb4, 0xc2, 0x98,
+	0x03, 0x00, 0x00,
+};
+
+std::string dynamic_text()
+{
+	std::string ret;
+	for (int i = 0; i < 30; ++i)
+		ret += std::to_string(i) + " bottles of beer on the wall\n";
+	return ret;
+}
+
+std::string inflate(span<char const> in, int const maximum_size, error_code& ec)
+{
+	std::vector<char> inflated;
+	inflate_gzip(in, inflated, maximum_size, ec);
+	return std::string(inflated.begin(), inflated.end());
+}
+
+std::vector<char> to_vector(span<unsigned char const> buf)
+{
+	return std::vector<char>(buf.begin(), buf.end());
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(dynamic_block)
+{
+	error_code ec;
+	TEST_EQUAL(inflate(to_vector(dynamic_gz), 1000000, ec), dynamic_text());
+	TEST_CHECK(!ec);
+}
+
+TORRENT_TEST(fixed_block)
+{
+	unsigned char const gz[] = {
+		0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xcb, 0x48,
+		0xcd, 0xc9, 0xc9, 0x57, 0xc8, 0x40, 0x22, 0xcb, 0xf3, 0x8b, 0x72, 0x52,
+		0x00, 0x26, 0xe6, 0x5a, 0x81, 0x17, 0x00, 0x00, 0x00};
+	error_code ec;
+	TEST_EQUAL(inflate(to_vector(gz), 1000000, ec), "hello hello hello world");
+	TEST_CHECK(!ec);
+}
+
+TORRENT_TEST(stored_block)
+{
+	unsigned char const gz[] = {
+		0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x03, 0x01, 0x0c,
+		0x00, 0xf3, 0xff, 's', 't', 'o', 'r', 'e', 'd', ' ', 'b', 'l',
+		'o', 'c', 'k', 0x94, 0xa3, 0x24, 0x3d, 0x0c, 0x00, 0x00, 0x00};
+	error_code ec;
+	TEST_EQUAL(inflate(to_vector(gz), 1000000, ec), "stored block");
+	TEST_CHECK(!ec);
+}
+
+TORRENT_TEST(maximum_size)
+{
+	int const size = int(dynamic_text().size());
+
+	std::vector<char> const gz = to_vector(dynamic_gz);
+
+	error_code ec;
+	TEST_EQUAL(inflate(gz, size, ec), dynamic_text());
+	TEST_CHECK(!ec);
+
+	inflate(gz, size - 1, ec);
+	TEST_EQUAL(ec, error_code(gzip_errors::inflated_data_too_large));
+}
+
+TORRENT_TEST(wrong_size_in_trailer)
+{
+	// the size in the trailer is only a hint for the size of the output
+	// buffer
+	std::vector<char> gz = to_vector(dynamic_gz);
+	gz[gz.size() - 4] = 1;
+	gz[gz.size() - 3] = 0;
+
+	error_code ec;
+	TEST_EQUAL(inflate(gz, 1000000, ec), dynamic_text());
+	TEST_CHECK(!ec);
+
+	// a size much larger than the input can decompress to isn't trusted,
+	// the buffer isn't sized to maximum_size up-front
+	gz[gz.size() - 2] = char(0xff);
+	gz[gz.size() - 1] = 0x7f;
+	std::vector<char> inflated;
+	inflate_gzip(gz, inflated, 100000000, ec);
+	TEST_CHECK(!ec);
+	TEST_CHECK(std::string(inflated.begin(), inflated.end()) == dynamic_text());
+	TEST_CHECK(inflated.capacity() < 100000);
+}
+
+TORRENT_TEST(truncated)
+{
+	std::vector<char> const gz = to_vector(dynamic_gz);
+
+	// the deflate stream ends before the 8 bytes of the trailer
+	for (std::ptrdiff_t size = 0; size < std::ptrdiff_t(gz.size()) - 8; ++size)
+	{
+		error_code ec;
+		inflate(span<char const>(gz).first(size), 1000000, ec);
+		TEST_CHECK(ec);
+	}
+}
@@ -22,8 +22,10 @@ see LICENSE file.
 #include "libtorrent/aux_/storage_utils.hpp"
 #include "libtorrent/aux_/random.hpp"
 
+#include <array>
 #include <iostream>
 #include <optional>
+#include <string>
 
 using namespace lt;
 
@@ -206,6 +208,143 @@ void run_suite(std::string const& protocol
 	stop_web_server();
 }
 
+// with keep-alive, the second request is sent over the connection of the
+// first one
+void run_keep_alive_test(std::string const& protocol)
+{
+	aux::random_bytes(data_buffer);
+	ofstream("test_file").write(data_buffer, 3216);
+	int const port = start_web_server(protocol == "https", false, true);
+
+#if TORRENT_USE_SSL
+	aux::ssl::context ssl_ctx(aux::ssl::context::sslv23_client);
+	ssl_ctx.set_verify_mode(aux::ssl::context::verify_none);
+#endif
+
+	auto const make_connection = [&]
+	{
+		return std::make_shared<aux::http_connection>(ios
+			, res, &::http_handler_test, true, 1024*1024, &::http_connect_handler_test
+			, aux::http_filter_handler()
+			, aux::hostname_filter_handler()
+#if TORRENT_USE_SSL
+			, &ssl_ctx
+#endif
+			);
+	};
+
+	char url[256];
+	std::snprintf(url, sizeof(url), "%s://127.0.0.1:%d/test_file", protocol.c_str(), port);
+
+	reset_globals();
+	auto h = make_connection();
+	h->keep_alive(true);
+	h->get(url, seconds(5), 0, nullptr, 5, "test/user-agent");
+	ios.restart();
+	ios.run();
+
+	TEST_EQUAL(connect_handler_called, 1);
+	TEST_EQUAL(handler_called, 1);
+	TEST_EQUAL(http_status, 200);
+	TEST_EQUAL(data_size, 3216);
+	TEST_CHECK(h->idle());
+
+	h->get(url, seconds(5), 0, nullptr, 5, "test/user-agent");
+	ios.restart();
+	ios.run();
+
+	TEST_EQUAL(connect_handler_called, 1);
+	TEST_EQUAL(handler_called, 2);
+	TEST_EQUAL(http_status, 200);
+	TEST_EQUAL(data_size, 3216);
+	TEST_CHECK(h->idle());
+
+#if TORRENT_USE_SSL
+	if (protocol == "https")
+	{
+		// a new connection resumes the SSL session of the first one
+		auto h2 = make_connection();
+		h2->resume_ssl_session(h->ssl_session());
+		h2->get(url, seconds(5), 0, nullptr, 5, "test/user-agent");
+		ios.restart();
+		ios.run();
+
+		TEST_EQUAL(connect_handler_called, 2);
+		TEST_EQUAL(handler_called, 3);
+		TEST_EQUAL(http_status, 200);
+		TEST_CHECK(h2->ssl_session_resumed());
+		h2->close(true);
+	}
+#endif
+
+	h->close(true);
+	ios.restart();
+	ios.run();
+
+	stop_web_server();
+}
+
+// an HTTP server on the loopback interface, serving a single connection.
+// Unlike the web server process, the test can shut it down synchronously
+struct local_server
+{
+	explicit local_server(io_context& ioc)
+		: m_acceptor(ioc)
+		, m_sock(ioc)
+	{
+		m_acceptor.open(tcp::v4());
+		m_acceptor.bind(tcp::endpoint(make_address_v4("127.0.0.1"), 0));
+		m_acceptor.listen();
+		m_acceptor.async_accept(m_sock, [this](error_code const& ec)
+		{
+			if (!ec) read();
+		});
+	}
+
+	int port() const { return m_acceptor.local_endpoint().port(); }
+
+	// closes the connection and stops listening, new connections are refused
+	void close()
+	{
+		error_code ec;
+		m_sock.close(ec);
+		m_acceptor.close(ec);
+	}
+
+	static int const body_size = 100;
+
+private:
+
+	// responds to every request with the first body_size bytes of
+	// data_buffer
+	void read()
+	{
+		m_sock.async_read_some(boost::asio::buffer(m_buf)
+			, [this](error_code const& ec, std::size_t const bytes)
+		{
+			if (ec) return;
+			m_request.append(m_buf.data(), bytes);
+			auto const end = m_request.find("\r\n\r\n");
+			if (end != std::string::npos)
+			{
+				m_request.erase(0, end + 4);
+				m_response = "HTTP/1.1 200 OK\r\nContent-Length: "
+					+ std::to_string(body_size) + "\r\n\r\n";
+				m_response.append(data_buffer, body_size);
+				boost::asio::async_write(m_sock, boost::asio::buffer(m_response)
+					, [](error_code const&, std::size_t) {});
+			}
+			read();
+		});
+	}
+
+	tcp::acceptor m_acceptor;
+	tcp::socket m_sock;
+	std::array<char, 1024> m_buf;
+	std::string m_request;
+	std::string m_response;
+};
+
 } // anonymous namespace
 
 #if TORRENT_USE_SSL
@@ -225,3 +364,66 @@ TORRENT_TEST(no_keepalive)
 {
 	run_suite("http", settings_pack::none, 0);
 }
+
+TORRENT_TEST(keep_alive)
+{
+	run_keep_alive_test("http");
+}
+
+// if the server closes an idle keep-alive connection, the next request is
+// sent over it, fails and is retried on a new connection. That one is
+// refused, since the server stopped listening
+TORRENT_TEST(keep_alive_retry)
+{
+	aux::random_bytes(data_buffer);
+	local_server server(ios);
+
+	char url[256];
+	std::snprintf(url, sizeof(url), "http://127.0.0.1:%d/test_file", server.port());
+
+	reset_globals();
+	auto h = std::make_shared<aux::http_connection>(ios
+		, res, &::http_handler_test, true, 1024*1024, &::http_connect_handler_test
+		, aux::http_filter_handler()
+		, aux::hostname_filter_handler()
+#if TORRENT_USE_SSL
+		, nullptr
+#endif
+		);
+	h->keep_alive(true);
+	h->get(url, seconds(5), 0, nullptr, 5, "test/user-agent");
+	// the server keeps the connection open, so the io_context doesn't run
+	// out of work
+	ios.restart();
+	time_point const deadline = clock_type::now() + seconds(5);
+	while (handler_called == 0 && clock_type::now() < deadline)
+		ios.run_one_for(milliseconds(50));
+
+	TEST_EQUAL(connect_handler_called, 1);
+	TEST_EQUAL(handler_called, 1);
+	TEST_EQUAL(http_status, 200);
+	TEST_EQUAL(data_size, local_server::body_size);
+	TEST_CHECK(h->idle());
+
+	server.close();
+
+	h->get(url, seconds(5), 0, nullptr, 5, "test/user-agent");
+	ios.restart();
+	ios.run();
+
+	TEST_EQUAL(connect_handler_called, 1);
+	TEST_EQUAL(handler_called, 2);
+	TEST_EQUAL(g_error_code, error_code(boost::asio::error::connection_refused));
+	TEST_CHECK(!h->idle());
+
+	h->close(true);
+	ios.restart();
+	ios.run();
+}
+
+#if TORRENT_USE_SSL
+TORRENT_TEST(keep_alive_ssl)
+{
+	run_keep_alive_test("https");
+}
+#endif
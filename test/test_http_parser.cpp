@@ -756,6 +756,170 @@ TORRENT_TEST(invalid_chunk_3)
 	feed_bytes(parser, {reinterpret_cast<char const*>(invalid_chunked_input), sizeof(invalid_chunked_input)});
 }
 
+namespace {
+
+// parses the header of ``response`` and then feeds the rest of it to
+// parse_body() ``step`` bytes at a time, the way web_peer_connection does. Returns the payload and the number
+// of bytes following the body
+std::tuple<std::string, int> parse_body_steps(http_parser& parser
+	, string_view const response, int const step, bool& error)
+{
+	bool header_error = false;
+	parser.incoming(response, header_error);
+	TEST_CHECK(!header_error);
+	TEST_CHECK(parser.header_finished());
+
+	std::string body;
+	span<char const> rest = span<char const>(response).subspan(parser.body_start());
+	while (!rest.empty() && !parser.body_finished() && !error)
+	{
+		span<char const> buf = rest.first(std::min(std::ptrdiff_t(step), rest.size()));
+		std::ptrdiff_t const size = buf.size();
+		while (!buf.empty() && !parser.body_finished() && !error)
+		{
+			span<char const> const payload = parser.parse_body(buf, error);
+			body.append(payload.data(), std::size_t(payload.size()));
+		}
+		rest = rest.subspan(size - buf.size());
+	}
+	return std::make_tuple(body, int(rest.size()));
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(parse_body_chunked)
+{
+	string_view const response =
+		"HTTP/1.1 200 OK\r\n"
+		"Transfer-Encoding: chunked\r\n"
+		"\r\n"
+		"4\r\ntest\r\n"
+		"10;ext=1\r\n0123456789abcdef\r\n"
+		"0\r\n"
+		"Trailer: foo\r\n"
+		"\r\n"
+		"HTTP/1.1 200 OK\r\n";
+
+	// chunk headers split at every possible point are handled the same
+	for (int step = 1; step < int(response.size()); ++step)
+	{
+		http_parser parser(http_parser::dont_parse_chunks);
+		bool error = false;
+		auto const [body, left] = parse_body_steps(parser, response, step, error);
+		TEST_CHECK(!error);
+		TEST_CHECK(parser.body_finished());
+		TEST_EQUAL(body, "test0123456789abcdef");
+		// the next response is left alone
+		TEST_EQUAL(left, 17);
+	}
+}
+
+TORRENT_TEST(parse_body_chunked_lf)
+{
+	// some servers terminate lines with just a LF
+	string_view const response =
+		"HTTP/1.1 200 OK\n"
+		"Transfer-Encoding: chunked\n"
+		"\n"
+		"3\nabc\n"
+		"0\n"
+		"\n";
+
+	http_parser parser(http_parser::dont_parse_chunks);
+	bool error = false;
+	auto const [body, left] = parse_body_steps(parser, response, 1000, error);
+	TEST_CHECK(!error);
+	TEST_CHECK(parser.body_finished());
+	TEST_EQUAL(body, "abc");
+	TEST_EQUAL(left, 0);
+}
+
+TORRENT_TEST(parse_body_content_length)
+{
+	string_view const response =
+		"HTTP/1.1 206 Partial Content\r\n"
+		"Content-Range: bytes 10-19/100\r\n"
+		"\r\n"
+		"0123456789"
+		"HTTP/1.1";
+
+	for (int step = 1; step < 12; ++step)
+	{
+		http_parser parser(http_parser::dont_parse_chunks);
+		bool error = false;
+		auto const [body, left] = parse_body_steps(parser, response, step, error);
+		TEST_CHECK(!error);
+		TEST_CHECK(parser.body_finished());
+		TEST_EQUAL(body, "0123456789");
+		TEST_EQUAL(left, 8);
+	}
+}
+
+TORRENT_TEST(parse_body_invalid_chunk)
+{
+	for (string_view const chunks : {"x\r\n"_sv, "\r\n"_sv, "3\r\nabcX"_sv
+		, "ffffffffffffffffff\r\n"_sv, "1\r2\r\n"_sv, "\r1\r\n"_sv})
+	{
+		std::string const response = "HTTP/1.1 200 OK\r\n"
+			"Transfer-Encoding: chunked\r\n"
+			"\r\n" + std::string(chunks);
+
+		http_parser parser(http_parser::dont_parse_chunks);
+		bool error = false;
+		parse_body_steps(parser, response, 1000, error);
+		TEST_CHECK(error);
+		TEST_CHECK(!parser.body_finished());
+	}
+}
+
+TORRENT_TEST(parse_body_until_close)
+{
+	// without a content-length or chunked encoding, the body lasts until
+	// the connection is closed
+	string_view const response =
+		"HTTP/1.1 200 OK\r\n"
+		"\r\n"
+		"0123456789";
+
+	http_parser parser(http_parser::dont_parse_chunks);
+	bool error = false;
+	auto const [body, left] = parse_body_steps(parser, response, 3, error);
+	TEST_CHECK(!error);
+	TEST_EQUAL(body, "0123456789");
+	TEST_EQUAL(left, 0);
+	TEST_CHECK(!parser.body_finished());
+
+	TEST_CHECK(parser.finish_body());
+	TEST_CHECK(parser.body_finished());
+}
+
+TORRENT_TEST(parse_body_finish_early)
+{
+	// closing the connection doesn't complete a body of known size
+	http_parser parser(http_parser::dont_parse_chunks);
+	bool error = false;
+	parse_body_steps(parser, "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nab"_sv, 1000, error);
+	TEST_CHECK(!error);
+	TEST_CHECK(!parser.finish_body());
+	TEST_CHECK(!parser.body_finished());
+}
+
+TORRENT_TEST(parse_body_reset)
+{
+	http_parser parser(http_parser::dont_parse_chunks);
+	bool error = false;
+	parse_body_steps(parser, "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nab"_sv, 1000, error);
+	TEST_CHECK(parser.body_finished());
+
+	parser.reset();
+	auto const [body, left] = parse_body_steps(parser, "HTTP/1.1 200 OK\r\n"
+		"Transfer-Encoding: chunked\r\n\r\n1\r\nx\r\n0\r\n\r\n"_sv, 1000, error);
+	TEST_CHECK(!error);
+	TEST_CHECK(parser.body_finished());
+	TEST_EQUAL(body, "x");
+	TEST_EQUAL(left, 0);
+}
+
 TORRENT_TEST(idna)
 {
 	TEST_CHECK(!is_idna("a.b.com"));
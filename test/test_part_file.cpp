@@ -10,6 +10,8 @@ see LICENSE file.
 
 #include <cstring>
 #include <array>
+#include <vector>
+#include <algorithm>
 
 #include "test.hpp"
 #include "test_utils.hpp"
@@ -17,6 +19,7 @@ see LICENSE file.
 #include "libtorrent/aux_/posix_part_file.hpp"
 #include "libtorrent/aux_/path.hpp"
 #include "libtorrent/error_code.hpp"
+#include "libtorrent/time.hpp"
 
 using namespace lt;
 
@@ -233,3 +236,149 @@ TORRENT_TEST(posix_part_file)
 		if (ec) std::printf("exists: %s\n", ec.message().c_str());
 	}
 }
+
+namespace {
+
+	void fill_piece(std::array<char, 1024>& buf, int const piece)
+	{
+		for (int i = 0; i < 1024; ++i)
+			buf[std::size_t(i)] = char((i + piece) & 0xff);
+	}
+
+	bool check_piece(aux::part_file& pf, int const piece)
+	{
+		std::array<char, 1024> expected;
+		std::array<char, 1024> buf;
+		fill_piece(expected, piece);
+		error_code ec;
+		iovec_t v = buf;
+		int const ret = pf.readv(v, piece_index_t(piece), 0, ec);
+		return !ec && ret == 1024 && buf == expected;
+	}
+}
+
+TORRENT_TEST(part_file_incremental_header)
+{
+	error_code ec;
+	std::string const dir = combine_path(complete("."), "partfile_test_dir3");
+	remove_all(dir, ec);
+
+	// the header spans many 1 kiB blocks. Only the blocks that changed are
+	// written when flushing, make sure the file on disk still ends up with
+	// the complete mapping
+	int const num_pieces = 2000;
+	int const piece_size = 1024;
+	std::array<char, 1024> buf;
+	std::vector<int> pieces = {0, 1, 250, 253, 254, 255, 256, 1000, 1999};
+
+	{
+		aux::part_file pf(dir, "partfile.parts", num_pieces, piece_size);
+		for (int const p : pieces)
+		{
+			fill_piece(buf, p);
+			iovec_t v = buf;
+			pf.writev(v, piece_index_t(p), 0, ec);
+			TEST_CHECK(!ec);
+		}
+		pf.flush_metadata(ec);
+		TEST_CHECK(!ec);
+
+		// these pieces are in the first, a middle and the last block of the
+		// header
+		pf.free_piece(piece_index_t(1));
+		pf.free_piece(piece_index_t(1000));
+		pf.free_piece(piece_index_t(1999));
+		for (int const p : {1998, 2, 1001})
+		{
+			fill_piece(buf, p);
+			iovec_t v = buf;
+			pf.writev(v, piece_index_t(p), 0, ec);
+			TEST_CHECK(!ec);
+		}
+		pf.flush_metadata(ec);
+		TEST_CHECK(!ec);
+	}
+
+	pieces = {0, 2, 250, 253, 254, 255, 256, 1001, 1998};
+	{
+		aux::part_file pf(dir, "partfile.parts", num_pieces, piece_size);
+		for (int p = 0; p < num_pieces; ++p)
+		{
+			bool const stored = std::find(pieces.begin(), pieces.end(), p) != pieces.end();
+			iovec_t v = buf;
+			pf.readv(v, piece_index_t(p), 0, ec);
+			TEST_EQUAL(bool(ec), !stored);
+			ec.clear();
+			if (stored) TEST_CHECK(check_piece(pf, p));
+		}
+	}
+	remove_all(dir, ec);
+}
+
+TORRENT_TEST(part_file_benchmark)
+{
+	error_code ec;
+	std::string const dir = combine_path(complete("."), "partfile_test_dir4");
+	remove_all(dir, ec);
+
+	// a large torrent where most files are deselected. The header is about
+	// 400 kiB
+	int const num_pieces = 100000;
+	int const piece_size = 1024;
+	int const num_stored = 4000;
+	int const num_flushes = 200;
+	std::array<char, 1024> buf;
+
+	std::vector<int> pieces;
+	for (int i = 0; i < num_stored; ++i)
+		pieces.push_back(int((std::int64_t(i) * 7919) % num_pieces));
+
+	{
+		aux::part_file pf(dir, "partfile.parts", num_pieces, piece_size);
+
+		time_point start = clock_type::now();
+		for (int const p : pieces)
+		{
+			fill_piece(buf, p);
+			iovec_t v = buf;
+			pf.writev(v, piece_index_t(p), 0, ec);
+			TEST_CHECK(!ec);
+		}
+		pf.flush_metadata(ec);
+		TEST_CHECK(!ec);
+		std::printf("write %d pieces + flush: %d us\n", num_stored
+			, int(total_microseconds(clock_type::now() - start)));
+
+		// pieces finish one at a time, every time the part file is flushed
+		start = clock_type::now();
+		for (int i = 0; i < num_flushes; ++i)
+		{
+			pf.free_piece(piece_index_t(pieces[std::size_t(i)]));
+			pf.flush_metadata(ec);
+			TEST_CHECK(!ec);
+		}
+		std::printf("%d incremental flushes: %d us\n", num_flushes
+			, int(total_microseconds(clock_type::now() - start)));
+
+		start = clock_type::now();
+		int failed = 0;
+		for (int i = num_flushes; i < num_stored; ++i)
+			if (!check_piece(pf, pieces[std::size_t(i)])) ++failed;
+		TEST_EQUAL(failed, 0);
+		std::printf("read %d pieces: %d us\n", num_stored - num_flushes
+			, int(total_microseconds(clock_type::now() - start)));
+	}
+
+	{
+		aux::part_file pf(dir, "partfile.parts", num_pieces, piece_size);
+		int failed = 0;
+		for (int i = num_flushes; i < num_stored; ++i)
+			if (!check_piece(pf, pieces[std::size_t(i)])) ++failed;
+		TEST_EQUAL(failed, 0);
+
+		iovec_t v = buf;
+		pf.readv(v, piece_index_t(pieces[0]), 0, ec);
+		TEST_CHECK(ec);
+	}
+	remove_all(dir, ec);
+}
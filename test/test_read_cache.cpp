@@ -0,0 +1,288 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/read_cache.hpp"
+#include "libtorrent/aux_/path.hpp"
+#include "libtorrent/aux_/vector.hpp"
+#include "libtorrent/download_priority.hpp"
+#include "libtorrent/file_storage.hpp"
+#include "libtorrent/mmap_disk_io.hpp"
+#include "libtorrent/peer_request.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/settings_pack.hpp"
+
+#include <vector>
+
+using lt::aux::read_cache;
+using lt::default_block_size;
+
+namespace {
+
+lt::storage_index_t const st0{0};
+lt::storage_index_t const st1{1};
+
+struct block_allocator final : lt::buffer_allocator_interface
+{
+	void free_disk_buffer(char* b) override { delete[] b; }
+};
+
+block_allocator allocator;
+
+read_cache::buffer_t make_block()
+{
+	return read_cache::buffer_t(new char[default_block_size], {&allocator});
+}
+
+// fills the blocks [first, first + num) of a piece with 4 blocks, with a byte
+// value derived from the piece and block index
+int fill(read_cache& c, lt::storage_index_t const st, int const piece
+	, int const first = 0, int const num = 4)
+{
+	lt::piece_index_t const p{piece};
+	std::uint32_t const token = c.begin_fill(st, p);
+	std::vector<read_cache::buffer_t> blocks;
+	for (int i = 0; i < num; ++i)
+	{
+		blocks.push_back(make_block());
+		std::memset(blocks.back().get(), piece * 4 + first + i, default_block_size);
+	}
+	return c.insert(st, p, first, 4, blocks, token);
+}
+
+bool cached(read_cache& c, lt::storage_index_t const st, int const piece
+	, int const start = 0, int const length = default_block_size)
+{
+	return c.get(st, lt::piece_index_t{piece}, start, length, [] { return nullptr; });
+}
+
+} // anonymous namespace
+
+TORRENT_TEST(read_cache_disabled)
+{
+	read_cache c;
+	TEST_EQUAL(fill(c, st0, 0), 0);
+	TEST_EQUAL(c.size(), 0);
+	TEST_CHECK(!cached(c, st0, 0));
+}
+
+TORRENT_TEST(read_cache_get)
+{
+	read_cache c(16);
+	fill(c, st0, 1, 1, 2);
+	TEST_EQUAL(c.size(), 2);
+	TEST_CHECK(c.has_block(st0, lt::piece_index_t{1}, default_block_size));
+	TEST_CHECK(!c.has_block(st0, lt::piece_index_t{1}, 0));
+	TEST_CHECK(!c.has_block(st1, lt::piece_index_t{1}, default_block_size));
+
+	// a read spanning blocks 1 and 2
+	std::vector<char> buf(default_block_size);
+	TEST_CHECK(c.get(st0, lt::piece_index_t{1}, default_block_size + 100
+		, default_block_size, [&] { return buf.data(); }));
+	TEST_EQUAL(buf[0], 5);
+	TEST_EQUAL(buf[default_block_size - 101], 5);
+	TEST_EQUAL(buf[default_block_size - 100], 6);
+	TEST_EQUAL(buf[default_block_size - 1], 6);
+
+	// spanning blocks 0 and 1, where block 0 is missing
+	TEST_CHECK(!cached(c, st0, 1, 100));
+	// spanning blocks 2 and 3, where block 3 is missing
+	TEST_CHECK(!cached(c, st0, 1, 2 * default_block_size + 100));
+
+	// filling in the rest of the piece
+	fill(c, st0, 1, 0, 4);
+	TEST_EQUAL(c.size(), 4);
+	TEST_CHECK(cached(c, st0, 1, 100));
+}
+
+TORRENT_TEST(read_cache_evict_fifo)
+{
+	read_cache c(8);
+	fill(c, st0, 0);
+	fill(c, st0, 1);
+	TEST_EQUAL(c.size(), 8);
+	TEST_EQUAL(fill(c, st0, 2), 4);
+	TEST_EQUAL(c.size(), 8);
+
+	// piece 0 was the oldest one
+	TEST_CHECK(!cached(c, st0, 0));
+	TEST_CHECK(cached(c, st0, 1));
+	TEST_CHECK(cached(c, st0, 2));
+}
+
+// pieces read more than once survive a scan of pieces only read once
+TORRENT_TEST(read_cache_scan_resistance)
+{
+	read_cache c(16);
+	fill(c, st0, 0);
+	// piece 0 falls off the end of A1in
+	for (int i = 1; i < 6; ++i) fill(c, st0, i);
+	TEST_CHECK(!cached(c, st0, 0));
+
+	// reading it again puts it in the main LRU
+	fill(c, st0, 0);
+	TEST_CHECK(cached(c, st0, 0));
+
+	// a long sequential read does not push it out
+	for (int i = 100; i < 200; ++i) fill(c, st0, i);
+	TEST_CHECK(cached(c, st0, 0));
+	TEST_CHECK(!cached(c, st0, 100));
+	TEST_CHECK(cached(c, st0, 199));
+	TEST_CHECK(c.size() <= 16);
+}
+
+TORRENT_TEST(read_cache_stale_fill)
+{
+	read_cache c(16);
+	lt::piece_index_t const p{3};
+	std::uint32_t const token = c.begin_fill(st0, p);
+
+	// the piece is written to while we're reading it from disk
+	c.evict_piece(st0, p);
+
+	std::vector<read_cache::buffer_t> blocks;
+	blocks.push_back(make_block());
+	c.insert(st0, p, 0, 4, blocks, token);
+	TEST_EQUAL(c.size(), 0);
+	TEST_CHECK(!cached(c, st0, 3));
+
+	// a fill starting after the write is fine
+	fill(c, st0, 3);
+	TEST_CHECK(cached(c, st0, 3));
+}
+
+TORRENT_TEST(read_cache_evict_storage)
+{
+	read_cache c(32);
+	fill(c, st0, 0);
+	fill(c, st1, 0);
+	fill(c, st0, 1);
+	TEST_EQUAL(c.size(), 12);
+
+	TEST_EQUAL(c.evict_storage(st0), 8);
+	TEST_EQUAL(c.size(), 4);
+	TEST_CHECK(!cached(c, st0, 0));
+	TEST_CHECK(!cached(c, st0, 1));
+	TEST_CHECK(cached(c, st1, 0));
+
+	TEST_EQUAL(c.evict_piece(st1, lt::piece_index_t{0}), 4);
+	TEST_EQUAL(c.size(), 0);
+}
+
+TORRENT_TEST(read_cache_resize)
+{
+	read_cache c(32);
+	for (int i = 0; i < 8; ++i) fill(c, st0, i);
+	TEST_EQUAL(c.size(), 32);
+	TEST_EQUAL(c.set_max_size(12), 20);
+	TEST_EQUAL(c.size(), 12);
+	TEST_EQUAL(c.set_max_size(0), 12);
+	TEST_EQUAL(c.size(), 0);
+	TEST_EQUAL(fill(c, st0, 0), 0);
+	TEST_EQUAL(c.size(), 0);
+}
+
+#if TORRENT_HAVE_MMAP
+namespace {
+
+void sync(lt::io_context& ioc, int& outstanding)
+{
+	while (outstanding > 0)
+	{
+		ioc.run_one();
+		ioc.restart();
+	}
+}
+
+} // anonymous namespace
+
+// blocks served from the read cache must reflect later writes to the piece
+TORRENT_TEST(read_cache_mmap_disk_io)
+{
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::aio_threads, 1);
+	pack.set_int(lt::settings_pack::file_pool_size, 2);
+	pack.set_int(lt::settings_pack::read_cache_size, 64);
+	pack.set_int(lt::settings_pack::read_cache_line_size, 4);
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::mmap_disk_io_constructor(ioc, pack, cnt);
+
+	lt::file_storage fs;
+	fs.add_file("test", default_block_size * 8);
+	fs.set_piece_length(default_block_size * 4);
+	fs.set_num_pieces(2);
+
+	std::string const save_path = lt::complete("read_cache_mmap");
+	lt::error_code ec;
+	lt::remove_all(save_path, ec);
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr, save_path, lt::storage_mode_sparse
+		, prios, lt::sha1_hash("01234567890123456789"));
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	int outstanding = 0;
+	auto write = [&](int const block, char const fill_byte)
+	{
+		std::vector<char> const buf(std::size_t(default_block_size), fill_byte);
+		lt::peer_request const r{lt::piece_index_t(block / 4)
+			, (block % 4) * default_block_size, default_block_size};
+		++outstanding;
+		disk_io->async_write(t, r, buf.data(), {}, [&](lt::storage_error const& se)
+		{
+			--outstanding;
+			TEST_CHECK(!se);
+		});
+		disk_io->submit_jobs();
+		sync(ioc, outstanding);
+	};
+
+	auto read = [&](int const block)
+	{
+		char ret = 0;
+		lt::peer_request const r{lt::piece_index_t(block / 4)
+			, (block % 4) * default_block_size, default_block_size};
+		++outstanding;
+		disk_io->async_read(t, r, [&](lt::disk_buffer_holder h, lt::storage_error const& se)
+		{
+			--outstanding;
+			TEST_CHECK(!se);
+			if (h) ret = h.data()[0];
+		});
+		disk_io->submit_jobs();
+		sync(ioc, outstanding);
+		return ret;
+	};
+
+	for (int i = 0; i < 8; ++i) write(i, char('a' + i));
+
+	// the first read pulls the rest of the piece into the cache
+	TEST_EQUAL(read(0), 'a');
+	TEST_EQUAL(cnt[lt::counters::read_cache_misses], 1);
+	TEST_EQUAL(read(1), 'b');
+	TEST_EQUAL(read(3), 'd');
+	TEST_EQUAL(cnt[lt::counters::read_cache_hits], 2);
+
+	// overwriting a block evicts the piece
+	write(1, 'x');
+	TEST_EQUAL(read(1), 'x');
+	TEST_EQUAL(read(2), 'c');
+
+	disk_io->update_stats_counters(cnt);
+	TEST_CHECK(cnt[lt::counters::read_cache_blocks] > 0);
+
+	// the cached blocks are allocated from the disk buffer pool
+	TEST_CHECK(cnt[lt::counters::disk_blocks_in_use] >= cnt[lt::counters::read_cache_blocks]);
+
+	t.reset();
+	disk_io->abort(true);
+}
+#endif
@@ -28,6 +28,8 @@ see LICENSE file.
 #include <numeric>
 #include <algorithm>
 #include <random>
+#include <functional>
+#include <vector>
 
 #include <cstdio>
 #include <cstdarg>
@@ -124,6 +126,63 @@ void test_offers()
 	sig->close();
 }
 
+void test_offer_pool()
+{
+	time_point const start_time = clock_type::now();
+
+	session_mock ses(io_context);
+	aux::torrent tor(ses, false, parse_magnet_uri("magnet:?xt=urn:btih:cdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcd"));
+
+	int const pool_size = 4;
+	ses.mutable_settings().set_int(settings_pack::webtorrent_offer_pool_size, pool_size);
+
+	auto& pool = ses.rtc_offers();
+	pool.refill();
+	TEST_EQUAL(pool.size(), pool_size);
+
+	std::cout << "Waiting for " << pool_size << " pre-generated offers" << std::endl;
+	auto const end_time = clock_type::now() + 30s;
+	while (pool.num_ready() < pool_size && clock_type::now() < end_time)
+	{
+		io_context.restart();
+		io_context.run_one_until(end_time);
+	}
+	TEST_EQUAL(pool.num_ready(), pool_size);
+
+	auto offers_handler = [&](error_code const& ec, std::vector<rtc_offer> offers) {
+		TEST_CHECK(!ec);
+
+		std::cout << "Generated " << int(offers.size()) << " offers" << std::endl;
+		TEST_EQUAL(int(offers.size()), pool_size);
+
+		std::cout << "Test succeeded" << std::endl;
+		success = true;
+	};
+
+	auto handler = [&](rtc_stream_init) {};
+
+	auto sig = std::make_shared<rtc_signaling>(io_context, &tor, handler);
+	sig->generate_offers(pool_size, offers_handler);
+
+	run_test();
+
+	// every offer was taken from the pool, which is being refilled
+	TEST_EQUAL(ses.stats_counters()[counters::rtc_offer_pool_hits], pool_size);
+	TEST_EQUAL(ses.stats_counters()[counters::rtc_offer_pool_misses], 0);
+	TEST_EQUAL(pool.size(), pool_size);
+
+	// lowering the setting discards the excess offers
+	ses.mutable_settings().set_int(settings_pack::webtorrent_offer_pool_size, 1);
+	pool.trim();
+	TEST_EQUAL(pool.size(), 1);
+	TEST_EQUAL(ses.stats_counters()[counters::num_rtc_pooled_offers], 1);
+
+	ses.print_alerts(start_time);
+
+	sig->close();
+	pool.close();
+}
+
 void test_connectivity()
 {
 	time_point const start_time = clock_type::now();
@@ -318,6 +377,164 @@ void test_stream()
 	TEST_CHECK(stream1 != nullptr);
 	TEST_CHECK(stream2 != nullptr);
 
+	for (auto* ses : {&ses1, &ses2})
+	{
+		auto const& cnt = ses->stats_counters();
+		TEST_EQUAL(cnt[counters::rtc_data_channels_opened], 1);
+		std::int64_t histogram = 0;
+		for (int i = counters::rtc_connect_time5; i <= counters::rtc_connect_time15; ++i)
+			histogram += cnt[i];
+		TEST_EQUAL(histogram, 1);
+	}
+	TEST_EQUAL(ses1.stats_counters()[counters::rtc_answers_received], 1);
+	TEST_EQUAL(ses1.stats_counters()[counters::rtc_messages_in], 1);
+	TEST_EQUAL(ses1.stats_counters()[counters::rtc_bytes_in], std::int64_t(message.size()));
+	TEST_EQUAL(ses2.stats_counters()[counters::rtc_messages_out], 1);
+	TEST_EQUAL(ses2.stats_counters()[counters::rtc_bytes_out], std::int64_t(message.size()));
+
+	ses1.print_alerts(start_time);
+	ses2.print_alerts(start_time);
+
+	if (stream1)
+		stream1->close();
+	if (stream2)
+		stream2->close();
+
+	sig1->close();
+	sig2->close();
+}
+
+
+void test_stream_flow_control()
+{
+	time_point const start_time = clock_type::now();
+
+	session_mock ses1(io_context);
+	aux::torrent tor1(ses1, false, parse_magnet_uri("magnet:?xt=urn:btih:cdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcd"));
+
+	session_mock ses2(io_context);
+	aux::torrent tor2(ses2, false, parse_magnet_uri("magnet:?xt=urn:btih:cdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcd"));
+
+	std::shared_ptr<rtc_signaling> sig1, sig2;
+	std::shared_ptr<rtc_stream> stream1, stream2;
+
+	// the small writes are sent as one message. The large one can't be
+	// buffered by the transport right away, which takes the DataChannel
+	// above the high watermark
+	std::size_t const small_write = 256;
+	int const num_small_writes = 16;
+	std::size_t const coalesced_size = small_write * num_small_writes;
+	std::size_t const high_watermark = 64 * 1024;
+	std::size_t const low_watermark = 16 * 1024;
+
+	std::vector<char> message(coalesced_size + 16 * 1024 * 1024);
+	std::mt19937 rng(0x1337);
+	std::generate(message.begin(), message.end(), [&] { return char(rng()); });
+
+	std::vector<char> received;
+	std::vector<char> read_chunk(64 * 1024);
+
+	std::size_t bytes_written = 0;
+	int num_large_writes = 0;
+	bool first_write_partial = false;
+
+	auto answer_callback = [&](peer_id const&, rtc_answer const& answer) {
+		sig1->process_answer(answer);
+	};
+
+	auto offers_handler = [&](error_code const& ec, std::vector<rtc_offer> offers) {
+		TEST_CHECK(!ec);
+		TEST_EQUAL(int(offers.size()), 1);
+		if (offers.empty()) return;
+
+		rtc_offer offer = offers[0];
+		offer.answer_callback = answer_callback;
+		sig2->process_offer(offer);
+	};
+
+	auto check_done = [&] {
+		if (bytes_written < message.size() || received.size() < message.size()) return;
+		std::cout << "Test succeeded" << std::endl;
+		success = true;
+	};
+
+	std::function<void(error_code const&, std::size_t)> read_handler
+		= [&](error_code const& ec, std::size_t size) {
+		if (success) return;
+		TEST_CHECK(!ec);
+		if (ec) return;
+
+		received.insert(received.end(), read_chunk.begin(), read_chunk.begin() + long(size));
+		check_done();
+		if (received.size() < message.size())
+			stream1->async_read_some(boost::asio::mutable_buffer(read_chunk.data(), read_chunk.size()), read_handler);
+	};
+
+	std::function<void(error_code const&, std::size_t)> large_write_handler
+		= [&](error_code const& ec, std::size_t size) {
+		TEST_CHECK(!ec);
+		if (ec) return;
+
+		std::size_t const requested = message.size() - bytes_written;
+		TEST_CHECK(size > 0);
+		TEST_CHECK(size <= requested);
+		if (num_large_writes == 1) first_write_partial = size < requested;
+		bytes_written += size;
+		check_done();
+		if (bytes_written == message.size()) return;
+
+		// this write is issued right away, while the DataChannel is still
+		// above the high watermark. It stays pending until it has drained to
+		// the low watermark
+		++num_large_writes;
+		stream2->async_write_some(boost::asio::const_buffer(message.data() + bytes_written
+			, message.size() - bytes_written), large_write_handler);
+	};
+
+	auto small_write_handler = [&](error_code const& ec, std::size_t size) {
+		TEST_CHECK(!ec);
+		TEST_EQUAL(size, coalesced_size);
+		TEST_EQUAL(ses2.stats_counters()[counters::rtc_messages_out], 1);
+		TEST_EQUAL(ses2.stats_counters()[counters::rtc_bytes_out], std::int64_t(coalesced_size));
+		bytes_written += size;
+
+		++num_large_writes;
+		stream2->async_write_some(boost::asio::const_buffer(message.data() + bytes_written
+			, message.size() - bytes_written), large_write_handler);
+	};
+
+	auto handler1 = [&](rtc_stream_init init) {
+		stream1 = std::make_shared<rtc_stream>(io_context, init);
+		stream1->async_read_some(boost::asio::mutable_buffer(read_chunk.data(), read_chunk.size()), read_handler);
+	};
+
+	auto handler2 = [&](rtc_stream_init init) {
+		init.send_buffer_low_watermark = low_watermark;
+		init.send_buffer_high_watermark = high_watermark;
+		stream2 = std::make_shared<rtc_stream>(io_context, init);
+
+		std::vector<boost::asio::const_buffer> buffers;
+		for (int i = 0; i < num_small_writes; ++i)
+			buffers.emplace_back(message.data() + std::size_t(i) * small_write, small_write);
+		stream2->async_write_some(buffers, small_write_handler);
+	};
+
+	sig1 = std::make_shared<rtc_signaling>(io_context, &tor1, handler1);
+	sig2 = std::make_shared<rtc_signaling>(io_context, &tor2, handler2);
+
+	sig1->generate_offers(1, offers_handler);
+
+	run_test();
+
+	TEST_EQUAL(bytes_written, message.size());
+	TEST_CHECK(received == message);
+
+	// the first large write returned early, once the DataChannel was above
+	// the high watermark, and the next one waited for it to drain
+	TEST_CHECK(first_write_partial);
+	TEST_CHECK(num_large_writes > 1);
+	TEST_CHECK(ses2.stats_counters()[counters::rtc_send_stalls] > 0);
+
 	ses1.print_alerts(start_time);
 	ses2.print_alerts(start_time);
 
@@ -331,12 +548,110 @@ void test_stream()
 }
 
 
+void test_shared_connection()
+{
+	time_point const start_time = clock_type::now();
+
+	session_mock ses1(io_context);
+	ses1.mutable_settings().set_bool(settings_pack::webtorrent_share_connections, true);
+	aux::torrent tor1a(ses1, false, parse_magnet_uri("magnet:?xt=urn:btih:cdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcd"));
+	aux::torrent tor1b(ses1, false, parse_magnet_uri("magnet:?xt=urn:btih:abababababababababababababababababababab"));
+
+	session_mock ses2(io_context);
+	ses2.mutable_settings().set_bool(settings_pack::webtorrent_share_connections, true);
+	aux::torrent tor2a(ses2, false, parse_magnet_uri("magnet:?xt=urn:btih:cdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcdcd"));
+	aux::torrent tor2b(ses2, false, parse_magnet_uri("magnet:?xt=urn:btih:abababababababababababababababababababab"));
+
+	std::shared_ptr<rtc_signaling> sig1a, sig2a, sig1b, sig2b;
+	rtc_stream_init init1a, init2a, init1b, init2b;
+
+	auto connect = [&](std::shared_ptr<rtc_signaling>& offerer
+		, std::shared_ptr<rtc_signaling>& answerer)
+	{
+		auto answer_callback = [&offerer](peer_id const&, rtc_answer const& answer) {
+			offerer->process_answer(answer);
+		};
+
+		offerer->generate_offers(1, [&answerer, answer_callback](error_code const& ec
+			, std::vector<rtc_offer> offers)
+		{
+			TEST_CHECK(!ec);
+			TEST_EQUAL(int(offers.size()), 1);
+			if (offers.empty()) return;
+
+			rtc_offer offer = offers[0];
+			offer.answer_callback = answer_callback;
+			answerer->process_offer(offer);
+		});
+	};
+
+	int connected = 0;
+	auto on_connected = [&] {
+		if (++connected < 4) return;
+		std::cout << "Test succeeded" << std::endl;
+		success = true;
+	};
+
+	auto handler_b = [&](rtc_stream_init& dst) {
+		return [&](rtc_stream_init init) {
+			TEST_CHECK(init.peer_connection);
+			TEST_CHECK(init.data_channel);
+			dst = std::move(init);
+			on_connected();
+		};
+	};
+
+	sig1b = std::make_shared<rtc_signaling>(io_context, &tor1b, handler_b(init1b));
+	sig2b = std::make_shared<rtc_signaling>(io_context, &tor2b, handler_b(init2b));
+
+	// once the first torrent is connected, the second one should open a
+	// DataChannel on the same connection
+	auto handler_a = [&](rtc_stream_init& dst) {
+		return [&](rtc_stream_init init) {
+			TEST_CHECK(init.peer_connection);
+			TEST_CHECK(init.data_channel);
+			dst = std::move(init);
+			if (++connected < 2) return;
+
+			std::cout << "First torrent is connected, connecting the second one" << std::endl;
+			connect(sig1b, sig2b);
+		};
+	};
+
+	sig1a = std::make_shared<rtc_signaling>(io_context, &tor1a, handler_a(init1a));
+	sig2a = std::make_shared<rtc_signaling>(io_context, &tor2a, handler_a(init2a));
+
+	std::cout << "Connecting the first torrent" << std::endl;
+	connect(sig1a, sig2a);
+
+	run_test();
+
+	TEST_CHECK(init1b.peer_connection == init1a.peer_connection);
+	TEST_CHECK(init2b.peer_connection == init2a.peer_connection);
+	TEST_CHECK(init1b.data_channel != init1a.data_channel);
+	TEST_CHECK(init2b.data_channel != init2a.data_channel);
+	TEST_EQUAL(ses1.stats_counters()[counters::rtc_shared_connections], 1);
+	TEST_EQUAL(ses2.stats_counters()[counters::rtc_shared_connections], 1);
+
+	ses1.print_alerts(start_time);
+	ses2.print_alerts(start_time);
+
+	sig1a->close();
+	sig2a->close();
+	sig1b->close();
+	sig2b->close();
+}
+
+
 } // namespace
 
 TORRENT_TEST(parse_endpoint) { test_parse_endpoint(); }
 TORRENT_TEST(signaling_offers) { test_offers(); }
+TORRENT_TEST(signaling_offer_pool) { test_offer_pool(); }
 TORRENT_TEST(signaling_connectivity) { test_connectivity(); }
 TORRENT_TEST(signaling_stream) { test_stream(); }
+TORRENT_TEST(signaling_stream_flow_control) { test_stream_flow_control(); }
+TORRENT_TEST(signaling_shared_connection) { test_shared_connection(); }
 #else
 TORRENT_TEST(disabled) {}
 #endif // TORRENT_USE_RTC
@@ -40,6 +40,8 @@ see LICENSE file.
 #include <functional> // for bind
 
 #include <iostream>
+#include <thread>
+#include <fstream>
 
 using namespace std::placeholders;
 using namespace lt;
@@ -638,6 +640,100 @@ TORRENT_TEST(remove_mmap_disk_io)
 {
 	test_remove<mmap_storage>(current_working_directory());
 }
+
+TORRENT_TEST(flush_dirty_mmap_disk_io)
+{
+	delete_dirs("temp_storage");
+
+	file_storage fs;
+	std::vector<char> buf;
+	aux::file_view_pool fp;
+	aux::session_settings set;
+	set.set_int(settings_pack::max_dirty_bytes, 0x4000);
+	auto s = setup_torrent<mmap_storage>(fs, fp, buf, current_working_directory(), set);
+	TEST_EQUAL(s->dirty_bytes(), 0);
+
+	buf.assign(0x4000, 'a');
+	iovec_t b = {buf.data(), 0x4000};
+	storage_error se;
+
+	// pieces 0 and 1 make up the first file, written out of order. Piece 3
+	// is the second half of the next one
+	writev(s, set, b, piece_index_t(1), 0, aux::open_mode::write, se);
+	writev(s, set, b, piece_index_t(3), 0, aux::open_mode::write, se);
+	writev(s, set, b, piece_index_t(0), 0, aux::open_mode::write, se);
+	// writing the same block again doesn't count twice
+	writev(s, set, b, piece_index_t(0), 0, aux::open_mode::write, se);
+	TEST_CHECK(!se);
+	TEST_EQUAL(s->dirty_bytes(), 3 * 0x4000);
+
+	auto const r = s->flush_dirty(set, se);
+	TEST_CHECK(!se);
+	TEST_EQUAL(r.ranges, 2);
+	TEST_EQUAL(r.bytes, 3 * 0x4000);
+	TEST_EQUAL(s->dirty_bytes(), 0);
+
+	// the second flush waits for the first one
+	writev(s, set, b, piece_index_t(4), 0, aux::open_mode::write, se);
+	auto const r2 = s->flush_dirty(set, se);
+	TEST_CHECK(!se);
+	TEST_EQUAL(r2.ranges, 1);
+	TEST_EQUAL(r2.bytes, 0x4000);
+
+	// nothing is tracked when the limit is disabled
+	set.set_int(settings_pack::max_dirty_bytes, 0);
+	writev(s, set, b, piece_index_t(5), 0, aux::open_mode::write, se);
+	TEST_EQUAL(s->dirty_bytes(), 0);
+
+	s->release_files(se);
+	delete_dirs("temp_storage");
+}
+
+TORRENT_TEST(flush_dirty_deleted_mmap_disk_io)
+{
+	delete_dirs("temp_storage");
+
+	file_storage fs;
+	std::vector<char> buf;
+	aux::file_view_pool fp;
+	aux::session_settings set;
+	set.set_int(settings_pack::max_dirty_bytes, 0x4000);
+	auto s = setup_torrent<mmap_storage>(fs, fp, buf, current_working_directory(), set);
+
+	buf.assign(0x4000, 'a');
+	iovec_t b = {buf.data(), 0x4000};
+	storage_error se;
+
+	// a flush doesn't create files that have been removed behind our back
+	writev(s, set, b, piece_index_t(0), 0, aux::open_mode::write, se);
+	TEST_CHECK(!se);
+	fp.release(s->storage_index());
+	std::string const first_file = s->files().file_path(file_index_t{0}
+		, current_working_directory());
+	TEST_CHECK(exists(first_file));
+	error_code ec;
+	remove(first_file, ec);
+	TEST_CHECK(!ec);
+	auto const r = s->flush_dirty(set, se);
+	TEST_CHECK(!se);
+	TEST_EQUAL(r.ranges, 1);
+	TEST_CHECK(!exists(first_file));
+
+	writev(s, set, b, piece_index_t(3), 0, aux::open_mode::write, se);
+	TEST_CHECK(!se);
+	TEST_EQUAL(s->dirty_bytes(), 0x4000);
+
+	// deleting the files forgets the dirty ranges and the pending writeback
+	s->delete_files(session::delete_files, se);
+	TEST_CHECK(!se);
+	TEST_EQUAL(s->dirty_bytes(), 0);
+
+	auto const r2 = s->flush_dirty(set, se);
+	TEST_CHECK(!se);
+	TEST_EQUAL(r2.ranges, 0);
+
+	delete_dirs("temp_storage");
+}
 #endif
 
 TORRENT_TEST(rename_posix_disk_io)
@@ -1396,7 +1492,7 @@ void test_move_storage_to_self()
 	TEST_CHECK(exists(combine_path(test_path, combine_path("_folder3", "test4.tmp"))));
 	TEST_EQUAL(se.ec, boost::system::errc::success);
 
-	s->move_storage(save_path, move_flags_t::always_replace_files, se);
+	s->move_storage(save_path, move_flags_t::always_replace_files, 1, {}, se);
 	TEST_EQUAL(se.ec, boost::system::errc::success);
 	std::cerr << "file: " << se.file() << '\n';
 	std::cerr << "op: " << int(se.operation) << '\n';
@@ -1426,7 +1522,7 @@ void test_move_storage_into_self()
 	writev(s, set, b, piece_index_t(2), 0, aux::open_mode::write, se);
 
 	std::string const test_path = combine_path(save_path, combine_path("temp_storage", "folder1"));
-	s->move_storage(test_path, move_flags_t::always_replace_files, se);
+	s->move_storage(test_path, move_flags_t::always_replace_files, 1, {}, se);
 	TEST_EQUAL(se.ec, boost::system::errc::success);
 
 	TEST_CHECK(exists(combine_path(test_path, combine_path("temp_storage"
@@ -1502,7 +1598,7 @@ TORRENT_TEST(dont_move_intermingled_files)
 	ofstream(combine_path(save_path, combine_path("temp_storage", "alien1.tmp")).c_str());
 	ofstream(combine_path(save_path, combine_path("temp_storage", combine_path("folder1", "alien2.tmp"))).c_str());
 
-	s->move_storage(test_path, move_flags_t::always_replace_files, se);
+	s->move_storage(test_path, move_flags_t::always_replace_files, 1, {}, se);
 	TEST_EQUAL(se.ec, boost::system::errc::success);
 
 	// torrent files moved to new place
@@ -1532,6 +1628,147 @@ TORRENT_TEST(dont_move_intermingled_files)
 
 namespace {
 
+std::vector<char> read_whole_file(std::string const& p)
+{
+	std::ifstream in(p, std::ios::binary);
+	return std::vector<char>{std::istreambuf_iterator<char>(in)
+		, std::istreambuf_iterator<char>()};
+}
+
+void write_whole_file(std::string const& p, span<char const> buf)
+{
+	error_code ec;
+	create_directories(parent_path(p), ec);
+	TEST_CHECK(!ec);
+	std::ofstream(p, std::ios::binary).write(buf.data(), buf.size());
+}
+
+// a torrent with three files, the first is large enough for a partial
+// copy of it to be resumed
+file_storage copy_files_torrent(std::vector<file_index_t>& files)
+{
+	file_storage fs;
+	fs.add_file(combine_path("copy", "a"), 3 * 1024 * 1024 + 100);
+	fs.add_file(combine_path("copy", combine_path("sub", "b")), 0x4000);
+	fs.add_file(combine_path("copy", "c"), 0);
+	for (auto const i : fs.file_range()) files.push_back(i);
+	return fs;
+}
+
+void setup_copy_source(file_storage const& fs, std::string const& save_path)
+{
+	for (auto const i : fs.file_range())
+	{
+		std::vector<char> buf(std::size_t(fs.file_size(i)));
+		aux::random_bytes(buf);
+		write_whole_file(fs.file_path(i, save_path), buf);
+	}
+}
+
+void check_copy(file_storage const& fs, std::string const& save_path
+	, std::string const& new_save_path)
+{
+	for (auto const i : fs.file_range())
+	{
+		TEST_CHECK(read_whole_file(fs.file_path(i, save_path))
+			== read_whole_file(fs.file_path(i, new_save_path)));
+		TEST_CHECK(!exists(fs.file_path(i, new_save_path) + ".moving"));
+	}
+}
+}
+
+TORRENT_TEST(copy_files)
+{
+	std::string const save_path = complete("copy_src");
+	std::string const new_save_path = complete("copy_dst");
+	delete_dirs(save_path);
+	delete_dirs(new_save_path);
+
+	std::vector<file_index_t> files;
+	file_storage const fs = copy_files_torrent(files);
+	setup_copy_source(fs, save_path);
+
+	std::int64_t last_copied = 0;
+	std::int64_t last_total = 0;
+	aux::vector<bool, file_index_t> copied(std::size_t(fs.num_files()), false);
+	storage_error se;
+	aux::copy_files(fs, save_path, new_save_path, files, 2
+		, [&](std::int64_t const c, std::int64_t const t) { last_copied = c; last_total = t; }
+		, copied, se);
+	TEST_CHECK(!se);
+	TEST_EQUAL(last_total, fs.total_size());
+	TEST_EQUAL(last_copied, fs.total_size());
+	for (auto const i : fs.file_range()) TEST_CHECK(copied[i]);
+	check_copy(fs, save_path, new_save_path);
+
+	// a missing source fails the copy
+	error_code ec;
+	remove(fs.file_path(file_index_t{1}, save_path), ec);
+	copied.assign(std::size_t(fs.num_files()), false);
+	aux::copy_files(fs, save_path, new_save_path, {file_index_t{1}}, 1, {}, copied, se);
+	TEST_CHECK(se);
+	TEST_EQUAL(se.file(), file_index_t{1});
+	TEST_CHECK(se.operation == operation_t::file_copy);
+	TEST_CHECK(!copied[file_index_t{1}]);
+
+	delete_dirs(save_path);
+	delete_dirs(new_save_path);
+}
+
+TORRENT_TEST(copy_files_resume)
+{
+	std::string const save_path = complete("copy_src");
+	std::string const new_save_path = complete("copy_dst");
+	delete_dirs(save_path);
+	delete_dirs(new_save_path);
+
+	std::vector<file_index_t> files;
+	file_storage const fs = copy_files_torrent(files);
+	setup_copy_source(fs, save_path);
+	std::string const part = fs.file_path(file_index_t{0}, new_save_path) + ".moving";
+	std::vector<char> const source = read_whole_file(fs.file_path(file_index_t{0}, save_path));
+
+	// partial copies are only resumed if they're newer than the source
+	std::this_thread::sleep_for(lt::milliseconds(1100));
+
+	// a partial copy with the right content is resumed. The bytes past the
+	// last whole MiB are copied again
+	std::vector<char> partial(source.begin(), source.begin() + 2 * 1024 * 1024 + 1000);
+	std::fill(partial.end() - 1000, partial.end(), 'x');
+	write_whole_file(part, partial);
+
+	aux::vector<bool, file_index_t> copied(std::size_t(fs.num_files()), false);
+	storage_error se;
+	aux::copy_files(fs, save_path, new_save_path, files, 2, {}, copied, se);
+	TEST_CHECK(!se);
+	check_copy(fs, save_path, new_save_path);
+
+	// a partial copy whose last block doesn't match the source is copied
+	// from the start
+	error_code ec;
+	remove(fs.file_path(file_index_t{0}, new_save_path), ec);
+	partial.assign(source.begin(), source.begin() + 2 * 1024 * 1024);
+	partial[partial.size() - 100] = char(~partial[partial.size() - 100]);
+	write_whole_file(part, partial);
+	aux::copy_files(fs, save_path, new_save_path, {file_index_t{0}}, 1, {}, copied, se);
+	TEST_CHECK(!se);
+	check_copy(fs, save_path, new_save_path);
+
+	// as is one that's larger than the source
+	remove(fs.file_path(file_index_t{0}, new_save_path), ec);
+	partial = source;
+	partial.resize(source.size() + 1024 * 1024, 'x');
+	write_whole_file(part, partial);
+	aux::copy_files(fs, save_path, new_save_path, {file_index_t{0}}, 1, {}, copied, se);
+	TEST_CHECK(!se);
+	check_copy(fs, save_path, new_save_path);
+
+	delete_dirs(save_path);
+	delete_dirs(new_save_path);
+}
+
+namespace {
+
 void sync(lt::io_context& ioc, int& outstanding)
 {
 	while (outstanding > 0)
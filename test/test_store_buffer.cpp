@@ -34,6 +34,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/store_buffer.hpp"
 #include "libtorrent/disk_interface.hpp" // for default_block_size
 
+#include <thread>
+#include <vector>
+
 using lt::aux::torrent_location;
 using lt::aux::store_buffer;
 
@@ -184,3 +187,44 @@ TORRENT_TEST(store_buffer_get2)
 	check2_miss(sb, loc[7], loc[4]);
 }
 
+
+// disk threads retire blocks while the network thread looks them up. The
+// test macros aren't thread safe, so the workers only count the lookups that
+// returned the wrong result
+TORRENT_TEST(store_buffer_threads)
+{
+	store_buffer sb;
+	int const num_threads = 4;
+	int const num_pieces = 200;
+	std::vector<int> errors(num_threads, 0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&sb, &errors, t]
+		{
+			int& err = errors[std::size_t(t)];
+			lt::storage_index_t const st(t);
+			for (int p = 0; p < num_pieces; ++p)
+			{
+				torrent_location const l0(st, lt::piece_index_t(p), 0);
+				torrent_location const l1(st, lt::piece_index_t(p), lt::default_block_size);
+				sb.insert(l0, &buf1);
+				sb.insert(l1, &buf2);
+				int const ret = sb.get2(l0, l1, [](char const* b0, char const* b1)
+				{ return b0 == &buf1 && b1 == &buf2 ? 1 : 2; });
+				if (ret != 1) ++err;
+				sb.erase(l0);
+				if (!sb.get(l1, [&err](char const* b) { if (b != &buf2) ++err; })) ++err;
+				if (sb.get(l0, [](char const*) {})) ++err;
+				sb.erase(l1);
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+
+	for (int t = 0; t < num_threads; ++t)
+	{
+		TEST_EQUAL(errors[std::size_t(t)], 0);
+		check_miss(sb, torrent_location(lt::storage_index_t(t), p0, 0));
+	}
+}
@@ -12,6 +12,14 @@ see LICENSE file.
 #include "settings.hpp"
 #include "libtorrent/download_priority.hpp"
 #include "libtorrent/torrent_info.hpp"
+#include "libtorrent/mmap_disk_io.hpp"
+#include "libtorrent/disk_interface.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/settings_pack.hpp"
+#include "libtorrent/aux_/path.hpp"
+#include "libtorrent/aux_/vector.hpp"
+
+#include <vector>
 
 TORRENT_TEST(time_crititcal)
 {
@@ -35,3 +43,120 @@ TORRENT_TEST(time_crititcal_zero_prio)
 	h.set_piece_deadline(lt::piece_index_t{0}, 0, lt::torrent_handle::alert_when_available);
 }
 
+
+#if TORRENT_HAVE_MMAP
+namespace {
+
+void sync(lt::io_context& ioc, int& outstanding)
+{
+	while (outstanding > 0)
+	{
+		ioc.run_one();
+		ioc.restart();
+	}
+}
+
+} // anonymous namespace
+
+// a read for a time-critical piece is issued behind a deep queue of other
+// reads. It should not have to wait for them
+TORRENT_TEST(time_critical_disk_read)
+{
+	int const num_blocks = 256;
+
+	lt::io_context ioc;
+	lt::counters cnt;
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::aio_threads, 1);
+	pack.set_int(lt::settings_pack::file_pool_size, 2);
+	pack.set_int(lt::settings_pack::read_cache_size, 0);
+	std::unique_ptr<lt::disk_interface> disk_io
+		= lt::mmap_disk_io_constructor(ioc, pack, cnt);
+
+	lt::file_storage fs;
+	fs.add_file("test", lt::default_block_size * num_blocks);
+	fs.set_piece_length(lt::default_block_size * 16);
+	fs.set_num_pieces(num_blocks / 16);
+
+	std::string const save_path = lt::complete("time_critical_read");
+	lt::error_code ec;
+	lt::remove_all(save_path, ec);
+
+	lt::aux::vector<lt::download_priority_t, lt::file_index_t> prios;
+	lt::storage_params params(fs, nullptr, save_path, lt::storage_mode_sparse
+		, prios, lt::sha1_hash("01234567890123456789"));
+	lt::storage_holder t = disk_io->new_torrent(params, {});
+
+	int outstanding = 0;
+	lt::add_torrent_params atp;
+	++outstanding;
+	disk_io->async_check_files(t, &atp, lt::aux::vector<std::string, lt::file_index_t>{}
+		, [&](lt::status_t, lt::storage_error const&) { --outstanding; });
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	std::vector<char> const buf(std::size_t(lt::default_block_size), 'x');
+	for (int i = 0; i < num_blocks; ++i)
+	{
+		lt::peer_request const r{lt::piece_index_t(i / 16)
+			, (i % 16) * lt::default_block_size, lt::default_block_size};
+		++outstanding;
+		disk_io->async_write(t, r, buf.data(), {}, [&](lt::storage_error const& se)
+		{
+			--outstanding;
+			TEST_CHECK(!se);
+		});
+	}
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	// the reads are queued behind a fence. They are blocked until the fence
+	// job completes, and then all added to the job queue at once. The
+	// disk thread doesn't pick up the fence job until it's submitted
+	++outstanding;
+	disk_io->async_release_files(t, [&] { --outstanding; });
+	TEST_EQUAL(cnt[lt::counters::blocked_disk_jobs], 0);
+
+	// queue a read of every block, and then one time-critical read of the
+	// last piece
+	int completed = 0;
+	for (int i = 0; i < num_blocks; ++i)
+	{
+		lt::peer_request const r{lt::piece_index_t(i / 16)
+			, (i % 16) * lt::default_block_size, lt::default_block_size};
+		++outstanding;
+		disk_io->async_read(t, r, [&](lt::disk_buffer_holder, lt::storage_error const& se)
+		{
+			--outstanding;
+			++completed;
+			TEST_CHECK(!se);
+		});
+	}
+
+	int critical_position = -1;
+	lt::peer_request const r{lt::piece_index_t(num_blocks / 16 - 1), 0, lt::default_block_size};
+	++outstanding;
+	disk_io->async_read_deadline(t, r, lt::clock_type::now() + lt::milliseconds(100)
+		, [&](lt::disk_buffer_holder h, lt::storage_error const& se)
+	{
+		--outstanding;
+		critical_position = completed;
+		++completed;
+		TEST_CHECK(!se);
+		TEST_CHECK(h.size() == lt::default_block_size && h.data()[0] == 'x');
+	});
+	TEST_EQUAL(cnt[lt::counters::blocked_disk_jobs], num_blocks + 1);
+
+	disk_io->submit_jobs();
+	sync(ioc, outstanding);
+
+	// once the fence is lowered, the time-critical read is served before
+	// all the reads queued ahead of it
+	TEST_EQUAL(critical_position, 0);
+	TEST_EQUAL(completed, num_blocks + 1);
+
+	disk_io->remove_torrent(t);
+	disk_io->abort(true);
+	lt::remove_all(save_path, ec);
+}
+#endif
@@ -20,6 +20,7 @@ see LICENSE file.
 #include "libtorrent/alert_types.hpp"
 #include "libtorrent/aux_/torrent.hpp"
 #include "libtorrent/peer_info.hpp"
+#include "libtorrent/peer_connection_interface.hpp"
 #include "libtorrent/extensions.hpp"
 #include "libtorrent/aux_/path.hpp" // for combine_path, current_working_directory
 #include "libtorrent/magnet_uri.hpp"
@@ -28,6 +29,7 @@ see LICENSE file.
 #include "libtorrent/aux_/random.hpp"
 #include "settings.hpp"
 #include <tuple>
+#include <array>
 #include <iostream>
 
 #include "test.hpp"
@@ -799,6 +801,128 @@ TORRENT_TEST(test_calc_bytes_all_pieces_two_pad)
 	TEST_EQUAL(aux::calc_bytes(fs, aux::piece_count{fs.num_pieces(), 2, true}), fs.total_size() - 2 * 0x4000);
 }
 
+namespace {
+
+// a connection that's only ever compared by address
+struct stub_connection final : peer_connection_interface
+{
+	tcp::endpoint const& remote() const override { return m_remote; }
+	tcp::endpoint local_endpoint() const override { return {}; }
+	void disconnect(error_code const&, operation_t, disconnect_severity_t) override {}
+	peer_id const& pid() const override { return m_pid; }
+	peer_id our_pid() const override { return m_pid; }
+	void set_holepunch_mode() override {}
+	aux::torrent_peer* peer_info_struct() const override { return nullptr; }
+	void set_peer_info(aux::torrent_peer*) override {}
+	bool is_outgoing() const override { return true; }
+	void add_stat(std::int64_t, std::int64_t) override {}
+	bool fast_reconnect() const override { return false; }
+	bool is_choked() const override { return false; }
+	bool failed() const override { return false; }
+	aux::stat const& statistics() const override { return m_stat; }
+	void get_peer_info(peer_info&) const override {}
+#ifndef TORRENT_DISABLE_LOGGING
+	bool should_log(peer_log_alert::direction_t) const override { return false; }
+	void peer_log(peer_log_alert::direction_t
+		, char const*, char const*, ...) const noexcept override TORRENT_FORMAT(4, 5) {}
+#endif
+
+	aux::stat m_stat;
+	tcp::endpoint m_remote;
+	peer_id m_pid;
+};
+
+}
+
+TORRENT_TEST(web_seed_peer_info)
+{
+	aux::web_seed_t ws("http://example.com/");
+
+	std::array<stub_connection, 3> conns;
+	peer_connection_interface* c1 = &conns[0];
+	peer_connection_interface* c2 = &conns[1];
+	peer_connection_interface* c3 = &conns[2];
+
+	TEST_EQUAL(ws.num_connections(), 0);
+	TEST_CHECK(&ws.free_peer_info() == &ws.peer_info);
+	ws.peer_info.connection = c1;
+
+	// the second connection gets a peer_info of its own
+	aux::ipv4_peer& second = ws.free_peer_info();
+	TEST_CHECK(&second != &ws.peer_info);
+	TEST_CHECK(second.web_seed);
+	second.connection = c2;
+	TEST_EQUAL(ws.extra_peer_info.size(), 1);
+
+	TEST_EQUAL(ws.num_connections(), 2);
+	TEST_CHECK(ws.has_connection(c1));
+	TEST_CHECK(ws.has_connection(c2));
+	TEST_CHECK(!ws.has_connection(c3));
+	TEST_CHECK(ws.peer_info_for(c1) == &ws.peer_info);
+	TEST_CHECK(ws.peer_info_for(c2) == &second);
+	TEST_CHECK(ws.peer_info_for(c3) == nullptr);
+
+	// a slot freed by a disconnect is reused
+	ws.peer_info.connection = nullptr;
+	TEST_EQUAL(ws.num_connections(), 1);
+	TEST_CHECK(&ws.free_peer_info() == &ws.peer_info);
+	ws.peer_info.connection = c3;
+	TEST_CHECK(&ws.free_peer_info() != &second);
+	TEST_EQUAL(ws.extra_peer_info.size(), 2);
+
+	// banning any of the connections bans the web seed
+	TEST_CHECK(!ws.banned());
+	second.banned = true;
+	TEST_CHECK(ws.banned());
+}
+
+TORRENT_TEST(web_seed_restart_blocks)
+{
+	aux::web_seed_t ws("http://example.com/");
+
+	std::array<stub_connection, 2> conns;
+	ws.peer_info.connection = &conns[0];
+	aux::ipv4_peer& second = ws.free_peer_info();
+	second.connection = &conns[1];
+
+	peer_request const r1{piece_index_t(1), 0, 0x4000};
+	peer_request const r2{piece_index_t(2), 0x4000, 0x4000};
+
+	// both connections are interrupted in the middle of a block. Neither
+	// replaces the block saved by the other
+	std::vector<char> data1(100, 'a');
+	std::vector<char> data2(200, 'b');
+	TEST_EQUAL(ws.save_restart_block(ws.peer_info_for(&conns[0]), r1, data1), 0);
+	TEST_EQUAL(ws.save_restart_block(ws.peer_info_for(&conns[1]), r2, data2), 0);
+	TEST_CHECK(data1.empty());
+	TEST_CHECK(data2.empty());
+	TEST_EQUAL(ws.restart_blocks.size(), 2);
+	ws.peer_info.connection = nullptr;
+	second.connection = nullptr;
+
+	// the next connections pick them up, whichever slot they use
+	std::vector<char> buf;
+	TEST_CHECK(!ws.take_restart_block(peer_request{piece_index_t(1), 0x4000, 0x4000}, buf));
+	TEST_CHECK(ws.take_restart_block(r2, buf));
+	TEST_CHECK(buf == std::vector<char>(200, 'b'));
+	buf.clear();
+	TEST_CHECK(ws.take_restart_block(r1, buf));
+	TEST_CHECK(buf == std::vector<char>(100, 'a'));
+	TEST_CHECK(ws.restart_blocks.empty());
+
+	// a second interruption of the same connection replaces its block, and
+	// the one it replaced is wasted
+	std::vector<char> data3(300, 'c');
+	std::vector<char> data4(400, 'd');
+	TEST_EQUAL(ws.save_restart_block(&ws.peer_info, r1, data3), 0);
+	TEST_EQUAL(ws.save_restart_block(&ws.peer_info, r2, data4), 300);
+	TEST_EQUAL(ws.restart_blocks.size(), 1);
+	buf.clear();
+	TEST_CHECK(!ws.take_restart_block(r1, buf));
+	TEST_CHECK(ws.take_restart_block(r2, buf));
+	TEST_EQUAL(buf.size(), 400);
+}
+
 #if TORRENT_HAS_SYMLINK
 TORRENT_TEST(symlinks_restore)
 {
@@ -32,6 +32,8 @@ see LICENSE file.
 #include "libtorrent/aux_/path.hpp"
 #include "libtorrent/aux_/socket_io.hpp"
 
+#include <limits>
+
 using namespace lt;
 
 // TODO: test scrape requests
@@ -225,6 +227,45 @@ TORRENT_TEST(parse_scrape_response_with_zero)
 	TEST_EQUAL(resp.downloaders, -1);
 }
 
+TORRENT_TEST(parse_multi_scrape_response)
+{
+	char const response[] = "d5:filesd"
+		"20:aaaaaaaaaaaaaaaaaaaad8:completei1e10:incompletei2e10:downloadedi3ee"
+		"20:bbbbbbbbbbbbbbbbbbbbd8:completei4e10:incompletei5e10:downloadedi6ee"
+		"ee";
+	std::vector<sha1_hash> const ihs = {sha1_hash("bbbbbbbbbbbbbbbbbbbb")
+		, sha1_hash("cccccccccccccccccccc"), sha1_hash("aaaaaaaaaaaaaaaaaaaa")};
+	std::vector<aux::scrape_entry> entries;
+	error_code ec;
+	aux::parse_scrape_response(response, ec, ihs, entries);
+
+	TEST_EQUAL(ec, error_code());
+	TEST_EQUAL(entries.size(), 3);
+	TEST_EQUAL(entries[0].ec, error_code());
+	TEST_EQUAL(entries[0].complete, 4);
+	TEST_EQUAL(entries[0].incomplete, 5);
+	TEST_EQUAL(entries[0].downloaded, 6);
+	TEST_EQUAL(entries[0].downloaders, -1);
+	TEST_EQUAL(entries[1].ec, error_code(errors::invalid_hash_entry));
+	TEST_EQUAL(entries[2].ec, error_code());
+	TEST_EQUAL(entries[2].complete, 1);
+	TEST_EQUAL(entries[2].incomplete, 2);
+	TEST_EQUAL(entries[2].downloaded, 3);
+}
+
+TORRENT_TEST(parse_multi_scrape_response_failure)
+{
+	char const response[] = "d14:failure reason12:test messagee";
+	std::vector<sha1_hash> const ihs = {sha1_hash("aaaaaaaaaaaaaaaaaaaa")};
+	std::vector<aux::scrape_entry> entries;
+	error_code ec;
+	aux::tracker_response const resp = aux::parse_scrape_response(response, ec, ihs, entries);
+
+	TEST_EQUAL(ec, errors::tracker_failure);
+	TEST_EQUAL(resp.failure_reason, "test message");
+	TEST_CHECK(entries.empty());
+}
+
 TORRENT_TEST(parse_external_ip)
 {
 	char const response[] = "d5:peers0:11:external ip4:\x01\x02\x03\x04" "e";
@@ -594,6 +635,42 @@ TORRENT_TEST(parse_websocket_tracker_response_invalid_info_hash)
 	TEST_CHECK(std::holds_alternative<std::string>(ret));
 }
 
+TORRENT_TEST(parse_websocket_tracker_response_double)
+{
+	char const response[] = R"({"complete":2.9,"incomplete":-1e300,"downloaded":1e300,"action":"announce","interval":120.5,"info_hash":"xxxxxxxxxxxxxxxxxxxx"})";
+
+	error_code ec;
+	auto ret = aux::parse_websocket_tracker_response({response, long(std::strlen(response))}, ec);
+
+	TEST_EQUAL(ec, error_code{});
+	TEST_CHECK(std::holds_alternative<aux::websocket_tracker_response>(ret));
+
+	if(std::holds_alternative<aux::websocket_tracker_response>(ret))
+	{
+		auto parsed = std::get<aux::websocket_tracker_response>(ret);
+		TEST_CHECK(parsed.resp);
+
+		if (parsed.resp)
+		{
+			TEST_EQUAL(parsed.resp->interval.count(), 120);
+			TEST_EQUAL(parsed.resp->complete, 2);
+			TEST_EQUAL(parsed.resp->incomplete, std::numeric_limits<int>::min());
+			TEST_EQUAL(parsed.resp->downloaded, std::numeric_limits<int>::max());
+		}
+	}
+}
+
+TORRENT_TEST(parse_websocket_tracker_response_infinite)
+{
+	char const response[] = R"({"complete":1e999,"action":"announce","interval":120,"info_hash":"xxxxxxxxxxxxxxxxxxxx"})";
+
+	error_code ec;
+	auto ret = aux::parse_websocket_tracker_response({response, long(std::strlen(response))}, ec);
+
+	TEST_EQUAL(ec.value(), boost::system::errc::bad_message);
+	TEST_CHECK(std::holds_alternative<std::string>(ret));
+}
+
 TORRENT_TEST(parse_websocket_tracker_response_offer)
 {
 	char const response[] = R"({"action":"announce","offer":{"type":"offer","sdp":"SDP\r\n"},"offer_id":"yyyyyyyyyyyyyyyy","peer_id":"-LT2000-p!SALH(DnYsi","info_hash":"xxxxxxxxxxxxxxxxxxxx"})";
@@ -648,6 +725,110 @@ TORRENT_TEST(parse_websocket_tracker_response_answer)
 	}
 }
 
+TORRENT_TEST(write_websocket_tracker_answer)
+{
+	aux::tracker_answer ans;
+	ans.info_hash = sha1_hash("\xff\x00xxxxxxxxxxxxxxxxx\x80");
+	ans.pid = peer_id("-LT2000-p!SALH(DnYsi");
+	ans.answer.offer_id = aux::rtc_offer_id{span<char const>("yyyyyyyyyyyyyyy\"", 16)};
+	ans.answer.pid = peer_id("-LT2000-aaaaaaaaaaaa");
+	ans.answer.sdp = "v=0\r\no=\"\\\x01\r\n";
+
+	std::string out;
+	aux::write_websocket_tracker_message(out, ans);
+
+	TEST_EQUAL(out, "{\"action\":\"announce\""
+		",\"info_hash\":\"\xc3\xbf\\u0000xxxxxxxxxxxxxxxxx\xc2\x80\""
+		",\"offer_id\":\"yyyyyyyyyyyyyyy\\\"\""
+		",\"to_peer_id\":\"-LT2000-aaaaaaaaaaaa\""
+		",\"peer_id\":\"-LT2000-p!SALH(DnYsi\""
+		",\"answer\":{\"type\":\"answer\",\"sdp\":\"v=0\\r\\no=\\\"\\\\\\u0001\\r\\n\"}}");
+
+	// the tracker relays the answer to the offering peer as is
+	error_code ec;
+	auto ret = aux::parse_websocket_tracker_response(out, ec);
+
+	TEST_EQUAL(ec, error_code{});
+	TEST_CHECK(std::holds_alternative<aux::websocket_tracker_response>(ret));
+
+	if(std::holds_alternative<aux::websocket_tracker_response>(ret))
+	{
+		auto parsed = std::get<aux::websocket_tracker_response>(ret);
+
+		TEST_EQUAL(parsed.info_hash, ans.info_hash);
+		TEST_CHECK(parsed.answer);
+
+		if (parsed.answer)
+		{
+			TEST_CHECK(parsed.answer->offer_id == ans.answer.offer_id);
+			TEST_EQUAL(parsed.answer->pid, ans.pid);
+			TEST_EQUAL(parsed.answer->sdp, ans.answer.sdp);
+		}
+	}
+}
+
+TORRENT_TEST(websocket_tracker_many_torrents)
+{
+	// this measures how fast announces of many torrents are pushed through
+	// the single WebSocket connection shared by all of them
+	int const http_port = start_websocket_server();
+
+	settings_pack pack = settings();
+	pack.set_bool(settings_pack::announce_to_all_trackers, true);
+	pack.set_int(settings_pack::num_want, 1);
+	pack.set_int(settings_pack::webtorrent_offer_pool_size, 0);
+	pack.set_int(settings_pack::alert_mask, alert_category::status | alert_category::tracker);
+
+	auto s = std::make_unique<lt::session>(pack);
+
+	error_code ec;
+	remove_all("tmp5_tracker", ec);
+	create_directory("tmp5_tracker", ec);
+
+	char tracker_url[200];
+	std::snprintf(tracker_url, sizeof(tracker_url), "ws://127.0.0.1:%d/announce"
+		, http_port);
+
+	int const num_torrents = 50;
+	for (int i = 0; i < num_torrents; ++i)
+	{
+		char name[50];
+		std::snprintf(name, sizeof(name), "temporary%d", i);
+		std::ofstream file(combine_path("tmp5_tracker", name).c_str());
+		std::shared_ptr<torrent_info> t = ::create_torrent(&file, name, 16 * 1024, 13, false);
+		file.close();
+		t->add_tracker(tracker_url, 0);
+
+		add_torrent_params addp;
+		addp.flags &= ~torrent_flags::paused;
+		addp.flags &= ~torrent_flags::auto_managed;
+		addp.flags |= torrent_flags::seed_mode;
+		addp.ti = t;
+		addp.save_path = "tmp5_tracker";
+		s->async_add_torrent(std::move(addp));
+	}
+
+	time_point const start = clock_type::now();
+	int num_replies = 0;
+	while (num_replies < num_torrents && clock_type::now() - start < seconds(60))
+	{
+		s->wait_for_alert(seconds(1));
+		std::vector<alert*> alerts;
+		s->pop_alerts(&alerts);
+		for (auto const a : alerts)
+			if (alert_cast<tracker_reply_alert>(a)) ++num_replies;
+	}
+	time_duration const elapsed = clock_type::now() - start;
+
+	TEST_EQUAL(num_replies, num_torrents);
+	std::printf("%d announces in %d ms (%.1f announces/s)\n", num_replies
+		, int(total_milliseconds(elapsed))
+		, num_replies * 1000.0 / std::max(1, int(total_milliseconds(elapsed))));
+
+	s.reset();
+	stop_websocket_server();
+}
+
 TORRENT_TEST(websocket_tracker)
 {
 	int const http_port = start_websocket_server();
@@ -13,6 +13,15 @@ see LICENSE file.
 #include "libtorrent/aux_/session_interface.hpp"
 #include "libtorrent/performance_counters.hpp"
 #include "libtorrent/aux_/resolver.hpp"
+#include "libtorrent/aux_/udp_tracker_connection.hpp"
+#include "libtorrent/aux_/io.hpp"
+#include "libtorrent/aux_/http_connection.hpp"
+#include "libtorrent/aux_/ssl.hpp"
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <thread>
 
 using namespace lt;
 using namespace lt::aux;
@@ -46,10 +55,12 @@ struct tracker_manager_handler : aux::session_logger {
 	void send_fn_hostname(aux::listen_socket_handle const&
 		, char const*
 		, int
-		, span<char const>
+		, span<char const> p
 		, error_code&
 		, aux::udp_send_flags_t const)
-	{}
+	{
+		m_sent.emplace_back(p.begin(), p.end());
+	}
 
 #ifndef TORRENT_DISABLE_LOGGING
 	bool should_log() const override { return false; }
@@ -57,7 +68,7 @@ struct tracker_manager_handler : aux::session_logger {
 #endif
 
 #if TORRENT_USE_ASSERTS
-	bool is_single_thread() const override { return false; }
+	bool is_single_thread() const override { return true; }
 	bool has_peer(aux::peer_connection const*) const override { return false; }
 	bool any_torrent_has_peer(aux::peer_connection const*) const override { return false; }
 	bool is_posting_torrent_updates() const override { return false; }
@@ -67,6 +78,9 @@ struct tracker_manager_handler : aux::session_logger {
 	counters m_stats_counters;
 	aux::resolver m_host_resolver;
 	tracker_manager m_tracker_manager;
+
+	// the packets sent to UDP trackers by hostname
+	std::vector<std::vector<char>> m_sent;
 };
 
 struct ws_request_callback : request_callback
@@ -174,3 +188,767 @@ TORRENT_TEST(empty_and_num_requests)
 #endif
 	}
 }
+
+namespace {
+
+struct scrape_callback : ws_request_callback
+{
+	void tracker_request_error(tracker_request const& req
+		, error_code const& ec
+		, operation_t
+		, const std::string&
+		, seconds32) override
+	{
+		errors.push_back(req.info_hash);
+		error_codes.push_back(ec);
+	}
+
+	std::vector<sha1_hash> errors;
+	std::vector<error_code> error_codes;
+};
+
+void queue_scrape(tracker_manager_handler& h, io_context& ios
+	, aux::session_settings const& sett, std::shared_ptr<request_callback> cb
+	, char const* url, int const i)
+{
+	tracker_request r;
+	r.url = url;
+	r.kind |= tracker_request::scrape_request;
+	r.info_hash[0] = std::uint8_t(i);
+	h.m_tracker_manager.queue_request(ios, std::move(r), sett, cb);
+}
+
+}
+
+TORRENT_TEST(batch_scrapes)
+{
+	io_context ios;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::scrape_batch_delay, 100);
+	tracker_manager_handler h{ios, sett};
+	auto cb = std::make_shared<scrape_callback>();
+
+	char const* udp_url = "udp://127.0.0.1:6969/announce";
+	char const* http_url = "http://127.0.0.1:8080/announce";
+
+	for (int i = 0; i < 3; ++i)
+		queue_scrape(h, ios, sett, cb, udp_url, i);
+	queue_scrape(h, ios, sett, cb, http_url, 3);
+	TEST_EQUAL(h.m_tracker_manager.num_pending_scrapes(), 4);
+	TEST_EQUAL(h.m_tracker_manager.num_requests(), 4);
+
+	// a full batch is sent right away, as a single request
+	int const max_udp = aux::udp_tracker_connection::max_scrape_hashes;
+	for (int i = 4; i < 4 + max_udp; ++i)
+		queue_scrape(h, ios, sett, cb, udp_url, i);
+	TEST_EQUAL(h.m_tracker_manager.num_pending_scrapes(), 4);
+	TEST_EQUAL(h.m_tracker_manager.num_requests(), 5);
+
+	// the rest are sent when the batch delay expires. There is no listen
+	// socket, so all the requests fail. Every torrent in a batch must be
+	// told
+	ios.run_for(seconds(2));
+	TEST_EQUAL(h.m_tracker_manager.num_pending_scrapes(), 0);
+	TEST_CHECK(h.m_tracker_manager.empty());
+
+	std::sort(cb->errors.begin(), cb->errors.end());
+	TEST_EQUAL(int(cb->errors.size()), 4 + max_udp);
+	for (int i = 0; i < std::min(int(cb->errors.size()), 4 + max_udp); ++i)
+		TEST_EQUAL(int(cb->errors[std::size_t(i)][0]), i);
+}
+
+TORRENT_TEST(batch_scrapes_abort)
+{
+	io_context ios;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::scrape_batch_delay, 100);
+	tracker_manager_handler h{ios, sett};
+	auto cb = std::make_shared<scrape_callback>();
+
+	for (int i = 0; i < 3; ++i)
+		queue_scrape(h, ios, sett, cb, "udp://127.0.0.1:6969/announce", i);
+	TEST_EQUAL(h.m_tracker_manager.num_pending_scrapes(), 3);
+
+	// the scrapes that haven't been sent yet are dropped when the tracker
+	// manager is aborted, without failing them
+	h.m_tracker_manager.abort_all_requests();
+	TEST_EQUAL(h.m_tracker_manager.num_pending_scrapes(), 0);
+	TEST_CHECK(h.m_tracker_manager.empty());
+
+	ios.run_for(seconds(1));
+	TEST_EQUAL(cb->errors.size(), 0);
+}
+
+TORRENT_TEST(batch_scrapes_disabled)
+{
+	io_context ios;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::scrape_batch_delay, 0);
+	tracker_manager_handler h{ios, sett};
+	auto cb = std::make_shared<scrape_callback>();
+
+	for (int i = 0; i < 3; ++i)
+		queue_scrape(h, ios, sett, cb, "udp://127.0.0.1:6969/announce", i);
+	TEST_EQUAL(h.m_tracker_manager.num_pending_scrapes(), 0);
+	TEST_EQUAL(h.m_tracker_manager.num_requests(), 3);
+
+	ios.run_for(seconds(2));
+	TEST_CHECK(h.m_tracker_manager.empty());
+	TEST_EQUAL(int(cb->errors.size()), 3);
+}
+
+namespace {
+
+void queue_announce(tracker_manager_handler& h, io_context& ios
+	, aux::session_settings const& sett, std::shared_ptr<request_callback> cb
+	, int const i, tracker_request_flags_t const flags = {}
+	, event_t const e = event_t::none)
+{
+	tracker_request r;
+	r.url = "udp://127.0.0.1:6969/announce";
+	r.kind = flags;
+	r.event = e;
+	r.info_hash[0] = std::uint8_t(i);
+	h.m_tracker_manager.queue_request(ios, std::move(r), sett, cb);
+}
+
+}
+
+TORRENT_TEST(announce_scheduler_host_limit)
+{
+	io_context ios;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::max_concurrent_host_announces, 1);
+	sett.set_int(settings_pack::announce_jitter, 0);
+	tracker_manager_handler h{ios, sett};
+	auto cb = std::make_shared<scrape_callback>();
+
+	queue_announce(h, ios, sett, cb, 0);
+	queue_announce(h, ios, sett, cb, 1);
+	queue_announce(h, ios, sett, cb, 2, tracker_request::needs_peers);
+	queue_announce(h, ios, sett, cb, 3);
+
+	// only one announce is sent to the host at a time
+	TEST_EQUAL(h.m_tracker_manager.num_scheduled_announces(), 3);
+	TEST_EQUAL(h.m_tracker_manager.num_requests(), 4);
+	TEST_EQUAL(h.m_stats_counters[counters::num_scheduled_tracker_announces], 3);
+
+	// event=stopped announces are not held back
+	queue_announce(h, ios, sett, cb, 4, {}, event_t::stopped);
+	TEST_EQUAL(h.m_tracker_manager.num_scheduled_announces(), 3);
+	TEST_EQUAL(h.m_tracker_manager.num_requests(), 5);
+
+	// there is no listen socket, so the announces fail one after the other.
+	// The torrent that needs peers goes ahead of the ones queued before it
+	ios.run_for(seconds(3));
+	TEST_CHECK(h.m_tracker_manager.empty());
+	TEST_EQUAL(h.m_stats_counters[counters::num_scheduled_tracker_announces], 0);
+	TEST_EQUAL(h.m_stats_counters[counters::tracker_announces], 4);
+
+	TEST_EQUAL(cb->errors.size(), 5);
+	std::vector<int> order;
+	for (auto const& ih : cb->errors)
+		if (ih[0] != 4) order.push_back(ih[0]);
+	TEST_CHECK((order == std::vector<int>{0, 2, 1, 3}));
+}
+
+TORRENT_TEST(announce_scheduler_http_host_limit)
+{
+	io_context ios;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::max_concurrent_host_announces, 1);
+	sett.set_int(settings_pack::max_concurrent_http_announces, 2);
+	sett.set_int(settings_pack::announce_jitter, 0);
+	tracker_manager_handler h{ios, sett};
+	auto cb = std::make_shared<scrape_callback>();
+
+	// each failed announce starts the next one for the host, while the
+	// connection list is being updated
+	for (int i = 0; i < 6; ++i)
+	{
+		tracker_request r;
+		r.url = "http://127.0.0.1:1/announce";
+		r.info_hash[0] = std::uint8_t(i);
+		h.m_tracker_manager.queue_request(ios, std::move(r), sett, cb);
+	}
+	TEST_EQUAL(h.m_tracker_manager.num_scheduled_announces(), 5);
+	TEST_EQUAL(h.m_tracker_manager.num_requests(), 6);
+
+	ios.run_for(seconds(10));
+	TEST_CHECK(h.m_tracker_manager.empty());
+	TEST_EQUAL(h.m_tracker_manager.num_scheduled_announces(), 0);
+	TEST_EQUAL(h.m_stats_counters[counters::tracker_announces], 6);
+	TEST_EQUAL(cb->errors.size(), 6);
+	std::vector<int> order;
+	for (auto const& ih : cb->errors) order.push_back(ih[0]);
+	TEST_CHECK((order == std::vector<int>{0, 1, 2, 3, 4, 5}));
+}
+
+TORRENT_TEST(announce_scheduler_stopped)
+{
+	io_context ios;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::max_concurrent_host_announces, 16);
+	sett.set_int(settings_pack::announce_jitter, 60000);
+	tracker_manager_handler h{ios, sett};
+	auto cb = std::make_shared<scrape_callback>();
+
+	// regular announces are held back by the jitter
+	queue_announce(h, ios, sett, cb, 0);
+	queue_announce(h, ios, sett, cb, 1);
+	queue_announce(h, ios, sett, cb, 1, tracker_request::needs_peers);
+	TEST_EQUAL(h.m_tracker_manager.num_scheduled_announces(), 3);
+
+	// when the torrent stops, its announces waiting to be sent are dropped.
+	// Other torrents' announces are not affected
+	queue_announce(h, ios, sett, cb, 1, {}, event_t::stopped);
+	TEST_EQUAL(h.m_tracker_manager.num_scheduled_announces(), 1);
+	TEST_EQUAL(h.m_stats_counters[counters::num_scheduled_tracker_announces], 1);
+	TEST_EQUAL(h.m_tracker_manager.num_requests(), 2);
+
+	h.m_tracker_manager.abort_all_requests(true);
+	ios.run_for(seconds(1));
+}
+
+TORRENT_TEST(announce_scheduler_abort)
+{
+	io_context ios;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::max_concurrent_host_announces, 16);
+	sett.set_int(settings_pack::announce_jitter, 60000);
+	tracker_manager_handler h{ios, sett};
+	auto cb = std::make_shared<scrape_callback>();
+
+	for (int i = 0; i < 3; ++i)
+		queue_announce(h, ios, sett, cb, i);
+	TEST_EQUAL(h.m_tracker_manager.num_scheduled_announces(), 3);
+
+	// the announces waiting in the scheduler are dropped when the tracker
+	// manager is aborted, without failing them
+	h.m_tracker_manager.abort_all_requests();
+	TEST_EQUAL(h.m_tracker_manager.num_scheduled_announces(), 0);
+	TEST_CHECK(h.m_tracker_manager.empty());
+
+	ios.run_for(seconds(1));
+	TEST_EQUAL(cb->errors.size(), 0);
+}
+
+TORRENT_TEST(announce_scheduler_jitter)
+{
+	io_context ios;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::max_concurrent_host_announces, 16);
+	sett.set_int(settings_pack::announce_jitter, 300);
+	tracker_manager_handler h{ios, sett};
+	auto cb = std::make_shared<scrape_callback>();
+
+	// announces with an event are sent right away, regular ones may be
+	// delayed by the jitter
+	queue_announce(h, ios, sett, cb, 0, {}, event_t::started);
+	TEST_EQUAL(h.m_tracker_manager.num_scheduled_announces(), 0);
+	for (int i = 1; i < 10; ++i)
+		queue_announce(h, ios, sett, cb, i);
+	TEST_EQUAL(h.m_tracker_manager.num_requests(), 10);
+
+	ios.run_for(seconds(3));
+	TEST_CHECK(h.m_tracker_manager.empty());
+	TEST_EQUAL(cb->errors.size(), 10);
+	TEST_EQUAL(h.m_stats_counters[counters::tracker_announces], 10);
+}
+
+TORRENT_TEST(announce_port)
+{
+	tracker_request req;
+	TEST_EQUAL(announce_port(req, 6881), 6881);
+
+	// trackers don't accept port 0
+	TEST_EQUAL(announce_port(req, 0), 1);
+
+	req.kind |= tracker_request::needs_peers;
+	TEST_EQUAL(announce_port(req, 6881), 6881);
+
+#if TORRENT_USE_I2P
+	// I2P announces don't reveal the listen port, whatever other flags
+	// the request has
+	req.kind = tracker_request::i2p;
+	TEST_EQUAL(announce_port(req, 6881), 1);
+	req.kind |= tracker_request::needs_peers;
+	TEST_EQUAL(announce_port(req, 6881), 1);
+#endif
+}
+
+namespace {
+
+struct announce_callback : scrape_callback
+{
+	void tracker_response(tracker_request const& req
+		, address const&
+		, std::list<address> const&
+		, struct tracker_response const&) override
+	{
+		responses.push_back(req.info_hash);
+	}
+
+	std::vector<sha1_hash> responses;
+};
+
+// the settings to send UDP tracker packets by hostname, through the
+// handler's send_fn_hostname()
+aux::session_settings udp_proxy_settings()
+{
+	aux::session_settings sett;
+	sett.set_int(settings_pack::proxy_type, settings_pack::socks5);
+	sett.set_bool(settings_pack::proxy_hostnames, true);
+	return sett;
+}
+
+void queue_udp_announce(tracker_manager_handler& h, io_context& ios
+	, aux::session_settings const& sett, std::shared_ptr<request_callback> cb
+	, int const i)
+{
+	tracker_request r;
+	r.url = "udp://tracker.test:6969/announce";
+	r.info_hash[0] = std::uint8_t(i);
+	h.m_tracker_manager.queue_request(ios, std::move(r), sett, cb);
+}
+
+std::uint32_t packet_action(std::vector<char> const& p)
+{
+	span<char const> view(p);
+	aux::read_uint64(view);
+	return aux::read_uint32(view);
+}
+
+std::uint32_t packet_tid(std::vector<char> const& p)
+{
+	span<char const> view(p);
+	aux::read_uint64(view);
+	aux::read_uint32(view);
+	return aux::read_uint32(view);
+}
+
+std::int64_t packet_connection_id(std::vector<char> const& p)
+{
+	span<char const> view(p);
+	return aux::read_int64(view);
+}
+
+bool is_connect(std::vector<char> const& p)
+{
+	return p.size() == 16 && packet_connection_id(p) == 0x41727101980
+		&& packet_action(p) == 0;
+}
+
+void respond_connect(tracker_manager_handler& h, std::vector<char> const& req
+	, std::int64_t const id)
+{
+	std::array<char, 16> buf;
+	span<char> view(buf);
+	aux::write_uint32(0, view); // action (connect)
+	aux::write_uint32(packet_tid(req), view);
+	aux::write_int64(id, view);
+	h.m_tracker_manager.incoming_packet("tracker.test", buf);
+}
+
+void respond_announce(tracker_manager_handler& h, std::vector<char> const& req)
+{
+	std::array<char, 20> buf;
+	span<char> view(buf);
+	aux::write_uint32(1, view); // action (announce)
+	aux::write_uint32(packet_tid(req), view);
+	aux::write_uint32(1800, view); // interval
+	aux::write_uint32(0, view); // leechers
+	aux::write_uint32(0, view); // seeders
+	h.m_tracker_manager.incoming_packet("tracker.test", buf);
+}
+
+}
+
+TORRENT_TEST(udp_connection_id_shared)
+{
+	io_context ios;
+	aux::session_settings sett = udp_proxy_settings();
+	tracker_manager_handler h{ios, sett};
+	auto cb = std::make_shared<announce_callback>();
+
+	for (int i = 0; i < 3; ++i)
+		queue_udp_announce(h, ios, sett, cb, i);
+	ios.poll();
+
+	// only one of the announces sends a connect request, the others wait
+	// for it
+	TEST_EQUAL(h.m_sent.size(), 1);
+	TEST_CHECK(is_connect(h.m_sent.front()));
+	TEST_EQUAL(h.m_stats_counters[counters::udp_tracker_connection_id_misses], 1);
+	TEST_EQUAL(h.m_stats_counters[counters::udp_tracker_connection_id_waits], 2);
+
+	auto const connect = h.m_sent.front();
+	h.m_sent.clear();
+	respond_connect(h, connect, 1337);
+
+	// now all of them announce, with the same connection ID
+	TEST_EQUAL(h.m_sent.size(), 3);
+	auto const announces = h.m_sent;
+	h.m_sent.clear();
+	for (auto const& p : announces)
+	{
+		TEST_EQUAL(packet_connection_id(p), 1337);
+		TEST_EQUAL(packet_action(p), 1);
+		respond_announce(h, p);
+	}
+	TEST_EQUAL(cb->responses.size(), 3);
+
+	// the connection ID is cached for the next announce
+	queue_udp_announce(h, ios, sett, cb, 3);
+	ios.poll();
+	TEST_EQUAL(h.m_sent.size(), 1);
+	if (h.m_sent.size() == 1)
+	{
+		TEST_EQUAL(packet_connection_id(h.m_sent.front()), 1337);
+		respond_announce(h, h.m_sent.front());
+	}
+	TEST_EQUAL(h.m_stats_counters[counters::udp_tracker_connection_id_hits], 1);
+	TEST_EQUAL(h.m_stats_counters[counters::udp_tracker_connection_id_misses], 1);
+	TEST_EQUAL(cb->responses.size(), 4);
+	TEST_EQUAL(cb->errors.size(), 0);
+
+	ios.run_for(milliseconds(100));
+	TEST_CHECK(h.m_tracker_manager.empty());
+}
+
+TORRENT_TEST(udp_connection_id_connect_failure)
+{
+	io_context ios;
+	aux::session_settings sett = udp_proxy_settings();
+	tracker_manager_handler h{ios, sett};
+	auto cb = std::make_shared<announce_callback>();
+
+	for (int i = 0; i < 3; ++i)
+		queue_udp_announce(h, ios, sett, cb, i);
+	ios.poll();
+	TEST_EQUAL(h.m_sent.size(), 1);
+
+	// the tracker rejects the connect request. The announce that sent it
+	// fails, and one of the others sends a new one
+	auto const connect = h.m_sent.front();
+	h.m_sent.clear();
+	std::array<char, 16> buf;
+	span<char> view(buf);
+	aux::write_uint32(3, view); // action (error)
+	aux::write_uint32(packet_tid(connect), view);
+	aux::write_string("busy", view);
+	aux::write_uint32(0, view);
+	h.m_tracker_manager.incoming_packet("tracker.test", buf);
+	ios.poll();
+
+	TEST_EQUAL(cb->errors.size(), 1);
+	TEST_EQUAL(h.m_sent.size(), 1);
+	if (h.m_sent.size() == 1)
+	{
+		TEST_CHECK(is_connect(h.m_sent.front()));
+		TEST_CHECK(packet_tid(h.m_sent.front()) != packet_tid(connect));
+	}
+	TEST_EQUAL(h.m_stats_counters[counters::udp_tracker_connection_id_misses], 2);
+
+	h.m_tracker_manager.abort_all_requests();
+	ios.run_for(milliseconds(100));
+	TEST_CHECK(h.m_tracker_manager.empty());
+}
+
+TORRENT_TEST(udp_connection_id_refresh)
+{
+	io_context ios;
+	aux::session_settings sett = udp_proxy_settings();
+	sett.set_int(settings_pack::udp_tracker_token_expiry, 2);
+	tracker_manager_handler h{ios, sett};
+	auto cb = std::make_shared<announce_callback>();
+
+	queue_udp_announce(h, ios, sett, cb, 0);
+	ios.poll();
+	TEST_EQUAL(h.m_sent.size(), 1);
+	respond_connect(h, h.m_sent.front(), 1);
+	TEST_EQUAL(h.m_sent.size(), 2);
+	respond_announce(h, h.m_sent.back());
+	h.m_sent.clear();
+
+	// an announce shortly before the connection ID expires uses it, but
+	// the tracker manager asks for a new one in the background
+	std::this_thread::sleep_for(milliseconds(1700));
+	queue_udp_announce(h, ios, sett, cb, 1);
+	ios.poll();
+	TEST_EQUAL(h.m_sent.size(), 2);
+	TEST_EQUAL(h.m_stats_counters[counters::udp_tracker_connection_id_refreshes], 1);
+	if (h.m_sent.size() == 2)
+	{
+		auto const refresh = is_connect(h.m_sent[0]) ? h.m_sent[0] : h.m_sent[1];
+		auto const announce = is_connect(h.m_sent[0]) ? h.m_sent[1] : h.m_sent[0];
+		TEST_CHECK(is_connect(refresh));
+		TEST_EQUAL(packet_connection_id(announce), 1);
+		TEST_EQUAL(packet_action(announce), 1);
+		respond_announce(h, announce);
+		respond_connect(h, refresh, 2);
+	}
+	h.m_sent.clear();
+
+	// the next announce uses the new connection ID, well after the old one
+	// expired
+	std::this_thread::sleep_for(milliseconds(1000));
+	queue_udp_announce(h, ios, sett, cb, 2);
+	ios.poll();
+	TEST_EQUAL(h.m_sent.size(), 1);
+	if (h.m_sent.size() == 1)
+	{
+		TEST_EQUAL(packet_connection_id(h.m_sent.front()), 2);
+		respond_announce(h, h.m_sent.front());
+	}
+	TEST_EQUAL(h.m_stats_counters[counters::udp_tracker_connection_id_misses], 1);
+	TEST_EQUAL(cb->responses.size(), 3);
+
+	ios.run_for(milliseconds(100));
+	TEST_CHECK(h.m_tracker_manager.empty());
+}
+
+namespace {
+
+// an HTTP server keeping connections open, responding to every request on
+// them with the same short response
+struct keep_alive_server
+{
+	explicit keep_alive_server(io_context& ios)
+		: m_ios(ios)
+		, m_acceptor(ios)
+	{
+		m_acceptor.open(tcp::v4());
+		m_acceptor.bind(tcp::endpoint(make_address_v4("127.0.0.1"), 0));
+		m_acceptor.listen();
+		accept();
+	}
+
+	int port() const { return m_acceptor.local_endpoint().port(); }
+
+	int connections = 0;
+
+private:
+
+	struct connection
+	{
+		explicit connection(io_context& ios) : sock(ios) {}
+		tcp::socket sock;
+		std::array<char, 1024> buf;
+		std::string request;
+	};
+
+	void accept()
+	{
+		auto c = std::make_shared<connection>(m_ios);
+		m_acceptor.async_accept(c->sock, [this, c](error_code const& ec)
+		{
+			if (ec) return;
+			++connections;
+			read(c);
+			accept();
+		});
+	}
+
+	void read(std::shared_ptr<connection> c)
+	{
+		connection& conn = *c;
+		conn.sock.async_read_some(boost::asio::buffer(conn.buf)
+			, [this, c](error_code const& ec, std::size_t const bytes)
+		{
+			if (ec) return;
+			c->request.append(c->buf.data(), bytes);
+			auto const end = c->request.find("\r\n\r\n");
+			if (end != std::string::npos)
+			{
+				c->request.erase(0, end + 4);
+				static char const response[] = "HTTP/1.1 200 OK\r\n"
+					"Content-Length: 2\r\n\r\nok";
+				boost::asio::async_write(c->sock
+					, boost::asio::buffer(response, sizeof(response) - 1)
+					, [c](error_code const&, std::size_t) {});
+			}
+			read(c);
+		});
+	}
+
+	io_context& m_ios;
+	tcp::acceptor m_acceptor;
+};
+
+// returns a connection that has completed a request to ``port`` and is
+// ready for the next one
+std::shared_ptr<aux::http_connection> idle_connection(io_context& ios
+	, aux::resolver_interface& res, int const port)
+{
+	bool done = false;
+	auto c = std::make_shared<aux::http_connection>(ios, res
+		, [&done](error_code const& ec, aux::http_parser const&, span<char const>
+			, aux::http_connection&)
+		{
+			TEST_CHECK(!ec);
+			done = true;
+		}
+		, true, 1024 * 1024, aux::http_connect_handler()
+		, aux::http_filter_handler(), aux::hostname_filter_handler()
+#if TORRENT_USE_SSL
+		, nullptr
+#endif
+		);
+	c->keep_alive(true);
+	c->get("http://127.0.0.1:" + std::to_string(port) + "/announce", seconds(5));
+	time_point const deadline = clock_type::now() + seconds(5);
+	while (!done && clock_type::now() < deadline)
+		ios.run_one_for(milliseconds(50));
+	TEST_CHECK(done);
+	TEST_CHECK(c->idle());
+	return c;
+}
+
+http_tracker_key local_key(int const port)
+{
+	http_tracker_key key;
+	key.hostname = "127.0.0.1";
+	key.port = port;
+	return key;
+}
+
+}
+
+TORRENT_TEST(http_connection_pool)
+{
+	io_context ios;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::max_idle_tracker_connections, 1);
+	tracker_manager_handler h{ios, sett};
+	tracker_manager& tm = h.m_tracker_manager;
+	keep_alive_server server(ios);
+	http_tracker_key const key = local_key(server.port());
+
+	auto const c1 = idle_connection(ios, h.m_host_resolver, server.port());
+	auto const c2 = idle_connection(ios, h.m_host_resolver, server.port());
+	TEST_EQUAL(server.connections, 2);
+	TEST_CHECK(!tm.take_http_connection(key));
+
+	tm.return_http_connection(ios, key, c1);
+	TEST_EQUAL(h.m_stats_counters[counters::num_idle_http_tracker_connections], 1);
+
+	// there's only room for one idle connection to the tracker, the second
+	// one is closed
+	tm.return_http_connection(ios, key, c2);
+	TEST_EQUAL(h.m_stats_counters[counters::num_idle_http_tracker_connections], 1);
+	TEST_CHECK(!c2->idle());
+
+	// requests to other trackers don't get it, and neither do requests
+	// using another SSL context
+	http_tracker_key other = key;
+	other.port += 1;
+	TEST_CHECK(!tm.take_http_connection(other));
+#if TORRENT_USE_SSL
+	other = key;
+	other.ssl_ctx_id = new_ssl_context_id();
+	TEST_CHECK(!tm.take_http_connection(other));
+#endif
+
+	auto const c = tm.take_http_connection(key);
+	TEST_CHECK(c == c1);
+	TEST_EQUAL(h.m_stats_counters[counters::num_idle_http_tracker_connections], 0);
+	TEST_EQUAL(h.m_stats_counters[counters::http_tracker_connections_reused], 1);
+	TEST_CHECK(!tm.take_http_connection(key));
+
+	// the connection is still open, the next request doesn't make a new one
+	bool done = false;
+	c->set_handlers([&done](error_code const& ec, aux::http_parser const& p
+		, span<char const>, aux::http_connection&)
+		{
+			TEST_CHECK(!ec);
+			TEST_EQUAL(p.status_code(), 200);
+			done = true;
+		}, nullptr, nullptr, nullptr);
+	c->get("http://127.0.0.1:" + std::to_string(server.port()) + "/announce", seconds(5));
+	time_point const deadline = clock_type::now() + seconds(5);
+	while (!done && clock_type::now() < deadline)
+		ios.run_one_for(milliseconds(50));
+	TEST_CHECK(done);
+	TEST_EQUAL(server.connections, 2);
+
+	c->close();
+	h.m_tracker_manager.abort_all_requests(true);
+	ios.run_for(milliseconds(100));
+}
+
+TORRENT_TEST(http_connection_pool_expire)
+{
+	io_context ios;
+	aux::session_settings sett;
+	sett.set_int(settings_pack::tracker_keep_alive_timeout, 1);
+	tracker_manager_handler h{ios, sett};
+	tracker_manager& tm = h.m_tracker_manager;
+	keep_alive_server server(ios);
+	http_tracker_key const key = local_key(server.port());
+
+	auto const c = idle_connection(ios, h.m_host_resolver, server.port());
+	tm.return_http_connection(ios, key, c);
+	TEST_EQUAL(h.m_stats_counters[counters::num_idle_http_tracker_connections], 1);
+
+	// idle connections are closed once the keep-alive timeout passes
+	ios.run_for(milliseconds(1500));
+	TEST_EQUAL(h.m_stats_counters[counters::num_idle_http_tracker_connections], 0);
+	TEST_CHECK(!c->idle());
+	TEST_CHECK(!tm.take_http_connection(key));
+	TEST_EQUAL(h.m_stats_counters[counters::http_tracker_connections_reused], 0);
+
+	// with keep-alive disabled, they're closed right away
+	sett.set_int(settings_pack::tracker_keep_alive_timeout, 0);
+	auto const c2 = idle_connection(ios, h.m_host_resolver, server.port());
+	tm.return_http_connection(ios, key, c2);
+	TEST_EQUAL(h.m_stats_counters[counters::num_idle_http_tracker_connections], 0);
+	TEST_CHECK(!c2->idle());
+	TEST_CHECK(!tm.take_http_connection(key));
+
+	h.m_tracker_manager.abort_all_requests(true);
+	ios.run_for(milliseconds(100));
+}
+
+#if TORRENT_USE_SSL
+TORRENT_TEST(ssl_session_cache)
+{
+	io_context ios;
+	aux::session_settings sett;
+	tracker_manager_handler h{ios, sett};
+	tracker_manager& tm = h.m_tracker_manager;
+
+	auto const new_session = []
+	{
+#ifdef TORRENT_USE_OPENSSL
+		return ssl::session_handle(SSL_SESSION_new(), &SSL_SESSION_free);
+#else
+		return std::make_shared<std::vector<char>>(1, 'x');
+#endif
+	};
+
+	http_tracker_key key = local_key(443);
+	key.ssl = true;
+	auto const s = new_session();
+	tm.save_ssl_session(key, s);
+	TEST_CHECK(tm.ssl_session(key) == s);
+
+	// sessions are per SSL context
+	http_tracker_key other = key;
+	other.ssl_ctx_id = new_ssl_context_id();
+	TEST_CHECK(!tm.ssl_session(other));
+
+	// the cache doesn't grow forever, the oldest sessions are dropped
+	for (int i = 0; i < 200; ++i)
+	{
+		http_tracker_key k = key;
+		k.hostname = "tracker" + std::to_string(i) + ".test";
+		tm.save_ssl_session(k, new_session());
+	}
+	TEST_CHECK(tm.num_ssl_sessions() < 200);
+	TEST_CHECK(!tm.ssl_session(key));
+	http_tracker_key last = key;
+	last.hostname = "tracker199.test";
+	TEST_CHECK(tm.ssl_session(last));
+}
+#endif
@@ -0,0 +1,107 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "test.hpp"
+#include "libtorrent/aux_/web_peer_connection.hpp"
+#include "libtorrent/peer_request.hpp"
+
+#include <deque>
+
+using namespace lt;
+using lt::aux::add_pending_request;
+using lt::aux::web_seed_pipeline_depth;
+
+namespace {
+
+int const piece_size = 0x8000;
+int const block_size = 0x4000;
+
+peer_request req(int const piece, int const start, int const length)
+{
+	peer_request r;
+	r.piece = piece_index_t(piece);
+	r.start = start;
+	r.length = length;
+	return r;
+}
+
+}
+
+TORRENT_TEST(merge_adjacent_requests)
+{
+	std::deque<peer_request> pending;
+	TEST_CHECK(!add_pending_request(pending, req(0, 0, block_size), piece_size, 0x100000));
+	TEST_CHECK(add_pending_request(pending, req(0, block_size, block_size), piece_size, 0x100000));
+	TEST_EQUAL(pending.size(), 1);
+	TEST_CHECK(pending.front() == req(0, 0, piece_size));
+}
+
+TORRENT_TEST(merge_across_pieces)
+{
+	// the HTTP request may span pieces
+	std::deque<peer_request> pending;
+	add_pending_request(pending, req(3, block_size, block_size), piece_size, 0x100000);
+	TEST_CHECK(add_pending_request(pending, req(4, 0, block_size), piece_size, 0x100000));
+	TEST_EQUAL(pending.size(), 1);
+	TEST_CHECK(pending.front() == req(3, block_size, 2 * block_size));
+}
+
+TORRENT_TEST(merge_only_contiguous)
+{
+	std::deque<peer_request> pending;
+	add_pending_request(pending, req(0, 0, block_size), piece_size, 0x100000);
+
+	// a gap
+	TEST_CHECK(!add_pending_request(pending, req(1, 0, block_size), piece_size, 0x100000));
+	TEST_EQUAL(pending.size(), 2);
+
+	// only the last request is extended, not earlier ones
+	TEST_CHECK(!add_pending_request(pending, req(0, block_size, block_size), piece_size, 0x100000));
+	TEST_EQUAL(pending.size(), 3);
+
+	// going backwards
+	TEST_CHECK(!add_pending_request(pending, req(0, 0, block_size), piece_size, 0x100000));
+	TEST_EQUAL(pending.size(), 4);
+}
+
+TORRENT_TEST(merge_max_request_bytes)
+{
+	// requests aren't merged beyond urlseed_max_request_bytes
+	std::deque<peer_request> pending;
+	add_pending_request(pending, req(0, 0, block_size), piece_size, 2 * block_size);
+	TEST_CHECK(add_pending_request(pending, req(0, block_size, block_size), piece_size, 2 * block_size));
+	TEST_CHECK(!add_pending_request(pending, req(1, 0, block_size), piece_size, 2 * block_size));
+	TEST_EQUAL(pending.size(), 2);
+	TEST_CHECK(pending[0] == req(0, 0, 2 * block_size));
+	TEST_CHECK(pending[1] == req(1, 0, block_size));
+}
+
+TORRENT_TEST(merge_large_torrent)
+{
+	// byte offsets beyond 2 GiB don't overflow
+	int const large_piece = 4 * 1024 * 1024;
+	std::deque<peer_request> pending;
+	add_pending_request(pending, req(1000, large_piece - block_size, block_size), large_piece, 0x100000);
+	TEST_CHECK(add_pending_request(pending, req(1001, 0, block_size), large_piece, 0x100000));
+	TEST_EQUAL(pending.size(), 1);
+}
+
+TORRENT_TEST(pipeline_depth)
+{
+	// the default urlseed_pipeline_size
+	TEST_EQUAL(web_seed_pipeline_depth(true, 5), 5);
+	TEST_EQUAL(web_seed_pipeline_depth(true, 1), 1);
+
+	// there's always room for one request
+	TEST_EQUAL(web_seed_pipeline_depth(true, 0), 1);
+	TEST_EQUAL(web_seed_pipeline_depth(true, -3), 1);
+
+	// servers without keep-alive only get one request at a time
+	TEST_EQUAL(web_seed_pipeline_depth(false, 5), 1);
+}
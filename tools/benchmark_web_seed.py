@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+# vim: tabstop=8 expandtab shiftwidth=4 softtabstop=4
+
+# this benchmark measures the download rate of a single web seed connection
+# over links with different round-trip times, for different HTTP pipeline
+# depths (the urlseed_pipeline_size setting). The web server is
+# test/web_server.py, and the round-trip time is simulated by a proxy that
+# delays all data by half the RTT in each direction.
+
+import os
+import shutil
+import socket
+import subprocess
+import sys
+import threading
+import time
+
+toolset = ''
+if len(sys.argv) > 1:
+    toolset = sys.argv[1]
+
+rtts = [0, 10, 50, 100]
+pipeline_sizes = [1, 2, 5, 10]
+
+# the size of the test file, in MiB
+file_size = 64
+
+server_port = 8200
+proxy_port = 8201
+
+ret = os.system('cd ../examples && b2 release %s stage' % toolset)
+if ret != 0:
+    print('ERROR: build failed: %d' % ret)
+    sys.exit(1)
+
+if not os.path.exists('web_seed_benchmark_root'):
+    os.mkdir('web_seed_benchmark_root')
+    with open('web_seed_benchmark_root/web_seed_benchmark', 'wb') as f:
+        for i in range(file_size):
+            f.write(os.urandom(1024 * 1024))
+
+if not os.path.exists('web_seed_benchmark.torrent'):
+    ret = os.system('../examples/make_torrent web_seed_benchmark_root/web_seed_benchmark '
+                    '-w http://127.0.0.1:%d/ -o web_seed_benchmark.torrent' % proxy_port)
+    if ret != 0:
+        print('ERROR: make_torrent failed: %d' % ret)
+        sys.exit(1)
+
+
+class delay_proxy(threading.Thread):
+    # forwards connections to server_port, holding back all data for
+    # ``delay`` seconds in each direction
+
+    def __init__(self, delay):
+        threading.Thread.__init__(self, daemon=True)
+        self.delay = delay
+        self.listen = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.listen.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.listen.bind(('127.0.0.1', proxy_port))
+        self.listen.listen(5)
+
+    def run(self):
+        while True:
+            try:
+                client, _ = self.listen.accept()
+            except Exception:
+                return
+            server = socket.create_connection(('127.0.0.1', server_port))
+            self.pump(client, server)
+            self.pump(server, client)
+
+    def pump(self, src, dst):
+        cond = threading.Condition()
+        queue = []
+
+        def receive():
+            while True:
+                try:
+                    buf = src.recv(65536)
+                except Exception:
+                    buf = b''
+                with cond:
+                    queue.append((time.time() + self.delay, buf))
+                    cond.notify()
+                if len(buf) == 0:
+                    return
+
+        def send():
+            while True:
+                with cond:
+                    while len(queue) == 0:
+                        cond.wait()
+                    deadline, buf = queue.pop(0)
+                wait = deadline - time.time()
+                if wait > 0:
+                    time.sleep(wait)
+                try:
+                    if len(buf) == 0:
+                        dst.shutdown(socket.SHUT_WR)
+                        return
+                    dst.sendall(buf)
+                except Exception:
+                    return
+
+        threading.Thread(target=receive, daemon=True).start()
+        threading.Thread(target=send, daemon=True).start()
+
+    def close(self):
+        self.listen.close()
+
+
+def run_test(rtt, pipeline_size):
+    name = 'rtt%d_pipeline%d' % (rtt, pipeline_size)
+    output_dir = 'logs_web_seed_%s' % name
+
+    try:
+        shutil.rmtree(output_dir)
+    except Exception:
+        pass
+    os.mkdir(output_dir)
+
+    for p in ['.ses_state', '.resume']:
+        try:
+            if os.path.isdir(p):
+                shutil.rmtree(p)
+            else:
+                os.remove(p)
+        except Exception:
+            pass
+
+    server_out = open('%s/server.out' % output_dir, 'w+')
+    server = subprocess.Popen([sys.executable, '../../test/web_server.py',
+                               str(server_port), '0', '0', '1', '0'],
+                              cwd='web_seed_benchmark_root', stdout=server_out,
+                              stderr=server_out)
+    time.sleep(1)
+
+    proxy = delay_proxy(rtt / 2000.0)
+    proxy.start()
+
+    client_cmd = '../examples/client_test web_seed_benchmark.torrent ' \
+                 '--enable_dht=0 --enable_lsd=0 --enable_upnp=0 --enable_natpmp=0 ' \
+                 '--urlseed_pipeline_size=%d -1 -s %s' \
+                 % (pipeline_size, output_dir)
+
+    client_out = open('%s/client.out' % output_dir, 'w+')
+    print(client_cmd)
+    start_time = time.time()
+    c = subprocess.Popen(client_cmd.split(' '), stdout=client_out, stderr=client_out, stdin=subprocess.PIPE)
+    c.wait()
+    end_time = time.time()
+
+    client_out.close()
+    proxy.close()
+    server.kill()
+    server.wait()
+    server_out.close()
+
+    rate = file_size / (end_time - start_time)
+    print('%s: %.2f MiB/s' % (name, rate))
+    with open('%s/rate.txt' % output_dir, 'w+') as f:
+        f.write('%s: %.2f\n' % (name, rate))
+    return rate
+
+
+results = {}
+for rtt in rtts:
+    for pipeline_size in pipeline_sizes:
+        results[(rtt, pipeline_size)] = run_test(rtt, pipeline_size)
+
+print('download rate (MiB/s)')
+print('RTT (ms)  ' + ''.join(['pipeline %-4d' % p for p in pipeline_sizes]))
+for rtt in rtts:
+    print('%-10d' % rtt + ''.join(['%-13.2f' % results[(rtt, p)] for p in pipeline_sizes]))
@@ -14,6 +14,10 @@ see LICENSE file.
 #include "libtorrent/flags.hpp"
 #include "libtorrent/performance_counters.hpp"
 #include "libtorrent/add_torrent_params.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/aux_/disk_buffer_pool.hpp"
+#include "libtorrent/aux_/store_buffer.hpp"
+#include "libtorrent/aux_/file_view_pool.hpp"
 
 // TODO: remove this dependency
 #include "libtorrent/aux_/path.hpp"
@@ -22,6 +26,8 @@ see LICENSE file.
 #include <algorithm>
 #include <vector>
 #include <iostream>
+#include <thread>
+#include <atomic>
 
 using disk_test_mode_t = lt::flags::bitfield_flag<std::uint8_t, struct disk_test_mode_tag>;
 
@@ -85,13 +91,15 @@ int run_test(disk_test_mode_t const flags
 	, int const file_pool_size
 	, int const num_files
 	, int const queue_limit
-	, int const read_multiplier) try
+	, int const read_multiplier
+	, int const slab_size) try
 {
 	lt::io_context ioc;
 	lt::counters cnt;
 	lt::settings_pack pack;
 	pack.set_int(lt::settings_pack::aio_threads, num_threads);
 	pack.set_int(lt::settings_pack::file_pool_size, file_pool_size);
+	pack.set_int(lt::settings_pack::disk_buffer_slab_size, slab_size);
 
 	std::unique_ptr<lt::disk_interface> disk_io
 		= lt::default_disk_io_constructor(ioc, pack, cnt);
@@ -122,9 +130,12 @@ int run_test(disk_test_mode_t const flags
 		<< num_pieces << '-'
 		<< file_pool_size << '-'
 		<< queue_limit << '-'
-		<< read_multiplier
+		<< read_multiplier << '-'
+		<< (slab_size > 0 ? "slab" : "malloc")
 		<< ": ";
 
+	lt::time_point const start_time = lt::clock_type::now();
+
 	// TODO: in C++17, use std::filesystem
 	remove_all("scratch-area");
 
@@ -262,7 +273,9 @@ int run_test(disk_test_mode_t const flags
 
 	disk_io->abort(true);
 
-	std::cerr << "OK\n";
+	std::int64_t const duration = std::max(lt::total_milliseconds(
+		lt::clock_type::now() - start_time), std::int64_t(1));
+	std::cerr << "OK (" << job_counter * 1000 / duration << " jobs/s)\n";
 	return 0;
 }
 catch (std::exception const& e)
@@ -271,6 +284,160 @@ catch (std::exception const& e)
 	return 1;
 }
 
+// measures the throughput of disk buffer allocations, with the pattern of
+// the disk I/O subsystem: disk threads allocate buffers for read jobs, which
+// are freed by the network thread once they've been sent
+int run_buffer_pool_benchmark(int const num_threads, int const queue_limit
+	, int const slab_size)
+{
+	lt::io_context ioc;
+	lt::aux::disk_buffer_pool pool(ioc);
+	lt::settings_pack pack;
+	pack.set_int(lt::settings_pack::disk_buffer_slab_size, slab_size);
+	pack.set_int(lt::settings_pack::max_queued_disk_bytes
+		, queue_limit * num_threads * lt::default_block_size);
+	pool.set_settings(pack);
+
+	int const rounds = 20000;
+	int const batch = 10;
+	std::vector<std::vector<char*>> queues{std::size_t(num_threads)};
+
+	lt::time_point const start_time = lt::clock_type::now();
+	for (int r = 0; r < rounds; r += batch)
+	{
+		std::vector<std::thread> threads;
+		for (int t = 0; t < num_threads; ++t)
+		{
+			threads.emplace_back([&, t]
+			{
+				auto& allocated = queues[std::size_t(t)];
+				for (int i = 0; i < batch; ++i)
+				{
+					for (int j = 0; j < queue_limit; ++j)
+						allocated.push_back(pool.allocate_buffer("send buffer"));
+					// half of them are freed by the disk thread itself, like
+					// hash jobs do. The rest are freed by the network thread
+					for (int j = 0; j < queue_limit / 2; ++j)
+					{
+						pool.free_buffer(allocated.back());
+						allocated.pop_back();
+					}
+				}
+			});
+		}
+		for (auto& t : threads) t.join();
+
+		for (auto& allocated : queues)
+		{
+			pool.free_multiple_buffers(allocated);
+			allocated.clear();
+		}
+	}
+
+	std::int64_t const duration = std::max(lt::total_microseconds(
+		lt::clock_type::now() - start_time), std::int64_t(1));
+	std::int64_t const ops = std::int64_t(rounds) * num_threads * queue_limit * 2;
+	std::cerr << "BUFFER POOL: " << num_threads << " threads "
+		<< (slab_size > 0 ? "slab" : "malloc") << ": "
+		<< ops * 1000000 / duration << " alloc+free/s\n";
+	return pool.in_use() == 0 ? 0 : 1;
+}
+
+// measures contention on the store buffer. Each thread acts like a disk
+// thread completing write jobs for its own torrent, while also looking up
+// blocks the way async_read() does for all torrents
+template <int Shards>
+int run_store_buffer_benchmark(int const num_threads, int const queue_limit)
+{
+	lt::aux::basic_store_buffer<Shards> sb;
+	char const buf = 0;
+
+	int const rounds = 20000;
+	lt::time_point const start_time = lt::clock_type::now();
+	std::atomic<int> hits{0};
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&, t]
+		{
+			lt::storage_index_t const st(t);
+			for (int r = 0; r < rounds; ++r)
+			{
+				for (int i = 0; i < queue_limit; ++i)
+					sb.insert({st, lt::piece_index_t(r), i * lt::default_block_size}, &buf);
+				for (int i = 0; i < queue_limit; ++i)
+				{
+					lt::storage_index_t const other((t + i) % num_threads);
+					if (sb.get({other, lt::piece_index_t(r), i * lt::default_block_size}
+						, [](char const*) {}))
+						++hits;
+				}
+				for (int i = 0; i < queue_limit; ++i)
+					sb.erase({st, lt::piece_index_t(r), i * lt::default_block_size});
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+
+	std::int64_t const duration = std::max(lt::total_microseconds(
+		lt::clock_type::now() - start_time), std::int64_t(1));
+	std::int64_t const ops = std::int64_t(rounds) * num_threads * queue_limit * 3;
+	std::cerr << "STORE BUFFER: " << num_threads << " threads " << Shards
+		<< " shards: " << ops * 1000000 / duration << " ops/s ("
+		<< hits << " hits)\n";
+	return 0;
+}
+
+#if TORRENT_HAVE_MMAP
+// measures the throughput of file_view_pool lookups that hit an already open
+// file, the way disk threads look up files for every read and write job
+int run_file_view_pool_benchmark(int const num_threads, int const num_files
+	, int const shards)
+{
+	remove_all("scratch-area");
+	lt::error_code ec;
+	lt::create_directory("scratch-area", ec);
+	std::string const save_path = lt::complete("scratch-area");
+
+	lt::file_storage fs;
+	for (int i = 0; i < num_files; ++i)
+		fs.add_file("test/" + std::to_string(i), 0x4000);
+	lt::create_directory(lt::combine_path(save_path, "test"), ec);
+
+	lt::aux::file_view_pool pool(num_files + 1, shards);
+	lt::storage_index_t const st(0);
+	for (lt::file_index_t i : fs.file_range())
+		pool.open_file(st, save_path, i, fs, lt::aux::open_mode::write);
+
+	int const rounds = 200000;
+	lt::time_point const start_time = lt::clock_type::now();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; ++t)
+	{
+		threads.emplace_back([&, t]
+		{
+			for (int r = 0; r < rounds; ++r)
+			{
+				lt::file_index_t const f((r + t * 7) % num_files);
+				pool.open_file(st, save_path, f, fs, lt::aux::open_mode::read_only);
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+
+	std::int64_t const duration = std::max(lt::total_microseconds(
+		lt::clock_type::now() - start_time), std::int64_t(1));
+	std::int64_t const ops = std::int64_t(rounds) * num_threads;
+	std::cerr << "FILE VIEW POOL: " << num_threads << " threads " << shards
+		<< " shards: " << ops * 1000000 / duration << " lookups/s\n";
+
+	int const ret = pool.num_files() == num_files ? 0 : 1;
+	pool.release();
+	remove_all("scratch-area");
+	return ret;
+}
+#endif
+
 int main(int, char const*[])
 {
 	// TODO: make it possible to run a test with all custom arguments from the
@@ -283,11 +450,23 @@ int main(int, char const*[])
 	int file_pool_size = 10;
 
 	int ret = 0;
-	ret |= run_test(test_mode::sparse, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
-	ret |= run_test(test_mode::sparse | test_mode::even_file_sizes, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
-	ret |= run_test(test_mode::read_random_order | test_mode::sparse, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
-	ret |= run_test(test_mode::read_random_order | test_mode::sparse | test_mode::even_file_sizes, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
-	ret |= run_test(test_mode::flush_files | test_mode::read_random_order | test_mode::sparse | test_mode::even_file_sizes, num_threads, file_pool_size, num_files, queue_size, read_multiplier);
+	ret |= run_store_buffer_benchmark<1>(num_threads, queue_size);
+	ret |= run_store_buffer_benchmark<32>(num_threads, queue_size);
+#if TORRENT_HAVE_MMAP
+	ret |= run_file_view_pool_benchmark(num_threads, num_files, 1);
+	ret |= run_file_view_pool_benchmark(num_threads, num_files, 16);
+#endif
+
+	for (int const slab_size : {0, 4 * 1024 * 1024})
+	{
+		ret |= run_buffer_pool_benchmark(num_threads, queue_size, slab_size);
+
+		ret |= run_test(test_mode::sparse, num_threads, file_pool_size, num_files, queue_size, read_multiplier, slab_size);
+		ret |= run_test(test_mode::sparse | test_mode::even_file_sizes, num_threads, file_pool_size, num_files, queue_size, read_multiplier, slab_size);
+		ret |= run_test(test_mode::read_random_order | test_mode::sparse, num_threads, file_pool_size, num_files, queue_size, read_multiplier, slab_size);
+		ret |= run_test(test_mode::read_random_order | test_mode::sparse | test_mode::even_file_sizes, num_threads, file_pool_size, num_files, queue_size, read_multiplier, slab_size);
+		ret |= run_test(test_mode::flush_files | test_mode::read_random_order | test_mode::sparse | test_mode::even_file_sizes, num_threads, file_pool_size, num_files, queue_size, read_multiplier, slab_size);
+	}
 
 	return ret;
 }
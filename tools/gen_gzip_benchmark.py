@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+# vim: tabstop=8 expandtab shiftwidth=4 softtabstop=4
+
+# generates the inputs for gzip_benchmark, in the current directory:
+#
+# scrape.gz  a bencoded scrape response for many torrents, the kind of
+#            gzipped response trackers send
+# text.gz    a few MiB of text
+# random.gz  incompressible data, which deflate stores in stored blocks
+
+import gzip
+import random
+
+rng = random.Random(1337)
+
+
+def scrape_response(num_torrents):
+    files = b''
+    for i in range(num_torrents):
+        info_hash = bytes(rng.getrandbits(8) for _ in range(20))
+        files += b'20:' + info_hash
+        files += b'd8:completei%de10:downloadedi%de10:incompletei%dee' % (
+            rng.randrange(10000), rng.randrange(100000), rng.randrange(1000))
+    return b'd5:filesd' + files + b'ee'
+
+
+def text(size):
+    words = ['peer', 'piece', 'block', 'request', 'choke', 'unchoke', 'have',
+             'interested', 'tracker', 'announce', 'torrent', 'session', 'the',
+             'a', 'of', 'to', 'and', 'is', 'for', 'with', 'bitfield', 'hash']
+    out = []
+    length = 0
+    while length < size:
+        line = ' '.join(rng.choice(words) for _ in range(rng.randrange(4, 16)))
+        line += ' %d\n' % rng.randrange(100000)
+        out.append(line)
+        length += len(line)
+    return ''.join(out).encode()[:size]
+
+
+inputs = {
+    'scrape.gz': scrape_response(50000),
+    'text.gz': text(4 * 1024 * 1024),
+    'random.gz': bytes(rng.getrandbits(8) for _ in range(4 * 1024 * 1024)),
+}
+
+for name, data in inputs.items():
+    compressed = gzip.compress(data, compresslevel=9, mtime=0)
+    with open(name, 'wb') as f:
+        f.write(compressed)
+    print('%s: %d bytes (%d inflated)' % (name, len(compressed), len(data)))
@@ -0,0 +1,84 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "libtorrent/gzip.hpp"
+#include "libtorrent/time.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// measures the throughput of inflating gzip files with lt::inflate_gzip().
+//
+// usage: gzip_benchmark [rounds] [file.gz...]
+//
+// by default, the inputs are test/zeroes.gz and the files generated by
+// gen_gzip_benchmark.py (run it in this directory first).
+
+namespace {
+
+// the maximum size of the inflated data
+int const maximum_size = 64 * 1024 * 1024;
+
+std::size_t gzip_inflate(std::vector<char> const& in, std::vector<char>& buffer)
+{
+	lt::error_code ec;
+	lt::inflate_gzip(in, buffer, maximum_size, ec);
+	if (ec) return 0;
+	return buffer.size();
+}
+
+void run(char const* name, std::size_t (*fun)(std::vector<char> const&, std::vector<char>&)
+	, std::vector<char> const& in, int const rounds)
+{
+	std::size_t inflated = 0;
+	auto const start = lt::clock_type::now();
+	for (int i = 0; i < rounds; ++i)
+	{
+		std::vector<char> buffer;
+		inflated = fun(in, buffer);
+	}
+	auto const duration = lt::clock_type::now() - start;
+
+	double const seconds = double(lt::total_microseconds(duration)) / 1000000.0;
+	double const rate = double(inflated) * rounds / seconds / 1024 / 1024;
+	std::printf("%-13s %9.1f MiB/s%s\n", name, rate, inflated > 0 ? "" : "  (FAILED)");
+}
+
+} // anonymous namespace
+
+int main(int argc, char const* argv[])
+{
+	int const rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+
+	std::vector<std::string> files;
+	for (int i = 2; i < argc; ++i) files.emplace_back(argv[i]);
+	if (files.empty())
+		files = {"../test/zeroes.gz", "scrape.gz", "text.gz", "random.gz"};
+
+	for (auto const& f : files)
+	{
+		std::ifstream file(f, std::ios::binary);
+		if (!file)
+		{
+			std::printf("%s: failed to open\n", f.c_str());
+			continue;
+		}
+		std::vector<char> const in{std::istreambuf_iterator<char>(file)
+			, std::istreambuf_iterator<char>()};
+
+		std::vector<char> out;
+		std::printf("%s: %d bytes (%d inflated)\n", f.c_str(), int(in.size())
+			, int(gzip_inflate(in, out)));
+		run("inflate-gzip", &gzip_inflate, in, rounds);
+	}
+}
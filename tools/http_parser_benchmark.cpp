@@ -0,0 +1,214 @@
+/*
+
+Copyright (c) 2026, Arvid Norberg
+All rights reserved.
+
+You may use, distribute and modify this code under the terms of the BSD license,
+see LICENSE file.
+*/
+
+#include "libtorrent/aux_/http_parser.hpp"
+#include "libtorrent/span.hpp"
+#include "libtorrent/time.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+// measures the throughput of parsing the bodies of synthetic chunked HTTP
+// responses, the way web_peer_connection receives them: the response is
+// received in reads of a fixed size into a receive buffer, the payload is
+// delivered and the bytes that have been dealt with are cut from the front
+// of the buffer.
+//
+// "chunk-header" is the approach of parsing each chunk header with
+// parse_chunk_header() once it has been received in full, "parse-body" is
+// the incremental http_parser::parse_body().
+
+namespace {
+
+using lt::span;
+using lt::aux::http_parser;
+
+std::string make_response(int const body_size, int const min_chunk, int const max_chunk
+	, std::string& body)
+{
+	std::mt19937 rng(0x1337);
+	std::uniform_int_distribution<int> chunk_dist(min_chunk, max_chunk);
+
+	body.resize(std::size_t(body_size));
+	for (auto& c : body) c = char(rng());
+
+	std::string ret = "HTTP/1.1 200 OK\r\n"
+		"Content-Type: application/octet-stream\r\n"
+		"Transfer-Encoding: chunked\r\n"
+		"\r\n";
+
+	int pos = 0;
+	while (pos < body_size)
+	{
+		int const size = std::min(chunk_dist(rng), body_size - pos);
+		char header[20];
+		std::snprintf(header, sizeof(header), "%x\r\n", size);
+		ret += header;
+		ret.append(body, std::size_t(pos), std::size_t(size));
+		ret += "\r\n";
+		pos += size;
+	}
+	ret += "0\r\n\r\n";
+	return ret;
+}
+
+struct receiver
+{
+	explicit receiver(std::string const& r) : response(r) {}
+
+	// appends the next read to the receive buffer. Returns false at the end
+	// of the response
+	bool read(int const read_size)
+	{
+		if (pos == response.size()) return false;
+		std::size_t const n = std::min(response.size() - pos, std::size_t(read_size));
+		buffer.insert(buffer.end(), response.begin() + std::ptrdiff_t(pos)
+			, response.begin() + std::ptrdiff_t(pos + n));
+		pos += n;
+		return true;
+	}
+
+	void cut(std::ptrdiff_t const n)
+	{
+		buffer.erase(buffer.begin(), buffer.begin() + n);
+	}
+
+	void deliver(span<char const> payload)
+	{
+		// this stands in for copying the payload into the piece buffer
+		received += std::size_t(payload.size());
+	}
+
+	std::string const& response;
+	std::size_t pos = 0;
+	std::vector<char> buffer;
+	std::size_t received = 0;
+};
+
+// receives and parses the header, returns false on failure
+bool parse_header(http_parser& p, receiver& r, int const read_size)
+{
+	for (;;)
+	{
+		if (!r.read(read_size)) return false;
+		bool error = false;
+		p.incoming(r.buffer, error);
+		if (error) return false;
+		if (p.header_finished()) break;
+	}
+	r.cut(p.body_start());
+	return true;
+}
+
+// the previous approach in web_peer_connection: chunk headers are parsed
+// once they have been received in full, a partial header is left in the
+// receive buffer and parsed again from its start on the next read
+std::size_t chunk_header(std::string const& response, int const read_size)
+{
+	http_parser p(http_parser::dont_parse_chunks);
+	receiver r(response);
+	if (!parse_header(p, r, read_size)) return 0;
+
+	std::int64_t chunk_left = 0;
+	bool done = false;
+	while (!done)
+	{
+		span<char const> buf = r.buffer;
+		for (;;)
+		{
+			if (chunk_left > 0 && !buf.empty())
+			{
+				auto const n = std::ptrdiff_t(std::min(chunk_left, std::int64_t(buf.size())));
+				r.deliver(buf.first(n));
+				buf = buf.subspan(n);
+				chunk_left -= n;
+			}
+			if (buf.empty()) break;
+
+			std::int64_t chunk_size = 0;
+			int header_size = 0;
+			if (!p.parse_chunk_header(buf, &chunk_size, &header_size)) break;
+			if (chunk_size < 0) return 0;
+			buf = buf.subspan(header_size);
+			if (chunk_size == 0)
+			{
+				done = true;
+				break;
+			}
+			chunk_left = chunk_size;
+		}
+		r.cut(buf.data() - r.buffer.data());
+		if (!done && !r.read(read_size)) return 0;
+	}
+	return r.received;
+}
+
+std::size_t parse_body(std::string const& response, int const read_size)
+{
+	http_parser p(http_parser::dont_parse_chunks);
+	receiver r(response);
+	if (!parse_header(p, r, read_size)) return 0;
+
+	while (!p.body_finished())
+	{
+		span<char const> buf = r.buffer;
+		while (!buf.empty() && !p.body_finished())
+		{
+			bool error = false;
+			span<char const> const payload = p.parse_body(buf, error);
+			if (error) return 0;
+			if (!payload.empty()) r.deliver(payload);
+		}
+		r.cut(buf.data() - r.buffer.data());
+		if (!p.body_finished() && !r.read(read_size)) return 0;
+	}
+	return r.received;
+}
+
+void run(char const* name, std::size_t (*fun)(std::string const&, int)
+	, std::string const& response, std::string const& body, int const read_size
+	, int const rounds)
+{
+	auto const start = lt::clock_type::now();
+	std::size_t result = 0;
+	for (int i = 0; i < rounds; ++i) result = fun(response, read_size);
+	auto const duration = lt::clock_type::now() - start;
+
+	double const seconds = double(lt::total_microseconds(duration)) / 1000000.0;
+	double const rate = double(response.size()) * rounds / seconds / 1024 / 1024;
+	std::printf("%-13s read: %6d  %9.1f MiB/s%s\n", name, read_size, rate
+		, result == body.size() ? "" : "  (FAILED)");
+}
+
+} // anonymous namespace
+
+int main(int argc, char const* argv[])
+{
+	int const rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+	int const body_size = 16 * 1024 * 1024;
+
+	struct { int min_chunk; int max_chunk; } const chunkings[] = {
+		{0x900, 0x900}, {1, 1024}, {1, 64 * 1024}, {256 * 1024, 256 * 1024}};
+
+	for (auto const& c : chunkings)
+	{
+		std::string body;
+		std::string const response = make_response(body_size, c.min_chunk, c.max_chunk, body);
+		std::printf("chunk size: %d - %d bytes\n", c.min_chunk, c.max_chunk);
+		for (int const read_size : {1460, 16 * 1024, 64 * 1024})
+		{
+			run("chunk-header", &chunk_header, response, body, read_size, rounds);
+			run("parse-body", &parse_body, response, body, read_size, rounds);
+		}
+	}
+}
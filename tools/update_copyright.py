@@ -7,7 +7,7 @@ import os
 
 
 def update_file(name):
-    if os.path.split(name)[1] in ['puff.cpp', 'puff.hpp', 'sha1.cpp', 'sha1.hpp', 'route.h']:
+    if os.path.split(name)[1] in ['sha1.cpp', 'sha1.hpp', 'route.h']:
         return
 
     new_header = copyright.get_authors(name)